@@ -0,0 +1,74 @@
+#ifndef PARALLEL_CBS_BATCH_H
+#define PARALLEL_CBS_BATCH_H
+
+#include "instance_io.h"
+
+/* Default budget of the goal distance tables kept between the instances of a batch */
+#define BATCH_DEFAULT_CACHE_MB 256.0
+
+/* One instance of a batch: a map and scenario, or a packed instance */
+typedef struct
+{
+    /** Map file (NULL for a packed instance) */
+    char *map_path;
+    /** Scenario file (NULL for a packed instance) */
+    char *agents_path;
+    /** Packed instance file (NULL for a map and scenario) */
+    char *instance_path;
+    /** Agents of the scenario to plan for */
+    AgentSelection selection;
+} ManifestEntry;
+
+/* Instances of a batch run, in manifest order */
+typedef struct
+{
+    /** Array of entries */
+    ManifestEntry *entries;
+    /** Number of entries */
+    int count;
+    /** Capacity of the entries array */
+    int capacity;
+} Manifest;
+
+/*
+Map and goal distance tables kept between the instances of a batch.
+Scenarios of one map share the map, and scenarios that slice the same
+file share goals, so a loader that keeps both only parses each map once
+and only runs a BFS for goals it has not seen.
+*/
+typedef struct
+{
+    /** Path of the cached map, NULL while empty */
+    char *map_path;
+    /** Cached map */
+    Grid map;
+    /** Distance table per goal cell of the map, NULL where no table is kept */
+    int **tables;
+    /** Most bytes of tables to keep */
+    size_t budget_bytes;
+    /** Bytes of tables kept */
+    size_t used_bytes;
+    /** Goal tables copied from the cache */
+    long long table_hits;
+    /** Goal tables computed */
+    long long table_misses;
+} InstanceCache;
+
+void manifest_init(Manifest *manifest);
+void manifest_free(Manifest *manifest);
+void manifest_add(Manifest *manifest,
+                  const char *map_path,
+                  const char *agents_path,
+                  const char *instance_path,
+                  const AgentSelection *selection);
+bool manifest_load(const char *path, Manifest *manifest);
+const char *manifest_entry_name(const ManifestEntry *entry);
+
+void instance_cache_init(InstanceCache *cache, size_t budget_bytes);
+void instance_cache_free(InstanceCache *cache);
+bool instance_cache_load(InstanceCache *cache, const ManifestEntry *entry, ProblemInstance *instance);
+
+MPI_Comm batch_group_comm(int groups, int *out_group);
+void batch_csv_header(const char *path, const char *header);
+
+#endif /* PARALLEL_CBS_BATCH_H */
@@ -0,0 +1,44 @@
+#ifndef PARALLEL_CBS_BUCKET_QUEUE_H
+#define PARALLEL_CBS_BUCKET_QUEUE_H
+
+#include "common.h"
+
+/* LIFO stack of node indices sharing one integer key */
+typedef struct
+{
+    /** Node indices in push order */
+    int *items;
+    /** Number of indices in the bucket */
+    int count;
+    /** Capacity of the items array */
+    int capacity;
+} Bucket;
+
+/*
+Monotone bucket queue for the low-level open list.
+Keys are small non-negative integers (f-costs) used directly as bucket
+indices. Each bucket pops the most recently pushed index first, which on
+an f-plateau prefers the deepest (largest g) node and dives toward the goal.
+*/
+typedef struct
+{
+    /** Buckets indexed by key */
+    Bucket *buckets;
+    /** Number of allocated buckets */
+    int bucket_capacity;
+    /** Lowest key that may hold an index */
+    int min_key;
+    /** Highest key pushed since the last clear, -1 if none */
+    int max_key;
+    /** Total number of queued indices */
+    int count;
+} BucketQueue;
+
+void bucket_queue_init(BucketQueue *queue);
+void bucket_queue_free(BucketQueue *queue);
+void bucket_queue_clear(BucketQueue *queue);
+void bucket_queue_push(BucketQueue *queue, int key, int value);
+int bucket_queue_pop(BucketQueue *queue, int *out_key);
+int bucket_queue_peek_key(BucketQueue *queue);
+
+#endif /* PARALLEL_CBS_BUCKET_QUEUE_H */
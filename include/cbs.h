@@ -4,6 +4,8 @@
 #include "common.h"
 #include "constraints.h"
 #include "grid.h"
+#include "mdd.h"
+#include "thread_pool.h"
 
 /*
 Conflict structure representing a conflict between two agents
@@ -16,16 +18,69 @@ typedef struct
     int agent_b;
     /** Time step of the conflict */
     int time;
-    /** Position of the conflict */
-    GridCoord position;
+    /** Cell of the conflict */
+    int position;
     /** Whether the conflict is a vertex conflict */
     bool is_vertex_conflict;
-    /** Position of the edge to which the conflict occurs (for edge conflicts) */
-    GridCoord edge_to;
+    /** Cell the edge of an edge conflict leads to */
+    int edge_to;
 } Conflict;
 
+/* Effect of splitting on a conflict, from the agents' MDDs */
+typedef enum
+{
+    /** Both children may keep their cost */
+    CONFLICT_NON_CARDINAL = 0,
+    /** One child must increase its cost */
+    CONFLICT_SEMI_CARDINAL = 1,
+    /** Both children must increase their cost */
+    CONFLICT_CARDINAL = 2
+} ConflictClass;
+
+/*
+All current conflicts of a CT node, at most one (the earliest) per agent pair
+*/
+typedef struct
+{
+    /** Conflicts with agent_a < agent_b */
+    Conflict *items;
+    /** Number of conflicts */
+    int count;
+    /** Capacity of the items array */
+    int capacity;
+} ConflictTable;
+
+/*
+Reference-counted agent path shared by every CT node that has not replanned the agent
+*/
+typedef struct
+{
+    /** Path of the agent */
+    AgentPath path;
+    /** Number of nodes holding the path */
+    int refcount;
+    /** MDD of the agent for this path's cost and constraints (NULL until needed) */
+    Mdd *mdd;
+} PathRef;
+
+/*
+Link of a persistent constraint chain: a node's constraints are its own
+link followed by the links of its ancestors
+*/
+typedef struct ConstraintLink
+{
+    /** Constraint added by this link */
+    Constraint constraint;
+    /** Link of the parent node (NULL at the root) */
+    struct ConstraintLink *parent;
+    /** Number of nodes and child links holding this link */
+    int refcount;
+} ConstraintLink;
+
 /* 
-Single HighLevelNode structue, element of constraint tree
+Single HighLevelNode structue, element of constraint tree.
+Children share the parent's constraint chain and path references, so a
+child only allocates its new constraint link and its replanned path.
 */
 typedef struct
 {
@@ -37,12 +92,18 @@ typedef struct
     int depth;
     /** Cost associated with the node */
     double cost;
-    /** Set of constraints associated with the node */
-    ConstraintSet constraints;
-    /** Paths for all agents in the node */
-    AgentPath *paths;
+    /** Newest link of the constraint chain (NULL when unconstrained) */
+    ConstraintLink *constraints;
+    /** Number of constraints in the chain */
+    int constraint_count;
+    /** Shared paths for all agents in the node (NULL while the node is compressed) */
+    PathRef **paths;
     /** Number of agents */
     int num_agents;
+    /** Pairwise conflicts of the paths, kept current when a path is replaced */
+    ConflictTable conflicts;
+    /** Whether conflicts has been computed for the current paths */
+    bool conflicts_valid;
 } HighLevelNode;
 
 /* 
@@ -58,14 +119,50 @@ typedef struct
     GridCoord *goals;
     /** Number of agents */
     int num_agents;
+    /** Exact goal distances, one width * height table per agent (NULL until built) */
+    int *heuristics;
+    /** Node-shared window holding map layers and heuristics, MPI_WIN_NULL when they are private */
+    MPI_Win shared_window;
+    /** Mapped packed instance file the map layers (and maybe heuristics) point into, NULL if none */
+    void *mapped_file;
+    /** Size of the mapping in bytes */
+    size_t mapped_bytes;
 } ProblemInstance;
 
 void problem_instance_init(ProblemInstance *instance, int num_agents);
 void problem_instance_free(ProblemInstance *instance);
+void problem_instance_release_tables(ProblemInstance *instance);
+bool problem_instance_build_heuristics(ProblemInstance *instance);
+const int *problem_instance_heuristic(const ProblemInstance *instance, int agent_id);
+
+PathRef *path_ref_create(void);
+void path_ref_retain(PathRef *ref);
+void path_ref_release(PathRef *ref);
 
 HighLevelNode *cbs_node_create(int num_agents);
+HighLevelNode *cbs_node_share(const HighLevelNode *node);
+HighLevelNode *cbs_node_create_child(const HighLevelNode *parent, Constraint constraint);
 void cbs_node_free(HighLevelNode *node);
+void cbs_node_compress(HighLevelNode *node);
+void cbs_node_add_constraint(HighLevelNode *node, Constraint constraint);
+void cbs_node_set_path(HighLevelNode *node, int agent_id, PathRef *path);
+void cbs_node_collect_constraints(const HighLevelNode *node, int agent_id, ConstraintSet *out);
+Constraint cbs_conflict_constraint(const HighLevelNode *node, const Conflict *conflict, int agent_id);
 double cbs_compute_soc(const HighLevelNode *node);
-bool cbs_detect_conflict(const HighLevelNode *node, Conflict *conflict);
+bool cbs_detect_conflict(HighLevelNode *node, Conflict *conflict);
+int cbs_count_conflicts(HighLevelNode *node);
+ConflictClass cbs_classify_conflict(HighLevelNode *node, const ProblemInstance *instance, const Conflict *conflict);
+bool cbs_select_conflict(HighLevelNode *node, const ProblemInstance *instance, Conflict *conflict, ConflictClass *out_class);
+void cbs_prepare_mdds(HighLevelNode *node, const ProblemInstance *instance, ThreadPool *threads);
+
+/* Get the path of an agent in a node
+@param node Pointer to the HighLevelNode
+@param agent_id ID of the agent
+@return Pointer to the agent's (shared, read-only) AgentPath
+*/
+static inline const AgentPath *cbs_node_path(const HighLevelNode *node, int agent_id)
+{
+    return &node->paths[agent_id]->path;
+}
 
 #endif /* PARALLEL_CBS_CBS_H */
@@ -7,11 +7,23 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
-#define MAX_AGENTS 40
 #define MAX_PATH_LENGTH 4096
 #define MAX_CONSTRAINTS 4096
 
+/*
+Wall-clock time in seconds. Safe on any thread, unlike MPI_Wtime under
+MPI_THREAD_FUNNELED, so code that may run on a helper thread uses it.
+*/
+static inline double wall_time_seconds(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
 /*
 Basic Grid Coordinate structure
 */
@@ -28,8 +40,8 @@ Agent Path structure
 */
 typedef struct
 {
-    /**Array of GridCoord steps*/
-    GridCoord *steps;
+    /**Linear cell index (y * width + x) of each step*/
+    int *steps;
     /**Current length of the path*/
     int length;
     /**Current capacity of the steps array*/
@@ -43,7 +55,7 @@ Initialize AgentPath with given capacity
 */
 static inline void path_init(AgentPath *path, int capacity)
 {
-    path->steps = capacity > 0 ? (GridCoord *)malloc(sizeof(GridCoord) * (size_t)capacity) : NULL;
+    path->steps = capacity > 0 ? (int *)malloc(sizeof(int) * (size_t)capacity) : NULL;
     path->length = 0;
     path->capacity = capacity;
 }
@@ -74,7 +86,7 @@ static inline void path_reserve(AgentPath *path, int capacity)
     {
         return;
     }
-    GridCoord *new_steps = (GridCoord *)realloc(path->steps, sizeof(GridCoord) * (size_t)capacity);
+    int *new_steps = (int *)realloc(path->steps, sizeof(int) * (size_t)capacity);
     if (!new_steps)
     {
         fprintf(stderr, "path_reserve: failed to allocate memory for path steps (size=%d)\n", capacity);
@@ -87,16 +99,16 @@ static inline void path_reserve(AgentPath *path, int capacity)
 
 /* Push new step to AgentPath
 @param path Pointer to the AgentPath
-@param coord GridCoord step to add
+@param cell Cell index of the step to add
 */
-static inline void path_push_step(AgentPath *path, GridCoord coord)
+static inline void path_push_step(AgentPath *path, int cell)
 {
     if (path->length >= path->capacity)
     {
         int new_cap = path->capacity == 0 ? 8 : path->capacity * 2;
         path_reserve(path, new_cap);
     }
-    path->steps[path->length++] = coord;
+    path->steps[path->length++] = cell;
 }
 
 /* Copy AgentPath from src to dst
@@ -107,22 +119,22 @@ static inline void path_copy(AgentPath *dst, const AgentPath *src)
 {
     path_reserve(dst, src->length);
     dst->length = src->length;
-    for (int i = 0; i < src->length; ++i)
+    if (src->length > 0)
     {
-        dst->steps[i] = src->steps[i];
+        memcpy(dst->steps, src->steps, sizeof(int) * (size_t)src->length);
     }
 }
 
 /*
 @param path Pointer to the AgentPath
 @param time_index Time index to get the position for
-@return GridCoord position of the agent at the given time index
+@return Cell index of the agent at the given time index (it stays at its goal after the path ends)
 */
-static inline GridCoord path_step_at(const AgentPath *path, int time_index)
+static inline int path_step_at(const AgentPath *path, int time_index)
 {
     if (path->length == 0)
     {
-        return (GridCoord){0, 0};
+        return 0;
     }
     if (time_index < path->length)
     {
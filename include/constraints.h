@@ -21,10 +21,10 @@ typedef struct
     int time;
     /** Type of the constraint (vertex or edge) */
     ConstraintType type;
-    /** Vertex involved in the constraint */
-    GridCoord vertex;
-    /** Destination vertex for edge constraints */
-    GridCoord edge_to;
+    /** Cell involved in the constraint */
+    int vertex;
+    /** Destination cell for edge constraints */
+    int edge_to;
 } Constraint;
 
 /* Set of constraints */
@@ -42,4 +42,71 @@ void constraint_set_init(ConstraintSet *set, int capacity);
 void constraint_set_free(ConstraintSet *set);
 void constraint_set_add(ConstraintSet *set, Constraint constraint);
 
+/* Check whether a constraint applies to an agent (negative agent_id applies to all)
+@param c Pointer to the Constraint
+@param agent_id ID of the agent
+@return true if the agent must respect the constraint
+*/
+static inline bool constraint_applies_to(const Constraint *c, int agent_id)
+{
+    return c->agent_id < 0 || c->agent_id == agent_id;
+}
+
+/* Hash slot of the constraint index, keyed by (time, from cell, to cell) */
+typedef struct
+{
+    /** Time step (vertex) or departure time step (edge), -1 marks a free slot */
+    int time;
+    /** Constrained cell (vertex) or departure cell (edge) */
+    int from;
+    /** Constrained cell (vertex) or arrival cell (edge) */
+    int to;
+} ConstraintKey;
+
+/*
+Spatio-temporal index over the constraints of a single agent.
+Vertex constraints are stored as (time, cell, cell) and edge constraints
+as (time, from, to), so a move is checked with two hash lookups instead
+of a scan over the whole ConstraintSet.
+*/
+typedef struct
+{
+    /** Open-addressing slots */
+    ConstraintKey *slots;
+    /** Number of slots (zero or a power of two) */
+    int capacity;
+    /** Number of indexed constraints */
+    int count;
+    /** Last timestep restricted by any constraint (edges restrict time + 1), -1 if none */
+    int last_time;
+    /** Constraints of the agent, kept for per-cell queries */
+    ConstraintSet filtered;
+} ConstraintIndex;
+
+void constraint_index_init(ConstraintIndex *index);
+void constraint_index_free(ConstraintIndex *index);
+void constraint_index_build(ConstraintIndex *index, const ConstraintSet *set, int agent_id);
+bool constraint_index_contains(const ConstraintIndex *index, int time, int from, int to);
+int constraint_index_last_vertex_time(const ConstraintIndex *index, int cell);
+
+/* Check whether moving from one cell to another departing at time_from is forbidden
+@param index Pointer to the ConstraintIndex
+@param time_from Departure time step
+@param from Departure cell
+@param to Arrival cell (equal to from for a wait)
+@return true if a vertex constraint at arrival or an edge constraint on the move applies
+*/
+static inline bool constraint_index_blocks(const ConstraintIndex *index, int time_from, int from, int to)
+{
+    if (index->count == 0 || time_from >= index->last_time)
+    {
+        return false;
+    }
+    if (constraint_index_contains(index, time_from + 1, to, to))
+    {
+        return true;
+    }
+    return from != to && constraint_index_contains(index, time_from, from, to);
+}
+
 #endif /* PARALLEL_CBS_CONSTRAINTS_H */
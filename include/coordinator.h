@@ -4,6 +4,11 @@
 #include "cbs.h"
 #include "low_level.h"
 
+#include <float.h>
+
+/* Default number of tasks a worker may hold before the coordinator waits for its reply */
+#define COORDINATOR_DEFAULT_INFLIGHT 2
+
 typedef struct
 {
     int *ranks;
@@ -21,11 +26,35 @@ typedef struct
     double runtime_sec;
     double comm_time_sec;    /* Time spent in MPI communication */
     double compute_time_sec; /* Time spent in CBS computation */
+    long long ll_cache_hits;   /* Low-level calls answered by the path cache */
+    long long ll_cache_misses; /* Low-level calls that ran a search */
+    long long open_peak_resident; /* Most open nodes held in memory at once */
+    long long open_compressed;    /* Open nodes reduced to their constraints */
+    long long open_spilled;       /* Open nodes written to run files */
+    double lower_bound;           /* Proven lower bound on the optimal cost when the search stopped (DBL_MAX if unknown) */
 } RunStats;
 
+/*
+@param cost Cost of the solution found
+@param lower_bound Proven lower bound on the optimal cost (DBL_MAX if unknown)
+@return Achieved suboptimality cost / lower_bound, -1 if the bound is unknown
+*/
+static inline double achieved_suboptimality(double cost, double lower_bound)
+{
+    if (lower_bound >= DBL_MAX / 2.0)
+    {
+        return -1.0;
+    }
+    return lower_bound > 0.0 ? cost / lower_bound : 1.0;
+}
+
 void run_coordinator(const ProblemInstance *instance,
                      const LowLevelContext *ll_ctx,
                      const WorkerSet *workers,
+                     int inflight_depth,
+                     bool resident_nodes,
+                     size_t open_budget_bytes,
+                     double suboptimality,
                      double timeout_seconds,
                      RunStats *stats);
 
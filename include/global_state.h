@@ -0,0 +1,98 @@
+#ifndef PARALLEL_CBS_GLOBAL_STATE_H
+#define PARALLEL_CBS_GLOBAL_STATE_H
+
+#include "common.h"
+#include "messages.h"
+
+/* Values combined by one global state round (lower bound, incumbent, timeout, terminated) */
+#define GLOBAL_STATE_FIELDS 4
+
+/*
+Global search state refreshed with non-blocking reductions.
+Each round is one MPI_Iallreduce that every rank starts on its own
+schedule; ranks keep expanding while it is in flight and only read the
+result once it completes. The flags are sent negated so a single
+MPI_MIN reduction combines all fields.
+*/
+typedef struct
+{
+    /** Communicator the rounds run on */
+    MPI_Comm comm;
+    /** Request of the round in flight */
+    MPI_Request request;
+    /** Whether a round has been started and not completed */
+    bool in_flight;
+    /** Local contribution of the round in flight */
+    double send[GLOBAL_STATE_FIELDS];
+    /** Reduced values of the round in flight */
+    double recv[GLOBAL_STATE_FIELDS];
+    /** Lowest open cost over all ranks at the last completed round */
+    double lower_bound;
+    /** Best solution cost over all ranks at the last completed round (DBL_MAX if none) */
+    double incumbent;
+    /** Whether some rank reported a timeout */
+    bool timeout;
+    /** Whether termination has been detected */
+    bool terminated;
+    /** Number of completed rounds */
+    long long rounds;
+} GlobalState;
+
+/*
+Safra's token-based termination detection over a ring of ranks.
+Every rank counts the node messages it sent minus the ones it received
+and turns black on a receive. Rank 0 sends a white token around the ring
+once passive; each rank forwards it when passive, adding its count and
+blackening it if the rank is black. Termination holds when the token
+returns white with a total of zero while rank 0 is white and passive.
+*/
+typedef struct
+{
+    /** Communicator of the ring */
+    MPI_Comm comm;
+    /** Rank in comm */
+    int rank;
+    /** Number of ranks in comm */
+    int size;
+    /** Node messages sent minus node messages received */
+    long long balance;
+    /** Whether a node message was received since the token last left */
+    bool black;
+    /** Whether this rank holds the token */
+    bool holding;
+    /** Count carried by the held token */
+    long long token_count;
+    /** Color carried by the held token */
+    bool token_black;
+    /** Whether rank 0 has a probe travelling around the ring */
+    bool probe_active;
+    /** Whether rank 0 has detected termination */
+    bool detected;
+    /** Token send in flight */
+    MPI_Request token_request;
+    /** Buffer of the token send in flight */
+    long long token_buffer[2];
+    /** Node messages and tokens sent per destination rank, interleaved */
+    long long *sent_to;
+    /** Node messages received */
+    long long node_received;
+    /** Tokens received */
+    long long token_received;
+} TerminationDetector;
+
+void global_state_init(GlobalState *state, MPI_Comm comm, double lower_bound);
+void global_state_start(GlobalState *state,
+                        double local_lower_bound,
+                        double local_incumbent,
+                        bool local_timeout,
+                        bool local_terminated);
+bool global_state_test(GlobalState *state);
+
+void termination_init(TerminationDetector *detector, MPI_Comm comm);
+void termination_free(TerminationDetector *detector);
+void termination_on_send(TerminationDetector *detector, int dest_rank);
+void termination_on_receive(TerminationDetector *detector);
+void termination_poll(TerminationDetector *detector, bool passive);
+long long termination_finish(TerminationDetector *detector);
+
+#endif /* PARALLEL_CBS_GLOBAL_STATE_H */
@@ -3,6 +3,18 @@
 
 #include "common.h"
 
+/* Number of moves an agent can make per timestep (wait and four steps) */
+#define GRID_MOVE_COUNT 5
+
+/* Move bits of Grid.moves, in the order the planners generate successors */
+#define GRID_MOVE_WAIT 0x01u
+#define GRID_MOVE_EAST 0x02u
+#define GRID_MOVE_WEST 0x04u
+#define GRID_MOVE_SOUTH 0x08u
+#define GRID_MOVE_NORTH 0x10u
+/* All moves that change the cell */
+#define GRID_MOVE_STEPS (GRID_MOVE_EAST | GRID_MOVE_WEST | GRID_MOVE_SOUTH | GRID_MOVE_NORTH)
+
 /* Grid structure representing the map */
 typedef struct
 {
@@ -10,8 +22,12 @@ typedef struct
     int width;
     /** Height of the grid */
     int height;
-    /** Array of cells representing the grid */
-    uint8_t *cells;
+    /** 64-bit words per row of the obstacle layer, rows are padded to whole words */
+    int row_words;
+    /** Bit-packed obstacle layer (1 = blocked), row_words words per row */
+    uint64_t *obstacles;
+    /** Legal moves per cell as GRID_MOVE_* bits, 0 for obstacles */
+    uint8_t *moves;
 } Grid;
 
 /* Check if location is inside map boundaries
@@ -36,11 +52,63 @@ static inline bool grid_is_obstacle(const Grid *grid, int x, int y)
     {
         return true;
     }
-    return grid->cells[y * grid->width + x] != 0;
+    uint64_t word = grid->obstacles[(size_t)y * (size_t)grid->row_words + (size_t)(x >> 6)];
+    return ((word >> (x & 63)) & 1u) != 0;
+}
+
+/*
+Legal moves out of a cell, so successor generation is one load and a loop
+over the set bits instead of bounds and obstacle checks per move
+
+@param grid Pointer to the Grid
+@param cell Cell index (y * width + x)
+@return GRID_MOVE_* bits, 0 for obstacles
+*/
+static inline unsigned int grid_moves(const Grid *grid, int cell)
+{
+    return grid->moves[cell];
+}
+
+/*
+@param from Cell the move starts from
+@param move Move index below GRID_MOVE_COUNT (bit position in Grid.moves)
+@return Cell reached by the move
+*/
+static inline GridCoord grid_apply_move(GridCoord from, int move)
+{
+    static const GridCoord offsets[GRID_MOVE_COUNT] = {{0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    return (GridCoord){.x = from.x + offsets[move].x, .y = from.y + offsets[move].y};
+}
+
+/*
+@param grid Pointer to the Grid
+@param cell Cell index the move starts from
+@param move Move index below GRID_MOVE_COUNT (bit position in Grid.moves)
+@return Cell index reached by the move
+*/
+static inline int grid_move_cell(const Grid *grid, int cell, int move)
+{
+    switch (move)
+    {
+    case 1:
+        return cell + 1;
+    case 2:
+        return cell - 1;
+    case 3:
+        return cell + grid->width;
+    case 4:
+        return cell - grid->width;
+    default:
+        return cell;
+    }
 }
 
 void grid_init(Grid *grid, int width, int height);
 void grid_free(Grid *grid);
+void grid_copy(Grid *dst, const Grid *src);
+void grid_set_obstacle(Grid *grid, int x, int y);
+void grid_build_moves(Grid *grid);
+size_t grid_obstacle_words(const Grid *grid);
 bool grid_load_from_file(Grid *grid, const char *path);
 
 #endif /* PARALLEL_CBS_GRID_H */
@@ -0,0 +1,34 @@
+#ifndef PARALLEL_CBS_HEURISTIC_H
+#define PARALLEL_CBS_HEURISTIC_H
+
+#include "common.h"
+#include "grid.h"
+
+#include <limits.h>
+
+/* Distance stored for cells that cannot reach the goal (obstacles, other components) */
+#define HEURISTIC_UNREACHABLE INT_MAX
+
+/*
+Look up the exact goal distance of a cell in a per-goal distance table
+
+@param table Distance table of size width * height (NULL falls back to Manhattan distance)
+@param grid Pointer to the Grid the table was built on
+@param cell Cell to query
+@param goal Goal the table was built for (used only by the fallback)
+@return Number of moves from cell to goal, or HEURISTIC_UNREACHABLE
+*/
+static inline int heuristic_lookup(const int *table, const Grid *grid, GridCoord cell, GridCoord goal)
+{
+    if (table == NULL)
+    {
+        int dx = cell.x > goal.x ? cell.x - goal.x : goal.x - cell.x;
+        int dy = cell.y > goal.y ? cell.y - goal.y : goal.y - cell.y;
+        return dx + dy;
+    }
+    return table[cell.y * grid->width + cell.x];
+}
+
+bool heuristic_compute_distances(const Grid *grid, GridCoord goal, int *out_table);
+
+#endif /* PARALLEL_CBS_HEURISTIC_H */
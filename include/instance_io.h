@@ -3,8 +3,31 @@
 
 #include "cbs.h"
 
+/*
+Which agents of a scenario file to plan for: the entries of one bucket
+(or all of them), sliced by offset and count in file order
+*/
+typedef struct
+{
+    /** Scenario bucket to take agents from, -1 for every bucket */
+    int bucket;
+    /** Number of matching agents to skip */
+    int offset;
+    /** Number of agents to take, 0 for all remaining */
+    int count;
+} AgentSelection;
+
+void agent_selection_init(AgentSelection *selection);
 bool load_problem_instance(const char *map_path,
                            const char *agents_path,
+                           const AgentSelection *selection,
                            ProblemInstance *instance);
+bool load_problem_agents(const Grid *map,
+                         const char *agents_path,
+                         const AgentSelection *selection,
+                         ProblemInstance *instance);
+bool save_packed_instance(const ProblemInstance *instance, const char *path, bool with_heuristics);
+bool load_packed_instance(const char *path, ProblemInstance *instance);
+void broadcast_problem_instance(ProblemInstance *instance, int root, MPI_Comm comm);
 
 #endif /* PARALLEL_CBS_INSTANCE_IO_H */
@@ -0,0 +1,68 @@
+#ifndef PARALLEL_CBS_LOAD_BALANCE_H
+#define PARALLEL_CBS_LOAD_BALANCE_H
+
+#include "global_state.h"
+#include "open_list.h"
+#include "serialization.h"
+
+/* aux_value of a TAG_DP_NODE batch donated in answer to a steal request */
+#define STEAL_GRANT_AUX 1
+
+/* First wait after a denied steal request, doubled up to STEAL_BACKOFF_MAX */
+#define STEAL_BACKOFF_MIN 0.0005
+#define STEAL_BACKOFF_MAX 0.016
+
+/*
+Work stealing between the ranks of the decentralized solver.
+An idle rank asks a random victim for work and waits for its answer
+before asking again. A victim with at least two open nodes donates every
+other node from the top of its queue (up to steal_batch), so thief and
+victim both continue with some of its best nodes. Donations are regular
+TAG_DP_NODE messages counted by the termination detector; requests and
+denials never activate a rank and are only counted here so they can be
+absorbed at shutdown.
+*/
+typedef struct
+{
+    /** Communicator of the solver ranks */
+    MPI_Comm comm;
+    /** Rank in comm */
+    int rank;
+    /** Number of ranks in comm */
+    int size;
+    /** Maximum number of nodes donated per request */
+    int steal_batch;
+    /** Whether a steal request is waiting for its answer */
+    bool request_pending;
+    /** Earliest time of the next steal request */
+    double next_request_time;
+    /** Current wait after a denial */
+    double backoff;
+    /** State of the victim picker */
+    unsigned int seed;
+    /** Requests and denials sent per destination rank, interleaved */
+    long long *sent_to;
+    /** Requests received */
+    long long requests_received;
+    /** Denials received */
+    long long denials_received;
+    /** Steal requests sent */
+    long long steals_sent;
+    /** Steal requests answered with nodes */
+    long long steals_granted;
+    /** Nodes donated to other ranks */
+    long long nodes_donated;
+} LoadBalancer;
+
+void load_balancer_init(LoadBalancer *balancer, MPI_Comm comm, int steal_batch);
+void load_balancer_free(LoadBalancer *balancer);
+void load_balancer_request(LoadBalancer *balancer);
+void load_balancer_on_grant(LoadBalancer *balancer);
+void load_balancer_poll(LoadBalancer *balancer,
+                        OpenList *open,
+                        const HighLevelNode *root,
+                        PendingSendPool *pool,
+                        TerminationDetector *detector);
+void load_balancer_finish(LoadBalancer *balancer);
+
+#endif /* PARALLEL_CBS_LOAD_BALANCE_H */
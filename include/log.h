@@ -0,0 +1,51 @@
+#ifndef PARALLEL_CBS_LOG_H
+#define PARALLEL_CBS_LOG_H
+
+#include "common.h"
+
+/* Log levels, each one includes the ones above it */
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_DEBUG 2
+#define LOG_LEVEL_TRACE 3
+
+/*
+Most verbose level compiled in (make LOG_LEVEL=error|info|debug|trace).
+Calls above it are removed by the compiler, arguments included.
+*/
+#ifndef CBS_LOG_LEVEL
+#define CBS_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/* Most verbose level written at run time (--log-level), at most CBS_LOG_LEVEL */
+extern int log_runtime_level;
+
+/*
+Log a message at a level. A disabled level keeps its arguments type-checked
+but generates no code, so hot paths may log freely at debug and trace.
+*/
+#define LOG_AT(level, ...)                                                  \
+    do                                                                      \
+    {                                                                       \
+        if ((level) <= CBS_LOG_LEVEL && (level) <= log_runtime_level)       \
+        {                                                                   \
+            log_write((level), __VA_ARGS__);                                \
+        }                                                                   \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+
+void log_init(int level);
+bool log_level_parse(const char *name, int *out_level);
+const char *log_level_name(int level);
+void log_write(int level, const char *format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void log_flush(void);
+
+#endif /* PARALLEL_CBS_LOG_H */
@@ -5,19 +5,58 @@
 #include "constraints.h"
 #include "messages.h"
 #include "parallel_a_star.h"
+#include "path_cache.h"
+#include "sipp.h"
+#include "thread_pool.h"
+
+/*
+Low-level planner used to (re)plan a single agent
+*/
+typedef enum
+{
+    /** Time-expanded A* on a single rank */
+    LL_ENGINE_ASTAR = 0,
+    /** Safe Interval Path Planning on a single rank */
+    LL_ENGINE_SIPP = 1,
+    /** Time-expanded hash-distributed A* (HDA*) over the low-level pool */
+    LL_ENGINE_PARALLEL = 2
+} LowLevelEngine;
 
 typedef struct
 {
+    /** Rank of the low-level pool manager in solver_comm, -1 plans locally */
     int manager_world_rank;
     MPI_Comm pool_comm;
+    LowLevelEngine engine;
+    /** Search memory reused by every call on this rank (NULL allocates per call) */
+    AStarWorkspace *workspace;
+    /** Results of earlier calls on this rank (NULL disables caching) */
+    PathCache *cache;
+    /** Threads planning the local requests of a batch side by side (NULL plans them in turn) */
+    ThreadPool *threads;
+    /** Search memory of each thread of threads */
+    AStarWorkspace *thread_workspaces;
 } LowLevelContext;
 
+bool low_level_engine_parse(const char *name, LowLevelEngine *out_engine);
+const char *low_level_engine_name(LowLevelEngine engine);
+
+void low_level_threads_init(LowLevelContext *ctx, int thread_count);
+void low_level_threads_free(LowLevelContext *ctx);
+
 void low_level_service_loop(const ProblemInstance *instance, const LowLevelContext *ctx);
 bool low_level_request_path(const ProblemInstance *instance,
-                            const ConstraintSet *constraints,
+                            const HighLevelNode *node,
                             int agent_id,
                             const LowLevelContext *ctx,
                             AgentPath *out_path);
+bool low_level_request_paths(const ProblemInstance *instance,
+                             const HighLevelNode *const *nodes,
+                             const int *agent_ids,
+                             int count,
+                             const LowLevelContext *ctx,
+                             AgentPath *const *out_paths,
+                             bool *out_ok);
 void low_level_request_shutdown(const LowLevelContext *ctx);
 
 #endif /* PARALLEL_CBS_LOW_LEVEL_H */
@@ -0,0 +1,48 @@
+#ifndef PARALLEL_CBS_MDD_H
+#define PARALLEL_CBS_MDD_H
+
+#include "common.h"
+#include "constraints.h"
+#include "grid.h"
+
+/*
+Multi-valued decision diagram summary of one agent's optimal paths.
+Layer t holds every cell the agent can occupy at time t on some path of
+the same cost that respects its constraints. Only the layer widths and
+the cell of each singleton layer are kept, which is all that conflict
+classification needs.
+*/
+typedef struct
+{
+    /** Arrival time the diagram was built for (path length - 1) */
+    int depth;
+    /** Number of cells per layer, depth + 1 entries */
+    int *widths;
+    /** Cell of each layer of width one (unspecified for wider layers) */
+    int *singletons;
+} Mdd;
+
+void mdd_init(Mdd *mdd);
+void mdd_free(Mdd *mdd);
+bool mdd_build(const Grid *grid,
+               const ConstraintSet *constraints,
+               GridCoord start,
+               GridCoord goal,
+               const int *heuristic,
+               int agent_id,
+               int depth,
+               Mdd *out);
+
+/* Check whether every optimal path of the agent occupies a cell at a time
+@param mdd Pointer to a built Mdd
+@param time Time step (after depth the agent waits at its goal)
+@param cell Cell index to test
+@return true if the layer at time is exactly {cell}
+*/
+static inline bool mdd_is_singleton(const Mdd *mdd, int time, int cell)
+{
+    int layer = time < mdd->depth ? time : mdd->depth;
+    return mdd->widths[layer] == 1 && mdd->singletons[layer] == cell;
+}
+
+#endif /* PARALLEL_CBS_MDD_H */
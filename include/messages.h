@@ -1,6 +1,8 @@
 #ifndef PARALLEL_CBS_MESSAGES_H
 #define PARALLEL_CBS_MESSAGES_H
 
+#include <mpi.h>
+
 /* Message tags for MPI communication */
 typedef enum
 {
@@ -16,18 +18,36 @@ typedef enum
     TAG_TERMINATE = 104,
     /* Incumbent message */
     TAG_INCUMBENT = 105,
-    /* Low-Level messages */
+    /* Coordinator asks a worker to expand or forward a resident node */
+    TAG_EXPAND = 106,
+    /* Worker to Coordinator handles of resident children */
+    TAG_HANDLES = 107,
+    /* Low-Level batch of generated states sent to the rank that owns them */
     TAG_LL_TASK = 200,
-    /* Low-Level result message */
+    /* Low-Level path trace handed to the rank holding the next node */
     TAG_LL_RESULT = 201,
-    /* Low-Level terminate message */
+    /* Low-Level path trace reached the start */
     TAG_LL_TERMINATE = 202,
     /* Low-Level path request and response */
     TAG_LL_REQUEST = 210,
     /* Low-Level path response */
     TAG_LL_RESPONSE = 211,
+    /* Pool rank to its manager: an independent search finished */
+    TAG_LL_DONE = 212,
     /* Data packet messages */
-    TAG_DP_NODE = 300
+    TAG_DP_NODE = 300,
+    /* Termination detection token passed around the ring */
+    TAG_DP_TOKEN = 301,
+    /* Work steal request from an idle rank */
+    TAG_DP_STEAL = 302,
+    /* Answer to a steal request when the victim has nothing to give */
+    TAG_DP_STEAL_DENY = 303
 } MessageTag;
 
+/*
+Communicator every solver message and collective goes over: MPI_COMM_WORLD,
+or in batch mode the communicator of the group solving the current instance
+*/
+extern MPI_Comm solver_comm;
+
 #endif /* PARALLEL_CBS_MESSAGES_H */
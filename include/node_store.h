@@ -0,0 +1,68 @@
+#ifndef PARALLEL_CBS_NODE_STORE_H
+#define PARALLEL_CBS_NODE_STORE_H
+
+#include "cbs.h"
+
+/*
+Lightweight reference to a CT node kept by the worker that generated it.
+The coordinator's open list holds only these handles and asks the owner
+to expand (or forward) the node when its handle is popped.
+*/
+typedef struct
+{
+    /** Sum of costs of the node */
+    double cost;
+    /** Globally unique node id */
+    int id;
+    /** World rank of the worker holding the node */
+    int owner;
+    /** Number of conflicting agent pairs in the node */
+    int conflicts;
+    /** Depth of the node in the constraint tree */
+    int depth;
+} NodeHandle;
+
+/*
+Binary min-heap of NodeHandle values ordered by cost, then by fewer
+conflicts, so ties go to the node closest to a solution
+*/
+typedef struct
+{
+    /** Heap array */
+    NodeHandle *items;
+    /** Number of handles */
+    int count;
+    /** Capacity of the items array */
+    int capacity;
+} HandleQueue;
+
+/*
+Open-addressing map from node id to the CT nodes resident on a worker.
+Linear probing with backward-shift deletion, so no tombstones build up
+as nodes are taken out for expansion.
+*/
+typedef struct
+{
+    /** Node ids per slot, -1 when empty */
+    int *ids;
+    /** Owned nodes per slot */
+    HighLevelNode **nodes;
+    /** Number of slots (power of two) */
+    int capacity;
+    /** Number of stored nodes */
+    int count;
+} NodeStore;
+
+void handle_queue_init(HandleQueue *queue);
+void handle_queue_free(HandleQueue *queue);
+void handle_queue_push(HandleQueue *queue, NodeHandle handle);
+bool handle_queue_pop(HandleQueue *queue, NodeHandle *out_handle);
+const NodeHandle *handle_queue_peek(const HandleQueue *queue);
+
+void node_store_init(NodeStore *store);
+void node_store_free(NodeStore *store);
+void node_store_put(NodeStore *store, HighLevelNode *node);
+HighLevelNode *node_store_take(NodeStore *store, int node_id);
+int node_store_prune(NodeStore *store, double bound);
+
+#endif /* PARALLEL_CBS_NODE_STORE_H */
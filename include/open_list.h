@@ -0,0 +1,137 @@
+#ifndef PARALLEL_CBS_OPEN_LIST_H
+#define PARALLEL_CBS_OPEN_LIST_H
+
+#include "cbs.h"
+#include "low_level.h"
+#include "priority_queue.h"
+
+/* Share of the budget at which far nodes start being compressed */
+#define OPEN_COMPRESS_FRACTION 0.5
+
+/* Queued node with the keys it is ordered by */
+typedef struct
+{
+    /** Sum of costs of the node when it was queued */
+    double cost;
+    /** Conflicting agent pairs of the node (counted in focal mode only) */
+    int conflicts;
+    /** The node, owned by the list */
+    HighLevelNode *node;
+} OpenEntry;
+
+/*
+Binary min-heap of OpenEntry values, ordered by cost or, for the focal
+list, by fewer conflicts and then by cost
+*/
+typedef struct
+{
+    OpenEntry *items;
+    int count;
+    int capacity;
+    /** Whether entries are ordered by conflicts first */
+    bool by_conflicts;
+} OpenHeap;
+
+/*
+Run file of spilled nodes, written in cost order and read back one node
+at a time. Each record holds the node's id, parent id, depth, constraint
+count, conflict count and cost followed by its constraints, oldest first.
+*/
+typedef struct
+{
+    /** Unlinked temporary file of the run */
+    FILE *file;
+    /** Records still in the file after head */
+    long long remaining;
+    /** Next node of the run, compressed (node is NULL once the run is exhausted) */
+    OpenEntry head;
+} SpillRun;
+
+/*
+High-level open list with an optional focal list and an estimated memory budget.
+
+With a suboptimality w above 1, every node whose cost is at most w times
+the lowest open cost (LB) moves to the focal list, and nodes are popped
+from there by fewest conflicting agent pairs, so the first solution found
+costs at most w times the optimum.
+
+Past OPEN_COMPRESS_FRACTION of the budget, nodes costlier than LB are
+compressed: their paths and conflicts are dropped and only the constraint
+chain is kept, the paths are replanned when the node is popped. Past the
+full budget, the costlier half of the queue is written to a run file
+sorted by cost and merged back once the frontier reaches it. Focal nodes
+are never compressed or spilled. A budget of zero keeps every node resident.
+*/
+typedef struct
+{
+    /** Nodes held in memory outside the focal list, ordered by cost */
+    OpenHeap queue;
+    /** Nodes within the suboptimality bound, ordered by conflicts (focal mode only) */
+    OpenHeap focal;
+    /** Costs of the focal nodes, for the lowest one */
+    PriorityQueue focal_costs;
+    /** Costs of nodes popped from the focal list but still in focal_costs */
+    PriorityQueue focal_removed;
+    /** Cost bound of the focal list, w * LB when it was last refreshed */
+    double focal_bound;
+    /** External lower bound capping the focal bound (DBL_MAX when none) */
+    double focal_lb_cap;
+    /** Suboptimality bound w, 1 for best-first search */
+    double suboptimality;
+    /** Instance the paths of compressed nodes are replanned on */
+    const ProblemInstance *instance;
+    /** Low-level context the paths of compressed nodes are replanned with */
+    const LowLevelContext *ll_ctx;
+    /** Memory budget in bytes, 0 when unbounded */
+    size_t budget_bytes;
+    /** Estimated bytes of the nodes in queue and focal */
+    size_t bytes;
+    /** Estimate at which the next compression pass runs */
+    size_t compress_at;
+    /** Estimate at which the next spill runs */
+    size_t spill_at;
+    /** Whether spilling stopped after a run file could not be created */
+    bool spill_failed;
+    /** Runs that still hold nodes */
+    SpillRun *runs;
+    /** Number of runs */
+    int run_count;
+    /** Capacity of the runs array */
+    int run_capacity;
+    /** Compressed nodes in queue */
+    int compressed_count;
+    /** Nodes in run files, heads included */
+    long long spilled_count;
+    /** Most nodes held in memory at once */
+    long long peak_resident;
+    /** Nodes compressed so far */
+    long long nodes_compressed;
+    /** Compressed nodes whose paths were replanned on pop */
+    long long nodes_restored;
+    /** Nodes written to run files so far */
+    long long nodes_spilled;
+} OpenList;
+
+void open_list_init(OpenList *open,
+                    const ProblemInstance *instance,
+                    const LowLevelContext *ll_ctx,
+                    size_t budget_bytes,
+                    double suboptimality);
+void open_list_free(OpenList *open);
+void open_list_clear(OpenList *open);
+void open_list_push(OpenList *open, HighLevelNode *node);
+HighLevelNode *open_list_pop(OpenList *open);
+const HighLevelNode *open_list_peek(OpenList *open);
+double open_list_lower_bound(OpenList *open);
+void open_list_cap_focal(OpenList *open, double lower_bound);
+
+/*
+@param open Pointer to the OpenList
+@return Number of open nodes, in memory and spilled
+*/
+static inline long long open_list_count(const OpenList *open)
+{
+    return (long long)open->queue.count + open->focal.count + open->spilled_count;
+}
+
+#endif /* PARALLEL_CBS_OPEN_LIST_H */
@@ -1,9 +1,11 @@
 #ifndef PARALLEL_CBS_PARALLEL_A_STAR_H
 #define PARALLEL_CBS_PARALLEL_A_STAR_H
 
+#include "bucket_queue.h"
 #include "common.h"
 #include "constraints.h"
 #include "grid.h"
+#include "state_table.h"
 
 /*
 AStarNode represents a node in the A* search algorithm
@@ -20,6 +22,8 @@ typedef struct
     int parent_index;
     /** Time step of the node */
     int time;
+    /** Safe interval index of the cell (SIPP only) */
+    int interval;
 } AStarNode;
 
 /* 
@@ -40,18 +44,74 @@ void a_star_buffer_init(AStarNodeBuffer *buffer);
 void a_star_buffer_free(AStarNodeBuffer *buffer);
 int a_star_buffer_add(AStarNodeBuffer *buffer, AStarNode node);
 
+/*
+States generated for one other rank of the parallel search.
+New states collect in pending while the previous batch is still being
+sent from sending, so a flush never has to wait for the receiver.
+*/
+typedef struct
+{
+    /** Queued states, HDA_STATE_INTS ints each */
+    int *pending;
+    /** Number of queued ints */
+    int pending_count;
+    /** Capacity of pending in ints */
+    int pending_capacity;
+    /** Batch owned by the send in flight */
+    int *sending;
+    /** Capacity of sending in ints */
+    int sending_capacity;
+    /** Request of the send in flight (MPI_REQUEST_NULL if none) */
+    MPI_Request request;
+} StateOutbox;
+
+/*
+Long-lived memory for low-level searches, owned by one rank's loop.
+Every buffer keeps its high-water-mark capacity between calls and a reset
+only touches the counters (the closed set bumps its generation), so a CBS
+run stops allocating once the largest search has been seen.
+*/
+typedef struct
+{
+    /** Search nodes of the current call */
+    AStarNodeBuffer buffer;
+    /** Open list of the current call, keyed by f-cost */
+    BucketQueue open;
+    /** Closed set of the current call */
+    StateTable closed;
+    /** Constraint index of the agent being planned */
+    ConstraintIndex index;
+    /** Integer scratch space (task batches, SIPP interval table) */
+    int *scratch;
+    /** Capacity of scratch in ints */
+    int scratch_capacity;
+    /** One outbox per rank of the parallel search (NULL until first used) */
+    StateOutbox *outboxes;
+    /** Number of outboxes */
+    int outbox_count;
+} AStarWorkspace;
+
+void a_star_workspace_init(AStarWorkspace *workspace);
+void a_star_workspace_free(AStarWorkspace *workspace);
+void a_star_workspace_reset(AStarWorkspace *workspace);
+int *a_star_workspace_scratch(AStarWorkspace *workspace, int count);
+
 bool parallel_a_star(const Grid *grid,
                      const ConstraintSet *constraints,
                      GridCoord start,
                      GridCoord goal,
+                     const int *heuristic,
                      int agent_id,
                      MPI_Comm comm,
+                     AStarWorkspace *workspace,
                      AgentPath *out_path);
 bool sequential_a_star(const Grid *grid,
                        const ConstraintSet *constraints,
                        GridCoord start,
                        GridCoord goal,
+                       const int *heuristic,
                        int agent_id,
+                       AStarWorkspace *workspace,
                        AgentPath *out_path);
 
 #endif /* PARALLEL_CBS_PARALLEL_A_STAR_H */
@@ -0,0 +1,84 @@
+#ifndef PARALLEL_CBS_PATH_CACHE_H
+#define PARALLEL_CBS_PATH_CACHE_H
+
+#include "common.h"
+#include "constraints.h"
+
+/* Ints per canonical constraint record (time, type, vertex, edge_to) */
+#define PATH_CACHE_RECORD_INTS 4
+
+/* Cached low-level result of one agent under one set of constraints */
+typedef struct PathCacheEntry
+{
+    /** ID of the planned agent */
+    int agent_id;
+    /** Hash of agent_id and the canonical constraint records */
+    uint64_t fingerprint;
+    /** Sorted, deduplicated constraint records used to confirm a hit */
+    int *records;
+    /** Number of constraint records */
+    int record_count;
+    /** Whether the low level found a path */
+    bool found;
+    /** Planned path (empty if found is false) */
+    AgentPath path;
+    /** Bytes charged against the cache budget */
+    size_t bytes;
+    /** Next entry of the same hash bucket */
+    struct PathCacheEntry *bucket_next;
+    /** Neighbour used more recently, NULL for the head */
+    struct PathCacheEntry *lru_prev;
+    /** Neighbour used less recently, NULL for the tail */
+    struct PathCacheEntry *lru_next;
+} PathCacheEntry;
+
+/*
+Per-rank LRU cache of low-level results.
+Constraints on other agents never change a replan, so two CT nodes whose
+chains hold the same constraints for an agent get the same path. Entries
+are keyed by the agent and its constraints sorted into a canonical order,
+so the result is independent of the branch order that added them.
+Least recently used entries are evicted once the budget is exceeded.
+*/
+typedef struct
+{
+    /** Hash buckets (power of two count) */
+    PathCacheEntry **buckets;
+    /** Number of buckets */
+    int bucket_count;
+    /** Number of cached entries */
+    int count;
+    /** Bytes used by cached entries */
+    size_t bytes;
+    /** Memory budget in bytes (0 disables the cache) */
+    size_t budget;
+    /** Most recently used entry */
+    PathCacheEntry *lru_head;
+    /** Least recently used entry */
+    PathCacheEntry *lru_tail;
+    /** Canonical records of the last key built */
+    int *scratch;
+    /** Capacity of the scratch array in records */
+    int scratch_capacity;
+    /** Lookups answered from the cache */
+    long long hits;
+    /** Lookups that had to run the low level */
+    long long misses;
+    /** Entries dropped to stay within the budget */
+    long long evictions;
+} PathCache;
+
+void path_cache_init(PathCache *cache, size_t budget_bytes);
+void path_cache_free(PathCache *cache);
+bool path_cache_lookup(PathCache *cache,
+                       const ConstraintSet *constraints,
+                       int agent_id,
+                       bool *out_found,
+                       AgentPath *out_path);
+void path_cache_store(PathCache *cache,
+                      const ConstraintSet *constraints,
+                      int agent_id,
+                      bool found,
+                      const AgentPath *path);
+
+#endif /* PARALLEL_CBS_PATH_CACHE_H */
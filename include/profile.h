@@ -0,0 +1,85 @@
+#ifndef PARALLEL_CBS_PROFILE_H
+#define PARALLEL_CBS_PROFILE_H
+
+#include "common.h"
+
+/* Log2 buckets of the low-level call time histogram, bucket b counts calls of [2^b, 2^(b+1)) microseconds */
+#define PROFILE_LL_BUCKETS 24
+
+/* Seconds between two samples of the open list size */
+#define PROFILE_SAMPLE_INTERVAL 0.05
+
+/* Most open list samples kept per rank, later samples are dropped */
+#define PROFILE_MAX_SAMPLES 65536
+
+/* Timed phases of a rank */
+typedef enum
+{
+    /** Low-level searches run on this rank (A*, SIPP or its share of HDA*) */
+    PROFILE_LL_SEARCH = 0,
+    /** Waiting for low-level results planned on other ranks */
+    PROFILE_LL_WAIT,
+    /** Building MDDs for conflict selection */
+    PROFILE_MDD,
+    /** Building and updating the conflict tables of nodes */
+    PROFILE_CONFLICTS,
+    /** Creating child nodes from their parent */
+    PROFILE_CLONE,
+    /** Packing nodes into wire batches (bytes packed) */
+    PROFILE_SERIALIZE,
+    /** Unpacking nodes from wire batches (bytes read) */
+    PROFILE_DESERIALIZE,
+    /** Waiting for messages or work (whole idle iterations of a decentralized rank, their polling included) */
+    PROFILE_IDLE,
+    /** Global reductions and bound refreshes */
+    PROFILE_COLLECTIVE,
+    PROFILE_PHASE_COUNT
+} ProfilePhase;
+
+/* Whether collection is on for this rank (set by profile_init) */
+extern bool profile_enabled;
+
+void profile_init(bool enabled);
+void profile_record(ProfilePhase phase, double seconds, long long bytes);
+void profile_ll_call(double seconds, long long expanded);
+void profile_hl_expand(void);
+void profile_sample_open(long long open_count);
+void profile_write(const char *prefix, const char *role);
+const char *profile_phase_name(ProfilePhase phase);
+
+/*
+Start timing a phase. Costs one branch while collection is off.
+
+@return Start time to pass to profile_stop
+*/
+static inline double profile_start(void)
+{
+    return profile_enabled ? wall_time_seconds() : 0.0;
+}
+
+/*
+@param phase Phase the time since start is added to
+@param start Value returned by profile_start
+*/
+static inline void profile_stop(ProfilePhase phase, double start)
+{
+    if (profile_enabled)
+    {
+        profile_record(phase, wall_time_seconds() - start, 0);
+    }
+}
+
+/*
+@param phase Phase the time since start and the bytes are added to
+@param start Value returned by profile_start
+@param bytes Bytes handled in the phase
+*/
+static inline void profile_stop_bytes(ProfilePhase phase, double start, long long bytes)
+{
+    if (profile_enabled)
+    {
+        profile_record(phase, wall_time_seconds() - start, bytes);
+    }
+}
+
+#endif /* PARALLEL_CBS_PROFILE_H */
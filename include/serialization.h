@@ -4,60 +4,116 @@
 #include "cbs.h"
 #include <mpi.h>
 
+/* Version of the packed node format, bumped on any layout change */
+#define NODE_WIRE_VERSION 3
+
+/* Number of recent task nodes a worker keeps as delta bases (mirrored by the coordinator) */
+#define TASK_WINDOW_SIZE 64
+
+/* Kind of a packed node record */
+typedef enum
+{
+    /** Every path and constraint of the node */
+    NODE_RECORD_FULL = 0,
+    /** Constraints and paths that differ from a base node the receiver holds */
+    NODE_RECORD_DELTA = 1
+} NodeRecordKind;
+
+/*
+Packed wire buffer holding one or more CT nodes, sent as a single MPI_BYTE message.
+Layout (native int and double representation, ranks are assumed homogeneous):
+  header: version, node_count, aux_value, reserved (4 ints)
+  full node: kind, id, parent_id, depth, num_agents, constraint_count (6 ints), cost (double),
+             one path per agent, then the constraints oldest first
+  delta node: kind, id, parent_id, depth, num_agents, base_id, new constraint count,
+              changed path count (8 ints), cost (double), the new constraints oldest
+              first, then (agent_id, path) per changed path
+  path: length, encoding, then for move encoding the first cell, the row stride
+        and one 3-bit move code per later step packed ten to an int, for raw
+        encoding one cell index per step
+  constraint: agent_id, time, type, vertex cell, edge_to cell (5 ints)
+aux_value carries a per-message integer (incumbent bound for tasks,
+parent node id for children).
+*/
 typedef struct
 {
-    int node_id;
-    int parent_id;
-    int depth;
-    int num_agents;
-    int constraint_count;
+    /** Packed bytes, header first */
+    unsigned char *data;
+    /** Number of bytes in use */
+    int size;
+    /** Capacity of the data array in bytes */
+    int capacity;
+    /** Number of nodes in the buffer */
+    int node_count;
+    /** Per-message integer stored in the header */
     int aux_value;
-    double cost;
-    int path_int_count;
-    int constraint_int_count;
-    int *path_data;
-    int *constraint_data;
-} SerializedNode;
-
-/* Pending async send entry - stores MPI requests and buffer pointers */
+} NodeBatch;
+
+/*
+FIFO window of recently exchanged nodes used as delta bases.
+A sender only encodes a delta against a node that the receiver's window
+is known to hold, either because both sides insert the same nodes in the
+same order (coordinator and worker) or because the base never changes
+(the shared root of the decentralized driver).
+*/
 typedef struct
 {
-    MPI_Request requests[4]; /* header, cost, path_data, constraint_data */
-    int num_requests;
-    int *header;             /* dynamically allocated header buffer */
-    double *cost;            /* dynamically allocated cost buffer */
-    int *path_data;          /* owned copy of path data */
-    int *constraint_data;    /* owned copy of constraint data */
-} PendingSend;
+    /** Ring of owned nodes, oldest at head */
+    HighLevelNode **nodes;
+    /** Number of slots */
+    int capacity;
+    /** Slot of the oldest node */
+    int head;
+    /** Number of held nodes */
+    int count;
+} NodeWindow;
 
-/* Pool of pending async sends */
-#define MAX_PENDING_SENDS 256
+/* In-flight non-blocking send and the buffer it owns */
+typedef struct
+{
+    MPI_Request request;
+    unsigned char *data;
+} PendingSend;
 
+/* Growable pool of pending async sends */
 typedef struct
 {
-    PendingSend entries[MAX_PENDING_SENDS];
+    PendingSend *entries;
     int count;
+    int capacity;
 } PendingSendPool;
 
-void serialize_high_level_node(const HighLevelNode *node, SerializedNode *out);
-void free_serialized_node(SerializedNode *node);
-HighLevelNode *deserialize_high_level_node(const SerializedNode *data);
+void node_batch_init(NodeBatch *batch);
+void node_batch_free(NodeBatch *batch);
+void node_batch_reset(NodeBatch *batch, int aux_value);
+void node_batch_append(NodeBatch *batch, const HighLevelNode *node);
+void node_batch_append_delta(NodeBatch *batch, const HighLevelNode *node, const HighLevelNode *base);
+HighLevelNode *node_batch_next(const NodeBatch *batch, int *cursor, const NodeWindow *bases);
+
+void node_window_init(NodeWindow *window, int capacity);
+void node_window_free(NodeWindow *window);
+void node_window_push(NodeWindow *window, HighLevelNode *node);
+HighLevelNode *node_window_find(const NodeWindow *window, int node_id);
 
-/* Blocking send (original) */
-void send_serialized_node(int dest_rank, int tag, const SerializedNode *node);
+/* Blocking send of a whole batch */
+void node_batch_send(int dest_rank, int tag, const NodeBatch *batch);
 
-/* Non-blocking send - stores requests in pool */
-void send_serialized_node_async(int dest_rank, int tag, const SerializedNode *node, PendingSendPool *pool);
+/* Non-blocking send, the pool takes over the buffer and leaves the batch empty */
+void node_batch_send_async(int dest_rank, int tag, NodeBatch *batch, PendingSendPool *pool);
+
+/* Receive one batch into a reusable buffer, sized with MPI_Probe/MPI_Get_count */
+bool node_batch_receive(int source_rank, int tag, NodeBatch *batch, MPI_Status *status_out);
 
 /* Initialize the pending send pool */
 void pending_send_pool_init(PendingSendPool *pool);
 
+/* Wait for every pending send and release the pool */
+void pending_send_pool_free(PendingSendPool *pool);
+
 /* Test and complete any finished sends, freeing their buffers */
 void pending_send_pool_progress(PendingSendPool *pool);
 
 /* Wait for all pending sends to complete */
 void pending_send_pool_wait_all(PendingSendPool *pool);
 
-void receive_serialized_node(int source_rank, int tag, SerializedNode *out, MPI_Status *status_out);
-
 #endif /* PARALLEL_CBS_SERIALIZATION_H */
@@ -0,0 +1,18 @@
+#ifndef PARALLEL_CBS_SIPP_H
+#define PARALLEL_CBS_SIPP_H
+
+#include "common.h"
+#include "constraints.h"
+#include "grid.h"
+#include "parallel_a_star.h"
+
+bool sipp_plan(const Grid *grid,
+               const ConstraintSet *constraints,
+               GridCoord start,
+               GridCoord goal,
+               const int *heuristic,
+               int agent_id,
+               AStarWorkspace *workspace,
+               AgentPath *out_path);
+
+#endif /* PARALLEL_CBS_SIPP_H */
@@ -0,0 +1,36 @@
+#ifndef PARALLEL_CBS_STATE_TABLE_H
+#define PARALLEL_CBS_STATE_TABLE_H
+
+#include "common.h"
+
+/*
+Sparse closed set for the time-expanded low-level search.
+Open-addressing hash table keyed by (time, cell) that stores the best
+g-cost seen for each state, so memory scales with the states actually
+generated instead of the time horizon.
+A slot is occupied only if its stamp matches the current generation, so
+clearing the table between searches is a counter increment.
+*/
+typedef struct
+{
+    /** Packed (time, cell) keys, valid only in occupied slots */
+    uint64_t *keys;
+    /** Best g-cost per occupied slot */
+    int *values;
+    /** Generation that last wrote each slot */
+    uint32_t *stamps;
+    /** Current generation, never zero */
+    uint32_t generation;
+    /** Number of occupied slots */
+    int count;
+    /** Number of slots (always a power of two) */
+    int capacity;
+} StateTable;
+
+void state_table_init(StateTable *table);
+void state_table_free(StateTable *table);
+void state_table_clear(StateTable *table);
+bool state_table_improve(StateTable *table, int time, int cell, int g_cost);
+bool state_table_contains(const StateTable *table, int time, int cell);
+
+#endif /* PARALLEL_CBS_STATE_TABLE_H */
@@ -0,0 +1,36 @@
+#ifndef PARALLEL_CBS_THREAD_POOL_H
+#define PARALLEL_CBS_THREAD_POOL_H
+
+#include "common.h"
+
+/*
+Task of a parallel loop
+
+@param context Caller data shared by every task
+@param task_index Index of the task in the loop
+@param thread_index Index of the running thread, below the pool's thread_count
+*/
+typedef void (*ThreadTask)(void *context, int task_index, int thread_index);
+
+struct ThreadPoolState;
+
+/*
+Threads inside one MPI rank running parallel loops of independent tasks.
+The backend is chosen at build time (make THREADS=pthreads|openmp|none);
+the thread that calls thread_pool_run always takes part as thread 0 and
+is the only one that makes MPI calls (MPI_THREAD_FUNNELED).
+*/
+typedef struct
+{
+    /** Number of threads, including the caller */
+    int thread_count;
+    /** Backend state (pthreads only) */
+    struct ThreadPoolState *state;
+} ThreadPool;
+
+void thread_pool_init(ThreadPool *pool, int thread_count);
+void thread_pool_free(ThreadPool *pool);
+void thread_pool_run(ThreadPool *pool, int task_count, ThreadTask task, void *context);
+const char *thread_pool_backend(void);
+
+#endif /* PARALLEL_CBS_THREAD_POOL_H */
@@ -6,6 +6,7 @@
 
 void run_worker(const ProblemInstance *instance,
                 const LowLevelContext *ll_ctx,
-                int coordinator_rank);
+                int coordinator_rank,
+                bool resident_nodes);
 
 #endif /* PARALLEL_CBS_WORKER_H */
@@ -0,0 +1,411 @@
+#!/bin/bash
+#
+# Scaling Study for the Parallel CBS Solvers
+# Sweeps rank counts and coordinator/expander/low-level pool splits over an
+# instance set, runs the serial baseline of every instance, and collects one
+# row per run with the per-rank profile of the run (see --profile)
+#
+
+set -o pipefail
+
+# Default configuration
+DEFAULT_TIMEOUT=300
+DEFAULT_PROCS="2 4 8"
+DEFAULT_SOLVERS="central decentral"
+DEFAULT_LL_POOLS="0"
+DEFAULT_OUT_DIR="scaling_results"
+DEFAULT_MPIRUN="mpirun --oversubscribe"
+DEFAULT_SOLVER_ARGS="--w 1"
+
+# Colors for terminal output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+# Parse command line arguments
+TIMEOUT=${DEFAULT_TIMEOUT}
+PROCS_LIST=${DEFAULT_PROCS}
+SOLVERS=${DEFAULT_SOLVERS}
+LL_POOLS=${DEFAULT_LL_POOLS}
+OUT_DIR=${DEFAULT_OUT_DIR}
+MPIRUN=${DEFAULT_MPIRUN}
+SOLVER_ARGS=${DEFAULT_SOLVER_ARGS}
+MANIFEST=""
+SPECIFIC_MAP=""
+SPECIFIC_AGENTS=""
+WEAK_AGENTS=0
+SKIP_STRONG=0
+DRY_RUN=0
+FAILED_RUNS=0
+
+usage() {
+    echo "Usage: $0 (--manifest FILE | --map FILE --agents FILE) [OPTIONS]"
+    echo ""
+    echo "Options:"
+    echo "  --manifest FILE     Instance set, one line of instance options per instance (batch manifest format)"
+    echo "  --map FILE          Map of a single instance"
+    echo "  --agents FILE       Agent scenario of a single instance"
+    echo "  --solvers LIST      Solvers to sweep: central, decentral, parallel (default: \"$DEFAULT_SOLVERS\")"
+    echo "  --procs LIST        MPI rank counts to sweep (default: \"$DEFAULT_PROCS\")"
+    echo "  --ll-pool LIST      Low-level pool sizes to sweep for central and parallel; the other non-coordinator"
+    echo "                      ranks expand (default: \"$DEFAULT_LL_POOLS\")"
+    echo "  --weak-agents K     Also run a weak-scaling study with K agents per rank (agents = K * procs)"
+    echo "  --skip-strong       Only run the weak-scaling study"
+    echo "  --timeout SEC       Timeout per run in seconds (default: $DEFAULT_TIMEOUT)"
+    echo "  --solver-args ARGS  Extra options for every solver, serial included (default: \"$DEFAULT_SOLVER_ARGS\")"
+    echo "  --mpirun CMD        MPI launcher (default: \"$DEFAULT_MPIRUN\")"
+    echo "  --out DIR           Output directory (default: $DEFAULT_OUT_DIR)"
+    echo "  --dry-run           Show what would be run without executing"
+    echo "  --help              Show this help message"
+    echo ""
+    echo "Examples:"
+    echo "  $0 --manifest den312d.txt --procs \"2 4 8 16\" --ll-pool \"0 1 2\""
+    echo "  $0 --map MAPF_benchmark_maps/den312d.map --agents den312d.scen --weak-agents 4 --skip-strong"
+    echo "  python3 visualize_results.py --scaling $DEFAULT_OUT_DIR/scaling_runs.csv"
+    exit 0
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --manifest)
+            MANIFEST="$2"
+            shift 2
+            ;;
+        --map)
+            SPECIFIC_MAP="$2"
+            shift 2
+            ;;
+        --agents)
+            SPECIFIC_AGENTS="$2"
+            shift 2
+            ;;
+        --solvers)
+            SOLVERS="$2"
+            shift 2
+            ;;
+        --procs)
+            PROCS_LIST="$2"
+            shift 2
+            ;;
+        --ll-pool)
+            LL_POOLS="$2"
+            shift 2
+            ;;
+        --weak-agents)
+            WEAK_AGENTS="$2"
+            shift 2
+            ;;
+        --skip-strong)
+            SKIP_STRONG=1
+            shift
+            ;;
+        --timeout)
+            TIMEOUT="$2"
+            shift 2
+            ;;
+        --solver-args)
+            SOLVER_ARGS="$2"
+            shift 2
+            ;;
+        --mpirun)
+            MPIRUN="$2"
+            shift 2
+            ;;
+        --out)
+            OUT_DIR="$2"
+            shift 2
+            ;;
+        --dry-run)
+            DRY_RUN=1
+            shift
+            ;;
+        --help)
+            usage
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            ;;
+    esac
+done
+
+RUN_DIR="${OUT_DIR}/runs"
+RUNS_CSV="${OUT_DIR}/scaling_runs.csv"
+LOG_FILE="${OUT_DIR}/scaling_$(date +%Y%m%d_%H%M%S).log"
+RUNS_HEADER="study,instance,map,agents,solver,procs,expanders,ll_pool,status,cost,runtime_sec,nodes_expanded,nodes_generated,hl_ranks,hl_expanded_max,hl_expanded_mean,ll_expanded_total,ll_expanded_max,comm_bytes,idle_sec_mean,exit_code"
+
+mkdir -p "$RUN_DIR"
+
+# Logging function
+log() {
+    local level=$1
+    shift
+    local message="$*"
+    local timestamp=$(date '+%Y-%m-%d %H:%M:%S')
+    echo "[$timestamp] [$level] $message" >> "$LOG_FILE"
+
+    case $level in
+        INFO)
+            echo -e "${BLUE}[INFO]${NC} $message"
+            ;;
+        SUCCESS)
+            echo -e "${GREEN}[SUCCESS]${NC} $message"
+            ;;
+        WARNING)
+            echo -e "${YELLOW}[WARNING]${NC} $message"
+            ;;
+        ERROR)
+            echo -e "${RED}[ERROR]${NC} $message"
+            ;;
+        *)
+            echo "[$level] $message"
+            ;;
+    esac
+}
+
+# Print the named columns of the last row of a solver CSV, comma separated
+# (empty fields when the run wrote no row)
+csv_fields() {
+    local csv_file=$1
+    local columns=$2
+    if [[ ! -f "$csv_file" ]]; then
+        echo "$columns" | awk '{ out = ""; for (i = 2; i <= NF; i++) out = out ","; print out }'
+        return
+    fi
+    awk -F, -v want="$columns" '
+        NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+        { last = $0 }
+        END {
+            split(last, values, ",")
+            n = split(want, names, " ")
+            out = ""
+            for (j = 1; j <= n; j++) {
+                value = (names[j] in col && last != "") ? values[col[names[j]]] : ""
+                out = out (j > 1 ? "," : "") value
+            }
+            print out
+        }' "$csv_file"
+}
+
+# Summarize the per-rank rows of a profile rank table: ranks that expand CT
+# nodes (peers, workers or the serial rank, idle ones included so starvation
+# shows), most and mean CT expansions over those ranks, total and most
+# low-level expansions, node batch bytes packed, mean idle seconds
+profile_fields() {
+    local ranks_csv=$1
+    if [[ ! -f "$ranks_csv" ]]; then
+        echo ",,,,,,"
+        return
+    fi
+    awk -F, '
+        NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+        $1 !~ /^[0-9]+$/ { next }
+        {
+            ranks++
+            hl = $col["hl_expanded"]; ll = $col["ll_expanded"]
+            role = $col["role"]
+            if (role == "peer" || role == "worker" || role == "serial") { hl_ranks++; hl_sum += hl }
+            if (hl > hl_max) hl_max = hl
+            ll_sum += ll
+            if (ll > ll_max) ll_max = ll
+            bytes += $col["serialize_bytes"]
+            idle += $col["idle_sec"]
+        }
+        END {
+            hl_mean = hl_ranks > 0 ? hl_sum / hl_ranks : 0
+            idle_mean = ranks > 0 ? idle / ranks : 0
+            printf "%d,%d,%.1f,%d,%d,%d,%.6f\n", hl_ranks, hl_max, hl_mean, ll_sum, ll_max, bytes, idle_mean
+        }' "$ranks_csv"
+}
+
+# Run one configuration on one instance and append its row to the runs CSV
+run_config() {
+    local study=$1        # strong or weak
+    local index=$2        # instance number in the set
+    local solver=$3       # serial, central, decentral, or parallel
+    local procs=$4
+    local ll_pool=$5
+    local instance_args=$6
+
+    local expanders=$procs
+    local solver_flags=""
+    case $solver in
+        serial)
+            expanders=1
+            ;;
+        central|parallel)
+            expanders=$((procs - 1 - ll_pool))
+            solver_flags="--expanders $expanders --ll-pool $ll_pool"
+            ;;
+    esac
+
+    local run_id="${study}_i${index}_${solver}_p${procs}_l${ll_pool}"
+    local run_csv="${RUN_DIR}/${run_id}.csv"
+    local run_log="${RUN_DIR}/${run_id}.log"
+    local profile_prefix="${RUN_DIR}/${run_id}"
+
+    local cmd=""
+    case $solver in
+        serial)
+            cmd="timeout $((TIMEOUT + 10)) ./serial_cbs $instance_args --timeout $TIMEOUT $SOLVER_ARGS --csv \"$run_csv\" --profile \"$profile_prefix\""
+            ;;
+        central)
+            cmd="timeout $((TIMEOUT + 30)) $MPIRUN -n $procs ./central_cbs $instance_args $solver_flags --timeout $TIMEOUT $SOLVER_ARGS --csv \"$run_csv\" --profile \"$profile_prefix\""
+            ;;
+        decentral)
+            cmd="timeout $((TIMEOUT + 30)) $MPIRUN -n $procs ./decentralized_cbs $instance_args --timeout $TIMEOUT $SOLVER_ARGS --csv \"$run_csv\" --profile \"$profile_prefix\""
+            ;;
+        parallel)
+            cmd="timeout $((TIMEOUT + 30)) $MPIRUN -n $procs ./parallel_cbs $instance_args $solver_flags --timeout $TIMEOUT $SOLVER_ARGS --csv \"$run_csv\" --profile \"$profile_prefix\""
+            ;;
+        *)
+            log ERROR "Unknown solver: $solver"
+            return 1
+            ;;
+    esac
+
+    if [[ $DRY_RUN -eq 1 ]]; then
+        log INFO "[DRY RUN] Would execute: $cmd"
+        return 0
+    fi
+
+    log INFO "Running $run_id"
+    rm -f "$run_csv" "${profile_prefix}".rank*.json "${profile_prefix}.ranks.csv"
+    echo "Command: $cmd" > "$run_log"
+    eval "$cmd" >> "$run_log" 2>&1
+    local exit_code=$?
+
+    local fields=$(csv_fields "$run_csv" "map agents status cost runtime_sec nodes_expanded nodes_generated")
+    IFS=',' read -r map agents status cost runtime nodes_expanded nodes_generated <<< "$fields"
+    if [[ -z "$status" ]]; then
+        status="killed"
+    fi
+    echo "$study,$index,$map,$agents,$solver,$procs,$expanders,$ll_pool,$status,$cost,$runtime,$nodes_expanded,$nodes_generated,$(profile_fields "${profile_prefix}.ranks.csv"),$exit_code" >> "$RUNS_CSV"
+
+    if [[ $exit_code -eq 0 ]] && [[ "$status" == "success" ]]; then
+        log SUCCESS "$run_id: cost=$cost runtime=${runtime}s expanded=$nodes_expanded"
+        return 0
+    fi
+    log WARNING "$run_id: status=$status exit code $exit_code (see $run_log)"
+    FAILED_RUNS=$((FAILED_RUNS + 1))
+    return 1
+}
+
+# Run the serial baseline and every solver configuration at one rank count
+run_sweep() {
+    local study=$1
+    local index=$2
+    local procs=$3
+    local instance_args=$4
+
+    for solver in $SOLVERS; do
+        case $solver in
+            central|parallel)
+                for ll_pool in $LL_POOLS; do
+                    # the coordinator and at least one expander come first
+                    if [[ $((procs - 1 - ll_pool)) -lt 1 ]]; then
+                        log WARNING "Skipping $solver at $procs ranks with a pool of $ll_pool"
+                        continue
+                    fi
+                    run_config "$study" "$index" "$solver" "$procs" "$ll_pool" "$instance_args"
+                done
+                ;;
+            *)
+                run_config "$study" "$index" "$solver" "$procs" 0 "$instance_args"
+                ;;
+        esac
+    done
+}
+
+main() {
+    local instances=()
+    if [[ -n "$MANIFEST" ]]; then
+        if [[ ! -f "$MANIFEST" ]]; then
+            log ERROR "Manifest not found: $MANIFEST"
+            exit 1
+        fi
+        while IFS= read -r line || [[ -n "$line" ]]; do
+            line="${line%%#*}"
+            if [[ -n "${line// /}" ]]; then
+                instances+=("$line")
+            fi
+        done < "$MANIFEST"
+    elif [[ -n "$SPECIFIC_MAP" ]] && [[ -n "$SPECIFIC_AGENTS" ]]; then
+        instances+=("--map \"$SPECIFIC_MAP\" --agents \"$SPECIFIC_AGENTS\"")
+    else
+        log ERROR "Give an instance set with --manifest or --map and --agents"
+        exit 1
+    fi
+
+    for solver in serial $SOLVERS; do
+        local exe=""
+        case $solver in
+            serial) exe="./serial_cbs" ;;
+            central) exe="./central_cbs" ;;
+            decentral) exe="./decentralized_cbs" ;;
+            parallel) exe="./parallel_cbs" ;;
+            *)
+                log ERROR "Unknown solver: $solver (expected central, decentral or parallel)"
+                exit 1
+                ;;
+        esac
+        if [[ ! -x "$exe" ]]; then
+            log ERROR "$exe executable not found. Run 'make all' first."
+            exit 1
+        fi
+    done
+
+    log INFO "=========================================="
+    log INFO "CBS Scaling Study Started"
+    log INFO "=========================================="
+    log INFO "  Instances: ${#instances[@]}"
+    log INFO "  Solvers: $SOLVERS"
+    log INFO "  Rank counts: $PROCS_LIST"
+    log INFO "  Low-level pools: $LL_POOLS"
+    log INFO "  Weak scaling agents per rank: $WEAK_AGENTS"
+    log INFO "  Timeout: ${TIMEOUT}s"
+
+    if [[ ! -f "$RUNS_CSV" ]] && [[ $DRY_RUN -eq 0 ]]; then
+        echo "$RUNS_HEADER" > "$RUNS_CSV"
+    fi
+
+    local index=0
+    for instance_args in "${instances[@]}"; do
+        index=$((index + 1))
+        log INFO "------------------------------------------"
+        log INFO "Instance $index: $instance_args"
+        log INFO "------------------------------------------"
+
+        # strong scaling: the same instance at every rank count
+        if [[ $SKIP_STRONG -eq 0 ]]; then
+            run_config strong "$index" serial 1 0 "$instance_args"
+            for procs in $PROCS_LIST; do
+                run_sweep strong "$index" "$procs" "$instance_args"
+            done
+        fi
+
+        # weak scaling: the agent count grows with the ranks (the last --num-agents wins)
+        if [[ $WEAK_AGENTS -gt 0 ]]; then
+            for procs in $PROCS_LIST; do
+                local weak_args="$instance_args --num-agents $((WEAK_AGENTS * procs))"
+                run_config weak "$index" serial "$procs" 0 "$weak_args"
+                run_sweep weak "$index" "$procs" "$weak_args"
+            done
+        fi
+    done
+
+    log INFO "=========================================="
+    log INFO "Scaling Study Complete"
+    log INFO "=========================================="
+    log INFO "Runs: $RUNS_CSV"
+    log INFO "Summaries: python3 visualize_results.py --scaling $RUNS_CSV"
+    if [[ $FAILED_RUNS -gt 0 ]]; then
+        log WARNING "Unsolved runs: $FAILED_RUNS"
+    fi
+    exit 0
+}
+
+# Run main
+main
@@ -0,0 +1,363 @@
+#include "batch.h"
+
+#include "heuristic.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Longest manifest line */
+#define MANIFEST_LINE_LENGTH 4096
+
+/*
+@param text String to copy (may be NULL)
+@return Newly allocated copy, or NULL for NULL
+*/
+static char *copy_string(const char *text)
+{
+    if (!text)
+    {
+        return NULL;
+    }
+    size_t length = strlen(text);
+    char *copy = (char *)malloc(length + 1);
+    if (!copy)
+    {
+        fprintf(stderr, "copy_string: failed to allocate string (length=%zu)\n", length);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, length + 1);
+    return copy;
+}
+
+void manifest_init(Manifest *manifest)
+{
+    manifest->entries = NULL;
+    manifest->count = 0;
+    manifest->capacity = 0;
+}
+
+void manifest_free(Manifest *manifest)
+{
+    for (int i = 0; i < manifest->count; ++i)
+    {
+        free(manifest->entries[i].map_path);
+        free(manifest->entries[i].agents_path);
+        free(manifest->entries[i].instance_path);
+    }
+    free(manifest->entries);
+    manifest_init(manifest);
+}
+
+/*
+Append an instance to a manifest, the paths are copied
+
+@param manifest Pointer to the Manifest
+@param map_path Map file (NULL for a packed instance)
+@param agents_path Scenario file (NULL for a packed instance)
+@param instance_path Packed instance file (NULL for a map and scenario)
+@param selection Agents of the scenario to plan for (NULL: all of them)
+*/
+void manifest_add(Manifest *manifest,
+                  const char *map_path,
+                  const char *agents_path,
+                  const char *instance_path,
+                  const AgentSelection *selection)
+{
+    if (manifest->count >= manifest->capacity)
+    {
+        int new_cap = manifest->capacity == 0 ? 16 : manifest->capacity * 2;
+        ManifestEntry *new_entries = (ManifestEntry *)realloc(manifest->entries, sizeof(ManifestEntry) * (size_t)new_cap);
+        if (!new_entries)
+        {
+            fprintf(stderr, "manifest_add: failed to allocate manifest entries (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        manifest->entries = new_entries;
+        manifest->capacity = new_cap;
+    }
+    ManifestEntry *entry = &manifest->entries[manifest->count++];
+    entry->map_path = copy_string(instance_path ? NULL : map_path);
+    entry->agents_path = copy_string(instance_path ? NULL : agents_path);
+    entry->instance_path = copy_string(instance_path);
+    if (selection)
+    {
+        entry->selection = *selection;
+    }
+    else
+    {
+        agent_selection_init(&entry->selection);
+    }
+}
+
+/*
+Read a batch manifest. Each line describes one instance with the instance
+options of the solvers, "--map map --agents scen [--scen-bucket B]
+[--num-agents N] [--agent-offset K]" or "--instance packed"; blank lines
+and text after '#' are ignored.
+
+@param path Path of the manifest file
+@param manifest Pointer to an initialized Manifest the entries are appended to
+@return true on success, false if the file cannot be read or a line is malformed
+*/
+bool manifest_load(const char *path, Manifest *manifest)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        return false;
+    }
+    char line[MANIFEST_LINE_LENGTH];
+    int line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), fp) != NULL)
+    {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+
+        const char *map_path = NULL;
+        const char *agents_path = NULL;
+        const char *instance_path = NULL;
+        AgentSelection selection;
+        agent_selection_init(&selection);
+        bool empty = true;
+        for (char *token = strtok(line, " \t\r\n"); ok && token != NULL; token = strtok(NULL, " \t\r\n"))
+        {
+            empty = false;
+            char *value = strtok(NULL, " \t\r\n");
+            if (value == NULL)
+            {
+                ok = false;
+            }
+            else if (strcmp(token, "--map") == 0)
+            {
+                map_path = value;
+            }
+            else if (strcmp(token, "--agents") == 0)
+            {
+                agents_path = value;
+            }
+            else if (strcmp(token, "--instance") == 0)
+            {
+                instance_path = value;
+            }
+            else if (strcmp(token, "--scen-bucket") == 0)
+            {
+                selection.bucket = atoi(value);
+            }
+            else if (strcmp(token, "--num-agents") == 0)
+            {
+                selection.count = atoi(value);
+            }
+            else if (strcmp(token, "--agent-offset") == 0)
+            {
+                selection.offset = atoi(value);
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        if (empty)
+        {
+            continue;
+        }
+        ok = ok && (instance_path || (map_path && agents_path));
+        if (!ok)
+        {
+            fprintf(stderr, "manifest_load: %s:%d is not an instance line\n", path, line_number);
+            break;
+        }
+        manifest_add(manifest, map_path, agents_path, instance_path, &selection);
+    }
+    fclose(fp);
+    return ok;
+}
+
+/*
+@param entry Pointer to the ManifestEntry
+@return File name of the entry's map or packed instance, for the result CSV
+*/
+const char *manifest_entry_name(const ManifestEntry *entry)
+{
+    const char *source_path = entry->instance_path ? entry->instance_path : entry->map_path;
+    const char *name = strrchr(source_path, '/');
+    return name ? name + 1 : source_path;
+}
+
+/*
+@param cache Pointer to the InstanceCache
+@param budget_bytes Most bytes of goal distance tables to keep (0 keeps only the map)
+*/
+void instance_cache_init(InstanceCache *cache, size_t budget_bytes)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->budget_bytes = budget_bytes;
+}
+
+/*
+Drop the cached map and its tables
+
+@param cache Pointer to the InstanceCache
+*/
+static void instance_cache_clear(InstanceCache *cache)
+{
+    if (cache->tables)
+    {
+        size_t cell_count = (size_t)cache->map.width * (size_t)cache->map.height;
+        for (size_t cell = 0; cell < cell_count; ++cell)
+        {
+            free(cache->tables[cell]);
+        }
+        free(cache->tables);
+        cache->tables = NULL;
+    }
+    if (cache->map_path)
+    {
+        grid_free(&cache->map);
+        free(cache->map_path);
+        cache->map_path = NULL;
+    }
+    cache->used_bytes = 0;
+}
+
+void instance_cache_free(InstanceCache *cache)
+{
+    instance_cache_clear(cache);
+}
+
+/*
+Load the instance of a manifest entry. A map and scenario reuse the cached
+map when the entry names the same map file as the previous one, and the
+goal distance table of every goal seen before on that map; tables computed
+for new goals are kept while they fit the budget. Packed instances are
+mapped as usual and bypass the cache.
+
+@param cache Pointer to the InstanceCache
+@param entry Pointer to the ManifestEntry to load
+@param instance Output ProblemInstance, owned by the caller as with load_problem_instance
+@return true on success, false otherwise
+*/
+bool instance_cache_load(InstanceCache *cache, const ManifestEntry *entry, ProblemInstance *instance)
+{
+    if (entry->instance_path)
+    {
+        return load_packed_instance(entry->instance_path, instance);
+    }
+    if (!cache->map_path || strcmp(cache->map_path, entry->map_path) != 0)
+    {
+        instance_cache_clear(cache);
+        if (!grid_load_from_file(&cache->map, entry->map_path))
+        {
+            return false;
+        }
+        cache->map_path = copy_string(entry->map_path);
+        size_t cell_count = (size_t)cache->map.width * (size_t)cache->map.height;
+        cache->tables = (int **)calloc(cell_count, sizeof(int *));
+        if (!cache->tables)
+        {
+            fprintf(stderr, "instance_cache_load: failed to allocate table slots (cells=%zu)\n", cell_count);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!load_problem_agents(&cache->map, entry->agents_path, &entry->selection, instance))
+    {
+        return false;
+    }
+
+    size_t plane = (size_t)instance->map.width * (size_t)instance->map.height;
+    size_t table_bytes = sizeof(int) * plane;
+    instance->heuristics = (int *)malloc(table_bytes * (size_t)instance->num_agents);
+    if (!instance->heuristics)
+    {
+        fprintf(stderr, "instance_cache_load: failed to allocate tables (agents=%d cells=%zu)\n",
+                instance->num_agents, plane);
+        problem_instance_free(instance);
+        return false;
+    }
+    for (int agent = 0; agent < instance->num_agents; ++agent)
+    {
+        GridCoord goal = instance->goals[agent];
+        size_t cell = (size_t)goal.y * (size_t)instance->map.width + (size_t)goal.x;
+        int *table = instance->heuristics + plane * (size_t)agent;
+        if (cache->tables[cell])
+        {
+            memcpy(table, cache->tables[cell], table_bytes);
+            cache->table_hits++;
+            continue;
+        }
+        if (!heuristic_compute_distances(&instance->map, goal, table))
+        {
+            problem_instance_free(instance);
+            return false;
+        }
+        cache->table_misses++;
+        if (cache->used_bytes + table_bytes <= cache->budget_bytes)
+        {
+            cache->tables[cell] = (int *)malloc(table_bytes);
+            if (cache->tables[cell])
+            {
+                memcpy(cache->tables[cell], table, table_bytes);
+                cache->used_bytes += table_bytes;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+Split MPI_COMM_WORLD into groups of consecutive ranks that solve
+instances independently, group sizes differ by at most one
+
+@param groups Number of groups, clamped to [1, world size]
+@param out_group Output index of the calling rank's group
+@return Communicator of the group, freed by the caller
+*/
+MPI_Comm batch_group_comm(int groups, int *out_group)
+{
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (groups < 1)
+    {
+        groups = 1;
+    }
+    if (groups > size)
+    {
+        groups = size;
+    }
+    int group = (int)((long long)rank * groups / size);
+    MPI_Comm comm = MPI_COMM_NULL;
+    MPI_Comm_split(MPI_COMM_WORLD, group, rank, &comm);
+    *out_group = group;
+    return comm;
+}
+
+/*
+Create a result CSV with its header line if it does not exist yet. Called
+once before the first result, so groups appending rows concurrently never
+race on the header.
+
+@param path Path of the CSV file
+@param header Header line without the newline
+*/
+void batch_csv_header(const char *path, const char *header)
+{
+    if (access(path, F_OK) == 0)
+    {
+        return;
+    }
+    FILE *fp = fopen(path, "a");
+    if (!fp)
+    {
+        fprintf(stderr, "Warning: could not open CSV file %s for writing.\n", path);
+        return;
+    }
+    fprintf(fp, "%s\n", header);
+    fclose(fp);
+}
@@ -0,0 +1,873 @@
+#include "cbs.h"
+#include "constraints.h"
+#include "grid.h"
+#include "heuristic.h"
+#include "parallel_a_star.h"
+#include "priority_queue.h"
+#include "serialization.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Shortest time a calibrated repetition runs for */
+#define BENCH_MIN_SECONDS 0.05
+
+/* Goals tried per agent, and starts tried per goal, before sampling gives up */
+#define BENCH_SAMPLE_TRIES 64
+
+/* Most maps given with --map */
+#define BENCH_MAX_MAPS 64
+
+/* Tags of the ping-pong messages, rank 0 sends BENCH_TAG_STOP once it is done */
+enum
+{
+    BENCH_TAG_SYNC = 300,
+    BENCH_TAG_ASYNC = 301,
+    BENCH_TAG_STOP = 302
+};
+
+/* Map under test and its passable cells */
+typedef struct
+{
+    /** Loaded map */
+    Grid grid;
+    /** File name of the map, without directories */
+    const char *name;
+    /** Indices of the passable cells */
+    int *free_cells;
+    /** Number of passable cells */
+    int free_count;
+} BenchMap;
+
+/* Agents sampled on a map with their unconstrained shortest paths */
+typedef struct
+{
+    /** Number of agents */
+    int count;
+    /** Start of each agent */
+    GridCoord *starts;
+    /** Goal of each agent */
+    GridCoord *goals;
+    /** Goal distance table of each agent, width * height entries per agent */
+    int *heuristics;
+    /** Shortest path of each agent */
+    AgentPath *paths;
+    /** Mean number of steps of the paths */
+    double mean_length;
+} BenchAgents;
+
+/* Timing of one benchmark */
+typedef struct
+{
+    /** Elementary operations per repetition */
+    long long ops;
+    /** Fastest repetition, nanoseconds per operation */
+    double best_ns;
+    /** Mean over the repetitions, nanoseconds per operation */
+    double mean_ns;
+} BenchTiming;
+
+/* Timed operation, returns the number of elementary operations it performed */
+typedef long long (*BenchOp)(void *arg);
+
+static uint64_t rng_state = 1;
+static int bench_reps = 5;
+static FILE *bench_out = NULL;
+
+/*
+Seed the generator, so every map gets the same draws whatever its position in the run
+
+@param seed Seed of the run
+*/
+static void bench_seed(uint64_t seed)
+{
+    rng_state = seed * 0x9E3779B97F4A7C15ull + 1;
+}
+
+/*
+@param bound Exclusive upper bound, positive
+@return Pseudo-random integer in [0, bound) from a xorshift64* generator
+*/
+static int bench_random(int bound)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (int)(((rng_state * 0x2545F4914F6CDD1Dull) >> 33) % (uint64_t)bound);
+}
+
+/*
+@param grid Pointer to the Grid
+@param cell Cell index
+@return Coordinate of the cell
+*/
+static GridCoord cell_coord(const Grid *grid, int cell)
+{
+    return (GridCoord){.x = cell % grid->width, .y = cell / grid->width};
+}
+
+/*
+Time an operation. The number of calls per repetition is doubled until a
+repetition runs for BENCH_MIN_SECONDS, which also warms caches and the
+allocator, then bench_reps repetitions of that many calls are timed.
+
+@param op Operation to time
+@param arg Argument of the operation
+@return Timing per elementary operation
+*/
+static BenchTiming bench_measure(BenchOp op, void *arg)
+{
+    long long calls = 1;
+    long long ops = 0;
+    for (;;)
+    {
+        double start = wall_time_seconds();
+        ops = 0;
+        for (long long c = 0; c < calls; ++c)
+        {
+            ops += op(arg);
+        }
+        if (wall_time_seconds() - start >= BENCH_MIN_SECONDS || calls >= (1LL << 40))
+        {
+            break;
+        }
+        calls *= 2;
+    }
+
+    BenchTiming timing = {.ops = ops, .best_ns = 0.0, .mean_ns = 0.0};
+    if (ops <= 0)
+    {
+        return timing;
+    }
+    for (int r = 0; r < bench_reps; ++r)
+    {
+        double start = wall_time_seconds();
+        for (long long c = 0; c < calls; ++c)
+        {
+            op(arg);
+        }
+        double ns = (wall_time_seconds() - start) * 1e9 / (double)ops;
+        if (r == 0 || ns < timing.best_ns)
+        {
+            timing.best_ns = ns;
+        }
+        timing.mean_ns += ns / (double)bench_reps;
+    }
+    return timing;
+}
+
+/*
+Write one result row to the CSV file and a summary line to stdout
+
+@param benchmark Benchmark name
+@param map Map name, "-" for benchmarks without a map
+@param agents Agents involved (0 if not applicable)
+@param path_length Mean path length of the agents (0 if not applicable)
+@param constraints Constraints involved (0 if not applicable)
+@param timing Timing of the benchmark
+@param bytes Bytes handled per operation (0 if not applicable)
+*/
+static void bench_report(const char *benchmark,
+                         const char *map,
+                         int agents,
+                         double path_length,
+                         int constraints,
+                         BenchTiming timing,
+                         long long bytes)
+{
+    if (bench_out)
+    {
+        fprintf(bench_out, "%s,%s,%d,%.1f,%d,%lld,%d,%.1f,%.1f,%lld\n", benchmark, map, agents, path_length,
+                constraints, timing.ops, bench_reps, timing.best_ns, timing.mean_ns, bytes);
+        fflush(bench_out);
+    }
+    printf("[Bench] %-18s %-14s agents=%-4d length=%-6.1f constraints=%-4d best=%12.1f ns/op mean=%12.1f ns/op",
+           benchmark, map, agents, path_length, constraints, timing.best_ns, timing.mean_ns);
+    if (bytes > 0)
+    {
+        printf(" bytes=%lld", bytes);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/*
+Load a map and list its passable cells
+
+@param map Pointer to the BenchMap
+@param path Path of the map file
+@return true on success, false if the map cannot be read or has no passable cell
+*/
+static bool bench_map_load(BenchMap *map, const char *path)
+{
+    memset(map, 0, sizeof(*map));
+    if (!grid_load_from_file(&map->grid, path))
+    {
+        return false;
+    }
+    const char *slash = strrchr(path, '/');
+    map->name = slash ? slash + 1 : path;
+    int cells = map->grid.width * map->grid.height;
+    map->free_cells = (int *)malloc(sizeof(int) * (size_t)cells);
+    if (!map->free_cells)
+    {
+        fprintf(stderr, "bench_map_load: failed to allocate cell list (cells=%d)\n", cells);
+        exit(EXIT_FAILURE);
+    }
+    for (int cell = 0; cell < cells; ++cell)
+    {
+        GridCoord c = cell_coord(&map->grid, cell);
+        if (!grid_is_obstacle(&map->grid, c.x, c.y))
+        {
+            map->free_cells[map->free_count++] = cell;
+        }
+    }
+    return map->free_count > 0;
+}
+
+static void bench_map_free(BenchMap *map)
+{
+    grid_free(&map->grid);
+    free(map->free_cells);
+    map->free_cells = NULL;
+    map->free_count = 0;
+}
+
+static void bench_agents_free(BenchAgents *agents)
+{
+    for (int a = 0; agents->paths && a < agents->count; ++a)
+    {
+        path_free(&agents->paths[a]);
+    }
+    free(agents->paths);
+    free(agents->starts);
+    free(agents->goals);
+    free(agents->heuristics);
+    memset(agents, 0, sizeof(*agents));
+}
+
+/*
+Sample agents whose shortest path has between min_length and max_length
+moves and plan those paths. The repo ships maps without scenarios, so
+start and goal pairs are drawn from the seeded generator instead.
+
+@param map Pointer to the BenchMap
+@param count Number of agents
+@param min_length Fewest moves of a path
+@param max_length Most moves of a path
+@param out Pointer to the BenchAgents to fill
+@return true on success, false if the map has too few such pairs
+*/
+static bool bench_agents_sample(const BenchMap *map, int count, int min_length, int max_length, BenchAgents *out)
+{
+    size_t plane = (size_t)map->grid.width * (size_t)map->grid.height;
+    memset(out, 0, sizeof(*out));
+    out->count = count;
+    out->starts = (GridCoord *)calloc((size_t)count, sizeof(GridCoord));
+    out->goals = (GridCoord *)calloc((size_t)count, sizeof(GridCoord));
+    out->heuristics = (int *)malloc(sizeof(int) * plane * (size_t)count);
+    out->paths = (AgentPath *)calloc((size_t)count, sizeof(AgentPath));
+    if (!out->starts || !out->goals || !out->heuristics || !out->paths)
+    {
+        fprintf(stderr, "bench_agents_sample: failed to allocate agents (agents=%d cells=%zu)\n", count, plane);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int a = 0; a < count; ++a)
+    {
+        int *table = out->heuristics + plane * (size_t)a;
+        bool found = false;
+        for (int g = 0; g < BENCH_SAMPLE_TRIES && !found; ++g)
+        {
+            out->goals[a] = cell_coord(&map->grid, map->free_cells[bench_random(map->free_count)]);
+            if (!heuristic_compute_distances(&map->grid, out->goals[a], table))
+            {
+                break;
+            }
+            for (int s = 0; s < BENCH_SAMPLE_TRIES && !found; ++s)
+            {
+                int cell = map->free_cells[bench_random(map->free_count)];
+                int distance = table[cell];
+                if (distance != HEURISTIC_UNREACHABLE && distance >= min_length && distance <= max_length)
+                {
+                    out->starts[a] = cell_coord(&map->grid, cell);
+                    found = true;
+                }
+            }
+        }
+        if (!found)
+        {
+            bench_agents_free(out);
+            return false;
+        }
+    }
+
+    ConstraintSet none;
+    constraint_set_init(&none, 0);
+    AStarWorkspace workspace;
+    a_star_workspace_init(&workspace);
+    double total = 0.0;
+    bool ok = true;
+    for (int a = 0; a < count && ok; ++a)
+    {
+        path_init(&out->paths[a], 0);
+        ok = sequential_a_star(&map->grid, &none, out->starts[a], out->goals[a], out->heuristics + plane * (size_t)a,
+                               a, &workspace, &out->paths[a]);
+        total += out->paths[a].length - 1;
+    }
+    a_star_workspace_free(&workspace);
+    constraint_set_free(&none);
+    if (!ok)
+    {
+        bench_agents_free(out);
+        return false;
+    }
+    out->mean_length = total / (double)count;
+    return true;
+}
+
+/*
+Build a CT node holding the agents' paths
+
+@param agents Pointer to the BenchAgents
+@return Newly allocated HighLevelNode with id 1
+*/
+static HighLevelNode *bench_node_create(const BenchAgents *agents)
+{
+    HighLevelNode *node = cbs_node_create(agents->count);
+    if (!node)
+    {
+        fprintf(stderr, "bench_node_create: failed to allocate node (agents=%d)\n", agents->count);
+        exit(EXIT_FAILURE);
+    }
+    node->id = 1;
+    for (int a = 0; a < agents->count; ++a)
+    {
+        path_copy(&node->paths[a]->path, &agents->paths[a]);
+    }
+    node->cost = cbs_compute_soc(node);
+    return node;
+}
+
+/* Arguments of the low-level benchmark */
+typedef struct
+{
+    const BenchMap *map;
+    const BenchAgents *agents;
+    /** Constraints of each agent */
+    ConstraintSet *sets;
+    AStarWorkspace workspace;
+    AgentPath path;
+} AStarArgs;
+
+static long long op_a_star(void *arg)
+{
+    AStarArgs *args = (AStarArgs *)arg;
+    size_t plane = (size_t)args->map->grid.width * (size_t)args->map->grid.height;
+    for (int a = 0; a < args->agents->count; ++a)
+    {
+        sequential_a_star(&args->map->grid, &args->sets[a], args->agents->starts[a], args->agents->goals[a],
+                          args->agents->heuristics + plane * (size_t)a, a, &args->workspace, &args->path);
+    }
+    return args->agents->count;
+}
+
+/*
+Time sequential_a_star with 0 to 128 constraints per agent. Constraints
+are added the way CBS adds them: each one forbids a random step of the
+agent's current path, which is then replanned.
+
+@param map Pointer to the BenchMap
+*/
+static void bench_a_star(const BenchMap *map)
+{
+    static const int constraint_counts[] = {0, 8, 32, 128};
+    BenchAgents agents;
+    if (!bench_agents_sample(map, 16, 32, 128, &agents))
+    {
+        fprintf(stderr, "Warning: %s has too few start and goal pairs for the a_star benchmark.\n", map->name);
+        return;
+    }
+    size_t plane = (size_t)map->grid.width * (size_t)map->grid.height;
+    AStarArgs args = {.map = map, .agents = &agents};
+    args.sets = (ConstraintSet *)malloc(sizeof(ConstraintSet) * (size_t)agents.count);
+    if (!args.sets)
+    {
+        fprintf(stderr, "bench_a_star: failed to allocate constraint sets\n");
+        exit(EXIT_FAILURE);
+    }
+    a_star_workspace_init(&args.workspace);
+    path_init(&args.path, 0);
+    for (int a = 0; a < agents.count; ++a)
+    {
+        constraint_set_init(&args.sets[a], 0);
+    }
+
+    int added = 0;
+    for (size_t k = 0; k < sizeof(constraint_counts) / sizeof(constraint_counts[0]); ++k)
+    {
+        for (int a = 0; a < agents.count; ++a)
+        {
+            for (int c = added; c < constraint_counts[k]; ++c)
+            {
+                if (!sequential_a_star(&map->grid, &args.sets[a], agents.starts[a], agents.goals[a],
+                                       agents.heuristics + plane * (size_t)a, a, &args.workspace, &args.path))
+                {
+                    break;
+                }
+                int time = 1 + bench_random(args.path.length > 1 ? args.path.length - 1 : 1);
+                Constraint constraint = {.agent_id = a,
+                                         .time = time,
+                                         .type = CONSTRAINT_VERTEX,
+                                         .vertex = path_step_at(&args.path, time),
+                                         .edge_to = -1};
+                constraint_set_add(&args.sets[a], constraint);
+            }
+        }
+        added = constraint_counts[k];
+        bench_report("a_star", map->name, agents.count, agents.mean_length, added, bench_measure(op_a_star, &args), 0);
+    }
+
+    for (int a = 0; a < agents.count; ++a)
+    {
+        constraint_set_free(&args.sets[a]);
+    }
+    free(args.sets);
+    path_free(&args.path);
+    a_star_workspace_free(&args.workspace);
+    bench_agents_free(&agents);
+}
+
+static long long op_detect_conflict(void *arg)
+{
+    HighLevelNode *node = (HighLevelNode *)arg;
+    Conflict conflict;
+    node->conflicts_valid = false;
+    cbs_detect_conflict(node, &conflict);
+    return 1;
+}
+
+/* Arguments of the incremental conflict update benchmark */
+typedef struct
+{
+    HighLevelNode *node;
+    /** Two paths of agent 0 swapped in turn */
+    PathRef *refs[2];
+    int turn;
+} UpdateArgs;
+
+static long long op_update_conflicts(void *arg)
+{
+    UpdateArgs *args = (UpdateArgs *)arg;
+    PathRef *ref = args->refs[args->turn];
+    args->turn ^= 1;
+    path_ref_retain(ref);
+    cbs_node_set_path(args->node, 0, ref);
+    return 1;
+}
+
+/*
+Time a full conflict table build (cbs_detect_conflict on a fresh node),
+and the incremental update after one agent is replanned, for 8 to 128
+agents on short and long paths
+
+@param map Pointer to the BenchMap
+*/
+static void bench_conflicts(const BenchMap *map)
+{
+    static const int agent_counts[] = {8, 32, 128};
+    static const int bands[][2] = {{8, 32}, {64, 192}};
+    for (size_t b = 0; b < sizeof(bands) / sizeof(bands[0]); ++b)
+    {
+        for (size_t n = 0; n < sizeof(agent_counts) / sizeof(agent_counts[0]); ++n)
+        {
+            BenchAgents agents;
+            if (!bench_agents_sample(map, agent_counts[n], bands[b][0], bands[b][1], &agents))
+            {
+                fprintf(stderr, "Warning: %s has too few paths of %d to %d moves for the conflict benchmark.\n",
+                        map->name, bands[b][0], bands[b][1]);
+                continue;
+            }
+            HighLevelNode *node = bench_node_create(&agents);
+            bench_report("detect_conflict", map->name, agents.count, agents.mean_length, 0,
+                         bench_measure(op_detect_conflict, node), 0);
+
+            // agent 0 alternates between its path and the path delayed by one wait
+            UpdateArgs args = {.node = node, .turn = 0};
+            args.refs[0] = node->paths[0];
+            path_ref_retain(args.refs[0]);
+            args.refs[1] = path_ref_create();
+            path_push_step(&args.refs[1]->path, agents.paths[0].steps[0]);
+            for (int t = 0; t < agents.paths[0].length; ++t)
+            {
+                path_push_step(&args.refs[1]->path, agents.paths[0].steps[t]);
+            }
+            cbs_count_conflicts(node);
+            bench_report("update_conflicts", map->name, agents.count, agents.mean_length, 0,
+                         bench_measure(op_update_conflicts, &args), 0);
+            path_ref_release(args.refs[0]);
+            path_ref_release(args.refs[1]);
+            cbs_node_free(node);
+            bench_agents_free(&agents);
+        }
+    }
+}
+
+/* Arguments of the priority queue benchmark */
+typedef struct
+{
+    PriorityQueue queue;
+    double *keys;
+    int count;
+} QueueArgs;
+
+static long long op_queue(void *arg)
+{
+    QueueArgs *args = (QueueArgs *)arg;
+    for (int i = 0; i < args->count; ++i)
+    {
+        pq_push(&args->queue, args->keys[i], args);
+    }
+    double key = 0.0;
+    while (pq_pop(&args->queue, &key) != NULL)
+    {
+    }
+    return 2LL * args->count;
+}
+
+/*
+Time pq_push and pq_pop: each operation is one push or one pop of a queue
+filled with 1k, 64k or 1M random keys and then drained
+*/
+static void bench_queue(void)
+{
+    static const int sizes[] = {1024, 65536, 1048576};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        QueueArgs args = {.count = sizes[s]};
+        args.keys = (double *)malloc(sizeof(double) * (size_t)args.count);
+        if (!args.keys)
+        {
+            fprintf(stderr, "bench_queue: failed to allocate keys (count=%d)\n", args.count);
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < args.count; ++i)
+        {
+            // CBS costs are integral with many ties, so draw from a narrow range
+            args.keys[i] = (double)(1000 + bench_random(256));
+        }
+        pq_init(&args.queue);
+        BenchTiming timing = bench_measure(op_queue, &args);
+        bench_report("pq_push_pop", "-", args.count, 0.0, 0, timing, 0);
+        pq_free(&args.queue);
+        free(args.keys);
+    }
+}
+
+/* Arguments of the serialization, cloning and ping-pong benchmarks */
+typedef struct
+{
+    HighLevelNode *node;
+    HighLevelNode *child;
+    NodeWindow window;
+    NodeBatch batch;
+    NodeBatch reply;
+    PendingSendPool pool;
+    Constraint constraint;
+    /** Delayed path of agent 0 set on clones */
+    AgentPath detour;
+} NodeArgs;
+
+static long long op_round_trip(void *arg)
+{
+    NodeArgs *args = (NodeArgs *)arg;
+    node_batch_reset(&args->batch, 0);
+    node_batch_append(&args->batch, args->node);
+    int cursor = 0;
+    cbs_node_free(node_batch_next(&args->batch, &cursor, NULL));
+    return 1;
+}
+
+static long long op_round_trip_delta(void *arg)
+{
+    NodeArgs *args = (NodeArgs *)arg;
+    node_batch_reset(&args->batch, 0);
+    node_batch_append_delta(&args->batch, args->child, args->node);
+    int cursor = 0;
+    cbs_node_free(node_batch_next(&args->batch, &cursor, &args->window));
+    return 1;
+}
+
+static long long op_clone(void *arg)
+{
+    NodeArgs *args = (NodeArgs *)arg;
+    cbs_node_free(cbs_node_create_child(args->node, args->constraint));
+    return 1;
+}
+
+static long long op_clone_replan(void *arg)
+{
+    NodeArgs *args = (NodeArgs *)arg;
+    HighLevelNode *child = cbs_node_create_child(args->node, args->constraint);
+    PathRef *ref = path_ref_create();
+    path_copy(&ref->path, &args->detour);
+    cbs_node_set_path(child, 0, ref);
+    cbs_node_free(child);
+    return 1;
+}
+
+static long long op_ping_pong_sync(void *arg)
+{
+    NodeArgs *args = (NodeArgs *)arg;
+    node_batch_reset(&args->batch, 0);
+    node_batch_append(&args->batch, args->node);
+    node_batch_send(1, BENCH_TAG_SYNC, &args->batch);
+    node_batch_receive(1, BENCH_TAG_SYNC, &args->reply, NULL);
+    return 1;
+}
+
+static long long op_ping_pong_async(void *arg)
+{
+    NodeArgs *args = (NodeArgs *)arg;
+    node_batch_reset(&args->batch, 0);
+    node_batch_append(&args->batch, args->node);
+    node_batch_send_async(1, BENCH_TAG_ASYNC, &args->batch, &args->pool);
+    node_batch_receive(1, BENCH_TAG_ASYNC, &args->reply, NULL);
+    pending_send_pool_progress(&args->pool);
+    return 1;
+}
+
+/*
+Time node serialization round trips (full and delta records), node cloning
+and, with a second rank, the round trip of a packed node between rank 0
+and rank 1 over the blocking send and the async send pool. The node holds
+32 agents, a chain of 32 constraints and a valid conflict table, like a
+node some way down the constraint tree.
+
+@param map Pointer to the BenchMap
+@param world_size Number of ranks
+*/
+static void bench_nodes(const BenchMap *map, int world_size)
+{
+    BenchAgents agents;
+    if (!bench_agents_sample(map, 32, 32, 128, &agents))
+    {
+        fprintf(stderr, "Warning: %s has too few start and goal pairs for the node benchmarks.\n", map->name);
+        return;
+    }
+    NodeArgs args;
+    memset(&args, 0, sizeof(args));
+    args.node = bench_node_create(&agents);
+    for (int c = 0; c < 32; ++c)
+    {
+        int agent = bench_random(agents.count);
+        int time = 1 + bench_random(agents.paths[agent].length);
+        Constraint constraint = {.agent_id = agent,
+                                 .time = time,
+                                 .type = CONSTRAINT_VERTEX,
+                                 .vertex = map->free_cells[bench_random(map->free_count)],
+                                 .edge_to = -1};
+        cbs_node_add_constraint(args.node, constraint);
+    }
+    cbs_count_conflicts(args.node);
+    args.constraint = (Constraint){.agent_id = 0,
+                                   .time = 1,
+                                   .type = CONSTRAINT_VERTEX,
+                                   .vertex = path_step_at(&agents.paths[0], 1),
+                                   .edge_to = -1};
+    path_init(&args.detour, 0);
+    path_push_step(&args.detour, agents.paths[0].steps[0]);
+    for (int t = 0; t < agents.paths[0].length; ++t)
+    {
+        path_push_step(&args.detour, agents.paths[0].steps[t]);
+    }
+
+    // the delta child replans agent 0, its base waits in the receiver's window
+    args.child = cbs_node_create_child(args.node, args.constraint);
+    args.child->id = 2;
+    PathRef *ref = path_ref_create();
+    path_copy(&ref->path, &args.detour);
+    cbs_node_set_path(args.child, 0, ref);
+    args.child->cost = cbs_compute_soc(args.child);
+    node_window_init(&args.window, 4);
+    node_window_push(&args.window, cbs_node_share(args.node));
+
+    node_batch_init(&args.batch);
+    node_batch_init(&args.reply);
+    int constraints = args.node->constraint_count;
+    BenchTiming timing = bench_measure(op_round_trip, &args);
+    bench_report("serialize_full", map->name, agents.count, agents.mean_length, constraints, timing, args.batch.size);
+    timing = bench_measure(op_round_trip_delta, &args);
+    bench_report("serialize_delta", map->name, agents.count, agents.mean_length, constraints, timing, args.batch.size);
+    bench_report("clone", map->name, agents.count, agents.mean_length, constraints, bench_measure(op_clone, &args), 0);
+    bench_report("clone_replan", map->name, agents.count, agents.mean_length, constraints,
+                 bench_measure(op_clone_replan, &args), 0);
+
+    if (world_size >= 2)
+    {
+        pending_send_pool_init(&args.pool);
+        timing = bench_measure(op_ping_pong_sync, &args);
+        bench_report("ping_pong_sync", map->name, agents.count, agents.mean_length, constraints, timing,
+                     args.batch.size);
+        timing = bench_measure(op_ping_pong_async, &args);
+        // the async send hands its buffer to the pool, the reply has the same size
+        bench_report("ping_pong_async", map->name, agents.count, agents.mean_length, constraints, timing,
+                     args.reply.size);
+        pending_send_pool_wait_all(&args.pool);
+        pending_send_pool_free(&args.pool);
+    }
+
+    node_batch_free(&args.batch);
+    node_batch_free(&args.reply);
+    node_window_free(&args.window);
+    path_free(&args.detour);
+    cbs_node_free(args.child);
+    cbs_node_free(args.node);
+    bench_agents_free(&agents);
+}
+
+/*
+Send every ping-pong message back to rank 0 the way it came (blocking or
+through the async pool) until rank 0 sends BENCH_TAG_STOP
+*/
+static void bench_echo(void)
+{
+    NodeBatch batch;
+    node_batch_init(&batch);
+    PendingSendPool pool;
+    pending_send_pool_init(&pool);
+    for (;;)
+    {
+        MPI_Status status;
+        node_batch_receive(0, MPI_ANY_TAG, &batch, &status);
+        if (status.MPI_TAG == BENCH_TAG_STOP)
+        {
+            break;
+        }
+        if (status.MPI_TAG == BENCH_TAG_ASYNC)
+        {
+            node_batch_send_async(0, BENCH_TAG_ASYNC, &batch, &pool);
+            pending_send_pool_progress(&pool);
+        }
+        else
+        {
+            node_batch_send(0, status.MPI_TAG, &batch);
+        }
+    }
+    pending_send_pool_wait_all(&pool);
+    pending_send_pool_free(&pool);
+    node_batch_free(&batch);
+}
+
+/*
+Micro-benchmarks of the solver components. Rank 0 runs every benchmark on
+each --map and appends one CSV row per result to --out, rank 1 echoes the
+ping-pong messages and the other ranks wait.
+*/
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    int rank = 0;
+    int world_size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    const char *map_paths[BENCH_MAX_MAPS];
+    int map_count = 0;
+    const char *out_path = NULL;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+        {
+            if (map_count < BENCH_MAX_MAPS)
+            {
+                map_paths[map_count++] = argv[++i];
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+        {
+            bench_reps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = (uint64_t)strtoull(argv[++i], NULL, 10);
+        }
+    }
+    if (map_count == 0 || bench_reps <= 0)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Usage: bench_cbs --map map [--map map ...] [--out results.csv] [--reps N] [--seed S]\n");
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (rank != 0)
+    {
+        bench_echo();
+        MPI_Finalize();
+        return 0;
+    }
+
+    if (out_path)
+    {
+        bench_out = fopen(out_path, "w");
+        if (!bench_out)
+        {
+            fprintf(stderr, "Warning: could not open %s for writing, results go to stdout only.\n", out_path);
+        }
+        else
+        {
+            fprintf(bench_out, "benchmark,map,agents,path_length,constraints,ops,reps,best_ns_per_op,mean_ns_per_op,"
+                               "bytes_per_op\n");
+        }
+    }
+    if (world_size < 2)
+    {
+        fprintf(stderr, "Warning: ping-pong benchmarks need at least 2 ranks and are skipped.\n");
+    }
+
+    bench_seed(seed);
+    bench_queue();
+    for (int m = 0; m < map_count; ++m)
+    {
+        BenchMap map;
+        if (!bench_map_load(&map, map_paths[m]))
+        {
+            fprintf(stderr, "Warning: could not load map %s, skipping it.\n", map_paths[m]);
+            bench_map_free(&map);
+            continue;
+        }
+        bench_seed(seed);
+        bench_a_star(&map);
+        bench_conflicts(&map);
+        bench_nodes(&map, world_size);
+        bench_map_free(&map);
+    }
+
+    NodeBatch stop;
+    node_batch_init(&stop);
+    node_batch_reset(&stop, 0);
+    for (int r = 1; r < world_size; ++r)
+    {
+        node_batch_send(r, BENCH_TAG_STOP, &stop);
+    }
+    node_batch_free(&stop);
+    if (bench_out)
+    {
+        fclose(bench_out);
+    }
+    MPI_Finalize();
+    return 0;
+}
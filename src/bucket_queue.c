@@ -0,0 +1,147 @@
+#include "bucket_queue.h"
+
+#include <string.h>
+
+/*
+Initialize an empty BucketQueue
+
+@param queue Pointer to the BucketQueue to initialize
+*/
+void bucket_queue_init(BucketQueue *queue)
+{
+    queue->buckets = NULL;
+    queue->bucket_capacity = 0;
+    queue->min_key = 0;
+    queue->max_key = -1;
+    queue->count = 0;
+}
+
+/*
+Free memory used by BucketQueue
+
+@param queue Pointer to the BucketQueue to free
+*/
+void bucket_queue_free(BucketQueue *queue)
+{
+    for (int i = 0; i < queue->bucket_capacity; ++i)
+    {
+        free(queue->buckets[i].items);
+    }
+    free(queue->buckets);
+    bucket_queue_init(queue);
+}
+
+/*
+Remove every index while keeping the bucket storage for the next search
+
+@param queue Pointer to the BucketQueue to clear
+*/
+void bucket_queue_clear(BucketQueue *queue)
+{
+    for (int i = queue->min_key; i <= queue->max_key; ++i)
+    {
+        queue->buckets[i].count = 0;
+    }
+    queue->min_key = 0;
+    queue->max_key = -1;
+    queue->count = 0;
+}
+
+/*
+Insert a node index under an integer key
+
+@param queue Pointer to the BucketQueue
+@param key Non-negative priority (lower pops first)
+@param value Node index
+*/
+void bucket_queue_push(BucketQueue *queue, int key, int value)
+{
+    if (key >= queue->bucket_capacity)
+    {
+        int new_cap = queue->bucket_capacity == 0 ? 64 : queue->bucket_capacity;
+        while (new_cap <= key)
+        {
+            new_cap *= 2;
+        }
+        Bucket *new_buckets = (Bucket *)realloc(queue->buckets, sizeof(Bucket) * (size_t)new_cap);
+        if (!new_buckets)
+        {
+            fprintf(stderr, "bucket_queue_push: failed to allocate memory for BucketQueue (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        memset(new_buckets + queue->bucket_capacity, 0, sizeof(Bucket) * (size_t)(new_cap - queue->bucket_capacity));
+        queue->buckets = new_buckets;
+        queue->bucket_capacity = new_cap;
+    }
+
+    Bucket *bucket = &queue->buckets[key];
+    if (bucket->count >= bucket->capacity)
+    {
+        int new_cap = bucket->capacity == 0 ? 16 : bucket->capacity * 2;
+        int *new_items = (int *)realloc(bucket->items, sizeof(int) * (size_t)new_cap);
+        if (!new_items)
+        {
+            fprintf(stderr, "bucket_queue_push: failed to allocate memory for Bucket (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        bucket->items = new_items;
+        bucket->capacity = new_cap;
+    }
+    bucket->items[bucket->count++] = value;
+
+    // the first push fixes the scan range, later pushes may only widen it
+    if (queue->max_key < 0 || key < queue->min_key)
+    {
+        queue->min_key = key;
+    }
+    if (key > queue->max_key)
+    {
+        queue->max_key = key;
+    }
+    queue->count++;
+}
+
+/*
+Remove the most recently pushed index of the lowest non-empty key
+
+@param queue Pointer to the BucketQueue (must not be empty)
+@param out_key Output key of the popped index (may be NULL)
+@return Popped node index, or -1 if the queue is empty
+*/
+int bucket_queue_pop(BucketQueue *queue, int *out_key)
+{
+    if (queue->count == 0)
+    {
+        return -1;
+    }
+    while (queue->buckets[queue->min_key].count == 0)
+    {
+        queue->min_key++;
+    }
+    if (out_key)
+    {
+        *out_key = queue->min_key;
+    }
+    queue->count--;
+    Bucket *bucket = &queue->buckets[queue->min_key];
+    return bucket->items[--bucket->count];
+}
+
+/*
+Get the lowest key that holds an index without removing it
+
+@param queue Pointer to the BucketQueue
+@return Lowest non-empty key, or -1 if the queue is empty
+*/
+int bucket_queue_peek_key(BucketQueue *queue)
+{
+    if (queue->count == 0)
+    {
+        return -1;
+    }
+    while (queue->buckets[queue->min_key].count == 0)
+    {
+        queue->min_key++;
+    }
+    return queue->min_key;
+}
@@ -1,7 +1,12 @@
 #include "cbs.h"
 
+#include "heuristic.h"
+#include "profile.h"
+
 #include <float.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
 
 /* 
 Initialize ProblemInstance with a given number of agents and no map
@@ -16,10 +21,54 @@ void problem_instance_init(ProblemInstance *instance, int num_agents)
     instance->goals = (GridCoord *)calloc((size_t)num_agents, sizeof(GridCoord));
     instance->map.width = 0;
     instance->map.height = 0;
-    instance->map.cells = NULL;
+    instance->map.row_words = 0;
+    instance->map.obstacles = NULL;
+    instance->map.moves = NULL;
+    instance->heuristics = NULL;
+    instance->shared_window = MPI_WIN_NULL;
+    instance->mapped_file = NULL;
+    instance->mapped_bytes = 0;
     // load_grid_from_file? grid_init?
 }
 
+/*
+Release the map layers and heuristic tables wherever they live: private
+allocations, a mapped packed instance file or the node-shared window.
+Width, height and agents are kept.
+
+@param instance Pointer to the ProblemInstance
+*/
+void problem_instance_release_tables(ProblemInstance *instance)
+{
+    if (instance->shared_window != MPI_WIN_NULL)
+    {
+        // freeing the node-shared segment is collective
+        MPI_Win_free(&instance->shared_window);
+    }
+    else if (instance->mapped_file != NULL)
+    {
+        // tables computed after loading a file without them are private
+        const uint8_t *begin = (const uint8_t *)instance->mapped_file;
+        const uint8_t *table = (const uint8_t *)instance->heuristics;
+        if (table != NULL && (table < begin || table >= begin + instance->mapped_bytes))
+        {
+            free(instance->heuristics);
+        }
+        munmap(instance->mapped_file, instance->mapped_bytes);
+    }
+    else
+    {
+        free(instance->map.obstacles);
+        free(instance->map.moves);
+        free(instance->heuristics);
+    }
+    instance->map.obstacles = NULL;
+    instance->map.moves = NULL;
+    instance->heuristics = NULL;
+    instance->mapped_file = NULL;
+    instance->mapped_bytes = 0;
+}
+
 /* 
 Free memory used by ProblemInstance 
 
@@ -27,6 +76,7 @@ Free memory used by ProblemInstance
 */
 void problem_instance_free(ProblemInstance *instance)
 {
+    problem_instance_release_tables(instance);
     grid_free(&instance->map);
     free(instance->starts);
     free(instance->goals);
@@ -36,7 +86,119 @@ void problem_instance_free(ProblemInstance *instance)
 }
 
 /*
-Initialize a HighLevelNode 
+Run one backward BFS per agent goal and store the exact distance tables in the instance
+
+@param instance Pointer to the ProblemInstance, map and goals must already be loaded
+@return true on success, false on allocation failure
+*/
+bool problem_instance_build_heuristics(ProblemInstance *instance)
+{
+    size_t plane = (size_t)instance->map.width * (size_t)instance->map.height;
+    free(instance->heuristics);
+    instance->heuristics = (int *)malloc(sizeof(int) * plane * (size_t)instance->num_agents);
+    if (!instance->heuristics)
+    {
+        fprintf(stderr, "problem_instance_build_heuristics: failed to allocate tables (agents=%d cells=%zu)\n",
+                instance->num_agents, plane);
+        return false;
+    }
+    for (int agent = 0; agent < instance->num_agents; ++agent)
+    {
+        if (!heuristic_compute_distances(&instance->map, instance->goals[agent], instance->heuristics + plane * (size_t)agent))
+        {
+            free(instance->heuristics);
+            instance->heuristics = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+Get the goal distance table of an agent
+
+@param instance Pointer to the ProblemInstance
+@param agent_id ID of the agent
+@return Distance table of size width * height, or NULL if tables were not built
+*/
+const int *problem_instance_heuristic(const ProblemInstance *instance, int agent_id)
+{
+    if (!instance->heuristics)
+    {
+        return NULL;
+    }
+    size_t plane = (size_t)instance->map.width * (size_t)instance->map.height;
+    return instance->heuristics + plane * (size_t)agent_id;
+}
+
+/*
+Create an empty path reference held once
+
+@return Pointer to the new PathRef
+*/
+PathRef *path_ref_create(void)
+{
+    PathRef *ref = (PathRef *)malloc(sizeof(PathRef));
+    if (!ref)
+    {
+        fprintf(stderr, "path_ref_create: failed to allocate PathRef\n");
+        exit(EXIT_FAILURE);
+    }
+    path_init(&ref->path, 0);
+    ref->refcount = 1;
+    ref->mdd = NULL;
+    return ref;
+}
+
+/*
+Take another reference to a shared path
+
+@param ref Pointer to the PathRef
+*/
+void path_ref_retain(PathRef *ref)
+{
+    ref->refcount++;
+}
+
+/*
+Drop a reference to a shared path, freeing it with the last one
+
+@param ref Pointer to the PathRef (may be NULL)
+*/
+void path_ref_release(PathRef *ref)
+{
+    if (!ref || --ref->refcount > 0)
+    {
+        return;
+    }
+    path_free(&ref->path);
+    if (ref->mdd)
+    {
+        mdd_free(ref->mdd);
+        free(ref->mdd);
+    }
+    free(ref);
+}
+
+/*
+Drop a reference to a constraint link, freeing every ancestor link that
+is no longer held by another chain
+
+@param link Pointer to the newest ConstraintLink (may be NULL)
+*/
+static void constraint_link_release(ConstraintLink *link)
+{
+    while (link && --link->refcount == 0)
+    {
+        ConstraintLink *parent = link->parent;
+        free(link);
+        link = parent;
+    }
+}
+
+/*
+Initialize a HighLevelNode with an empty constraint chain and one empty
+unshared path per agent
 
 @param num_agents Number of agents in the problem instance
 @return Pointer to the newly created HighLevelNode, or NULL on failure
@@ -53,13 +215,103 @@ HighLevelNode *cbs_node_create(int num_agents)
     node->depth = 0;
     node->cost = 0.0;
     node->num_agents = num_agents;
-    node->paths = (AgentPath *)calloc((size_t)num_agents, sizeof(AgentPath));
-    constraint_set_init(&node->constraints, 0);
+    node->constraints = NULL;
+    node->constraint_count = 0;
+    node->conflicts = (ConflictTable){.items = NULL, .count = 0, .capacity = 0};
+    node->conflicts_valid = false;
+    node->paths = (PathRef **)malloc(sizeof(PathRef *) * (size_t)num_agents);
+    if (!node->paths)
+    {
+        free(node);
+        return NULL;
+    }
+    for (int i = 0; i < num_agents; ++i)
+    {
+        node->paths[i] = path_ref_create();
+    }
     return node;
 }
 
+/*
+Create a copy of a node that shares every path and the constraint chain
+of the original
+
+@param node Pointer to the HighLevelNode to share
+@return Pointer to the copy, or NULL on failure
+*/
+HighLevelNode *cbs_node_share(const HighLevelNode *node)
+{
+    HighLevelNode *copy = (HighLevelNode *)calloc(1, sizeof(HighLevelNode));
+    if (!copy)
+    {
+        return NULL;
+    }
+    copy->id = node->id;
+    copy->parent_id = node->parent_id;
+    copy->depth = node->depth;
+    copy->cost = node->cost;
+    copy->num_agents = node->num_agents;
+    copy->paths = (PathRef **)malloc(sizeof(PathRef *) * (size_t)node->num_agents);
+    if (!copy->paths)
+    {
+        free(copy);
+        return NULL;
+    }
+    for (int i = 0; i < node->num_agents; ++i)
+    {
+        copy->paths[i] = node->paths[i];
+        path_ref_retain(copy->paths[i]);
+    }
+    copy->constraints = node->constraints;
+    if (copy->constraints)
+    {
+        copy->constraints->refcount++;
+    }
+    copy->constraint_count = node->constraint_count;
+
+    // the copy starts from the original's conflicts and refreshes them per replanned agent
+    copy->conflicts_valid = node->conflicts_valid;
+    if (node->conflicts_valid && node->conflicts.count > 0)
+    {
+        copy->conflicts.items = (Conflict *)malloc(sizeof(Conflict) * (size_t)node->conflicts.count);
+        if (!copy->conflicts.items)
+        {
+            fprintf(stderr, "cbs_node_share: failed to allocate ConflictTable (size=%d)\n", node->conflicts.count);
+            exit(EXIT_FAILURE);
+        }
+        memcpy(copy->conflicts.items, node->conflicts.items, sizeof(Conflict) * (size_t)node->conflicts.count);
+        copy->conflicts.count = node->conflicts.count;
+        copy->conflicts.capacity = node->conflicts.count;
+    }
+    return copy;
+}
+
+/*
+Create a child node that shares every path and the constraint chain of its
+parent and adds one constraint
+
+@param parent Pointer to the parent HighLevelNode
+@param constraint Constraint added by the child
+@return Pointer to the child HighLevelNode, or NULL on failure
+*/
+HighLevelNode *cbs_node_create_child(const HighLevelNode *parent, Constraint constraint)
+{
+    double phase_start = profile_start();
+    HighLevelNode *child = cbs_node_share(parent);
+    if (!child)
+    {
+        return NULL;
+    }
+    child->id = -1;
+    child->parent_id = parent->id;
+    child->depth = parent->depth + 1;
+    cbs_node_add_constraint(child, constraint);
+    profile_stop(PROFILE_CLONE, phase_start);
+    return child;
+}
+
 /* 
-Free memory used by HighLevelNode
+Free memory used by HighLevelNode, releasing its shared paths and constraints
 
 @param node Pointer to the HighLevelNode to free
 */
@@ -69,15 +321,134 @@ void cbs_node_free(HighLevelNode *node)
     {
         return;
     }
-    for (int i = 0; i < node->num_agents; ++i)
+    for (int i = 0; node->paths && i < node->num_agents; ++i)
     {
-        path_free(&node->paths[i]);
+        path_ref_release(node->paths[i]);
     }
     free(node->paths);
-    constraint_set_free(&node->constraints);
+    constraint_link_release(node->constraints);
+    free(node->conflicts.items);
     free(node);
 }
 
+/*
+Drop the paths and conflicts of a node and keep only its constraint
+chain, from which the paths can be planned again
+
+@param node Pointer to the HighLevelNode to compress
+*/
+void cbs_node_compress(HighLevelNode *node)
+{
+    for (int i = 0; node->paths && i < node->num_agents; ++i)
+    {
+        path_ref_release(node->paths[i]);
+    }
+    free(node->paths);
+    node->paths = NULL;
+    free(node->conflicts.items);
+    node->conflicts = (ConflictTable){.items = NULL, .count = 0, .capacity = 0};
+    node->conflicts_valid = false;
+}
+
+/*
+Append a constraint to the node's chain
+
+@param node Pointer to the HighLevelNode
+@param constraint Constraint to add
+*/
+void cbs_node_add_constraint(HighLevelNode *node, Constraint constraint)
+{
+    ConstraintLink *link = (ConstraintLink *)malloc(sizeof(ConstraintLink));
+    if (!link)
+    {
+        fprintf(stderr, "cbs_node_add_constraint: failed to allocate ConstraintLink\n");
+        exit(EXIT_FAILURE);
+    }
+    link->constraint = constraint;
+    // the node's reference to the old head moves to the new link
+    link->parent = node->constraints;
+    link->refcount = 1;
+    node->constraints = link;
+    node->constraint_count++;
+}
+
+static void update_agent_conflicts(HighLevelNode *node, int agent_id);
+
+/*
+Replace the path of an agent, taking over the caller's reference.
+A valid conflict table is updated for the agent only.
+
+@param node Pointer to the HighLevelNode
+@param agent_id ID of the agent
+@param path Pointer to the new PathRef
+*/
+void cbs_node_set_path(HighLevelNode *node, int agent_id, PathRef *path)
+{
+    path_ref_release(node->paths[agent_id]);
+    node->paths[agent_id] = path;
+    if (node->conflicts_valid)
+    {
+        update_agent_conflicts(node, agent_id);
+    }
+}
+
+/*
+Flatten the constraint chain into a ConstraintSet, oldest constraint first
+
+@param node Pointer to the HighLevelNode
+@param agent_id Only collect constraints applying to this agent (negative collects all)
+@param out Pointer to an initialized ConstraintSet, its contents are replaced
+*/
+void cbs_node_collect_constraints(const HighLevelNode *node, int agent_id, ConstraintSet *out)
+{
+    out->count = 0;
+    for (const ConstraintLink *link = node->constraints; link != NULL; link = link->parent)
+    {
+        if (agent_id < 0 || constraint_applies_to(&link->constraint, agent_id))
+        {
+            constraint_set_add(out, link->constraint);
+        }
+    }
+    for (int i = 0, j = out->count - 1; i < j; ++i, --j)
+    {
+        Constraint tmp = out->items[i];
+        out->items[i] = out->items[j];
+        out->items[j] = tmp;
+    }
+}
+
+/*
+Build the constraint that resolves a conflict for one of its agents
+
+@param node Pointer to the HighLevelNode holding the conflict
+@param conflict Pointer to the Conflict
+@param agent_id Agent the constraint applies to (agent_a or agent_b)
+@return Vertex constraint at the conflict cell, or edge constraint on the agent's own move
+*/
+Constraint cbs_conflict_constraint(const HighLevelNode *node, const Conflict *conflict, int agent_id)
+{
+    if (conflict->is_vertex_conflict)
+    {
+        Constraint c = {.agent_id = agent_id,
+                        .time = conflict->time,
+                        .type = CONSTRAINT_VERTEX,
+                        .vertex = conflict->position,
+                        .edge_to = conflict->position};
+        return c;
+    }
+    Constraint c = {.agent_id = agent_id,
+                    .time = conflict->time,
+                    .type = CONSTRAINT_EDGE,
+                    .vertex = conflict->position,
+                    .edge_to = conflict->edge_to};
+    if (agent_id == conflict->agent_b)
+    {
+        c.vertex = path_step_at(cbs_node_path(node, agent_id), conflict->time);
+        c.edge_to = path_step_at(cbs_node_path(node, agent_id), conflict->time + 1);
+    }
+    return c;
+}
+
 /* 
 Compute the sum of costs (SOC) for all agents in the given HighLevelNode
 
@@ -89,104 +460,529 @@ double cbs_compute_soc(const HighLevelNode *node)
     double soc = 0.0;
     for (int i = 0; i < node->num_agents; ++i)
     {
-        soc += node->paths[i].length;
+        soc += cbs_node_path(node, i)->length;
     }
     return soc;
 }
 
-/* 
-Get the step of an agent's path at a given time index, waiting at the goal if necessary
+/* Time key of the occupancy entries that mark an agent parked at its goal */
+#define OCCUPANCY_PARKED UINT32_MAX
 
-@param path Pointer to the AgentPath
-@param time_index Time index to get the position for
-@return GridCoord position of the agent at the given time index
+/*
+Multimap from (time, cell) to the agents occupying the cell at that time.
+Each agent stores one entry per timestep before it reaches its goal and a
+single parked entry for its goal cell, so building it costs the total path
+length and a lookup costs the number of agents sharing the cell.
 */
-static GridCoord get_step_with_wait(const AgentPath *path, int time_index)
+typedef struct
 {
-    if (path->length <= 0)
+    /** Packed (time, cell) key per slot */
+    uint64_t *keys;
+    /** Agent per slot, -1 marks a free slot */
+    int *agents;
+    /** Number of slots (power of two) */
+    int capacity;
+} OccupancyTable;
+
+static inline uint64_t occupancy_key(uint32_t time, int cell)
+{
+    return ((uint64_t)time << 32) | (uint64_t)(uint32_t)cell;
+}
+
+static inline size_t occupancy_slot(uint64_t key, int capacity)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    return (size_t)key & (size_t)(capacity - 1);
+}
+
+static void occupancy_insert(OccupancyTable *table, uint64_t key, int agent)
+{
+    size_t slot = occupancy_slot(key, table->capacity);
+    while (table->agents[slot] >= 0)
     {
-        return (GridCoord){0, 0};
+        slot = (slot + 1) & (size_t)(table->capacity - 1);
     }
-    if (time_index < path->length)
+    table->keys[slot] = key;
+    table->agents[slot] = agent;
+}
+
+/*
+Build the occupancy of every agent except one
+
+@param table Pointer to the OccupancyTable to fill
+@param node Pointer to the HighLevelNode
+@param skip_agent Agent left out of the table (-1 keeps all)
+*/
+static void occupancy_build(OccupancyTable *table, const HighLevelNode *node, int skip_agent)
+{
+    int entries = 0;
+    for (int i = 0; i < node->num_agents; ++i)
     {
-        return path->steps[time_index];
+        if (i != skip_agent)
+        {
+            entries += cbs_node_path(node, i)->length;
+        }
+    }
+    // keep the load factor at or below one half
+    table->capacity = 16;
+    while (table->capacity < entries * 2)
+    {
+        table->capacity *= 2;
+    }
+    table->keys = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)table->capacity);
+    table->agents = (int *)malloc(sizeof(int) * (size_t)table->capacity);
+    if (!table->keys || !table->agents)
+    {
+        fprintf(stderr, "occupancy_build: failed to allocate OccupancyTable (size=%d)\n", table->capacity);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < table->capacity; ++i)
+    {
+        table->agents[i] = -1;
+    }
+
+    for (int agent = 0; agent < node->num_agents; ++agent)
+    {
+        const AgentPath *path = cbs_node_path(node, agent);
+        if (agent == skip_agent || path->length == 0)
+        {
+            continue;
+        }
+        for (int t = 0; t + 1 < path->length; ++t)
+        {
+            occupancy_insert(table, occupancy_key((uint32_t)t, path->steps[t]), agent);
+        }
+        occupancy_insert(table, occupancy_key(OCCUPANCY_PARKED, path->steps[path->length - 1]), agent);
     }
-    return path->steps[path->length - 1];
 }
 
-/* 
-Detect the first conflict in the given HighLevelNode's paths
+static void occupancy_free(OccupancyTable *table)
+{
+    free(table->keys);
+    free(table->agents);
+    table->keys = NULL;
+    table->agents = NULL;
+    table->capacity = 0;
+}
+
+static void conflict_table_add(ConflictTable *table, Conflict conflict)
+{
+    if (table->count >= table->capacity)
+    {
+        int new_cap = table->capacity == 0 ? 8 : table->capacity * 2;
+        Conflict *new_items = (Conflict *)realloc(table->items, sizeof(Conflict) * (size_t)new_cap);
+        if (!new_items)
+        {
+            fprintf(stderr, "conflict_table_add: failed to allocate memory for ConflictTable (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        table->items = new_items;
+        table->capacity = new_cap;
+    }
+    table->items[table->count++] = conflict;
+}
+
+/*
+Record the conflict between agent and other at time t, with agent_a the lower id
+and the positions taken from agent_a's path
+*/
+static Conflict make_conflict(const HighLevelNode *node, int agent, int other, int time, bool is_vertex)
+{
+    int a = agent < other ? agent : other;
+    int b = agent < other ? other : agent;
+    Conflict conflict = {.agent_a = a,
+                         .agent_b = b,
+                         .time = time,
+                         .position = path_step_at(cbs_node_path(node, a), time),
+                         .is_vertex_conflict = is_vertex,
+                         .edge_to = path_step_at(cbs_node_path(node, a), time + 1)};
+    if (is_vertex)
+    {
+        conflict.edge_to = conflict.position;
+    }
+    return conflict;
+}
+
+/*
+Append the earliest conflict between one agent and each other agent in the
+occupancy table. Timesteps are scanned in order and a vertex conflict is
+checked before a swap at the same timestep, so the result per pair matches
+a full pairwise scan.
 
 @param node Pointer to the HighLevelNode
-@param conflict Pointer to store the detected Conflict (can be NULL)
-@return true if a conflict is detected, false otherwise
+@param agent Agent whose path is checked
+@param occupancy Occupancy of the agents to check against
+@param min_other Only report conflicts with agents above this id (-1 reports all)
+@param seen Scratch flags, one per agent, cleared by the caller
+@param out Pointer to the ConflictTable receiving the conflicts
 */
-bool cbs_detect_conflict(const HighLevelNode *node, Conflict *conflict)
+static void collect_agent_conflicts(const HighLevelNode *node,
+                                    int agent,
+                                    const OccupancyTable *occupancy,
+                                    int min_other,
+                                    bool *seen,
+                                    ConflictTable *out)
 {
+    const AgentPath *path = cbs_node_path(node, agent);
+    if (path->length == 0)
+    {
+        return;
+    }
     int max_len = 0;
-    // iterate thru all agents to find the longest path length
     for (int i = 0; i < node->num_agents; ++i)
     {
-        if (node->paths[i].length > max_len)
+        if (cbs_node_path(node, i)->length > max_len)
         {
-            max_len = node->paths[i].length;
+            max_len = cbs_node_path(node, i)->length;
         }
     }
 
-    // iterate through all time steps up to the longest path length
+    size_t mask = (size_t)(occupancy->capacity - 1);
     for (int t = 0; t < max_len; ++t)
     {
-        // iterate through all agents pairwise to check for conflicts at time t
-        for (int a = 0; a < node->num_agents; ++a)
-        {
-            // get current and next positions for agent a
-            GridCoord pa_curr = get_step_with_wait(&node->paths[a], t);
-            GridCoord pa_next = get_step_with_wait(&node->paths[a], t + 1);
+        int curr = path_step_at(path, t);
+        int next = path_step_at(path, t + 1);
 
-            // get current and next positions for agent b
-            for (int b = a + 1; b < node->num_agents; ++b)
+        // vertex conflicts: agents moving through the cell at t and agents parked on it
+        uint64_t keys[2] = {occupancy_key((uint32_t)t, curr), occupancy_key(OCCUPANCY_PARKED, curr)};
+        for (int k = 0; k < 2; ++k)
+        {
+            for (size_t slot = occupancy_slot(keys[k], occupancy->capacity); occupancy->agents[slot] >= 0; slot = (slot + 1) & mask)
             {
-                GridCoord pb_curr = get_step_with_wait(&node->paths[b], t);
-                GridCoord pb_next = get_step_with_wait(&node->paths[b], t + 1);
-
-                // check for vertex conflict
-                if (pa_curr.x == pb_curr.x && pa_curr.y == pb_curr.y)
+                int other = occupancy->agents[slot];
+                if (occupancy->keys[slot] != keys[k] || other <= min_other || seen[other])
                 {
-                    // vertex conflict detected
-                    printf("Conflict detected between agent %d and agent %d at time %d at position (%d, %d)\n",
-                           a, b, t, pa_curr.x, pa_curr.y);
-                    if (conflict)
-                    {
-                        // fill conflict details
-                        conflict->agent_a = a;
-                        conflict->agent_b = b;
-                        conflict->time = t;
-                        conflict->position = pa_curr;
-                        conflict->is_vertex_conflict = true;
-                    }
-                    return true;
+                    continue;
                 }
-
-                if (pa_curr.x == pb_next.x && pa_curr.y == pb_next.y &&
-                    pb_curr.x == pa_next.x && pb_curr.y == pa_next.y)
+                if (k == 1 && t < cbs_node_path(node, other)->length - 1)
                 {
-                    // edge conflict detected
-                    printf("Edge conflict detected between agent %d and agent %d at time %d from (%d, %d) to (%d, %d)\n",
-                           a, b, t, pa_curr.x, pa_curr.y, pa_next.x, pa_next.y);
-                    if (conflict)
-                    {
-                        // fill conflict details
-                        conflict->agent_a = a;
-                        conflict->agent_b = b;
-                        conflict->time = t;
-                        conflict->position = pa_curr;
-                        conflict->edge_to = pa_next;
-                        conflict->is_vertex_conflict = false;
-                    }
-                    return true;
+                    continue;
                 }
+                seen[other] = true;
+                conflict_table_add(out, make_conflict(node, agent, other, t, true));
+            }
+        }
+
+        // edge conflicts: an agent at the next cell at t moving into the current cell
+        if (next == curr)
+        {
+            continue;
+        }
+        uint64_t key = occupancy_key((uint32_t)t, next);
+        for (size_t slot = occupancy_slot(key, occupancy->capacity); occupancy->agents[slot] >= 0; slot = (slot + 1) & mask)
+        {
+            int other = occupancy->agents[slot];
+            if (occupancy->keys[slot] != key || other <= min_other || seen[other])
+            {
+                continue;
+            }
+            if (path_step_at(cbs_node_path(node, other), t + 1) == curr)
+            {
+                seen[other] = true;
+                conflict_table_add(out, make_conflict(node, agent, other, t, false));
+            }
+        }
+    }
+}
+
+/*
+Compute the full conflict table of a node
+
+@param node Pointer to the HighLevelNode
+*/
+static void compute_conflicts(HighLevelNode *node)
+{
+    double phase_start = profile_start();
+    node->conflicts.count = 0;
+    OccupancyTable occupancy;
+    occupancy_build(&occupancy, node, -1);
+    bool *seen = (bool *)malloc(sizeof(bool) * (size_t)node->num_agents);
+    for (int agent = 0; agent < node->num_agents; ++agent)
+    {
+        for (int i = 0; i < node->num_agents; ++i)
+        {
+            seen[i] = false;
+        }
+        collect_agent_conflicts(node, agent, &occupancy, agent, seen, &node->conflicts);
+    }
+    free(seen);
+    occupancy_free(&occupancy);
+    node->conflicts_valid = true;
+    profile_stop(PROFILE_CONFLICTS, phase_start);
+}
+
+/*
+Refresh the conflicts of one agent after its path changed, leaving all
+other pairs untouched
+
+@param node Pointer to the HighLevelNode with a valid conflict table
+@param agent_id Agent whose path was replaced
+*/
+static void update_agent_conflicts(HighLevelNode *node, int agent_id)
+{
+    double phase_start = profile_start();
+    int write = 0;
+    for (int i = 0; i < node->conflicts.count; ++i)
+    {
+        const Conflict *c = &node->conflicts.items[i];
+        if (c->agent_a != agent_id && c->agent_b != agent_id)
+        {
+            node->conflicts.items[write++] = *c;
+        }
+    }
+    node->conflicts.count = write;
+
+    OccupancyTable occupancy;
+    occupancy_build(&occupancy, node, agent_id);
+    bool *seen = (bool *)calloc((size_t)node->num_agents, sizeof(bool));
+    collect_agent_conflicts(node, agent_id, &occupancy, -1, seen, &node->conflicts);
+    free(seen);
+    occupancy_free(&occupancy);
+    profile_stop(PROFILE_CONFLICTS, phase_start);
+}
+
+/* 
+Get the earliest conflict of the node's paths (lowest time, then lowest agent pair)
+
+@param node Pointer to the HighLevelNode, its conflict table is computed if needed
+@param conflict Pointer to store the detected Conflict (can be NULL)
+@return true if a conflict is detected, false otherwise
+*/
+bool cbs_detect_conflict(HighLevelNode *node, Conflict *conflict)
+{
+    if (!node->conflicts_valid)
+    {
+        compute_conflicts(node);
+    }
+    if (node->conflicts.count == 0)
+    {
+        return false;
+    }
+    const Conflict *best = &node->conflicts.items[0];
+    for (int i = 1; i < node->conflicts.count; ++i)
+    {
+        const Conflict *c = &node->conflicts.items[i];
+        if (c->time < best->time ||
+            (c->time == best->time && (c->agent_a < best->agent_a ||
+                                       (c->agent_a == best->agent_a && c->agent_b < best->agent_b))))
+        {
+            best = c;
+        }
+    }
+    if (conflict)
+    {
+        *conflict = *best;
+    }
+    return true;
+}
+
+/*
+Count the conflicting agent pairs of the node's paths
+
+@param node Pointer to the HighLevelNode, its conflict table is computed if needed
+@return Number of agent pairs in conflict
+*/
+int cbs_count_conflicts(HighLevelNode *node)
+{
+    if (!node->conflicts_valid)
+    {
+        compute_conflicts(node);
+    }
+    return node->conflicts.count;
+}
+
+/*
+Get the MDD of an agent's current path, building and caching it in the
+shared PathRef on first use. A PathRef is only ever shared by nodes that
+agree on the agent's constraints, so the cached diagram stays valid.
+
+@param node Pointer to the HighLevelNode
+@param instance Pointer to the ProblemInstance
+@param agent_id ID of the agent
+@return Pointer to the Mdd, or NULL if it could not be built
+*/
+static const Mdd *agent_mdd(HighLevelNode *node, const ProblemInstance *instance, int agent_id)
+{
+    PathRef *ref = node->paths[agent_id];
+    if (ref->mdd)
+    {
+        return ref->mdd->depth >= 0 ? ref->mdd : NULL;
+    }
+    Mdd *mdd = (Mdd *)malloc(sizeof(Mdd));
+    if (!mdd)
+    {
+        fprintf(stderr, "agent_mdd: failed to allocate Mdd\n");
+        exit(EXIT_FAILURE);
+    }
+    mdd_init(mdd);
+
+    ConstraintSet constraints;
+    constraint_set_init(&constraints, node->constraint_count);
+    cbs_node_collect_constraints(node, agent_id, &constraints);
+    bool ok = mdd_build(&instance->map,
+                        &constraints,
+                        instance->starts[agent_id],
+                        instance->goals[agent_id],
+                        problem_instance_heuristic(instance, agent_id),
+                        agent_id,
+                        ref->path.length - 1,
+                        mdd);
+    constraint_set_free(&constraints);
+    ref->mdd = mdd;
+    return ok ? mdd : NULL;
+}
+
+/* Agents whose MDDs cbs_prepare_mdds builds */
+typedef struct
+{
+    HighLevelNode *node;
+    const ProblemInstance *instance;
+    const int *agents;
+} MddBatch;
+
+static void build_mdd_task(void *context, int task_index, int thread_index)
+{
+    (void)thread_index;
+    const MddBatch *batch = (const MddBatch *)context;
+    agent_mdd(batch->node, batch->instance, batch->agents[task_index]);
+}
+
+/*
+Build the missing MDDs of every agent in a conflict of the node on the
+pool's threads, so classifying the conflicts afterwards only reads them.
+Each agent has its own PathRef, so the tasks never touch the same diagram.
+
+@param node Pointer to the HighLevelNode, its conflict table is computed if needed
+@param instance Pointer to the ProblemInstance
+@param threads Pointer to the ThreadPool (NULL or one thread does nothing)
+*/
+void cbs_prepare_mdds(HighLevelNode *node, const ProblemInstance *instance, ThreadPool *threads)
+{
+    if (threads == NULL || threads->thread_count == 1)
+    {
+        return;
+    }
+    if (!node->conflicts_valid)
+    {
+        compute_conflicts(node);
+    }
+    int *agents = (int *)malloc(sizeof(int) * (size_t)node->num_agents);
+    bool *listed = (bool *)calloc((size_t)node->num_agents, sizeof(bool));
+    if (!agents || !listed)
+    {
+        fprintf(stderr, "cbs_prepare_mdds: failed to allocate agent list (agents=%d)\n", node->num_agents);
+        exit(EXIT_FAILURE);
+    }
+    int count = 0;
+    for (int i = 0; i < node->conflicts.count; ++i)
+    {
+        int pair[2] = {node->conflicts.items[i].agent_a, node->conflicts.items[i].agent_b};
+        for (int k = 0; k < 2; ++k)
+        {
+            if (!listed[pair[k]] && node->paths[pair[k]]->mdd == NULL)
+            {
+                listed[pair[k]] = true;
+                agents[count++] = pair[k];
             }
         }
     }
-    return false;
+    MddBatch batch = {.node = node, .instance = instance, .agents = agents};
+    thread_pool_run(threads, count, build_mdd_task, &batch);
+    free(agents);
+    free(listed);
+}
+
+/*
+Check whether every optimal path of an agent makes the conflicting move
+
+@param node Pointer to the HighLevelNode
+@param instance Pointer to the ProblemInstance
+@param conflict Pointer to the Conflict
+@param agent_id agent_a or agent_b of the conflict
+@return true if the constraint for this agent forces a costlier path
+*/
+static bool agent_is_cardinal(HighLevelNode *node, const ProblemInstance *instance, const Conflict *conflict, int agent_id)
+{
+    const Mdd *mdd = agent_mdd(node, instance, agent_id);
+    if (!mdd)
+    {
+        return false;
+    }
+    const AgentPath *path = cbs_node_path(node, agent_id);
+    int from = path_step_at(path, conflict->time);
+    if (conflict->is_vertex_conflict)
+    {
+        return mdd_is_singleton(mdd, conflict->time, from);
+    }
+    int to = path_step_at(path, conflict->time + 1);
+    return mdd_is_singleton(mdd, conflict->time, from) && mdd_is_singleton(mdd, conflict->time + 1, to);
+}
+
+/*
+Classify a conflict as cardinal, semi-cardinal or non-cardinal
+
+@param node Pointer to the HighLevelNode holding the conflict
+@param instance Pointer to the ProblemInstance
+@param conflict Pointer to the Conflict
+@return ConflictClass of the conflict
+*/
+ConflictClass cbs_classify_conflict(HighLevelNode *node, const ProblemInstance *instance, const Conflict *conflict)
+{
+    int cardinal_agents = (agent_is_cardinal(node, instance, conflict, conflict->agent_a) ? 1 : 0) +
+                          (agent_is_cardinal(node, instance, conflict, conflict->agent_b) ? 1 : 0);
+    return cardinal_agents == 2 ? CONFLICT_CARDINAL
+                                : (cardinal_agents == 1 ? CONFLICT_SEMI_CARDINAL : CONFLICT_NON_CARDINAL);
+}
+
+/*
+Choose the conflict to split on: cardinal before semi-cardinal before
+non-cardinal, the earliest (then lowest agent pair) within a class
+
+@param node Pointer to the HighLevelNode
+@param instance Pointer to the ProblemInstance
+@param conflict Pointer to store the chosen Conflict (can be NULL)
+@param out_class Pointer to store the class of the chosen conflict (can be NULL)
+@return true if the node has a conflict, false otherwise
+*/
+bool cbs_select_conflict(HighLevelNode *node, const ProblemInstance *instance, Conflict *conflict, ConflictClass *out_class)
+{
+    if (!node->conflicts_valid)
+    {
+        compute_conflicts(node);
+    }
+    if (node->conflicts.count == 0)
+    {
+        return false;
+    }
+    int best = -1;
+    ConflictClass best_class = CONFLICT_NON_CARDINAL;
+    for (int i = 0; i < node->conflicts.count; ++i)
+    {
+        const Conflict *c = &node->conflicts.items[i];
+        ConflictClass cls = cbs_classify_conflict(node, instance, c);
+        if (best >= 0)
+        {
+            const Conflict *b = &node->conflicts.items[best];
+            bool earlier = c->time < b->time ||
+                           (c->time == b->time && (c->agent_a < b->agent_a ||
+                                                   (c->agent_a == b->agent_a && c->agent_b < b->agent_b)));
+            if (cls < best_class || (cls == best_class && !earlier))
+            {
+                continue;
+            }
+        }
+        best = i;
+        best_class = cls;
+    }
+    if (conflict)
+    {
+        *conflict = node->conflicts.items[best];
+    }
+    if (out_class)
+    {
+        *out_class = best_class;
+    }
+    return true;
 }
@@ -52,3 +52,171 @@ void constraint_set_add(ConstraintSet *set, Constraint constraint)
     }
     set->items[set->count++] = constraint;
 }
+
+
+static inline size_t constraint_key_slot(int time, int from, int to, int capacity)
+{
+    uint64_t h = (uint64_t)(uint32_t)time * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)(uint32_t)from * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (uint64_t)(uint32_t)to * 0x165667B19E3779F9ULL;
+    h ^= h >> 29;
+    return (size_t)h & (size_t)(capacity - 1);
+}
+
+/*
+Initialize an empty ConstraintIndex
+
+@param index Pointer to the ConstraintIndex to initialize
+*/
+void constraint_index_init(ConstraintIndex *index)
+{
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+    index->last_time = -1;
+    constraint_set_init(&index->filtered, 0);
+}
+
+/*
+Free memory used by ConstraintIndex
+
+@param index Pointer to the ConstraintIndex to free
+*/
+void constraint_index_free(ConstraintIndex *index)
+{
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+    index->last_time = -1;
+    constraint_set_free(&index->filtered);
+}
+
+static void constraint_index_insert(ConstraintIndex *index, int time, int from, int to)
+{
+    size_t slot = constraint_key_slot(time, from, to, index->capacity);
+    while (index->slots[slot].time >= 0)
+    {
+        const ConstraintKey *key = &index->slots[slot];
+        if (key->time == time && key->from == from && key->to == to)
+        {
+            return;
+        }
+        slot = (slot + 1) & (size_t)(index->capacity - 1);
+    }
+    index->slots[slot] = (ConstraintKey){.time = time, .from = from, .to = to};
+    index->count++;
+}
+
+/*
+Build the index for one agent from a ConstraintSet, replacing previous contents
+
+@param index Pointer to the ConstraintIndex
+@param set Pointer to the ConstraintSet (may hold constraints of other agents)
+@param agent_id ID of the agent being planned
+*/
+void constraint_index_build(ConstraintIndex *index, const ConstraintSet *set, int agent_id)
+{
+    index->count = 0;
+    index->last_time = -1;
+    index->filtered.count = 0;
+    for (int i = 0; i < set->count; ++i)
+    {
+        if (constraint_applies_to(&set->items[i], agent_id))
+        {
+            constraint_set_add(&index->filtered, set->items[i]);
+        }
+    }
+
+    // keep the load factor at or below one half
+    int needed = 16;
+    while (needed < index->filtered.count * 2)
+    {
+        needed *= 2;
+    }
+    if (needed > index->capacity)
+    {
+        free(index->slots);
+        index->slots = (ConstraintKey *)malloc(sizeof(ConstraintKey) * (size_t)needed);
+        if (!index->slots)
+        {
+            fprintf(stderr, "constraint_index_build: failed to allocate ConstraintIndex (size=%d)\n", needed);
+            exit(EXIT_FAILURE);
+        }
+        index->capacity = needed;
+    }
+    for (int i = 0; i < index->capacity; ++i)
+    {
+        index->slots[i].time = -1;
+    }
+
+    for (int i = 0; i < index->filtered.count; ++i)
+    {
+        const Constraint *c = &index->filtered.items[i];
+        if (c->type == CONSTRAINT_VERTEX)
+        {
+            constraint_index_insert(index, c->time, c->vertex, c->vertex);
+            if (c->time > index->last_time)
+            {
+                index->last_time = c->time;
+            }
+        }
+        else
+        {
+            constraint_index_insert(index, c->time, c->vertex, c->edge_to);
+            if (c->time + 1 > index->last_time)
+            {
+                index->last_time = c->time + 1;
+            }
+        }
+    }
+}
+
+/*
+Look up an exact (time, from, to) key; vertex constraints use from == to
+
+@param index Pointer to the ConstraintIndex
+@param time Time step of the key
+@param from Departure or constrained cell
+@param to Arrival or constrained cell
+@return true if the key is indexed
+*/
+bool constraint_index_contains(const ConstraintIndex *index, int time, int from, int to)
+{
+    if (index->count == 0)
+    {
+        return false;
+    }
+    size_t slot = constraint_key_slot(time, from, to, index->capacity);
+    while (index->slots[slot].time >= 0)
+    {
+        const ConstraintKey *key = &index->slots[slot];
+        if (key->time == time && key->from == from && key->to == to)
+        {
+            return true;
+        }
+        slot = (slot + 1) & (size_t)(index->capacity - 1);
+    }
+    return false;
+}
+
+/*
+Get the last timestep at which the agent is forbidden to occupy a cell
+
+@param index Pointer to the ConstraintIndex
+@param cell Linear cell index
+@return Last constrained timestep of the cell, or -1 if it is never constrained
+*/
+int constraint_index_last_vertex_time(const ConstraintIndex *index, int cell)
+{
+    int last = -1;
+    for (int i = 0; i < index->filtered.count; ++i)
+    {
+        const Constraint *c = &index->filtered.items[i];
+        if (c->type == CONSTRAINT_VERTEX && c->vertex == cell && c->time > last)
+        {
+            last = c->time;
+        }
+    }
+    return last;
+}
@@ -1,8 +1,11 @@
 #define _DEFAULT_SOURCE  /* For usleep() on Linux */
 #include "coordinator.h"
 
+#include "log.h"
 #include "messages.h"
-#include "priority_queue.h"
+#include "node_store.h"
+#include "open_list.h"
+#include "profile.h"
 #include "serialization.h"
 
 #include <float.h>
@@ -12,62 +15,645 @@
 #include <string.h>
 #include <unistd.h>
 
-static int select_worker(const WorkerSet *workers, int *rr_index)
+static bool initialize_root(const ProblemInstance *instance,
+                            const LowLevelContext *ll_ctx,
+                            HighLevelNode *root)
 {
-    if (workers->count == 0)
+    // one batch, so the low-level pool plans the agents side by side
+    int count = instance->num_agents;
+    const HighLevelNode **nodes = (const HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)count);
+    int *agents = (int *)malloc(sizeof(int) * (size_t)count);
+    AgentPath **paths = (AgentPath **)malloc(sizeof(AgentPath *) * (size_t)count);
+    if (!nodes || !agents || !paths)
+    {
+        fprintf(stderr, "initialize_root: failed to allocate root batch (agents=%d)\n", count);
+        exit(EXIT_FAILURE);
+    }
+    for (int agent = 0; agent < count; ++agent)
+    {
+        nodes[agent] = root;
+        agents[agent] = agent;
+        paths[agent] = &root->paths[agent]->path;
+    }
+    bool ok = low_level_request_paths(instance, nodes, agents, count, ll_ctx, paths, NULL);
+    free(nodes);
+    free(agents);
+    free(paths);
+    if (!ok)
     {
-        return MPI_PROC_NULL;
+        return false;
     }
-    int idx = *rr_index % workers->count;
-    int rank = workers->ranks[idx];
-    *rr_index = (*rr_index + 1) % workers->count;
-    return rank;
+    root->cost = cbs_compute_soc(root);
+    return true;
 }
 
-static bool initialize_root(const ProblemInstance *instance,
-                            const LowLevelContext *ll_ctx,
-                            HighLevelNode *root)
+static int worker_slot(const WorkerSet *workers, int rank)
 {
-    for (int agent = 0; agent < instance->num_agents; ++agent)
+    for (int w = 0; w < workers->count; ++w)
     {
-        if (!low_level_request_path(instance, &root->constraints, agent, ll_ctx, &root->paths[agent]))
+        if (workers->ranks[w] == rank)
         {
-            return false;
+            return w;
         }
     }
-    root->cost = cbs_compute_soc(root);
-    return true;
+    return -1;
+}
+
+/*
+Pick a worker for a node among those below the in-flight depth.
+The least loaded workers are preferred, and among them the one whose
+window holds the node's parent so it can be sent as a delta. Ties are
+broken round-robin.
+
+@param workers Pointer to the WorkerSet
+@param in_flight Tasks awaiting a reply per worker
+@param depth Maximum tasks in flight per worker
+@param windows Mirror of each worker's task window
+@param parent_id ID of the node's parent
+@param rr_index Round-robin cursor over the workers
+@return Worker slot, or -1 if every worker is at full depth
+*/
+static int pick_worker(const WorkerSet *workers,
+                       const int *in_flight,
+                       int depth,
+                       const NodeWindow *windows,
+                       int parent_id,
+                       int *rr_index)
+{
+    int best = -1;
+    bool best_holds_parent = false;
+    for (int k = 0; k < workers->count; ++k)
+    {
+        int w = (*rr_index + k) % workers->count;
+        if (in_flight[w] >= depth)
+        {
+            continue;
+        }
+        bool holds_parent = node_window_find(&windows[w], parent_id) != NULL;
+        if (best < 0 ||
+            in_flight[w] < in_flight[best] ||
+            (in_flight[w] == in_flight[best] && holds_parent && !best_holds_parent))
+        {
+            best = w;
+            best_holds_parent = holds_parent;
+        }
+    }
+    if (best >= 0)
+    {
+        *rr_index = (best + 1) % workers->count;
+    }
+    return best;
 }
 
-static void dispatch_node(const HighLevelNode *node,
+/*
+Hand out the next open nodes until every worker is at full depth or
+every open node is within the suboptimality bound of the incumbent.
+The nodes assigned to one worker go out in a single task message whose
+header carries the incumbent bound. A worker that gets no task but must
+learn a new incumbent receives an empty task message instead. Each sent
+node moves into the worker's mirrored window.
+
+@param open Pointer to the open list
+@param incumbent_cost Current incumbent cost (DBL_MAX if none)
+@param workers Pointer to the WorkerSet
+@param in_flight Tasks awaiting a reply per worker (updated)
+@param depth Maximum tasks in flight per worker
+@param notify Workers still unaware of the incumbent (cleared when told)
+@param rr_index Round-robin cursor over the workers
+@param batches One reusable NodeBatch per worker
+@param windows Mirror of each worker's task window
+@param pool Pointer to the PendingSendPool
+@return Number of nodes dispatched
+*/
+static int dispatch_ready(OpenList *open,
                           double incumbent_cost,
-                          int worker_rank,
+                          const WorkerSet *workers,
+                          int *in_flight,
+                          int depth,
+                          bool *notify,
+                          int *rr_index,
+                          NodeBatch *batches,
+                          NodeWindow *windows,
                           PendingSendPool *pool)
 {
-    SerializedNode payload;
-    serialize_high_level_node(node, &payload);
-    payload.aux_value = (int)(incumbent_cost >= (double)INT_MAX ? INT_MAX : (int)ceil(incumbent_cost));
-    send_serialized_node_async(worker_rank, TAG_TASK, &payload, pool);
-    free_serialized_node(&payload);
+    int coord_rank = 0;
+    MPI_Comm_rank(solver_comm, &coord_rank);
+    int bound = (int)(incumbent_cost >= (double)INT_MAX ? INT_MAX : (int)ceil(incumbent_cost));
+    for (int w = 0; w < workers->count; ++w)
+    {
+        node_batch_reset(&batches[w], bound);
+    }
+
+    int dispatched = 0;
+    while (1)
+    {
+        const HighLevelNode *best = open_list_peek(open);
+        if (best == NULL || open_list_lower_bound(open) * open->suboptimality >= incumbent_cost - 1e-6)
+        {
+            break;
+        }
+        int slot = pick_worker(workers, in_flight, depth, windows, best->parent_id, rr_index);
+        if (slot < 0)
+        {
+            break;
+        }
+        HighLevelNode *node = open_list_pop(open);
+        if (node == NULL)
+        {
+            break;
+        }
+        // a focal node (or a compressed one replanned on pop) may not beat the incumbent
+        if (node->cost >= incumbent_cost - 1e-6)
+        {
+            cbs_node_free(node);
+            continue;
+        }
+        const HighLevelNode *base = node_window_find(&windows[slot], node->parent_id);
+        LOG_DEBUG("[Coordinator %d] -> Worker %d: node id=%d depth=%d cost=%.0f (%s, in_flight=%d)\n",
+                  coord_rank,
+                  workers->ranks[slot],
+                  node->id,
+                  node->depth,
+                  node->cost,
+                  base ? "delta" : "full",
+                  in_flight[slot] + 1);
+        if (base)
+        {
+            node_batch_append_delta(&batches[slot], node, base);
+        }
+        else
+        {
+            node_batch_append(&batches[slot], node);
+        }
+        node_window_push(&windows[slot], node);
+        in_flight[slot]++;
+        dispatched++;
+    }
+
+    for (int w = 0; w < workers->count; ++w)
+    {
+        // an empty task still carries the bound to a worker busy with earlier tasks
+        if (batches[w].node_count > 0 || (notify[w] && in_flight[w] > 0))
+        {
+            node_batch_send_async(workers->ranks[w], TAG_TASK, &batches[w], pool);
+            notify[w] = false;
+        }
+    }
+    return dispatched;
+}
+
+/*
+Lowest cost among the tasks still awaiting a reply. Workers expand their
+tasks in arrival order, so those are the newest entries of each mirrored
+window.
+
+@param windows Mirrored task windows, one per worker
+@param in_flight Tasks awaiting a reply per worker
+@param count Number of workers
+@return Lowest in-flight task cost, DBL_MAX if none
+*/
+static double in_flight_lower_bound(const NodeWindow *windows, const int *in_flight, int count)
+{
+    double lowest = DBL_MAX;
+    for (int w = 0; w < count; ++w)
+    {
+        const NodeWindow *window = &windows[w];
+        for (int k = 0; k < in_flight[w] && k < window->count; ++k)
+        {
+            const HighLevelNode *task = window->nodes[(window->head + window->count - 1 - k) % window->capacity];
+            if (task->cost < lowest)
+            {
+                lowest = task->cost;
+            }
+        }
+    }
+    return lowest;
+}
+
+/*
+Block until the next message from any rank. Only called while tasks are
+outstanding, so a reply is bound to arrive; the caller checks its
+deadline between replies.
+
+@param pool Pointer to the PendingSendPool progressed before blocking
+@param status Output status of the pending message
+*/
+static void wait_for_message(PendingSendPool *pool, MPI_Status *status)
+{
+    pending_send_pool_progress(pool);
+    double idle_start = profile_start();
+    MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, solver_comm, status);
+    profile_stop(PROFILE_IDLE, idle_start);
+}
+
+/*
+Pick the worker that expands a resident node.
+The owner keeps its node unless it already has work while another
+worker sits idle; a node whose owner is at full depth goes to the least
+loaded worker with room.
+
+@param workers Pointer to the WorkerSet
+@param in_flight Tasks awaiting a reply per worker
+@param depth Maximum tasks in flight per worker
+@param owner_slot Slot of the worker holding the node
+@param rr_index Round-robin cursor over the workers
+@return Worker slot, or -1 if every worker is at full depth
+*/
+static int pick_resident_target(const WorkerSet *workers,
+                                const int *in_flight,
+                                int depth,
+                                int owner_slot,
+                                int *rr_index)
+{
+    int idle = -1;
+    int least = -1;
+    for (int k = 0; k < workers->count; ++k)
+    {
+        int w = (*rr_index + k) % workers->count;
+        if (in_flight[w] >= depth)
+        {
+            continue;
+        }
+        if (idle < 0 && in_flight[w] == 0)
+        {
+            idle = w;
+        }
+        if (least < 0 || in_flight[w] < in_flight[least])
+        {
+            least = w;
+        }
+    }
+    int target = least;
+    if (owner_slot >= 0 && in_flight[owner_slot] < depth && (in_flight[owner_slot] == 0 || idle < 0))
+    {
+        target = owner_slot;
+    }
+    else if (idle >= 0)
+    {
+        target = idle;
+    }
+    if (target >= 0 && target != owner_slot)
+    {
+        *rr_index = (target + 1) % workers->count;
+    }
+    return target;
+}
+
+/*
+Tell every worker a new incumbent bound with an empty task message, so
+resident nodes that can no longer improve it are freed where they live
+
+@param incumbent_cost New incumbent cost
+@param workers Pointer to the WorkerSet
+@param batches One reusable NodeBatch per worker
+@param pool Pointer to the PendingSendPool
+*/
+static void notify_incumbent(double incumbent_cost, const WorkerSet *workers, NodeBatch *batches, PendingSendPool *pool)
+{
+    int bound = (int)(incumbent_cost >= (double)INT_MAX ? INT_MAX : (int)ceil(incumbent_cost));
+    for (int w = 0; w < workers->count; ++w)
+    {
+        node_batch_reset(&batches[w], bound);
+        node_batch_send_async(workers->ranks[w], TAG_TASK, &batches[w], pool);
+    }
+}
+
+/*
+Receive a TAG_HANDLES reply into a reusable array
+
+@param source Rank of the sending worker
+@param buffer Pointer to the handle array (grown as needed)
+@param capacity Pointer to the array capacity in handles
+@return Number of handles received
+*/
+static int receive_handles(int source, NodeHandle **buffer, int *capacity)
+{
+    MPI_Status status;
+    MPI_Probe(source, TAG_HANDLES, solver_comm, &status);
+    int bytes = 0;
+    MPI_Get_count(&status, MPI_BYTE, &bytes);
+    int count = bytes / (int)sizeof(NodeHandle);
+    if (count > *capacity)
+    {
+        NodeHandle *grown = (NodeHandle *)realloc(*buffer, sizeof(NodeHandle) * (size_t)count);
+        if (!grown)
+        {
+            fprintf(stderr, "receive_handles: failed to allocate handle buffer (count=%d)\n", count);
+            exit(EXIT_FAILURE);
+        }
+        *buffer = grown;
+        *capacity = count;
+    }
+    MPI_Recv(*buffer, bytes, MPI_BYTE, source, TAG_HANDLES, solver_comm, MPI_STATUS_IGNORE);
+    return count;
 }
 
-static void broadcast_incumbent(double incumbent_cost, const WorkerSet *workers)
+/*
+Handle-based scheduler: CT nodes stay on the worker that generated them
+and the open list only holds NodeHandle values. Popping a handle sends
+the owner an expand request, optionally naming an idle worker to
+forward the node to. Only the root and solutions travel as nodes.
+
+@param instance Pointer to the ProblemInstance
+@param ll_ctx Pointer to the LowLevelContext used for the root
+@param workers Pointer to the WorkerSet
+@param depth Maximum tasks in flight per worker
+@param timeout_seconds Time limit (0 for none)
+@param stats Pointer to the RunStats to fill (may be NULL)
+*/
+static void run_resident_coordinator(const ProblemInstance *instance,
+                                     const LowLevelContext *ll_ctx,
+                                     const WorkerSet *workers,
+                                     int depth,
+                                     double timeout_seconds,
+                                     RunStats *stats)
 {
-    int cost_int = (int)ceil(incumbent_cost);
+    int coord_rank = 0;
+    MPI_Comm_rank(solver_comm, &coord_rank);
+    double start_time = MPI_Wtime();
+    int timed_out = 0;
+    double total_comm_time = 0.0;
+
+    HighLevelNode *root = cbs_node_create(instance->num_agents);
+    root->id = 0;
+    root->depth = 0;
+    root->parent_id = -1;
+    if (!initialize_root(instance, ll_ctx, root))
+    {
+        fprintf(stderr, "Failed to compute initial paths.\n");
+        cbs_node_free(root);
+        return;
+    }
+    LOG_INFO("[Coordinator %d] Root node ready: id=%d cost=%.0f agents=%d (resident nodes, in-flight depth %d)\n",
+             coord_rank,
+             root->id,
+             root->cost,
+             instance->num_agents,
+             depth);
+
+    PendingSendPool send_pool;
+    pending_send_pool_init(&send_pool);
+    NodeBatch *task_batches = (NodeBatch *)malloc(sizeof(NodeBatch) * (size_t)workers->count);
+    int *in_flight = (int *)calloc((size_t)workers->count, sizeof(int));
+    /* Costs of the requests awaiting a reply, depth slots per worker */
+    double *in_flight_costs = (double *)malloc(sizeof(double) * (size_t)workers->count * (size_t)depth);
+    if (!task_batches || !in_flight || !in_flight_costs)
+    {
+        fprintf(stderr, "run_resident_coordinator: failed to allocate worker state (workers=%d)\n", workers->count);
+        exit(EXIT_FAILURE);
+    }
+    for (int w = 0; w < workers->count; ++w)
+    {
+        node_batch_init(&task_batches[w]);
+    }
+    NodeBatch recv_batch;
+    node_batch_init(&recv_batch);
+    NodeHandle *handles = NULL;
+    int handle_capacity = 0;
+
+    HandleQueue open;
+    handle_queue_init(&open);
+
+    /* The root is the only node the coordinator sends out itself */
+    node_batch_reset(&task_batches[0], INT_MAX);
+    node_batch_append(&task_batches[0], root);
+    node_batch_send_async(workers->ranks[0], TAG_TASK, &task_batches[0], &send_pool);
+    in_flight_costs[0] = root->cost;
+    cbs_node_free(root);
+    in_flight[0] = 1;
+    int outstanding = 1;
+
+    double incumbent_cost = DBL_MAX;
+    HighLevelNode *incumbent_solution = NULL;
+    int rr_index = 1 % workers->count;
+    long long nodes_expanded = 1;
+    long long nodes_generated = 0;
+    long long conflicts_detected = 0;
+    long long forwarded = 0;
+    double last_status_time = 0.0;
+
+    while (1)
+    {
+        double elapsed = MPI_Wtime() - start_time;
+        if (timeout_seconds > 0.0 && elapsed > timeout_seconds)
+        {
+            timed_out = 1;
+            LOG_INFO("[Coordinator %d] TIMEOUT at %.2fs (limit=%.2fs, outstanding=%d)\n",
+                     coord_rank, elapsed, timeout_seconds, outstanding);
+            break;
+        }
+        if (elapsed - last_status_time >= 5.0)
+        {
+            LOG_INFO("[Coordinator %d] STATUS: elapsed=%.1fs, open handles=%d, expanded=%lld, generated=%lld, in_flight=%d, incumbent=%s\n",
+                     coord_rank, elapsed, open.count, nodes_expanded, nodes_generated, outstanding,
+                     incumbent_cost < DBL_MAX ? "found" : "none");
+            last_status_time = elapsed;
+        }
+
+        int bound = (int)(incumbent_cost >= (double)INT_MAX ? INT_MAX : (int)ceil(incumbent_cost));
+        while (open.count > 0)
+        {
+            const NodeHandle *top = handle_queue_peek(&open);
+            if (top->cost >= incumbent_cost - 1e-6)
+            {
+                break;
+            }
+            int owner_slot = worker_slot(workers, top->owner);
+            int target = pick_resident_target(workers, in_flight, depth, owner_slot, &rr_index);
+            if (target < 0)
+            {
+                break;
+            }
+            NodeHandle handle;
+            handle_queue_pop(&open, &handle);
+            int request[3] = {handle.id, bound, target == owner_slot ? -1 : workers->ranks[target]};
+            MPI_Send(request, 3, MPI_INT, handle.owner, TAG_EXPAND, solver_comm);
+            LOG_DEBUG("[Coordinator %d] -> Worker %d: expand node id=%d cost=%.0f conflicts=%d%s\n",
+                      coord_rank,
+                      handle.owner,
+                      handle.id,
+                      handle.cost,
+                      handle.conflicts,
+                      request[2] >= 0 ? " (forwarded)" : "");
+            forwarded += request[2] >= 0 ? 1 : 0;
+            in_flight_costs[target * depth + in_flight[target]] = handle.cost;
+            in_flight[target]++;
+            outstanding++;
+            nodes_expanded++;
+        }
+        profile_sample_open(open.count);
+
+        if (outstanding == 0)
+        {
+            break;
+        }
+
+        MPI_Status status;
+        wait_for_message(&send_pool, &status);
+        int slot = worker_slot(workers, status.MPI_SOURCE);
+
+        if (status.MPI_TAG == TAG_SOLUTION)
+        {
+            double comm_start = MPI_Wtime();
+            node_batch_receive(status.MPI_SOURCE, TAG_SOLUTION, &recv_batch, NULL);
+            total_comm_time += MPI_Wtime() - comm_start;
+            int cursor = 0;
+            HighLevelNode *solution_node = node_batch_next(&recv_batch, &cursor, NULL);
+            if (solution_node)
+            {
+                solution_node->cost = cbs_compute_soc(solution_node);
+                if (solution_node->cost < incumbent_cost)
+                {
+                    if (incumbent_solution != NULL)
+                    {
+                        cbs_node_free(incumbent_solution);
+                    }
+                    incumbent_solution = solution_node;
+                    incumbent_cost = solution_node->cost;
+                    notify_incumbent(incumbent_cost, workers, task_batches, &send_pool);
+                    LOG_INFO("[Coordinator %d] New incumbent: node id=%d cost=%.0f depth=%d\n",
+                             coord_rank,
+                             solution_node->id,
+                             solution_node->cost,
+                             solution_node->depth);
+                }
+                else
+                {
+                    cbs_node_free(solution_node);
+                }
+            }
+        }
+        else if (status.MPI_TAG == TAG_HANDLES)
+        {
+            double comm_start = MPI_Wtime();
+            int count = receive_handles(status.MPI_SOURCE, &handles, &handle_capacity);
+            total_comm_time += MPI_Wtime() - comm_start;
+            nodes_generated += count;
+            if (count > 0)
+            {
+                conflicts_detected++;
+            }
+            for (int i = 0; i < count; ++i)
+            {
+                if (handles[i].cost < incumbent_cost)
+                {
+                    handle_queue_push(&open, handles[i]);
+                }
+            }
+            LOG_DEBUG("[Coordinator %d] Received %d handle(s) from worker %d (open handles=%d)\n",
+                      coord_rank, count, status.MPI_SOURCE, open.count);
+        }
+        if (slot >= 0 && in_flight[slot] > 0)
+        {
+            // replies do not name their request, dropping the costliest keeps the rest a valid bound
+            double *costs = in_flight_costs + slot * depth;
+            int costliest = 0;
+            for (int k = 1; k < in_flight[slot]; ++k)
+            {
+                costliest = costs[k] > costs[costliest] ? k : costliest;
+            }
+            costs[costliest] = costs[in_flight[slot] - 1];
+            in_flight[slot]--;
+            outstanding--;
+        }
+    }
+
+    // a timed-out search can still prove a bound: handles left open and requests the drain discards
+    double lower_bound = open.count > 0 ? handle_queue_peek(&open)->cost : DBL_MAX;
+    for (int w = 0; w < workers->count; ++w)
+    {
+        for (int k = 0; k < in_flight[w]; ++k)
+        {
+            lower_bound = in_flight_costs[w * depth + k] < lower_bound ? in_flight_costs[w * depth + k] : lower_bound;
+        }
+    }
+    if (incumbent_cost < lower_bound)
+    {
+        lower_bound = incumbent_cost;
+    }
+
+    // every expand request answers exactly once, so the drain blocks until the last reply
+    while (outstanding > 0)
+    {
+        MPI_Status status;
+        wait_for_message(&send_pool, &status);
+        if (status.MPI_TAG == TAG_SOLUTION)
+        {
+            node_batch_receive(status.MPI_SOURCE, TAG_SOLUTION, &recv_batch, NULL);
+            outstanding--;
+        }
+        else if (status.MPI_TAG == TAG_HANDLES)
+        {
+            receive_handles(status.MPI_SOURCE, &handles, &handle_capacity);
+            outstanding--;
+        }
+    }
+
+    pending_send_pool_wait_all(&send_pool);
     for (int i = 0; i < workers->count; ++i)
     {
-        MPI_Send(&cost_int, 1, MPI_INT, workers->ranks[i], TAG_INCUMBENT, MPI_COMM_WORLD);
+        MPI_Send(NULL, 0, MPI_INT, workers->ranks[i], TAG_TERMINATE, solver_comm);
+    }
+
+    LOG_INFO("[Coordinator %d] Resident scheduling done: expanded=%lld forwarded=%lld\n",
+             coord_rank, nodes_expanded, forwarded);
+    // the result line goes out after every log line buffered before it
+    log_flush();
+    if (incumbent_solution)
+    {
+        printf("Best solution cost: %.0f\n", incumbent_solution->cost);
+        fflush(stdout);
+        LOG_INFO("[Coordinator %d] Solution found with node id=%d depth=%d\n",
+                 coord_rank,
+                 incumbent_solution->id,
+                 incumbent_solution->depth);
+        cbs_node_free(incumbent_solution);
+    }
+    else
+    {
+        LOG_INFO("[Coordinator %d] Search finished without finding a solution.\n", coord_rank);
+    }
+
+    handle_queue_free(&open);
+    free(handles);
+    pending_send_pool_free(&send_pool);
+    for (int w = 0; w < workers->count; ++w)
+    {
+        node_batch_free(&task_batches[w]);
+    }
+    free(task_batches);
+    free(in_flight);
+    free(in_flight_costs);
+    node_batch_free(&recv_batch);
+
+    if (stats)
+    {
+        stats->nodes_expanded = nodes_expanded;
+        stats->nodes_generated = nodes_generated;
+        stats->conflicts_detected = conflicts_detected;
+        stats->best_cost = incumbent_cost;
+        stats->solution_found = incumbent_solution != NULL;
+        stats->timed_out = timed_out;
+        stats->runtime_sec = MPI_Wtime() - start_time;
+        stats->comm_time_sec = total_comm_time;
+        stats->compute_time_sec = stats->runtime_sec - total_comm_time;
+        // best-first: a finished search expanded everything below the incumbent
+        stats->lower_bound = lower_bound;
     }
 }
 
 void run_coordinator(const ProblemInstance *instance,
                      const LowLevelContext *ll_ctx,
                      const WorkerSet *workers,
+                     int inflight_depth,
+                     bool resident_nodes,
+                     size_t open_budget_bytes,
+                     double suboptimality,
                      double timeout_seconds,
                      RunStats *stats)
 {
     int coord_rank = 0;
-    MPI_Comm_rank(MPI_COMM_WORLD, &coord_rank);
+    MPI_Comm_rank(solver_comm, &coord_rank);
 
     double start_time = MPI_Wtime();
     int timed_out = 0;
@@ -76,6 +662,7 @@ void run_coordinator(const ProblemInstance *instance,
     {
         memset(stats, 0, sizeof(RunStats));
         stats->best_cost = DBL_MAX;
+        stats->lower_bound = DBL_MAX;
     }
 
     if (workers->count == 0)
@@ -87,8 +674,20 @@ void run_coordinator(const ProblemInstance *instance,
         return;
     }
 
-    PriorityQueue open;
-    pq_init(&open);
+    /* Replies are decoded against the task in the mirrored window, so it must still be there */
+    int depth = inflight_depth < 1 ? 1 : inflight_depth;
+    if (depth > TASK_WINDOW_SIZE)
+    {
+        depth = TASK_WINDOW_SIZE;
+    }
+    if (resident_nodes)
+    {
+        run_resident_coordinator(instance, ll_ctx, workers, depth, timeout_seconds, stats);
+        return;
+    }
+
+    OpenList open;
+    open_list_init(&open, instance, ll_ctx, open_budget_bytes, suboptimality);
 
     HighLevelNode *root = cbs_node_create(instance->num_agents);
     root->id = 0;
@@ -99,22 +698,41 @@ void run_coordinator(const ProblemInstance *instance,
     {
         fprintf(stderr, "Failed to compute initial paths.\n");
         cbs_node_free(root);
-        pq_free(&open);
+        open_list_free(&open);
         return;
     }
 
-    pq_push(&open, root->cost, root);
-    printf("[Coordinator %d] Root node ready: id=%d cost=%.0f agents=%d\n",
-           coord_rank,
-           root->id,
-           root->cost,
-           instance->num_agents);
-    fflush(stdout);
+    open_list_push(&open, root);
+    LOG_INFO("[Coordinator %d] Root node ready: id=%d cost=%.0f agents=%d (in-flight depth %d)\n",
+             coord_rank,
+             root->id,
+             root->cost,
+             instance->num_agents,
+             depth);
 
     /* Initialize pending send pool for async MPI operations */
     PendingSendPool send_pool;
     pending_send_pool_init(&send_pool);
 
+    /* Reusable packing buffers: one task message per worker, one for receives */
+    NodeBatch *task_batches = (NodeBatch *)malloc(sizeof(NodeBatch) * (size_t)workers->count);
+    /* Dispatched nodes stay in a mirror of the receiving worker's window as delta bases */
+    NodeWindow *task_windows = (NodeWindow *)malloc(sizeof(NodeWindow) * (size_t)workers->count);
+    int *in_flight = (int *)calloc((size_t)workers->count, sizeof(int));
+    bool *notify = (bool *)calloc((size_t)workers->count, sizeof(bool));
+    if (!task_batches || !task_windows || !in_flight || !notify)
+    {
+        fprintf(stderr, "run_coordinator: failed to allocate worker state (workers=%d)\n", workers->count);
+        exit(EXIT_FAILURE);
+    }
+    for (int w = 0; w < workers->count; ++w)
+    {
+        node_batch_init(&task_batches[w]);
+        node_window_init(&task_windows[w], TASK_WINDOW_SIZE);
+    }
+    NodeBatch recv_batch;
+    node_batch_init(&recv_batch);
+
     double incumbent_cost = DBL_MAX;
     HighLevelNode *incumbent_solution = NULL;
     int next_node_id = 1;
@@ -123,10 +741,10 @@ void run_coordinator(const ProblemInstance *instance,
     long long nodes_generated = 0;
     long long conflicts_detected = 0;
     long long loop_iterations = 0;
-    double last_status_time = start_time;
-    int outstanding = 0;  /* Track outstanding workers at function scope for timeout_exit */
+    double last_status_time = 0.0;
+    int outstanding = 0;  /* Tasks awaiting a reply over all workers */
 
-    while (open.count > 0)
+    while (1)
     {
         loop_iterations++;
         double elapsed = MPI_Wtime() - start_time;
@@ -134,304 +752,203 @@ void run_coordinator(const ProblemInstance *instance,
         if (timeout_seconds > 0.0 && elapsed > timeout_seconds)
         {
             timed_out = 1;
-            printf("[Coordinator %d] TIMEOUT at %.2fs (limit=%.2fs) after %lld iterations\n", 
-                   coord_rank, elapsed, timeout_seconds, loop_iterations);
-            fflush(stdout);
+            LOG_INFO("[Coordinator %d] TIMEOUT at %.2fs (limit=%.2fs) after %lld iterations (outstanding=%d)\n", 
+                     coord_rank, elapsed, timeout_seconds, loop_iterations, outstanding);
             break;
         }
         
         // Periodic status update every 5 seconds
         if (elapsed - last_status_time >= 5.0)
         {
-            printf("[Coordinator %d] STATUS: elapsed=%.1fs, open=%d, expanded=%lld, generated=%lld, incumbent=%s\n",
-                   coord_rank, elapsed, open.count, nodes_expanded, nodes_generated,
-                   incumbent_cost < DBL_MAX ? "found" : "none");
-            fflush(stdout);
+            LOG_INFO("[Coordinator %d] STATUS: elapsed=%.1fs, open=%lld (compressed=%d spilled=%lld), expanded=%lld, generated=%lld, in_flight=%d, incumbent=%s\n",
+                     coord_rank, elapsed, open_list_count(&open), open.compressed_count, open.spilled_count, nodes_expanded, nodes_generated, outstanding,
+                     incumbent_cost < DBL_MAX ? "found" : "none");
             last_status_time = elapsed;
         }
 
-        double plateau_cost = 0.0;
-        double key = 0.0;
-        HighLevelNode *front = (HighLevelNode *)pq_pop(&open, &plateau_cost);
-        
-        /* Only collect up to workers->count nodes at the same cost level.
-         * This avoids the overhead of popping the entire plateau then re-pushing overflow. */
-        int max_dispatch = workers->count > 0 ? workers->count : 1;
-        HighLevelNode **plateau = (HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)max_dispatch);
-        int plateau_size = 0;
-        plateau[plateau_size++] = front;
-
-        while (open.count > 0 && plateau_size < max_dispatch)
-        {
-            HighLevelNode *peek = (HighLevelNode *)pq_peek(&open, &key);
-            if (fabs(peek->cost - plateau_cost) > 1e-6)
-            {
-                break;
-            }
-            HighLevelNode *equal_node = (HighLevelNode *)pq_pop(&open, &key);
-            plateau[plateau_size++] = equal_node;
-        }
+        /* Workers get new tasks as soon as they have room, not once per plateau */
+        int dispatched = dispatch_ready(&open,
+                                        incumbent_cost,
+                                        workers,
+                                        in_flight,
+                                        depth,
+                                        notify,
+                                        &rr_index,
+                                        task_batches,
+                                        task_windows,
+                                        &send_pool);
+        nodes_expanded += dispatched;
+        outstanding += dispatched;
+        profile_sample_open(open_list_count(&open));
 
-        nodes_expanded += plateau_size;
-        char incumbent_str[32];
-        if (incumbent_cost < DBL_MAX)
+        /* Nothing left below the incumbent and no task that could still improve it */
+        if (outstanding == 0)
         {
-            snprintf(incumbent_str, sizeof(incumbent_str), "%.0f", incumbent_cost);
-        }
-        else
-        {
-            strcpy(incumbent_str, "INF");
+            break;
         }
-        printf("[Coordinator %d] Dispatching %d node(s) at cost %.0f (incumbent=%s)\n",
-               coord_rank,
-               plateau_size,
-               plateau_cost,
-               incumbent_str);
-        fflush(stdout);
 
-        int dispatch_count = plateau_size;
-
-        outstanding = dispatch_count;  /* Assign (not declare) to use function-scope variable */
-        for (int i = 0; i < dispatch_count; ++i)
-        {
-            int worker_rank = select_worker(workers, &rr_index);
-            printf("[Coordinator %d] -> Worker %d: node id=%d depth=%d cost=%.0f\n",
-                   coord_rank,
-                   worker_rank,
-                   plateau[i]->id,
-                   plateau[i]->depth,
-                   plateau[i]->cost);
-            fflush(stdout);
-            dispatch_node(plateau[i], incumbent_cost, worker_rank, &send_pool);
-            cbs_node_free(plateau[i]);
-        }
+        MPI_Status status;
+        wait_for_message(&send_pool, &status);
+        int slot = worker_slot(workers, status.MPI_SOURCE);
 
-        free(plateau);
-        printf("[Coordinator %d] Waiting for %d worker response(s)...\n", coord_rank, outstanding);
-        fflush(stdout);
+        LOG_TRACE("[Coordinator %d] [t=%.1fs] Received message (tag=%d) from rank %d\n",
+                  coord_rank, MPI_Wtime() - start_time, status.MPI_TAG, status.MPI_SOURCE);
 
-        while (outstanding > 0)
+        if (status.MPI_TAG == TAG_SOLUTION)
         {
-            // CHECK TIMEOUT INSIDE THE WAITING LOOP
-            double wait_elapsed = MPI_Wtime() - start_time;
-            if (timeout_seconds > 0.0 && wait_elapsed > timeout_seconds)
-            {
-                timed_out = 1;
-                printf("[Coordinator %d] TIMEOUT in worker wait loop at %.2fs (outstanding=%d)\n",
-                       coord_rank, wait_elapsed, outstanding);
-                fflush(stdout);
-                goto timeout_exit;
-            }
-            
-            // Use NON-BLOCKING probe so we can check timeout
-            MPI_Status status;
-            int flag = 0;
-            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
-            
-            if (!flag)
+            double comm_start = MPI_Wtime();
+            node_batch_receive(status.MPI_SOURCE, TAG_SOLUTION, &recv_batch, NULL);
+            total_comm_time += MPI_Wtime() - comm_start;
+            int cursor = 0;
+            HighLevelNode *solution_node = node_batch_next(&recv_batch, &cursor, slot >= 0 ? &task_windows[slot] : NULL);
+            if (solution_node)
             {
-                // No message available, sleep briefly and check timeout again
-                usleep(1000);  // Sleep 1ms to avoid busy-waiting
-                // Progress any pending async sends
-                pending_send_pool_progress(&send_pool);
-                continue;
-            }
-            
-            printf("[Coordinator %d] [t=%.1fs] Received message (tag=%d) from rank %d\n",
-                   coord_rank, wait_elapsed, status.MPI_TAG, status.MPI_SOURCE);
-            fflush(stdout);
-            
-            if (status.MPI_TAG == TAG_SOLUTION)
-            {
-                SerializedNode solution_data;
-                double comm_start = MPI_Wtime();
-                receive_serialized_node(status.MPI_SOURCE, TAG_SOLUTION, &solution_data, NULL);
-                total_comm_time += MPI_Wtime() - comm_start;
-                HighLevelNode *solution_node = deserialize_high_level_node(&solution_data);
-                free_serialized_node(&solution_data);
-                if (solution_node)
+                solution_node->id = next_node_id++;
+                solution_node->cost = cbs_compute_soc(solution_node);
+                if (solution_node->cost < incumbent_cost)
                 {
-                    solution_node->id = next_node_id++;
-                    solution_node->cost = cbs_compute_soc(solution_node);
                     if (incumbent_solution != NULL)
                     {
                         cbs_node_free(incumbent_solution);
                     }
                     incumbent_solution = solution_node;
                     incumbent_cost = solution_node->cost;
-                    broadcast_incumbent(incumbent_cost, workers);
-                    printf("[Coordinator %d] New incumbent: node id=%d cost=%.0f depth=%d\n",
-                           coord_rank,
-                           solution_node->id,
-                           solution_node->cost,
-                           solution_node->depth);
-                    fflush(stdout);
+                    /* The bound travels with the next task message of every worker */
+                    for (int w = 0; w < workers->count; ++w)
+                    {
+                        notify[w] = true;
+                    }
+                    LOG_INFO("[Coordinator %d] New incumbent: node id=%d cost=%.0f depth=%d\n",
+                             coord_rank,
+                             solution_node->id,
+                             solution_node->cost,
+                             solution_node->depth);
+                }
+                else
+                {
+                    cbs_node_free(solution_node);
                 }
-                outstanding--;
-                printf("[Coordinator %d] Outstanding workers remaining: %d\n", coord_rank, outstanding);
-                fflush(stdout);
             }
-            else if (status.MPI_TAG == TAG_CHILDREN)
+        }
+        else if (status.MPI_TAG == TAG_CHILDREN)
+        {
+            double comm_start = MPI_Wtime();
+            node_batch_receive(status.MPI_SOURCE, TAG_CHILDREN, &recv_batch, NULL);
+            total_comm_time += MPI_Wtime() - comm_start;
+            int child_count = recv_batch.node_count;
+            int parent_id = recv_batch.aux_value;
+            nodes_generated += child_count;
+            if (child_count > 0)
             {
-                int source_worker = status.MPI_SOURCE;
-                int child_count = 0;
-                double comm_start = MPI_Wtime();
-                MPI_Recv(&child_count, 1, MPI_INT, source_worker, TAG_CHILDREN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                total_comm_time += MPI_Wtime() - comm_start;
-                nodes_generated += child_count;
-                if (child_count > 0)
+                conflicts_detected++;
+            }
+            LOG_DEBUG("[Coordinator %d] Received %d children from worker %d\n",
+                      coord_rank, child_count, status.MPI_SOURCE);
+            
+            int cursor = 0;
+            HighLevelNode *child = NULL;
+            while ((child = node_batch_next(&recv_batch, &cursor, slot >= 0 ? &task_windows[slot] : NULL)) != NULL)
+            {
+                child->id = next_node_id++;
+                child->cost = cbs_compute_soc(child);
+                if (child->cost < incumbent_cost)
                 {
-                    conflicts_detected++;
+                    open_list_push(&open, child);
+                    LOG_TRACE("[Coordinator %d] Received child id=%d (parent=%d) cost=%.0f depth=%d\n",
+                              coord_rank,
+                              child->id,
+                              parent_id,
+                              child->cost,
+                              child->depth);
                 }
-                printf("[Coordinator %d] Received %d children from worker %d\n",
-                       coord_rank, child_count, source_worker);
-                fflush(stdout);
-                
-                for (int i = 0; i < child_count; ++i)
+                else
                 {
-                    SerializedNode child_data;
-                    double comm_start = MPI_Wtime();
-                    receive_serialized_node(source_worker, TAG_CHILDREN, &child_data, NULL);
-                    total_comm_time += MPI_Wtime() - comm_start;
-                    int parent_id = child_data.aux_value;
-                    HighLevelNode *child = deserialize_high_level_node(&child_data);
-                    free_serialized_node(&child_data);
-                    if (!child)
-                    {
-                        continue;
-                    }
-                    child->id = next_node_id++;
-                    child->cost = cbs_compute_soc(child);
-                    if (child->cost < incumbent_cost)
-                    {
-                        pq_push(&open, child->cost, child);
-                        printf("[Coordinator %d] Received child id=%d (parent=%d) cost=%.0f depth=%d\n",
-                               coord_rank,
-                               child->id,
-                               parent_id,
-                               child->cost,
-                               child->depth);
-                        fflush(stdout);
-                    }
-                    else
-                    {
-                        printf("[Coordinator %d] Pruned child (parent=%d) cost=%.0f >= incumbent %.0f\n",
-                               coord_rank, parent_id, child->cost, incumbent_cost);
-                        fflush(stdout);
-                        cbs_node_free(child);
-                    }
+                    LOG_TRACE("[Coordinator %d] Pruned child (parent=%d) cost=%.0f >= incumbent %.0f\n",
+                              coord_rank, parent_id, child->cost, incumbent_cost);
+                    cbs_node_free(child);
                 }
-                outstanding--;
-                printf("[Coordinator %d] Outstanding workers remaining: %d\n", coord_rank, outstanding);
-                fflush(stdout);
             }
         }
-
-        if (incumbent_solution != NULL)
+        if (slot >= 0 && in_flight[slot] > 0)
         {
-            double peek_cost = 0.0;
-            HighLevelNode *next = (HighLevelNode *)pq_peek(&open, &peek_cost);
-            if (!next || peek_cost >= incumbent_cost - 1e-6)
-            {
-                break;
-            }
+            in_flight[slot]--;
+            outstanding--;
         }
     }
 
-timeout_exit:
-    /* Drain any remaining results from outstanding workers before terminating */
-    printf("[Coordinator %d] Draining remaining results from workers (outstanding=%d)...\n", 
-           coord_rank, outstanding);
-    fflush(stdout);
-    
-    /* Keep receiving until we've heard back from all outstanding workers, with a secondary timeout */
-    double drain_start = MPI_Wtime();
-    double drain_timeout = 5.0;  /* Max 5 seconds to drain */
+    // a timed-out search can still prove a bound: nodes left open and tasks the drain discards
+    double in_flight_bound = timed_out ? in_flight_lower_bound(task_windows, in_flight, workers->count) : DBL_MAX;
+
+    /* Drain any remaining results from outstanding tasks before terminating */
+    LOG_INFO("[Coordinator %d] Draining remaining results from workers (outstanding=%d)...\n", 
+             coord_rank, outstanding);
     
+    /* Every outstanding task answers exactly once, so the drain blocks until the last reply */
     while (outstanding > 0)
     {
-        double drain_elapsed = MPI_Wtime() - drain_start;
-        if (drain_elapsed > drain_timeout)
-        {
-            printf("[Coordinator %d] Drain timeout after %.2fs, %d workers still outstanding\n",
-                   coord_rank, drain_elapsed, outstanding);
-            fflush(stdout);
-            break;
-        }
-        
         MPI_Status status;
-        int flag = 0;
-        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
-        
-        if (!flag)
-        {
-            usleep(1000);  /* 1ms */
-            pending_send_pool_progress(&send_pool);
-            continue;
-        }
-        
-        if (status.MPI_TAG == TAG_SOLUTION)
+        wait_for_message(&send_pool, &status);
+        if (status.MPI_TAG == TAG_SOLUTION || status.MPI_TAG == TAG_CHILDREN)
         {
-            SerializedNode solution_data;
-            receive_serialized_node(status.MPI_SOURCE, TAG_SOLUTION, &solution_data, NULL);
-            free_serialized_node(&solution_data);
+            node_batch_receive(status.MPI_SOURCE, status.MPI_TAG, &recv_batch, NULL);
             outstanding--;
-            printf("[Coordinator %d] Drained solution from worker %d, outstanding=%d\n",
-                   coord_rank, status.MPI_SOURCE, outstanding);
-            fflush(stdout);
-        }
-        else if (status.MPI_TAG == TAG_CHILDREN)
-        {
-            int source_worker = status.MPI_SOURCE;
-            int child_count = 0;
-            MPI_Recv(&child_count, 1, MPI_INT, source_worker, TAG_CHILDREN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            for (int i = 0; i < child_count; ++i)
-            {
-                SerializedNode child_data;
-                receive_serialized_node(source_worker, TAG_CHILDREN, &child_data, NULL);
-                free_serialized_node(&child_data);
-            }
-            outstanding--;
-            printf("[Coordinator %d] Drained %d children from worker %d, outstanding=%d\n",
-                   coord_rank, child_count, source_worker, outstanding);
-            fflush(stdout);
+            LOG_DEBUG("[Coordinator %d] Drained %d node(s) from worker %d, outstanding=%d\n",
+                      coord_rank, recv_batch.node_count, status.MPI_SOURCE, outstanding);
         }
     }
     
-    printf("[Coordinator %d] All workers drained, sending termination...\n", coord_rank);
-    fflush(stdout);
+    LOG_INFO("[Coordinator %d] All workers drained, sending termination...\n", coord_rank);
     
     /* Wait for any pending async sends to complete before terminating workers */
     pending_send_pool_wait_all(&send_pool);
 
     for (int i = 0; i < workers->count; ++i)
     {
-        MPI_Send(NULL, 0, MPI_INT, workers->ranks[i], TAG_TERMINATE, MPI_COMM_WORLD);
+        MPI_Send(NULL, 0, MPI_INT, workers->ranks[i], TAG_TERMINATE, solver_comm);
     }
 
+    // the result line goes out after every log line buffered before it
+    log_flush();
     if (incumbent_solution)
     {
         printf("Best solution cost: %.0f\n", incumbent_solution->cost);
-        printf("[Coordinator %d] Solution found with node id=%d depth=%d\n",
-               coord_rank,
-               incumbent_solution->id,
-               incumbent_solution->depth);
         fflush(stdout);
+        LOG_INFO("[Coordinator %d] Solution found with node id=%d depth=%d\n",
+                 coord_rank,
+                 incumbent_solution->id,
+                 incumbent_solution->depth);
         cbs_node_free(incumbent_solution);
     }
     else
     {
-        printf("[Coordinator %d] Search finished without finding a solution.\n", coord_rank);
-        fflush(stdout);
+        LOG_INFO("[Coordinator %d] Search finished without finding a solution.\n", coord_rank);
     }
 
-    while (open.count > 0)
+    // a finished search leaves only nodes within the suboptimality bound of the incumbent open
+    double lower_bound = open_list_lower_bound(&open);
+    if (in_flight_bound < lower_bound)
+    {
+        lower_bound = in_flight_bound;
+    }
+    if (incumbent_cost < lower_bound)
+    {
+        lower_bound = incumbent_cost;
+    }
+    long long open_peak_resident = open.peak_resident;
+    long long open_compressed = open.nodes_compressed;
+    long long open_spilled = open.nodes_spilled;
+    open_list_free(&open);
+    pending_send_pool_free(&send_pool);
+    for (int w = 0; w < workers->count; ++w)
     {
-        double dummy = 0.0;
-        HighLevelNode *node = (HighLevelNode *)pq_pop(&open, &dummy);
-        cbs_node_free(node);
+        node_batch_free(&task_batches[w]);
+        node_window_free(&task_windows[w]);
     }
-    pq_free(&open);
+    free(task_batches);
+    free(task_windows);
+    free(in_flight);
+    free(notify);
+    node_batch_free(&recv_batch);
 
     if (stats)
     {
@@ -444,6 +961,10 @@ timeout_exit:
         stats->runtime_sec = MPI_Wtime() - start_time;
         stats->comm_time_sec = total_comm_time;
         stats->compute_time_sec = stats->runtime_sec - total_comm_time;
+        stats->open_peak_resident = open_peak_resident;
+        stats->open_compressed = open_compressed;
+        stats->open_spilled = open_spilled;
+        stats->lower_bound = lower_bound;
     }
 }
 
@@ -0,0 +1,255 @@
+#include "global_state.h"
+
+#include <float.h>
+
+/*
+Initialize the global state with no round in flight
+
+@param state Pointer to the GlobalState to initialize
+@param comm Communicator the rounds run on
+@param lower_bound Initial global lower bound (the root cost)
+*/
+void global_state_init(GlobalState *state, MPI_Comm comm, double lower_bound)
+{
+    state->comm = comm;
+    state->request = MPI_REQUEST_NULL;
+    state->in_flight = false;
+    for (int i = 0; i < GLOBAL_STATE_FIELDS; ++i)
+    {
+        state->send[i] = 0.0;
+        state->recv[i] = 0.0;
+    }
+    state->lower_bound = lower_bound;
+    state->incumbent = DBL_MAX;
+    state->timeout = false;
+    state->terminated = false;
+    state->rounds = 0;
+}
+
+/*
+Start a global state round with this rank's contribution.
+Must not be called while a round is in flight, and every rank has to
+start the same number of rounds before leaving the search.
+
+@param state Pointer to the GlobalState
+@param local_lower_bound Lowest cost in the local open list (DBL_MAX if empty)
+@param local_incumbent Best solution cost found on this rank (DBL_MAX if none)
+@param local_timeout Whether this rank ran out of time
+@param local_terminated Whether this rank detected termination
+*/
+void global_state_start(GlobalState *state,
+                        double local_lower_bound,
+                        double local_incumbent,
+                        bool local_timeout,
+                        bool local_terminated)
+{
+    state->send[0] = local_lower_bound;
+    state->send[1] = local_incumbent;
+    state->send[2] = local_timeout ? -1.0 : 0.0;
+    state->send[3] = local_terminated ? -1.0 : 0.0;
+    MPI_Iallreduce(state->send, state->recv, GLOBAL_STATE_FIELDS, MPI_DOUBLE, MPI_MIN, state->comm, &state->request);
+    state->in_flight = true;
+}
+
+/*
+Check whether the round in flight completed and publish its result
+
+@param state Pointer to the GlobalState
+@return true if a round completed during this call, false otherwise
+*/
+bool global_state_test(GlobalState *state)
+{
+    if (!state->in_flight)
+    {
+        return false;
+    }
+    int done = 0;
+    MPI_Test(&state->request, &done, MPI_STATUS_IGNORE);
+    if (!done)
+    {
+        return false;
+    }
+    state->in_flight = false;
+    state->lower_bound = state->recv[0];
+    state->incumbent = state->recv[1];
+    state->timeout = state->recv[2] < 0.0;
+    state->terminated = state->recv[3] < 0.0;
+    state->rounds++;
+    return true;
+}
+
+/*
+Initialize the termination detector, rank 0 starts without the token
+
+@param detector Pointer to the TerminationDetector to initialize
+@param comm Communicator of the ring
+*/
+void termination_init(TerminationDetector *detector, MPI_Comm comm)
+{
+    detector->comm = comm;
+    MPI_Comm_rank(comm, &detector->rank);
+    MPI_Comm_size(comm, &detector->size);
+    detector->balance = 0;
+    detector->black = false;
+    detector->holding = false;
+    detector->token_count = 0;
+    detector->token_black = false;
+    detector->probe_active = false;
+    detector->detected = false;
+    detector->token_request = MPI_REQUEST_NULL;
+    detector->token_buffer[0] = 0;
+    detector->token_buffer[1] = 0;
+    detector->sent_to = (long long *)calloc((size_t)detector->size * 2, sizeof(long long));
+    if (!detector->sent_to)
+    {
+        fprintf(stderr, "termination_init: failed to allocate send counters (ranks=%d)\n", detector->size);
+        exit(EXIT_FAILURE);
+    }
+    detector->node_received = 0;
+    detector->token_received = 0;
+}
+
+/*
+Free memory used by the TerminationDetector
+
+@param detector Pointer to the TerminationDetector to free
+*/
+void termination_free(TerminationDetector *detector)
+{
+    if (detector->token_request != MPI_REQUEST_NULL)
+    {
+        MPI_Wait(&detector->token_request, MPI_STATUS_IGNORE);
+    }
+    free(detector->sent_to);
+    detector->sent_to = NULL;
+}
+
+/*
+Record a node message sent to another rank
+
+@param detector Pointer to the TerminationDetector
+@param dest_rank Destination rank in the detector's communicator
+*/
+void termination_on_send(TerminationDetector *detector, int dest_rank)
+{
+    detector->balance++;
+    detector->sent_to[2 * dest_rank]++;
+}
+
+/*
+Record a received node message, which makes this rank black
+
+@param detector Pointer to the TerminationDetector
+*/
+void termination_on_receive(TerminationDetector *detector)
+{
+    detector->balance--;
+    detector->black = true;
+    detector->node_received++;
+}
+
+static void send_token(TerminationDetector *detector, long long count, bool black)
+{
+    // at most one token exists, so the previous send has normally completed
+    if (detector->token_request != MPI_REQUEST_NULL)
+    {
+        MPI_Wait(&detector->token_request, MPI_STATUS_IGNORE);
+    }
+    int next = (detector->rank + 1) % detector->size;
+    detector->token_buffer[0] = count;
+    detector->token_buffer[1] = black ? 1 : 0;
+    MPI_Isend(detector->token_buffer, 2, MPI_LONG_LONG, next, TAG_DP_TOKEN, detector->comm, &detector->token_request);
+    detector->sent_to[2 * next + 1]++;
+    detector->holding = false;
+}
+
+/*
+Receive the token if it arrived and pass it on while passive.
+Rank 0 starts a new probe whenever it is passive and the previous probe
+failed, and sets detector->detected once a probe succeeds.
+
+@param detector Pointer to the TerminationDetector
+@param passive Whether this rank has no work left and nothing to expand
+*/
+void termination_poll(TerminationDetector *detector, bool passive)
+{
+    if (detector->detected)
+    {
+        return;
+    }
+    if (detector->size == 1)
+    {
+        detector->detected = passive;
+        return;
+    }
+
+    int flag = 0;
+    MPI_Status status;
+    MPI_Iprobe(MPI_ANY_SOURCE, TAG_DP_TOKEN, detector->comm, &flag, &status);
+    if (flag)
+    {
+        long long token[2] = {0, 0};
+        MPI_Recv(token, 2, MPI_LONG_LONG, status.MPI_SOURCE, TAG_DP_TOKEN, detector->comm, MPI_STATUS_IGNORE);
+        detector->token_received++;
+        detector->holding = true;
+        detector->token_count = token[0];
+        detector->token_black = token[1] != 0;
+    }
+    if (!passive)
+    {
+        return;
+    }
+
+    if (detector->rank != 0)
+    {
+        if (detector->holding)
+        {
+            send_token(detector, detector->token_count + detector->balance, detector->token_black || detector->black);
+            detector->black = false;
+        }
+        return;
+    }
+
+    if (detector->holding)
+    {
+        detector->probe_active = false;
+        detector->holding = false;
+        if (!detector->token_black && !detector->black && detector->token_count + detector->balance == 0)
+        {
+            detector->detected = true;
+            return;
+        }
+    }
+    if (!detector->probe_active)
+    {
+        detector->black = false;
+        detector->probe_active = true;
+        send_token(detector, 0, false);
+    }
+}
+
+/*
+Settle the detector after the search stopped, possibly before termination
+was detected (timeout). Collective over the detector's communicator:
+absorbs every token still travelling and returns how many node messages
+were sent to this rank in total, so the caller can receive the rest.
+
+@param detector Pointer to the TerminationDetector
+@return Total number of node messages addressed to this rank
+*/
+long long termination_finish(TerminationDetector *detector)
+{
+    long long incoming[2] = {0, 0};
+    MPI_Reduce_scatter_block(detector->sent_to, incoming, 2, MPI_LONG_LONG, MPI_SUM, detector->comm);
+    while (detector->token_received < incoming[1])
+    {
+        long long token[2] = {0, 0};
+        MPI_Recv(token, 2, MPI_LONG_LONG, MPI_ANY_SOURCE, TAG_DP_TOKEN, detector->comm, MPI_STATUS_IGNORE);
+        detector->token_received++;
+    }
+    if (detector->token_request != MPI_REQUEST_NULL)
+    {
+        MPI_Wait(&detector->token_request, MPI_STATUS_IGNORE);
+    }
+    return incoming[0];
+}
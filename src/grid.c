@@ -5,7 +5,8 @@
 #include <string.h>
 
 /*
-Initialize Grid of given size
+Initialize an obstacle-free Grid of given size. The move masks are not
+built until grid_build_moves is called.
 
 @param grid Pointer to the Grid
 @param width Width of the grid
@@ -15,14 +16,30 @@ void grid_init(Grid *grid, int width, int height)
 {
     grid->width = width;
     grid->height = height;
+    grid->row_words = (width + 63) / 64;
     size_t total = (size_t)width * (size_t)height;
-    grid->cells = (uint8_t *)malloc(total);
-    if (grid->cells)
+    grid->obstacles = (uint64_t *)calloc(grid_obstacle_words(grid) > 0 ? grid_obstacle_words(grid) : 1, sizeof(uint64_t));
+    grid->moves = (uint8_t *)calloc(total > 0 ? total : 1, sizeof(uint8_t));
+    if (!grid->obstacles || !grid->moves)
     {
-        memset(grid->cells, 0, total);
+        fprintf(stderr, "grid_init: failed to allocate grid (width=%d height=%d)\n", width, height);
+        exit(EXIT_FAILURE);
     }
 }
 
+/*
+Copy a Grid with its obstacle layer and move masks
+
+@param dst Pointer to the uninitialized destination Grid
+@param src Pointer to the Grid to copy
+*/
+void grid_copy(Grid *dst, const Grid *src)
+{
+    grid_init(dst, src->width, src->height);
+    memcpy(dst->obstacles, src->obstacles, sizeof(uint64_t) * grid_obstacle_words(src));
+    memcpy(dst->moves, src->moves, (size_t)src->width * (size_t)src->height);
+}
+
 /*
 Free memory used by Grid
 
@@ -30,73 +47,181 @@ Free memory used by Grid
 */
 void grid_free(Grid *grid)
 {
-    if (grid->cells != NULL)
-    {
-        free(grid->cells);
-        grid->cells = NULL;
-    }
+    free(grid->obstacles);
+    free(grid->moves);
+    grid->obstacles = NULL;
+    grid->moves = NULL;
     grid->width = 0;
     grid->height = 0;
+    grid->row_words = 0;
+}
+
+/*
+Mark a cell as blocked in the obstacle layer
+
+@param grid Pointer to the Grid
+@param x X coordinate, inside the grid
+@param y Y coordinate, inside the grid
+*/
+void grid_set_obstacle(Grid *grid, int x, int y)
+{
+    grid->obstacles[(size_t)y * (size_t)grid->row_words + (size_t)(x >> 6)] |= (uint64_t)1 << (x & 63);
+}
+
+/*
+Rebuild the per-cell move masks from the obstacle layer. A free cell can
+always wait; each step is legal when the target is inside the grid and free.
+
+@param grid Pointer to the Grid
+*/
+void grid_build_moves(Grid *grid)
+{
+    for (int y = 0; y < grid->height; ++y)
+    {
+        for (int x = 0; x < grid->width; ++x)
+        {
+            uint8_t mask = 0;
+            if (!grid_is_obstacle(grid, x, y))
+            {
+                mask = GRID_MOVE_WAIT;
+                mask |= grid_is_obstacle(grid, x + 1, y) ? 0 : GRID_MOVE_EAST;
+                mask |= grid_is_obstacle(grid, x - 1, y) ? 0 : GRID_MOVE_WEST;
+                mask |= grid_is_obstacle(grid, x, y + 1) ? 0 : GRID_MOVE_SOUTH;
+                mask |= grid_is_obstacle(grid, x, y - 1) ? 0 : GRID_MOVE_NORTH;
+            }
+            grid->moves[y * grid->width + x] = mask;
+        }
+    }
+}
+
+/*
+@param grid Pointer to the Grid
+@return Number of 64-bit words in the obstacle layer
+*/
+size_t grid_obstacle_words(const Grid *grid)
+{
+    return (size_t)grid->row_words * (size_t)grid->height;
+}
+
+/*
+Read a whole file into memory
+
+@param path Path to the file
+@param out_size Output number of bytes read
+@return NUL-terminated buffer owned by the caller, or NULL if the file cannot be read
+*/
+static char *read_whole_file(const char *path, size_t *out_size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return NULL;
+    }
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0)
+    {
+        size = ftell(fp);
+    }
+    if (size < 0 || fseek(fp, 0, SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    char *text = (char *)malloc((size_t)size + 1);
+    if (!text)
+    {
+        fprintf(stderr, "read_whole_file: failed to allocate buffer for %s (size=%ld)\n", path, size);
+        exit(EXIT_FAILURE);
+    }
+    size_t read = fread(text, 1, (size_t)size, fp);
+    fclose(fp);
+    text[read] = '\0';
+    *out_size = read;
+    return text;
 }
 
-// Load the binary processed map
 /*
-Load the binary processed map file
+Load a map file. Two formats are accepted and told apart by their first
+line: MovingAI .map files ("type octile", height, width, "map", then one
+row per line, where only '.' and 'G' are passable) and the preprocessed
+format ("width height", then 0/1 cells with 1 blocked). The file is read in
+one go and both grid layers are built before returning.
 
 @param grid Pointer to the Grid
 @param path Pointer to the file path
+@return true on success, false if the file cannot be read or is malformed
 */
 bool grid_load_from_file(Grid *grid, const char *path)
 {
-    FILE *fp = fopen(path, "r");
-    if (!fp)
+    size_t size = 0;
+    char *text = read_whole_file(path, &size);
+    if (!text)
     {
         return false;
     }
 
+    // Read width and height
     int width = 0;
     int height = 0;
-    // Read width and height
-    if (fscanf(fp, "%d %d\n", &width, &height) != 2)
+    int consumed = 0;
+    bool movingai = strncmp(text, "type", 4) == 0;
+    if (movingai)
     {
-        fclose(fp);
+        if (sscanf(text, "type %*s height %d width %d map%n", &height, &width, &consumed) != 2 || consumed == 0)
+        {
+            free(text);
+            return false;
+        }
+    }
+    else if (sscanf(text, "%d %d%n", &width, &height, &consumed) != 2)
+    {
+        free(text);
         return false;
     }
 
     // Initialize grid
-    grid_init(grid, width, height);
-    if (grid->cells == NULL)
+    if (width <= 0 || height <= 0)
     {
-        fclose(fp);
+        free(text);
         return false;
     }
+    grid_init(grid, width, height);
 
-    // Read cell data one character at a time, skipping whitespace
+    // Read cell data, skipping whitespace
     size_t cell_count = (size_t)width * (size_t)height;
     size_t cell_index = 0;
-    while (cell_index < cell_count)
+    for (size_t pos = (size_t)consumed; pos < size && cell_index < cell_count; ++pos)
     {
-        int ch = fgetc(fp);
-        if (ch == EOF)
-        {
-            grid_free(grid);
-            fclose(fp);
-            return false;
-        }
+        unsigned char ch = (unsigned char)text[pos];
         if (isspace(ch))
         {
             continue;
         }
-        if (ch != '0' && ch != '1')
+        bool blocked = false;
+        if (movingai)
         {
-            grid_free(grid);
-            fclose(fp);
-            return false;
+            blocked = ch != '.' && ch != 'G';
+        }
+        else if (ch == '0' || ch == '1')
+        {
+            blocked = ch == '1';
         }
-        grid->cells[cell_index++] = (uint8_t)(ch - '0');
+        else
+        {
+            break;
+        }
+        if (blocked)
+        {
+            grid_set_obstacle(grid, (int)(cell_index % (size_t)width), (int)(cell_index / (size_t)width));
+        }
+        cell_index++;
     }
-
-    // Clean up and return
-    fclose(fp);
+    free(text);
+    if (cell_index < cell_count)
+    {
+        grid_free(grid);
+        return false;
+    }
+    grid_build_moves(grid);
     return true;
 }
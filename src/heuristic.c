@@ -0,0 +1,65 @@
+#include "heuristic.h"
+
+#include <stdio.h>
+
+/*
+Compute exact distances to a goal with a backward BFS over the static grid.
+Moves are unit cost and reversible, so the BFS from the goal gives the
+shortest distance from every free cell to the goal, ignoring other agents.
+
+@param grid Pointer to the Grid
+@param goal Goal GridCoord the distances are measured to
+@param out_table Output array of size width * height
+@return true on success, false if the queue could not be allocated
+*/
+bool heuristic_compute_distances(const Grid *grid, GridCoord goal, int *out_table)
+{
+    size_t cell_count = (size_t)grid->width * (size_t)grid->height;
+    for (size_t i = 0; i < cell_count; ++i)
+    {
+        out_table[i] = HEURISTIC_UNREACHABLE;
+    }
+    if (grid_is_obstacle(grid, goal.x, goal.y))
+    {
+        return true;
+    }
+
+    // every cell enters the queue at most once
+    int *queue = (int *)malloc(sizeof(int) * cell_count);
+    if (!queue)
+    {
+        fprintf(stderr, "heuristic_compute_distances: failed to allocate BFS queue (size=%zu)\n", cell_count);
+        return false;
+    }
+
+    int head = 0;
+    int tail = 0;
+    int goal_index = goal.y * grid->width + goal.x;
+    out_table[goal_index] = 0;
+    queue[tail++] = goal_index;
+
+    while (head < tail)
+    {
+        int current = queue[head++];
+        int next_distance = out_table[current] + 1;
+        int move = 0;
+        // every legal step is symmetric, so the forward masks serve the backward search
+        for (unsigned int mask = grid_moves(grid, current) & GRID_MOVE_STEPS; mask != 0; mask >>= 1, ++move)
+        {
+            if ((mask & 1u) == 0)
+            {
+                continue;
+            }
+            int next = grid_move_cell(grid, current, move);
+            if (out_table[next] != HEURISTIC_UNREACHABLE)
+            {
+                continue;
+            }
+            out_table[next] = next_distance;
+            queue[tail++] = next;
+        }
+    }
+
+    free(queue);
+    return true;
+}
@@ -1,54 +1,626 @@
 #include "instance_io.h"
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+/* Alignment of each table inside the node-shared instance segment and the packed file */
+#define SHARED_SEGMENT_ALIGN 64
+
+/* "CBSI" in a little-endian file */
+#define PACKED_INSTANCE_MAGIC 0x49534243u
+#define PACKED_INSTANCE_VERSION 1u
+
+/*
+Header at the start of a packed instance file. Every section starts at a
+multiple of SHARED_SEGMENT_ALIGN bytes and is stored in native byte order,
+so a mapped file can be used in place.
+*/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t row_words;
+    int32_t num_agents;
+    /** 1 if the per-agent heuristic tables are stored */
+    int32_t has_heuristics;
+    int32_t reserved;
+    /** Grid.obstacles, row_words * height words */
+    uint64_t obstacles_offset;
+    /** Grid.moves, width * height bytes */
+    uint64_t moves_offset;
+    /** sx, sy, gx, gy per agent as int32 */
+    uint64_t agents_offset;
+    /** num_agents tables of width * height int, 0 when not stored */
+    uint64_t heuristics_offset;
+    /** Size of the whole file */
+    uint64_t file_bytes;
+} PackedInstanceHeader;
+
+/* One agent of a scenario file before selection */
+typedef struct
+{
+    int bucket;
+    GridCoord start;
+    GridCoord goal;
+} ScenarioEntry;
+
+static size_t shared_section_bytes(size_t bytes)
+{
+    return (bytes + SHARED_SEGMENT_ALIGN - 1) / SHARED_SEGMENT_ALIGN * SHARED_SEGMENT_ALIGN;
+}
+
+/*
+Select every agent of every bucket
+
+@param selection Pointer to the AgentSelection to initialize
+*/
+void agent_selection_init(AgentSelection *selection)
+{
+    selection->bucket = -1;
+    selection->offset = 0;
+    selection->count = 0;
+}
+
+static void scenario_push(ScenarioEntry **entries, int *count, int *capacity, ScenarioEntry entry)
+{
+    if (*count >= *capacity)
+    {
+        int new_cap = *capacity == 0 ? 64 : *capacity * 2;
+        ScenarioEntry *new_entries = (ScenarioEntry *)realloc(*entries, sizeof(ScenarioEntry) * (size_t)new_cap);
+        if (!new_entries)
+        {
+            fprintf(stderr, "scenario_push: failed to allocate scenario entries (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        *entries = new_entries;
+        *capacity = new_cap;
+    }
+    (*entries)[(*count)++] = entry;
+}
+
+/*
+Read the agents of a scenario file. Two formats are accepted: the MovingAI
+.scen format ("version 1" followed by one "bucket map width height sx sy gx
+gy optimal" line per agent) and the project's own format (agent count
+followed by "sx sy gx gy" lines, all in bucket 0).
+
+@param path Path to the scenario file
+@param grid Pointer to the loaded Grid the scenario must match
+@param out_entries Output array of entries, owned by the caller
+@param out_count Output number of entries
+@return true on success, false if the file cannot be read or does not match the grid
+*/
+static bool read_scenario(const char *path, const Grid *grid, ScenarioEntry **out_entries, int *out_count)
+{
+    *out_entries = NULL;
+    *out_count = 0;
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        return false;
+    }
+
+    int capacity = 0;
+    bool ok = true;
+    char token[32];
+    if (fscanf(fp, "%31s", token) != 1)
+    {
+        ok = false;
+    }
+    else if (strcmp(token, "version") == 0)
+    {
+        // MovingAI scenario: skip the rest of the version line
+        char line[4096];
+        ok = fgets(line, sizeof(line), fp) != NULL;
+        while (ok && fgets(line, sizeof(line), fp) != NULL)
+        {
+            ScenarioEntry entry;
+            int map_width = 0;
+            int map_height = 0;
+            int fields = sscanf(line, "%d %*s %d %d %d %d %d %d",
+                                &entry.bucket, &map_width, &map_height,
+                                &entry.start.x, &entry.start.y, &entry.goal.x, &entry.goal.y);
+            if (fields <= 0)
+            {
+                continue;
+            }
+            if (fields != 7 || map_width != grid->width || map_height != grid->height)
+            {
+                fprintf(stderr, "read_scenario: %s does not match the %dx%d map\n", path, grid->width, grid->height);
+                ok = false;
+                break;
+            }
+            scenario_push(out_entries, out_count, &capacity, entry);
+        }
+    }
+    else
+    {
+        char *end = NULL;
+        long declared = strtol(token, &end, 10);
+        ok = *end == '\0' && declared > 0;
+        for (long i = 0; ok && i < declared; ++i)
+        {
+            ScenarioEntry entry = {.bucket = 0};
+            ok = fscanf(fp, "%d %d %d %d", &entry.start.x, &entry.start.y, &entry.goal.x, &entry.goal.y) == 4;
+            if (ok)
+            {
+                scenario_push(out_entries, out_count, &capacity, entry);
+            }
+        }
+    }
+    fclose(fp);
+
+    for (int i = 0; ok && i < *out_count; ++i)
+    {
+        const ScenarioEntry *entry = &(*out_entries)[i];
+        if (grid_is_obstacle(grid, entry->start.x, entry->start.y) || grid_is_obstacle(grid, entry->goal.x, entry->goal.y))
+        {
+            fprintf(stderr, "read_scenario: agent %d of %s starts or ends on a blocked cell\n", i, path);
+            ok = false;
+        }
+    }
+    if (!ok)
+    {
+        free(*out_entries);
+        *out_entries = NULL;
+        *out_count = 0;
+    }
+    return ok;
+}
+
+/*
+Read the selected agents of a scenario into a new ProblemInstance. The map
+of the instance is left empty.
+
+@param agents_path Path to the scenario file
+@param grid Pointer to the Grid the scenario must match
+@param selection Which agents of the scenario to plan for (NULL: all of them)
+@param instance Output ProblemInstance
+@return true on success, false otherwise
+*/
+static bool read_selected_agents(const char *agents_path,
+                                 const Grid *grid,
+                                 const AgentSelection *selection,
+                                 ProblemInstance *instance)
+{
+    ScenarioEntry *entries = NULL;
+    int entry_count = 0;
+    if (!read_scenario(agents_path, grid, &entries, &entry_count))
+    {
+        return false;
+    }
+
+    // Apply bucket and slice selection
+    AgentSelection all;
+    agent_selection_init(&all);
+    if (!selection)
+    {
+        selection = &all;
+    }
+    int num_agents = 0;
+    int skipped = 0;
+    for (int i = 0; i < entry_count; ++i)
+    {
+        if (selection->bucket >= 0 && entries[i].bucket != selection->bucket)
+        {
+            continue;
+        }
+        if (skipped < selection->offset)
+        {
+            skipped++;
+            continue;
+        }
+        if (selection->count > 0 && num_agents == selection->count)
+        {
+            break;
+        }
+        entries[num_agents++] = entries[i];
+    }
+    if (num_agents <= 0)
+    {
+        fprintf(stderr, "load_problem_instance: no agents selected from %s\n", agents_path);
+        free(entries);
+        return false;
+    }
+
+    problem_instance_init(instance, num_agents);
+    for (int i = 0; i < num_agents; ++i)
+    {
+        instance->starts[i] = entries[i].start;
+        instance->goals[i] = entries[i].goal;
+    }
+    free(entries);
+    return true;
+}
+
+/*
+Load a map and the selected agents of a scenario, then precompute the
+heuristic tables. Maps may be MovingAI .map files or the preprocessed 0/1
+format, scenarios MovingAI .scen files or the project's agent format.
+
+@param map_path Path to the map file
+@param agents_path Path to the scenario file
+@param selection Which agents of the scenario to plan for (NULL: all of them)
+@param instance Output ProblemInstance
+@return true on success, false otherwise
+*/
 bool load_problem_instance(const char *map_path,
                            const char *agents_path,
+                           const AgentSelection *selection,
                            ProblemInstance *instance)
 {
     // Load map
-    Grid local_map = {.width = 0, .height = 0, .cells = NULL};
+    Grid local_map = {.width = 0, .height = 0, .row_words = 0, .obstacles = NULL, .moves = NULL};
     if (!grid_load_from_file(&local_map, map_path))
     {
         return false;
     }
 
     // Load agents
-    FILE *fp = fopen(agents_path, "r");
-    if (!fp)
+    if (!read_selected_agents(agents_path, &local_map, selection, instance))
     {
         grid_free(&local_map);
         return false;
     }
+    instance->map = local_map;
 
-    // Read number of agents
-    int num_agents = 0;
-    if (fscanf(fp, "%d", &num_agents) != 1 || num_agents <= 0 || num_agents > MAX_AGENTS)
+    // Precompute exact goal distances once per instance
+    if (!problem_instance_build_heuristics(instance))
     {
-        fclose(fp);
-        grid_free(&local_map);
+        problem_instance_free(instance);
         return false;
     }
+    return true;
+}
 
-    // Initialize problem instance
-    problem_instance_init(instance, num_agents);
-    instance->map = local_map;
+/*
+Load the selected agents of a scenario on an already loaded map. The
+instance gets its own copy of the map and no heuristic tables, so a caller
+that keeps maps between instances can fill them from its own tables.
 
-    // Read start and goal positions
-    for (int i = 0; i < num_agents; ++i)
+@param map Pointer to the loaded Grid
+@param agents_path Path to the scenario file
+@param selection Which agents of the scenario to plan for (NULL: all of them)
+@param instance Output ProblemInstance
+@return true on success, false otherwise
+*/
+bool load_problem_agents(const Grid *map,
+                         const char *agents_path,
+                         const AgentSelection *selection,
+                         ProblemInstance *instance)
+{
+    if (!read_selected_agents(agents_path, map, selection, instance))
+    {
+        return false;
+    }
+    grid_copy(&instance->map, map);
+    return true;
+}
+
+static bool write_padding(FILE *fp, size_t bytes)
+{
+    static const uint8_t zeros[SHARED_SEGMENT_ALIGN] = {0};
+    return bytes == 0 || fwrite(zeros, 1, bytes, fp) == bytes;
+}
+
+/*
+Write a loaded ProblemInstance as a packed instance file that
+load_packed_instance maps in place: the bit-packed grid with its move
+masks, the starts and goals, and the heuristic tables if requested
+
+@param instance Pointer to the loaded ProblemInstance
+@param path Output file path
+@param with_heuristics Whether to store the heuristic tables (they must be built)
+@return true on success, false if the file cannot be written
+*/
+bool save_packed_instance(const ProblemInstance *instance, const char *path, bool with_heuristics)
+{
+    size_t cell_count = (size_t)instance->map.width * (size_t)instance->map.height;
+    size_t obstacle_bytes = sizeof(uint64_t) * grid_obstacle_words(&instance->map);
+    size_t agent_bytes = sizeof(int32_t) * 4 * (size_t)instance->num_agents;
+    size_t table_bytes = sizeof(int) * cell_count * (size_t)instance->num_agents;
+    with_heuristics = with_heuristics && instance->heuristics != NULL;
+
+    PackedInstanceHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PACKED_INSTANCE_MAGIC;
+    header.version = PACKED_INSTANCE_VERSION;
+    header.width = instance->map.width;
+    header.height = instance->map.height;
+    header.row_words = instance->map.row_words;
+    header.num_agents = instance->num_agents;
+    header.has_heuristics = with_heuristics ? 1 : 0;
+    header.obstacles_offset = shared_section_bytes(sizeof(header));
+    header.moves_offset = header.obstacles_offset + shared_section_bytes(obstacle_bytes);
+    header.agents_offset = header.moves_offset + shared_section_bytes(cell_count);
+    header.heuristics_offset = with_heuristics ? header.agents_offset + shared_section_bytes(agent_bytes) : 0;
+    header.file_bytes = with_heuristics ? header.heuristics_offset + table_bytes : header.agents_offset + agent_bytes;
+
+    int32_t *agents = (int32_t *)malloc(agent_bytes > 0 ? agent_bytes : 1);
+    if (!agents)
+    {
+        fprintf(stderr, "save_packed_instance: failed to allocate agents (count=%d)\n", instance->num_agents);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < instance->num_agents; ++i)
+    {
+        agents[i * 4] = instance->starts[i].x;
+        agents[i * 4 + 1] = instance->starts[i].y;
+        agents[i * 4 + 2] = instance->goals[i].x;
+        agents[i * 4 + 3] = instance->goals[i].y;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+    {
+        free(agents);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && write_padding(fp, header.obstacles_offset - sizeof(header));
+    ok = ok && fwrite(instance->map.obstacles, 1, obstacle_bytes, fp) == obstacle_bytes;
+    ok = ok && write_padding(fp, header.moves_offset - header.obstacles_offset - obstacle_bytes);
+    ok = ok && fwrite(instance->map.moves, 1, cell_count, fp) == cell_count;
+    ok = ok && write_padding(fp, header.agents_offset - header.moves_offset - cell_count);
+    ok = ok && fwrite(agents, 1, agent_bytes, fp) == agent_bytes;
+    if (with_heuristics)
+    {
+        ok = ok && write_padding(fp, header.heuristics_offset - header.agents_offset - agent_bytes);
+        ok = ok && fwrite(instance->heuristics, 1, table_bytes, fp) == table_bytes;
+    }
+    ok = fclose(fp) == 0 && ok;
+    free(agents);
+    return ok;
+}
+
+/*
+Map a packed instance file written by save_packed_instance. The grid
+layers and stored heuristic tables are used in place from the read-only
+mapping; missing heuristic tables are computed.
+
+@param path Path to the packed instance file
+@param instance Output ProblemInstance
+@return true on success, false if the file cannot be mapped or is not a valid packed instance
+*/
+bool load_packed_instance(const char *path, ProblemInstance *instance)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(PackedInstanceHeader))
+    {
+        close(fd);
+        return false;
+    }
+    size_t file_bytes = (size_t)info.st_size;
+    void *mapped = mmap(NULL, file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const PackedInstanceHeader *header = (const PackedInstanceHeader *)mapped;
+    size_t cell_count = (size_t)header->width * (size_t)header->height;
+    bool valid = header->magic == PACKED_INSTANCE_MAGIC &&
+                 header->version == PACKED_INSTANCE_VERSION &&
+                 header->width > 0 && header->height > 0 &&
+                 header->row_words == (header->width + 63) / 64 &&
+                 header->num_agents > 0 &&
+                 header->file_bytes == file_bytes &&
+                 header->obstacles_offset + sizeof(uint64_t) * (size_t)header->row_words * (size_t)header->height <= header->moves_offset &&
+                 header->moves_offset + cell_count <= header->agents_offset &&
+                 header->agents_offset + sizeof(int32_t) * 4 * (size_t)header->num_agents <= file_bytes &&
+                 (!header->has_heuristics || header->heuristics_offset + sizeof(int) * cell_count * (size_t)header->num_agents <= file_bytes);
+    if (!valid)
+    {
+        fprintf(stderr, "load_packed_instance: %s is not a packed instance of this build\n", path);
+        munmap(mapped, file_bytes);
+        return false;
+    }
+
+    uint8_t *base = (uint8_t *)mapped;
+    problem_instance_init(instance, header->num_agents);
+    instance->map.width = header->width;
+    instance->map.height = header->height;
+    instance->map.row_words = header->row_words;
+    instance->map.obstacles = (uint64_t *)(base + header->obstacles_offset);
+    instance->map.moves = base + header->moves_offset;
+    instance->mapped_file = mapped;
+    instance->mapped_bytes = file_bytes;
+    const int32_t *agents = (const int32_t *)(base + header->agents_offset);
+    for (int i = 0; i < instance->num_agents; ++i)
+    {
+        instance->starts[i] = (GridCoord){.x = agents[i * 4], .y = agents[i * 4 + 1]};
+        instance->goals[i] = (GridCoord){.x = agents[i * 4 + 2], .y = agents[i * 4 + 3]};
+    }
+    if (header->has_heuristics)
+    {
+        instance->heuristics = (int *)(base + header->heuristics_offset);
+    }
+    else if (!problem_instance_build_heuristics(instance))
     {
-        int sx, sy, gx, gy;
-        if (fscanf(fp, "%d %d %d %d", &sx, &sy, &gx, &gy) != 4)
+        problem_instance_free(instance);
+        return false;
+    }
+    return true;
+}
+
+/*
+Place the read-only instance tables (obstacle layer, move masks and
+heuristic tables) in one
+MPI-3 shared-memory segment per node. The segment is allocated by the first
+rank of each node and mapped by the other ranks of that node, so only one
+rank per node receives the data. Root always leads its node and copies its
+private tables (or its mapped packed file) into the segment before
+releasing them.
+
+@param instance Pointer to the ProblemInstance, width, height and agents set on every rank
+@param root Rank holding the loaded instance
+@param comm Communicator the instance is broadcast over
+@param has_heuristics Whether root has heuristic tables to share
+*/
+static void share_instance_tables(ProblemInstance *instance, int root, MPI_Comm comm, bool has_heuristics)
+{
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+
+    // Key 0 makes root the first rank, and so the leader, of its node
+    MPI_Comm node_comm = MPI_COMM_NULL;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank == root ? 0 : 1, MPI_INFO_NULL, &node_comm);
+    int node_rank = 0;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm leader_comm = MPI_COMM_NULL;
+    MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, rank == root ? 0 : 1, &leader_comm);
+
+    size_t cell_count = (size_t)instance->map.width * (size_t)instance->map.height;
+    size_t word_count = grid_obstacle_words(&instance->map);
+    size_t obstacle_bytes = shared_section_bytes(sizeof(uint64_t) * word_count);
+    size_t move_bytes = shared_section_bytes(cell_count);
+    size_t table_bytes = has_heuristics ? sizeof(int) * cell_count * (size_t)instance->num_agents : 0;
+    MPI_Aint segment_bytes = node_rank == 0 ? (MPI_Aint)(obstacle_bytes + move_bytes + table_bytes) : 0;
+
+    uint8_t *base = NULL;
+    MPI_Win window = MPI_WIN_NULL;
+    MPI_Win_allocate_shared(segment_bytes, 1, MPI_INFO_NULL, node_comm, &base, &window);
+    if (node_rank != 0)
+    {
+        MPI_Aint leader_bytes = 0;
+        int disp_unit = 0;
+        MPI_Win_shared_query(window, 0, &leader_bytes, &disp_unit, &base);
+    }
+    uint64_t *obstacles = (uint64_t *)base;
+    uint8_t *moves = base + obstacle_bytes;
+    int *tables = has_heuristics ? (int *)(base + obstacle_bytes + move_bytes) : NULL;
+
+    MPI_Win_fence(0, window);
+    if (leader_comm != MPI_COMM_NULL)
+    {
+        if (rank == root)
         {
-            fclose(fp);
-            problem_instance_free(instance);
-            return false;
+            memcpy(obstacles, instance->map.obstacles, sizeof(uint64_t) * word_count);
+            memcpy(moves, instance->map.moves, cell_count);
+            if (has_heuristics)
+            {
+                memcpy(tables, instance->heuristics, table_bytes);
+            }
+            problem_instance_release_tables(instance);
         }
-        instance->starts[i] = (GridCoord){.x = sx, .y = sy};
-        instance->goals[i] = (GridCoord){.x = gx, .y = gy};
+        // Root is rank 0 of the leaders
+        if (cell_count > 0)
+        {
+            MPI_Bcast(obstacles, (int)word_count, MPI_UINT64_T, 0, leader_comm);
+            MPI_Bcast(moves, (int)cell_count, MPI_UINT8_T, 0, leader_comm);
+        }
+        // One agent at a time to keep counts within int range
+        for (int i = 0; has_heuristics && i < instance->num_agents; ++i)
+        {
+            MPI_Bcast(tables + cell_count * (size_t)i, (int)cell_count, MPI_INT, 0, leader_comm);
+        }
+        MPI_Comm_free(&leader_comm);
     }
+    // Makes the leader's stores visible to every rank of the node
+    MPI_Win_fence(0, window);
+    MPI_Comm_free(&node_comm);
 
-    // Clean up and return
-    fclose(fp);
-    return true;
+    instance->shared_window = window;
+    instance->map.obstacles = obstacles;
+    instance->map.moves = moves;
+    instance->heuristics = tables;
+}
+
+/*
+Broadcast a loaded ProblemInstance from root to every rank of comm. The map
+layers and per-agent heuristic tables are received once per node into a
+shared-memory segment, so no rank has to recompute or duplicate them.
+
+@param instance Pointer to the ProblemInstance (loaded on root, empty elsewhere)
+@param root Rank holding the loaded instance
+@param comm Communicator to broadcast over
+*/
+void broadcast_problem_instance(ProblemInstance *instance, int root, MPI_Comm comm)
+{
+    // Get rank
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+
+    // Prepare header
+    int header[4] = {0, 0, 0, 0};
+    // Fill header on root
+    if (rank == root)
+    {
+        header[0] = instance->map.width;
+        header[1] = instance->map.height;
+        header[2] = instance->num_agents;
+        header[3] = instance->heuristics != NULL ? 1 : 0;
+    }
+    // Broadcast header
+    MPI_Bcast(header, 4, MPI_INT, root, comm);
+
+    int width = header[0];
+    int height = header[1];
+    int agents = header[2];
+    int has_heuristics = header[3];
+
+    // Allocate on non-root ranks, the grid layers come from the shared segment
+    if (rank != root)
+    {
+        problem_instance_init(instance, agents);
+        instance->map.width = width;
+        instance->map.height = height;
+        instance->map.row_words = (width + 63) / 64;
+    }
+
+    // Broadcast agent start and goal positions
+    if (agents > 0)
+    {
+        int *buffer = (int *)malloc(sizeof(int) * (size_t)agents * 2);
+        if (rank == root)
+        {
+            for (int i = 0; i < agents; ++i)
+            {
+                buffer[i * 2] = instance->starts[i].x;
+                buffer[i * 2 + 1] = instance->starts[i].y;
+            }
+        }
+        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
+        if (rank != root)
+        {
+            for (int i = 0; i < agents; ++i)
+            {
+                instance->starts[i].x = buffer[i * 2];
+                instance->starts[i].y = buffer[i * 2 + 1];
+            }
+        }
+
+        if (rank == root)
+        {
+            for (int i = 0; i < agents; ++i)
+            {
+                buffer[i * 2] = instance->goals[i].x;
+                buffer[i * 2 + 1] = instance->goals[i].y;
+            }
+        }
+        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
+        if (rank != root)
+        {
+            for (int i = 0; i < agents; ++i)
+            {
+                instance->goals[i].x = buffer[i * 2];
+                instance->goals[i].y = buffer[i * 2 + 1];
+            }
+        }
+        free(buffer);
+    }
+
+    share_instance_tables(instance, root, comm, has_heuristics != 0);
 }
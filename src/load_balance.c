@@ -0,0 +1,234 @@
+#include "load_balance.h"
+
+#include "messages.h"
+
+static unsigned int next_random(unsigned int *seed)
+{
+    // xorshift32, the seed is never zero
+    unsigned int x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+/*
+Initialize the LoadBalancer with no request pending
+
+@param balancer Pointer to the LoadBalancer to initialize
+@param comm Communicator of the solver ranks
+@param steal_batch Maximum number of nodes donated per request
+*/
+void load_balancer_init(LoadBalancer *balancer, MPI_Comm comm, int steal_batch)
+{
+    balancer->comm = comm;
+    MPI_Comm_rank(comm, &balancer->rank);
+    MPI_Comm_size(comm, &balancer->size);
+    balancer->steal_batch = steal_batch < 1 ? 1 : steal_batch;
+    balancer->request_pending = false;
+    balancer->next_request_time = 0.0;
+    balancer->backoff = STEAL_BACKOFF_MIN;
+    balancer->seed = 2654435761u * (unsigned int)(balancer->rank + 1);
+    balancer->sent_to = (long long *)calloc((size_t)balancer->size * 2, sizeof(long long));
+    if (!balancer->sent_to)
+    {
+        fprintf(stderr, "load_balancer_init: failed to allocate send counters (ranks=%d)\n", balancer->size);
+        exit(EXIT_FAILURE);
+    }
+    balancer->requests_received = 0;
+    balancer->denials_received = 0;
+    balancer->steals_sent = 0;
+    balancer->steals_granted = 0;
+    balancer->nodes_donated = 0;
+}
+
+/*
+Free memory used by the LoadBalancer
+
+@param balancer Pointer to the LoadBalancer to free
+*/
+void load_balancer_free(LoadBalancer *balancer)
+{
+    free(balancer->sent_to);
+    balancer->sent_to = NULL;
+}
+
+/*
+Ask a random other rank for work unless a request is pending or the
+backoff after a denial has not expired
+
+@param balancer Pointer to the LoadBalancer
+*/
+void load_balancer_request(LoadBalancer *balancer)
+{
+    if (balancer->size < 2 || balancer->request_pending || MPI_Wtime() < balancer->next_request_time)
+    {
+        return;
+    }
+    int victim = (int)(next_random(&balancer->seed) % (unsigned int)(balancer->size - 1));
+    if (victim >= balancer->rank)
+    {
+        victim++;
+    }
+    int payload = balancer->rank;
+    MPI_Send(&payload, 1, MPI_INT, victim, TAG_DP_STEAL, balancer->comm);
+    balancer->sent_to[2 * victim]++;
+    balancer->steals_sent++;
+    balancer->request_pending = true;
+}
+
+/*
+Record that the pending request was answered with nodes
+
+@param balancer Pointer to the LoadBalancer
+*/
+void load_balancer_on_grant(LoadBalancer *balancer)
+{
+    balancer->request_pending = false;
+    balancer->next_request_time = 0.0;
+    balancer->backoff = STEAL_BACKOFF_MIN;
+    balancer->steals_granted++;
+}
+
+/*
+Donate nodes from the top of the open list to a thief
+
+@param balancer Pointer to the LoadBalancer
+@param open Pointer to the local open list
+@param root Root node every rank holds, used as the delta base
+@param thief Rank that asked for work
+@param pool Pointer to the PendingSendPool
+@param detector Pointer to the TerminationDetector counting node messages
+@return true if nodes were donated, false if the queue was too short
+*/
+static bool donate_nodes(LoadBalancer *balancer,
+                         OpenList *open,
+                         const HighLevelNode *root,
+                         int thief,
+                         PendingSendPool *pool,
+                         TerminationDetector *detector)
+{
+    long long available = open_list_count(open) / 2;
+    int give = available < balancer->steal_batch ? (int)available : balancer->steal_batch;
+    if (give == 0)
+    {
+        return false;
+    }
+
+    NodeBatch batch;
+    node_batch_init(&batch);
+    node_batch_reset(&batch, STEAL_GRANT_AUX);
+    HighLevelNode **kept = (HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)give);
+    if (!kept)
+    {
+        fprintf(stderr, "donate_nodes: failed to allocate kept nodes (count=%d)\n", give);
+        exit(EXIT_FAILURE);
+    }
+    // alternate between donating and keeping so both ranks hold some of the best nodes
+    // compressed nodes are replanned on pop and may be dropped, so the list can run short
+    int donated = 0;
+    int kept_count = 0;
+    for (int i = 0; i < give; ++i)
+    {
+        HighLevelNode *node = open_list_pop(open);
+        if (!node)
+        {
+            break;
+        }
+        node_batch_append_delta(&batch, node, root);
+        cbs_node_free(node);
+        donated++;
+        kept[kept_count] = open_list_pop(open);
+        if (!kept[kept_count])
+        {
+            break;
+        }
+        kept_count++;
+    }
+    for (int i = 0; i < kept_count; ++i)
+    {
+        open_list_push(open, kept[i]);
+    }
+    free(kept);
+    if (donated == 0)
+    {
+        node_batch_free(&batch);
+        return false;
+    }
+
+    node_batch_send_async(thief, TAG_DP_NODE, &batch, pool);
+    termination_on_send(detector, thief);
+    balancer->nodes_donated += donated;
+    return true;
+}
+
+/*
+Answer steal requests and collect denials of this rank's own request
+
+@param balancer Pointer to the LoadBalancer
+@param open Pointer to the local open list
+@param root Root node every rank holds, used as the delta base
+@param pool Pointer to the PendingSendPool
+@param detector Pointer to the TerminationDetector counting node messages
+*/
+void load_balancer_poll(LoadBalancer *balancer,
+                        OpenList *open,
+                        const HighLevelNode *root,
+                        PendingSendPool *pool,
+                        TerminationDetector *detector)
+{
+    int flag = 0;
+    MPI_Status status;
+    while (1)
+    {
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_DP_STEAL, balancer->comm, &flag, &status);
+        if (!flag)
+        {
+            break;
+        }
+        int thief = 0;
+        MPI_Recv(&thief, 1, MPI_INT, status.MPI_SOURCE, TAG_DP_STEAL, balancer->comm, MPI_STATUS_IGNORE);
+        balancer->requests_received++;
+        if (!donate_nodes(balancer, open, root, status.MPI_SOURCE, pool, detector))
+        {
+            int payload = 0;
+            MPI_Send(&payload, 1, MPI_INT, status.MPI_SOURCE, TAG_DP_STEAL_DENY, balancer->comm);
+            balancer->sent_to[2 * status.MPI_SOURCE + 1]++;
+        }
+    }
+
+    MPI_Iprobe(MPI_ANY_SOURCE, TAG_DP_STEAL_DENY, balancer->comm, &flag, &status);
+    if (flag)
+    {
+        int payload = 0;
+        MPI_Recv(&payload, 1, MPI_INT, status.MPI_SOURCE, TAG_DP_STEAL_DENY, balancer->comm, MPI_STATUS_IGNORE);
+        balancer->denials_received++;
+        balancer->request_pending = false;
+        balancer->next_request_time = MPI_Wtime() + balancer->backoff;
+        balancer->backoff = balancer->backoff * 2.0 > STEAL_BACKOFF_MAX ? STEAL_BACKOFF_MAX : balancer->backoff * 2.0;
+    }
+}
+
+/*
+Absorb the steal requests and denials still in flight once the search
+stopped. Collective over the balancer's communicator.
+
+@param balancer Pointer to the LoadBalancer
+*/
+void load_balancer_finish(LoadBalancer *balancer)
+{
+    long long incoming[2] = {0, 0};
+    MPI_Reduce_scatter_block(balancer->sent_to, incoming, 2, MPI_LONG_LONG, MPI_SUM, balancer->comm);
+    int payload = 0;
+    while (balancer->requests_received < incoming[0])
+    {
+        MPI_Recv(&payload, 1, MPI_INT, MPI_ANY_SOURCE, TAG_DP_STEAL, balancer->comm, MPI_STATUS_IGNORE);
+        balancer->requests_received++;
+    }
+    while (balancer->denials_received < incoming[1])
+    {
+        MPI_Recv(&payload, 1, MPI_INT, MPI_ANY_SOURCE, TAG_DP_STEAL_DENY, balancer->comm, MPI_STATUS_IGNORE);
+        balancer->denials_received++;
+    }
+}
@@ -0,0 +1,160 @@
+#include "log.h"
+
+#include <stdarg.h>
+
+#if defined(CBS_THREADS_PTHREADS)
+#include <pthread.h>
+#endif
+
+/* Bytes of log lines held per rank before they are written out */
+#define LOG_BUFFER_SIZE (64 * 1024)
+
+int log_runtime_level = CBS_LOG_LEVEL < LOG_LEVEL_INFO ? CBS_LOG_LEVEL : LOG_LEVEL_INFO;
+
+/* Whole lines not yet written to stdout, guarded by log_lock */
+static char log_buffer[LOG_BUFFER_SIZE];
+static size_t log_used = 0;
+static bool log_registered = false;
+
+#if defined(CBS_THREADS_PTHREADS)
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*
+Write the buffered lines out. Called with the lock held.
+*/
+static void flush_locked(void)
+{
+    if (log_used > 0)
+    {
+        fwrite(log_buffer, 1, log_used, stdout);
+        log_used = 0;
+    }
+    fflush(stdout);
+}
+
+/*
+Append a line to the buffer, or pass NULL to only flush it. Serializes the
+threads of the rank with the lock of the threading backend.
+
+@param level Level of the line
+@param line Formatted line, NULL to flush
+@param size Bytes of line, at most LOG_BUFFER_SIZE
+*/
+static void append_line(int level, const char *line, size_t size)
+{
+#if defined(CBS_THREADS_PTHREADS)
+    pthread_mutex_lock(&log_lock);
+#elif defined(CBS_THREADS_OPENMP)
+#pragma omp critical(cbs_log)
+#endif
+    {
+        if (line == NULL || log_used + size > LOG_BUFFER_SIZE)
+        {
+            flush_locked();
+        }
+        if (line != NULL)
+        {
+            memcpy(log_buffer + log_used, line, size);
+            log_used += size;
+            if (level == LOG_LEVEL_ERROR)
+            {
+                flush_locked();
+            }
+        }
+    }
+#if defined(CBS_THREADS_PTHREADS)
+    pthread_mutex_unlock(&log_lock);
+#endif
+}
+
+/*
+Set the run-time level and make sure buffered lines are written at exit,
+including exits on fatal errors
+
+@param level Most verbose level to write (clamped to the compiled-in level)
+*/
+void log_init(int level)
+{
+    if (level > CBS_LOG_LEVEL)
+    {
+        level = CBS_LOG_LEVEL;
+    }
+    log_runtime_level = level < LOG_LEVEL_ERROR ? LOG_LEVEL_ERROR : level;
+    if (!log_registered)
+    {
+        atexit(log_flush);
+        log_registered = true;
+    }
+}
+
+/*
+Parse a --log-level argument
+
+@param name Level name ("error", "info", "debug" or "trace")
+@param out_level Output level
+@return true if the name is a known level, false otherwise
+*/
+bool log_level_parse(const char *name, int *out_level)
+{
+    for (int level = LOG_LEVEL_ERROR; level <= LOG_LEVEL_TRACE; ++level)
+    {
+        if (strcmp(name, log_level_name(level)) == 0)
+        {
+            *out_level = level;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+@param level Log level
+@return Command line name of the level
+*/
+const char *log_level_name(int level)
+{
+    switch (level)
+    {
+    case LOG_LEVEL_ERROR:
+        return "error";
+    case LOG_LEVEL_INFO:
+        return "info";
+    case LOG_LEVEL_DEBUG:
+        return "debug";
+    default:
+        return "trace";
+    }
+}
+
+/*
+Append a formatted line to the rank's buffer. The buffer is written out
+when full, on log_flush and right after every error line, so a rank's
+output is a few large writes instead of one flush per line.
+Safe on any thread of the rank.
+
+@param level Level of the message
+@param format printf format of the line, including its newline
+*/
+void log_write(int level, const char *format, ...)
+{
+    char line[1024];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0)
+    {
+        return;
+    }
+    size_t size = (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1;
+    append_line(level, line, size);
+}
+
+/*
+Write every buffered line of the rank to stdout
+*/
+void log_flush(void)
+{
+    append_line(LOG_LEVEL_ERROR, NULL, 0);
+}
@@ -1,5 +1,8 @@
 #include "low_level.h"
 
+#include "log.h"
+#include "profile.h"
+
 #include <stdio.h>
 #include <string.h>
 
@@ -11,23 +14,30 @@ typedef struct
     int goal_x;
     int goal_y;
     int constraint_count;
+    /* Index of the request in the requester's batch */
+    int request_id;
 } LLRequestHeader;
 
+/* Followed by path_length cell indices in the same message */
 typedef struct
 {
+    int request_id;
     int status;
     int path_length;
 } LLResponseHeader;
 
-_Static_assert(sizeof(LLRequestHeader) == sizeof(int) * 6, "LLRequestHeader padding mismatch");
-_Static_assert(sizeof(LLResponseHeader) == sizeof(int) * 2, "LLResponseHeader padding mismatch");
+_Static_assert(sizeof(LLRequestHeader) == sizeof(int) * 7, "LLRequestHeader padding mismatch");
+_Static_assert(sizeof(LLResponseHeader) == sizeof(int) * 3, "LLResponseHeader padding mismatch");
+
+/* Ints per constraint of a request: agent_id, time, type, vertex cell, edge_to cell */
+#define LL_CONSTRAINT_INTS 5
 
 static void build_constraint_buffer(const ConstraintSet *constraints, int agent_id, int **buffer_out, int *count_out)
 {
     int filtered = 0;
     for (int i = 0; i < constraints->count; ++i)
     {
-        if (constraints->items[i].agent_id == agent_id || constraints->items[i].agent_id < 0)
+        if (constraint_applies_to(&constraints->items[i], agent_id))
         {
             filtered++;
         }
@@ -40,20 +50,18 @@ static void build_constraint_buffer(const ConstraintSet *constraints, int agent_
         return;
     }
 
-    int *buf = (int *)malloc(sizeof(int) * (size_t)(filtered * 7));
+    int *buf = (int *)malloc(sizeof(int) * (size_t)(filtered * LL_CONSTRAINT_INTS));
     int cursor = 0;
     for (int i = 0; i < constraints->count; ++i)
     {
         const Constraint *c = &constraints->items[i];
-        if (c->agent_id == agent_id || c->agent_id < 0)
+        if (constraint_applies_to(c, agent_id))
         {
             buf[cursor++] = c->agent_id;
             buf[cursor++] = c->time;
             buf[cursor++] = (int)c->type;
-            buf[cursor++] = c->vertex.x;
-            buf[cursor++] = c->vertex.y;
-            buf[cursor++] = c->edge_to.x;
-            buf[cursor++] = c->edge_to.y;
+            buf[cursor++] = c->vertex;
+            buf[cursor++] = c->edge_to;
         }
     }
     *buffer_out = buf;
@@ -63,30 +71,117 @@ static void fill_constraint_set(ConstraintSet *set, const int *buffer, int count
 {
     for (int i = 0; i < count; ++i)
     {
+        const int *record = buffer + i * LL_CONSTRAINT_INTS;
         Constraint c = {
-            .agent_id = buffer[i * 7 + 0],
-            .time = buffer[i * 7 + 1],
-            .type = (ConstraintType)buffer[i * 7 + 2],
-            .vertex = {.x = buffer[i * 7 + 3], .y = buffer[i * 7 + 4]},
-            .edge_to = {.x = buffer[i * 7 + 5], .y = buffer[i * 7 + 6]}};
+            .agent_id = record[0],
+            .time = record[1],
+            .type = (ConstraintType)record[2],
+            .vertex = record[3],
+            .edge_to = record[4]};
         constraint_set_add(set, c);
     }
 }
 
-bool low_level_request_path(const ProblemInstance *instance,
-                            const ConstraintSet *constraints,
-                            int agent_id,
-                            const LowLevelContext *ctx,
-                            AgentPath *out_path)
+/*
+Parse a --low-level argument
+
+@param name Engine name ("astar", "sipp" or "parallel")
+@param out_engine Output engine
+@return true if the name is a known engine, false otherwise
+*/
+bool low_level_engine_parse(const char *name, LowLevelEngine *out_engine)
 {
-    int world_rank = 0;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (strcmp(name, "astar") == 0)
+    {
+        *out_engine = LL_ENGINE_ASTAR;
+    }
+    else if (strcmp(name, "sipp") == 0)
+    {
+        *out_engine = LL_ENGINE_SIPP;
+    }
+    else if (strcmp(name, "parallel") == 0)
+    {
+        *out_engine = LL_ENGINE_PARALLEL;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
 
-    if (ctx->manager_world_rank < 0)
+/*
+Get the command line name of an engine
+
+@param engine Low-level engine
+@return Engine name
+*/
+const char *low_level_engine_name(LowLevelEngine engine)
+{
+    switch (engine)
     {
-        return sequential_a_star(&instance->map, constraints, instance->starts[agent_id], instance->goals[agent_id], agent_id, out_path);
+    case LL_ENGINE_SIPP:
+        return "sipp";
+    case LL_ENGINE_PARALLEL:
+        return "parallel";
+    case LL_ENGINE_ASTAR:
+    default:
+        return "astar";
     }
+}
 
+/*
+Plan one agent with the selected engine.
+The parallel engine is collective over comm; the others run locally.
+
+@param instance Pointer to the ProblemInstance
+@param constraints Pointer to the ConstraintSet
+@param start Starting GridCoord
+@param goal Goal GridCoord
+@param agent_id ID of the agent
+@param engine Low-level engine
+@param comm Communicator for the parallel engine (MPI_COMM_NULL plans locally)
+@param workspace Search memory of this rank (may be NULL)
+@param out_path Pointer to the AgentPath to store the found path
+@return true if a path is found, false otherwise
+*/
+static bool plan_with_engine(const ProblemInstance *instance,
+                             const ConstraintSet *constraints,
+                             GridCoord start,
+                             GridCoord goal,
+                             int agent_id,
+                             LowLevelEngine engine,
+                             MPI_Comm comm,
+                             AStarWorkspace *workspace,
+                             AgentPath *out_path)
+{
+    const int *heuristic = problem_instance_heuristic(instance, agent_id);
+    if (engine == LL_ENGINE_SIPP)
+    {
+        return sipp_plan(&instance->map, constraints, start, goal, heuristic, agent_id, workspace, out_path);
+    }
+    if (engine == LL_ENGINE_PARALLEL && comm != MPI_COMM_NULL)
+    {
+        return parallel_a_star(&instance->map, constraints, start, goal, heuristic, agent_id, comm, workspace, out_path);
+    }
+    return sequential_a_star(&instance->map, constraints, start, goal, heuristic, agent_id, workspace, out_path);
+}
+
+/*
+Send one request of a batch to the pool manager
+
+@param instance Pointer to the ProblemInstance
+@param constraints Pointer to the agent's ConstraintSet
+@param agent_id ID of the agent
+@param request_id Index of the request in its batch, echoed in the response
+@param ctx Pointer to the LowLevelContext
+*/
+static void send_request(const ProblemInstance *instance,
+                         const ConstraintSet *constraints,
+                         int agent_id,
+                         int request_id,
+                         const LowLevelContext *ctx)
+{
     int constraint_count = 0;
     int *constraint_buffer = NULL;
     build_constraint_buffer(constraints, agent_id, &constraint_buffer, &constraint_count);
@@ -97,65 +192,234 @@ bool low_level_request_path(const ProblemInstance *instance,
         .start_y = instance->starts[agent_id].y,
         .goal_x = instance->goals[agent_id].x,
         .goal_y = instance->goals[agent_id].y,
-        .constraint_count = constraint_count};
+        .constraint_count = constraint_count,
+        .request_id = request_id};
 
-    double ll_start = MPI_Wtime();
-    printf("[LL req %d] agent=%d constraints=%d -> manager %d\n",
-           world_rank,
-           agent_id,
-           constraint_count,
-           ctx->manager_world_rank);
-    fflush(stdout);
-
-    MPI_Send(&header, sizeof(header) / sizeof(int), MPI_INT, ctx->manager_world_rank, TAG_LL_REQUEST, MPI_COMM_WORLD);
+    MPI_Send(&header, sizeof(header) / sizeof(int), MPI_INT, ctx->manager_world_rank, TAG_LL_REQUEST, solver_comm);
     if (constraint_count > 0)
     {
         MPI_Send(constraint_buffer,
-                 constraint_count * 7,
+                 constraint_count * LL_CONSTRAINT_INTS,
                  MPI_INT,
                  ctx->manager_world_rank,
                  TAG_LL_REQUEST,
-                 MPI_COMM_WORLD);
+                 solver_comm);
     }
 
     free(constraint_buffer);
+}
+
+/*
+Receive the next response of a batch, from whichever pool rank served it
+
+@param out_paths Output paths of the batch, indexed by request id
+@param out_ok Output success flags of the batch, indexed by request id
+@param count Number of requests in the batch
+@return Request id of the response
+*/
+static int receive_response(AgentPath *const *out_paths, bool *out_ok, int count)
+{
+    MPI_Status status;
+    MPI_Probe(MPI_ANY_SOURCE, TAG_LL_RESPONSE, solver_comm, &status);
+    int ints = 0;
+    MPI_Get_count(&status, MPI_INT, &ints);
+    int *buffer = (int *)malloc(sizeof(int) * (size_t)ints);
+    if (!buffer)
+    {
+        fprintf(stderr, "receive_response: failed to allocate response buffer (ints=%d)\n", ints);
+        exit(EXIT_FAILURE);
+    }
+    MPI_Recv(buffer, ints, MPI_INT, status.MPI_SOURCE, TAG_LL_RESPONSE, solver_comm, MPI_STATUS_IGNORE);
 
     LLResponseHeader response;
-    MPI_Recv(&response, sizeof(response) / sizeof(int), MPI_INT, ctx->manager_world_rank, TAG_LL_RESPONSE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    memcpy(&response, buffer, sizeof(response));
+    if (response.request_id < 0 || response.request_id >= count)
+    {
+        fprintf(stderr, "receive_response: response for unknown request %d (batch of %d)\n", response.request_id, count);
+        exit(EXIT_FAILURE);
+    }
+    out_ok[response.request_id] = response.status != 0;
+    if (response.status != 0)
+    {
+        AgentPath *path = out_paths[response.request_id];
+        path_reserve(path, response.path_length);
+        path->length = response.path_length;
+        if (response.path_length > 0)
+        {
+            memcpy(path->steps, buffer + sizeof(response) / sizeof(int), sizeof(int) * (size_t)response.path_length);
+        }
+    }
+    free(buffer);
+    return response.request_id;
+}
 
-    double ll_end = MPI_Wtime();
-    printf("[LL req %d] agent=%d: received response in %.3fs\n",
-           world_rank, agent_id, ll_end - ll_start);
-    fflush(stdout);
+/* Requests of a batch planned on this rank */
+typedef struct
+{
+    const ProblemInstance *instance;
+    const LowLevelContext *ctx;
+    const ConstraintSet *sets;
+    const int *agent_ids;
+    /** Batch index of each local request */
+    const int *indices;
+    AgentPath *const *out_paths;
+    bool *ok;
+} LocalBatch;
+
+/*
+ThreadTask planning one local request with the running thread's workspace
+
+@param context Pointer to the LocalBatch
+@param task_index Index into the batch's indices
+@param thread_index Index of the running thread
+*/
+static void plan_local_task(void *context, int task_index, int thread_index)
+{
+    const LocalBatch *batch = (const LocalBatch *)context;
+    const LowLevelContext *ctx = batch->ctx;
+    int i = batch->indices[task_index];
+    int agent_id = batch->agent_ids[i];
+    AStarWorkspace *workspace = ctx->threads != NULL ? &ctx->thread_workspaces[thread_index] : ctx->workspace;
+    batch->ok[i] = plan_with_engine(batch->instance,
+                                    &batch->sets[i],
+                                    batch->instance->starts[agent_id],
+                                    batch->instance->goals[agent_id],
+                                    agent_id,
+                                    ctx->engine,
+                                    MPI_COMM_NULL,
+                                    workspace,
+                                    batch->out_paths[i]);
+}
 
-    if (response.status == 0)
+/*
+Plan several agents at once, locally or through the low-level pool.
+Requests that miss the rank's PathCache are all sent before the first
+response is awaited, so the pool can serve them side by side; without a
+pool they are planned on the context's threads.
+
+@param instance Pointer to the ProblemInstance
+@param nodes CT node whose constraint chain applies, per request
+@param agent_ids ID of the agent to plan, per request
+@param count Number of requests
+@param ctx Pointer to the LowLevelContext
+@param out_paths Paths to store the results in, per request
+@param out_ok Output success flag per request (may be NULL)
+@return true if every path was found, false otherwise
+*/
+bool low_level_request_paths(const ProblemInstance *instance,
+                             const HighLevelNode *const *nodes,
+                             const int *agent_ids,
+                             int count,
+                             const LowLevelContext *ctx,
+                             AgentPath *const *out_paths,
+                             bool *out_ok)
+{
+    if (count <= 0)
     {
-        printf("[LL resp %d] agent=%d status=fail\n", world_rank, agent_id);
-        fflush(stdout);
-        return false;
+        return true;
+    }
+    ConstraintSet *sets = (ConstraintSet *)malloc(sizeof(ConstraintSet) * (size_t)count);
+    bool *ok = out_ok != NULL ? out_ok : (bool *)malloc(sizeof(bool) * (size_t)count);
+    int *local = (int *)malloc(sizeof(int) * (size_t)count);
+    int local_count = 0;
+    if (!sets || !ok || !local)
+    {
+        fprintf(stderr, "low_level_request_paths: failed to allocate batch (count=%d)\n", count);
+        exit(EXIT_FAILURE);
     }
 
-    int path_ints = response.path_length * 2;
-    int *path_buffer = NULL;
-    if (path_ints > 0)
+    int outstanding = 0;
+    for (int i = 0; i < count; ++i)
     {
-        path_buffer = (int *)malloc(sizeof(int) * (size_t)path_ints);
-        MPI_Recv(path_buffer, path_ints, MPI_INT, ctx->manager_world_rank, TAG_LL_RESPONSE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        constraint_set_init(&sets[i], nodes[i]->constraint_count);
+        cbs_node_collect_constraints(nodes[i], agent_ids[i], &sets[i]);
+        ok[i] = false;
+        if (ctx->cache != NULL && path_cache_lookup(ctx->cache, &sets[i], agent_ids[i], &ok[i], out_paths[i]))
+        {
+            continue;
+        }
+        if (ctx->manager_world_rank < 0)
+        {
+            local[local_count++] = i;
+            continue;
+        }
+        send_request(instance, &sets[i], agent_ids[i], i, ctx);
+        outstanding++;
     }
 
-    printf("[LL resp %d] agent=%d status=ok len=%d\n", world_rank, agent_id, response.path_length);
-    fflush(stdout);
+    if (local_count > 0)
+    {
+        LocalBatch batch = {.instance = instance,
+                            .ctx = ctx,
+                            .sets = sets,
+                            .agent_ids = agent_ids,
+                            .indices = local,
+                            .out_paths = out_paths,
+                            .ok = ok};
+        thread_pool_run(ctx->threads, local_count, plan_local_task, &batch);
+        // the cache is only touched by the calling thread
+        for (int k = 0; ctx->cache != NULL && k < local_count; ++k)
+        {
+            int i = local[k];
+            path_cache_store(ctx->cache, &sets[i], agent_ids[i], ok[i], out_paths[i]);
+        }
+    }
 
-    path_reserve(out_path, response.path_length);
-    out_path->length = response.path_length;
-    for (int i = 0; i < response.path_length; ++i)
+    if (outstanding > 0)
     {
-        out_path->steps[i].x = path_buffer[i * 2];
-        out_path->steps[i].y = path_buffer[i * 2 + 1];
+        int world_rank = 0;
+        MPI_Comm_rank(solver_comm, &world_rank);
+        double ll_start = MPI_Wtime();
+        LOG_DEBUG("[LL req %d] %d request(s) -> manager %d\n", world_rank, outstanding, ctx->manager_world_rank);
+        for (int received = 0; received < outstanding; ++received)
+        {
+            double wait_start = profile_start();
+            int id = receive_response(out_paths, ok, count);
+            profile_stop(PROFILE_LL_WAIT, wait_start);
+            if (ctx->cache != NULL)
+            {
+                path_cache_store(ctx->cache, &sets[id], agent_ids[id], ok[id], out_paths[id]);
+            }
+            LOG_TRACE("[LL resp %d] agent=%d status=%s len=%d\n",
+                      world_rank, agent_ids[id], ok[id] ? "ok" : "fail", ok[id] ? out_paths[id]->length : 0);
+        }
+        LOG_DEBUG("[LL req %d] received %d response(s) in %.3fs\n", world_rank, outstanding, MPI_Wtime() - ll_start);
     }
 
-    free(path_buffer);
-    return true;
+    bool all_ok = true;
+    for (int i = 0; i < count; ++i)
+    {
+        all_ok = all_ok && ok[i];
+        constraint_set_free(&sets[i]);
+    }
+    free(sets);
+    free(local);
+    if (ok != out_ok)
+    {
+        free(ok);
+    }
+    return all_ok;
+}
+
+/*
+Plan one agent of a CT node, locally or through the low-level pool.
+Results are looked up in the rank's PathCache first, so a hit never
+runs a search or leaves the rank.
+
+@param instance Pointer to the ProblemInstance
+@param node Pointer to the HighLevelNode whose constraint chain applies
+@param agent_id ID of the agent to plan
+@param ctx Pointer to the LowLevelContext
+@param out_path Pointer to the AgentPath to store the found path
+@return true if a path is found, false otherwise
+*/
+bool low_level_request_path(const ProblemInstance *instance,
+                            const HighLevelNode *node,
+                            int agent_id,
+                            const LowLevelContext *ctx,
+                            AgentPath *out_path)
+{
+    return low_level_request_paths(instance, &node, &agent_id, 1, ctx, &out_path, NULL);
 }
 
 void low_level_request_shutdown(const LowLevelContext *ctx)
@@ -169,136 +433,430 @@ void low_level_request_shutdown(const LowLevelContext *ctx)
                               .start_y = 0,
                               .goal_x = 0,
                               .goal_y = 0,
-                              .constraint_count = 0};
-    MPI_Send(&header, sizeof(header) / sizeof(int), MPI_INT, ctx->manager_world_rank, TAG_LL_REQUEST, MPI_COMM_WORLD);
+                              .constraint_count = 0,
+                              .request_id = 0};
+    MPI_Send(&header, sizeof(header) / sizeof(int), MPI_INT, ctx->manager_world_rank, TAG_LL_REQUEST, solver_comm);
 }
 
-void low_level_service_loop(const ProblemInstance *instance, const LowLevelContext *ctx)
+/*
+Give the context a pool of threads with one search workspace each, used
+to plan the local requests of a batch concurrently. A count of 1 (or a
+build without threading) keeps planning on the calling thread.
+
+@param ctx Pointer to the LowLevelContext
+@param thread_count Number of threads including the caller
+*/
+void low_level_threads_init(LowLevelContext *ctx, int thread_count)
 {
-    if (ctx->pool_comm == MPI_COMM_NULL)
+    ctx->threads = NULL;
+    ctx->thread_workspaces = NULL;
+    ThreadPool *threads = (ThreadPool *)malloc(sizeof(ThreadPool));
+    if (!threads)
+    {
+        fprintf(stderr, "low_level_threads_init: failed to allocate thread pool\n");
+        exit(EXIT_FAILURE);
+    }
+    thread_pool_init(threads, thread_count);
+    if (threads->thread_count == 1)
     {
+        thread_pool_free(threads);
+        free(threads);
         return;
     }
+    ctx->thread_workspaces = (AStarWorkspace *)malloc(sizeof(AStarWorkspace) * (size_t)threads->thread_count);
+    if (!ctx->thread_workspaces)
+    {
+        fprintf(stderr, "low_level_threads_init: failed to allocate workspaces (threads=%d)\n", threads->thread_count);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < threads->thread_count; ++i)
+    {
+        a_star_workspace_init(&ctx->thread_workspaces[i]);
+    }
+    ctx->threads = threads;
+}
+
+/*
+Stop the context's threads and free their workspaces
+
+@param ctx Pointer to the LowLevelContext
+*/
+void low_level_threads_free(LowLevelContext *ctx)
+{
+    if (ctx->threads == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < ctx->threads->thread_count; ++i)
+    {
+        a_star_workspace_free(&ctx->thread_workspaces[i]);
+    }
+    free(ctx->thread_workspaces);
+    thread_pool_free(ctx->threads);
+    free(ctx->threads);
+    ctx->threads = NULL;
+    ctx->thread_workspaces = NULL;
+}
 
+/* Ints before the constraints of a job: kind, requesting world rank, request header */
+#define LL_JOB_HEADER_INTS (2 + (int)(sizeof(LLRequestHeader) / sizeof(int)))
+
+/* Work the pool manager hands to another pool rank */
+typedef enum
+{
+    /** Plan one request alone and answer the requester directly */
+    LL_JOB_SINGLE = 0,
+    /** Plan one request together with the whole pool (parallel engine) */
+    LL_JOB_SPLIT = 1,
+    /** Leave the service loop */
+    LL_JOB_SHUTDOWN = 2
+} LowLevelJobKind;
+
+/*
+Request waiting in the manager's queue, in job layout: LL_JOB_HEADER_INTS
+ints followed by the constraints
+*/
+typedef struct
+{
+    int *job;
+    int ints;
+} QueuedRequest;
+
+/*
+Answer a requester with the status and path of one request
+
+@param dest World rank of the requester
+@param request_id Request id from the request header
+@param success Whether a path was found
+@param path Pointer to the found path
+*/
+static void send_response(int dest, int request_id, bool success, const AgentPath *path)
+{
+    int path_length = success ? path->length : 0;
+    int header_ints = (int)(sizeof(LLResponseHeader) / sizeof(int));
+    int ints = header_ints + path_length;
+    int *buffer = (int *)malloc(sizeof(int) * (size_t)ints);
+    if (!buffer)
+    {
+        fprintf(stderr, "send_response: failed to allocate response buffer (ints=%d)\n", ints);
+        exit(EXIT_FAILURE);
+    }
+    LLResponseHeader response = {.request_id = request_id, .status = success ? 1 : 0, .path_length = path_length};
+    memcpy(buffer, &response, sizeof(response));
+    if (path_length > 0)
+    {
+        memcpy(buffer + header_ints, path->steps, sizeof(int) * (size_t)path_length);
+    }
+    MPI_Send(buffer, ints, MPI_INT, dest, TAG_LL_RESPONSE, solver_comm);
+    free(buffer);
+}
+
+/*
+Plan the request of a job and answer its requester
+
+@param instance Pointer to the ProblemInstance
+@param ctx Pointer to the LowLevelContext
+@param job Job in LL_JOB_HEADER_INTS + constraints layout
+@param split Whether the whole pool plans the request together over search_comm
+@param search_comm Communicator of split searches
+@param workspace Search memory of this rank
+@param respond Whether this rank answers the requester
+*/
+static void serve_job(const ProblemInstance *instance,
+                      const LowLevelContext *ctx,
+                      const int *job,
+                      bool split,
+                      MPI_Comm search_comm,
+                      AStarWorkspace *workspace,
+                      bool respond)
+{
     int pool_rank = 0;
     MPI_Comm_rank(ctx->pool_comm, &pool_rank);
-    int world_rank = 0;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    int request_source = job[1];
+    LLRequestHeader header;
+    memcpy(&header, job + 2, sizeof(header));
+
+    ConstraintSet agent_constraints;
+    constraint_set_init(&agent_constraints, header.constraint_count);
+    fill_constraint_set(&agent_constraints, job + LL_JOB_HEADER_INTS, header.constraint_count);
+
+    AgentPath path;
+    path_init(&path, 0);
+    double path_compute_start = MPI_Wtime();
+    LOG_TRACE("[LL pool %d] Computing path for agent=%d from %d with %d constraints (%s%s)\n",
+              pool_rank, header.agent_id, request_source, header.constraint_count,
+              low_level_engine_name(ctx->engine), split ? ", whole pool" : "");
+    // a request served by one rank alone runs the sequential search of the parallel engine
+    bool success = plan_with_engine(instance,
+                                    &agent_constraints,
+                                    (GridCoord){.x = header.start_x, .y = header.start_y},
+                                    (GridCoord){.x = header.goal_x, .y = header.goal_y},
+                                    header.agent_id,
+                                    ctx->engine,
+                                    split ? search_comm : MPI_COMM_NULL,
+                                    workspace,
+                                    &path);
+    LOG_DEBUG("[LL pool %d] Path computation %s for agent=%d in %.3fs\n",
+              pool_rank, success ? "SUCCESS" : "FAILED", header.agent_id, MPI_Wtime() - path_compute_start);
+
+    if (respond)
+    {
+        send_response(request_source, header.request_id, success, &path);
+    }
+    path_free(&path);
+    constraint_set_free(&agent_constraints);
+}
+
+/*
+Receive a request header and its constraints from a requester into job layout
 
-    int running = 1;
-    while (running)
+@param source World rank of the requester
+@param header Request header already received from source
+@param out_request Output queued request
+*/
+static void read_request(int source, const LLRequestHeader *header, QueuedRequest *out_request)
+{
+    int constraint_entries = header->constraint_count * LL_CONSTRAINT_INTS;
+    out_request->ints = LL_JOB_HEADER_INTS + constraint_entries;
+    out_request->job = (int *)malloc(sizeof(int) * (size_t)out_request->ints);
+    if (!out_request->job)
     {
-        LLRequestHeader header;
-        int request_source = MPI_PROC_NULL;
+        fprintf(stderr, "read_request: failed to allocate request (ints=%d)\n", out_request->ints);
+        exit(EXIT_FAILURE);
+    }
+    out_request->job[0] = LL_JOB_SINGLE;
+    out_request->job[1] = source;
+    memcpy(out_request->job + 2, header, sizeof(*header));
+    if (constraint_entries > 0)
+    {
+        MPI_Recv(out_request->job + LL_JOB_HEADER_INTS,
+                 constraint_entries,
+                 MPI_INT,
+                 source,
+                 TAG_LL_REQUEST,
+                 solver_comm,
+                 MPI_STATUS_IGNORE);
+    }
+}
 
-        if (pool_rank == 0)
+/*
+Scheduling loop of pool rank 0. Requests from every expander are queued
+and handed to idle pool ranks as independent searches, which answer the
+requester themselves; the manager plans one itself when the rest of the
+pool is busy. A lone request that finds the whole pool idle is planned
+by all pool ranks together when the engine is parallel.
+
+@param instance Pointer to the ProblemInstance
+@param ctx Pointer to the LowLevelContext
+@param search_comm Communicator of split searches
+@param workspace Search memory of this rank
+*/
+static void manager_loop(const ProblemInstance *instance,
+                         const LowLevelContext *ctx,
+                         MPI_Comm search_comm,
+                         AStarWorkspace *workspace)
+{
+    int pool_size = 1;
+    MPI_Comm_size(ctx->pool_comm, &pool_size);
+    int world_rank = 0;
+    MPI_Comm_rank(solver_comm, &world_rank);
+
+    bool *busy = (bool *)calloc((size_t)pool_size, sizeof(bool));
+    if (!busy)
+    {
+        fprintf(stderr, "manager_loop: failed to allocate pool state (ranks=%d)\n", pool_size);
+        exit(EXIT_FAILURE);
+    }
+    int busy_count = 0;
+    QueuedRequest *queue = NULL;
+    int queue_head = 0;
+    int queue_count = 0;
+    int queue_capacity = 0;
+    bool shutdown = false;
+    long long served_alone = 0;
+    long long served_split = 0;
+
+    while (!shutdown || queue_count > 0 || busy_count > 0)
+    {
+        // requests and completions both arrive on solver_comm, so with nothing queued one probe waits for either
+        if (queue_count == 0)
         {
             MPI_Status status;
-            MPI_Recv(&header,
-                     sizeof(header) / sizeof(int),
-                     MPI_INT,
-                     MPI_ANY_SOURCE,
-                     TAG_LL_REQUEST,
-                     MPI_COMM_WORLD,
-                     &status);
-            request_source = status.MPI_SOURCE;
-            printf("[LL mgr world %d pool %d] recv request from %d agent=%d constraints=%d\n",
-                   world_rank,
-                   pool_rank,
-                   request_source,
-                   header.agent_id,
-                   header.constraint_count);
-            fflush(stdout);
-            double mgr_recv_time = MPI_Wtime();
+            double idle_start = profile_start();
+            MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, solver_comm, &status);
+            profile_stop(PROFILE_IDLE, idle_start);
         }
 
-        MPI_Bcast(&request_source, 1, MPI_INT, 0, ctx->pool_comm);
-        MPI_Bcast(&header, sizeof(header) / sizeof(int), MPI_INT, 0, ctx->pool_comm);
+        int flag = 0;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_LL_REQUEST, solver_comm, &flag, &status);
+        while (flag)
+        {
+            LLRequestHeader header;
+            MPI_Recv(&header, sizeof(header) / sizeof(int), MPI_INT, status.MPI_SOURCE, TAG_LL_REQUEST, solver_comm, MPI_STATUS_IGNORE);
+            if (header.agent_id < 0)
+            {
+                shutdown = true;
+            }
+            else
+            {
+                if (queue_count >= queue_capacity)
+                {
+                    int new_cap = queue_capacity == 0 ? 16 : queue_capacity * 2;
+                    QueuedRequest *grown = (QueuedRequest *)malloc(sizeof(QueuedRequest) * (size_t)new_cap);
+                    if (!grown)
+                    {
+                        fprintf(stderr, "manager_loop: failed to allocate request queue (size=%d)\n", new_cap);
+                        exit(EXIT_FAILURE);
+                    }
+                    for (int i = 0; i < queue_count; ++i)
+                    {
+                        grown[i] = queue[(queue_head + i) % queue_capacity];
+                    }
+                    free(queue);
+                    queue = grown;
+                    queue_head = 0;
+                    queue_capacity = new_cap;
+                }
+                read_request(status.MPI_SOURCE, &header, &queue[(queue_head + queue_count) % queue_capacity]);
+                queue_count++;
+                LOG_TRACE("[LL mgr world %d] recv request from %d agent=%d constraints=%d (queued=%d busy=%d)\n",
+                          world_rank, status.MPI_SOURCE, header.agent_id, header.constraint_count, queue_count, busy_count);
+            }
+            MPI_Iprobe(MPI_ANY_SOURCE, TAG_LL_REQUEST, solver_comm, &flag, &status);
+        }
 
-        if (header.agent_id < 0)
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_LL_DONE, solver_comm, &flag, &status);
+        while (flag)
         {
-            running = 0;
-            continue;
+            int pool_rank = 0;
+            MPI_Recv(&pool_rank, 1, MPI_INT, status.MPI_SOURCE, TAG_LL_DONE, solver_comm, MPI_STATUS_IGNORE);
+            busy[pool_rank] = false;
+            busy_count--;
+            MPI_Iprobe(MPI_ANY_SOURCE, TAG_LL_DONE, solver_comm, &flag, &status);
         }
 
-        int constraint_entries = header.constraint_count * 7;
-        int *constraint_buffer = NULL;
-        if (pool_rank == 0 && constraint_entries > 0)
+        if (queue_count == 0)
         {
-            constraint_buffer = (int *)malloc(sizeof(int) * (size_t)constraint_entries);
-            MPI_Recv(constraint_buffer,
-                     constraint_entries,
-                     MPI_INT,
-                     request_source,
-                     TAG_LL_REQUEST,
-                     MPI_COMM_WORLD,
-                     MPI_STATUS_IGNORE);
+            continue;
         }
 
-        if (constraint_entries > 0)
+        // a shallow queue lets the whole pool work on one search
+        if (queue_count == 1 && busy_count == 0 && pool_size > 1 && ctx->engine == LL_ENGINE_PARALLEL)
         {
-            if (pool_rank != 0)
+            QueuedRequest *request = &queue[queue_head];
+            request->job[0] = LL_JOB_SPLIT;
+            for (int r = 1; r < pool_size; ++r)
             {
-                constraint_buffer = (int *)malloc(sizeof(int) * (size_t)constraint_entries);
+                MPI_Send(request->job, request->ints, MPI_INT, r, TAG_LL_REQUEST, ctx->pool_comm);
             }
-            MPI_Bcast(constraint_buffer, constraint_entries, MPI_INT, 0, ctx->pool_comm);
+            serve_job(instance, ctx, request->job, true, search_comm, workspace, true);
+            free(request->job);
+            queue_head = (queue_head + 1) % queue_capacity;
+            queue_count--;
+            served_split++;
+            continue;
         }
 
-        ConstraintSet agent_constraints;
-        constraint_set_init(&agent_constraints, header.constraint_count);
-        if (constraint_entries > 0 && constraint_buffer != NULL)
+        for (int r = 1; r < pool_size && queue_count > 0; ++r)
+        {
+            if (busy[r])
+            {
+                continue;
+            }
+            QueuedRequest *request = &queue[queue_head];
+            MPI_Send(request->job, request->ints, MPI_INT, r, TAG_LL_REQUEST, ctx->pool_comm);
+            free(request->job);
+            queue_head = (queue_head + 1) % queue_capacity;
+            queue_count--;
+            busy[r] = true;
+            busy_count++;
+            served_alone++;
+        }
+        if (queue_count > 0 && busy_count == pool_size - 1)
         {
-            fill_constraint_set(&agent_constraints, constraint_buffer, header.constraint_count);
+            QueuedRequest *request = &queue[queue_head];
+            serve_job(instance, ctx, request->job, false, search_comm, workspace, true);
+            free(request->job);
+            queue_head = (queue_head + 1) % queue_capacity;
+            queue_count--;
+            served_alone++;
         }
+    }
+
+    int job[LL_JOB_HEADER_INTS] = {LL_JOB_SHUTDOWN};
+    for (int r = 1; r < pool_size; ++r)
+    {
+        MPI_Send(job, LL_JOB_HEADER_INTS, MPI_INT, r, TAG_LL_REQUEST, ctx->pool_comm);
+    }
+    LOG_INFO("[LL mgr world %d] served %lld request(s) on single ranks and %lld across the pool\n",
+             world_rank, served_alone, served_split);
+    free(queue);
+    free(busy);
+}
 
-        AgentPath path;
-        path_init(&path, 0);
-        double path_compute_start = MPI_Wtime();
-        printf("[LL pool %d] Computing path for agent=%d with %d constraints\n",
-               pool_rank, header.agent_id, header.constraint_count);
-        fflush(stdout);
-        bool success = parallel_a_star(&instance->map,
-                                       &agent_constraints,
-                                       (GridCoord){.x = header.start_x, .y = header.start_y},
-                                       (GridCoord){.x = header.goal_x, .y = header.goal_y},
-                                       header.agent_id,
-                                       ctx->pool_comm,
-                                       &path);
-
-        double path_compute_end = MPI_Wtime();
-        printf("[LL pool %d] Path computation %s for agent=%d in %.3fs\n",
-               pool_rank, success ? "SUCCESS" : "FAILED", header.agent_id, path_compute_end - path_compute_start);
-        fflush(stdout);
-        if (pool_rank == 0)
+void low_level_service_loop(const ProblemInstance *instance, const LowLevelContext *ctx)
+{
+    if (ctx->pool_comm == MPI_COMM_NULL)
+    {
+        return;
+    }
+
+    int pool_rank = 0;
+    MPI_Comm_rank(ctx->pool_comm, &pool_rank);
+
+    // one workspace serves every request handled by this pool rank
+    AStarWorkspace workspace;
+    a_star_workspace_init(&workspace);
+    // searches split across the pool get their own communicator so they never match job messages
+    MPI_Comm search_comm = MPI_COMM_NULL;
+    MPI_Comm_dup(ctx->pool_comm, &search_comm);
+
+    if (pool_rank == 0)
+    {
+        manager_loop(instance, ctx, search_comm, &workspace);
+    }
+    else
+    {
+        int *job = NULL;
+        int job_capacity = 0;
+        while (1)
         {
-            LLResponseHeader response = {.status = success ? 1 : 0, .path_length = success ? path.length : 0};
-            MPI_Send(&response, sizeof(response) / sizeof(int), MPI_INT, request_source, TAG_LL_RESPONSE, MPI_COMM_WORLD);
-            if (success && path.length > 0)
+            MPI_Status status;
+            double idle_start = profile_start();
+            MPI_Probe(0, TAG_LL_REQUEST, ctx->pool_comm, &status);
+            profile_stop(PROFILE_IDLE, idle_start);
+            int ints = 0;
+            MPI_Get_count(&status, MPI_INT, &ints);
+            if (ints > job_capacity)
             {
-                int ints = path.length * 2;
-                int *buffer = (int *)malloc(sizeof(int) * (size_t)ints);
-                for (int i = 0; i < path.length; ++i)
+                free(job);
+                job = (int *)malloc(sizeof(int) * (size_t)ints);
+                if (!job)
                 {
-                    buffer[i * 2] = path.steps[i].x;
-                    buffer[i * 2 + 1] = path.steps[i].y;
+                    fprintf(stderr, "low_level_service_loop: failed to allocate job buffer (ints=%d)\n", ints);
+                    exit(EXIT_FAILURE);
                 }
-                MPI_Send(buffer, ints, MPI_INT, request_source, TAG_LL_RESPONSE, MPI_COMM_WORLD);
-                free(buffer);
+                job_capacity = ints;
+            }
+            MPI_Recv(job, ints, MPI_INT, 0, TAG_LL_REQUEST, ctx->pool_comm, MPI_STATUS_IGNORE);
+            if (job[0] == LL_JOB_SHUTDOWN)
+            {
+                break;
+            }
+            bool split = job[0] == LL_JOB_SPLIT;
+            serve_job(instance, ctx, job, split, search_comm, &workspace, !split);
+            if (!split)
+            {
+                MPI_Send(&pool_rank, 1, MPI_INT, ctx->manager_world_rank, TAG_LL_DONE, solver_comm);
             }
-            printf("[LL mgr world %d] send response to %d agent=%d status=%d len=%d\n",
-                   world_rank,
-                   request_source,
-                   header.agent_id,
-                   success ? 1 : 0,
-                   success ? path.length : 0);
-            fflush(stdout);
         }
-
-        path_free(&path);
-        constraint_set_free(&agent_constraints);
-        free(constraint_buffer);
+        free(job);
     }
 
+    MPI_Comm_free(&search_comm);
+    a_star_workspace_free(&workspace);
+
     /* Ensure all ranks exit together */
     int dummy = 0;
     MPI_Bcast(&dummy, 1, MPI_INT, 0, ctx->pool_comm);
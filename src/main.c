@@ -1,6 +1,8 @@
 #include "coordinator.h"
 #include "instance_io.h"
+#include "log.h"
 #include "low_level.h"
+#include "profile.h"
 #include "worker.h"
 
 #include <mpi.h>
@@ -9,90 +11,11 @@
 #include <string.h>
 #include <unistd.h>
 
-static void broadcast_instance(ProblemInstance *instance, int root, MPI_Comm comm)
-{
-    // Get rank
-    int rank = 0;
-    MPI_Comm_rank(comm, &rank);
-
-    // Prepare header
-    int header[3] = {0, 0, 0};
-    // Fill header on root
-    if (rank == root)
-    {
-        header[0] = instance->map.width;
-        header[1] = instance->map.height;
-        header[2] = instance->num_agents;
-    }
-    // Broadcast header
-    MPI_Bcast(header, 3, MPI_INT, root, comm);
-
-    int width = header[0];
-    int height = header[1];
-    int agents = header[2];
-
-    // Allocate on non-root ranks
-    if (rank != root)
-    {
-        // Initialize problem instance and grid
-        problem_instance_init(instance, agents);
-        grid_init(&instance->map, width, height);
-    }
-
-    // Broadcast grid cells
-    size_t cell_count = (size_t)width * (size_t)height;
-    if (cell_count > 0)
-    {
-        MPI_Bcast(instance->map.cells, (int)cell_count, MPI_UNSIGNED_CHAR, root, comm);
-    }
-
-    // Broadcast agent start and goal positions
-    if (agents > 0)
-    {
-        int *buffer = (int *)malloc(sizeof(int) * (size_t)agents * 2);
-        if (rank == root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                buffer[i * 2] = instance->starts[i].x;
-                buffer[i * 2 + 1] = instance->starts[i].y;
-            }
-        }
-        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
-        if (rank != root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                instance->starts[i].x = buffer[i * 2];
-                instance->starts[i].y = buffer[i * 2 + 1];
-            }
-        }
-
-        if (rank == root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                buffer[i * 2] = instance->goals[i].x;
-                buffer[i * 2 + 1] = instance->goals[i].y;
-            }
-        }
-        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
-        if (rank != root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                instance->goals[i].x = buffer[i * 2];
-                instance->goals[i].y = buffer[i * 2 + 1];
-            }
-        }
-        free(buffer);
-    }
-}
-
 int main(int argc, char **argv)
 {
     // Initialize MPI
-    MPI_Init(&argc, &argv);
+    int thread_support = MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
 
     int world_rank = 0;
     int world_size = 0;
@@ -102,10 +25,24 @@ int main(int argc, char **argv)
 
     const char *map_path = NULL;
     const char *agents_path = NULL;
+    const char *instance_path = NULL;
+    AgentSelection selection;
+    agent_selection_init(&selection);
     int expanders = -1;
     int low_level_pool = -1;
     double timeout_seconds = 0.0;
     const char *csv_path = "results.csv";
+    LowLevelEngine engine = LL_ENGINE_PARALLEL;
+    bool engine_ok = true;
+    int log_level = LOG_LEVEL_INFO;
+    bool log_ok = true;
+    const char *profile_prefix = NULL;
+    double cache_mb = 64.0;
+    double open_mb = 0.0;
+    double suboptimality = 1.0;
+    int inflight_depth = COORDINATOR_DEFAULT_INFLIGHT;
+    bool resident_nodes = false;
+    int thread_count = 1;
 
     // Parse arguments
     for (int i = 1; i < argc; ++i)
@@ -118,6 +55,22 @@ int main(int argc, char **argv)
         {
             agents_path = argv[++i];
         }
+        else if (strcmp(argv[i], "--instance") == 0 && i + 1 < argc)
+        {
+            instance_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--scen-bucket") == 0 && i + 1 < argc)
+        {
+            selection.bucket = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--num-agents") == 0 && i + 1 < argc)
+        {
+            selection.count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--agent-offset") == 0 && i + 1 < argc)
+        {
+            selection.offset = atoi(argv[++i]);
+        }
         else if (strcmp(argv[i], "--expanders") == 0 && i + 1 < argc)
         {
             expanders = atoi(argv[++i]);
@@ -134,15 +87,75 @@ int main(int argc, char **argv)
         {
             csv_path = argv[++i];
         }
+        else if (strcmp(argv[i], "--low-level") == 0 && i + 1 < argc)
+        {
+            engine_ok = low_level_engine_parse(argv[++i], &engine) && engine_ok;
+        }
+        else if (strcmp(argv[i], "--inflight") == 0 && i + 1 < argc)
+        {
+            inflight_depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+        {
+            log_ok = log_level_parse(argv[++i], &log_level) && log_ok;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            thread_count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--resident-nodes") == 0)
+        {
+            resident_nodes = true;
+        }
+        else if (strcmp(argv[i], "--ll-cache-mb") == 0 && i + 1 < argc)
+        {
+            cache_mb = atof(argv[++i]);
+            if (cache_mb < 0.0)
+            {
+                cache_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--w") == 0 && i + 1 < argc)
+        {
+            suboptimality = atof(argv[++i]);
+            if (suboptimality < 1.0)
+            {
+                suboptimality = 1.0;
+            }
+        }
+        else if (strcmp(argv[i], "--open-mem-mb") == 0 && i + 1 < argc)
+        {
+            open_mb = atof(argv[++i]);
+            if (open_mb < 0.0)
+            {
+                open_mb = 0.0;
+            }
+        }
     }
+    log_init(log_level);
+    profile_init(profile_prefix != NULL);
 
     int config_ok = 1;
     // Validate configuration on rank 0
     if (world_rank == 0)
     {
-        if (!map_path || !agents_path)
+        if (!instance_path && (!map_path || !agents_path))
+        {
+            fprintf(stderr, "Usage: mpirun -n <procs> parallel_cbs (--map map --agents scen [--scen-bucket B] [--num-agents N] [--agent-offset K] | --instance packed) [--expanders N] [--ll-pool M] [--timeout SEC] [--csv path] [--low-level astar|sipp|parallel] [--ll-cache-mb MB] [--open-mem-mb MB] [--w bound] [--inflight N] [--resident-nodes] [--threads N] [--log-level error|info|debug|trace] [--profile prefix]\n");
+            config_ok = 0;
+        }
+        if (!engine_ok)
+        {
+            fprintf(stderr, "Unknown --low-level engine (expected astar, sipp or parallel).\n");
+            config_ok = 0;
+        }
+        if (!log_ok)
         {
-            fprintf(stderr, "Usage: mpirun -n <procs> parallel_cbs --map map.txt --agents agents.txt [--expanders N] [--ll-pool M] [--timeout SEC] [--csv path]\n");
+            fprintf(stderr, "Unknown --log-level (expected error, info, debug or trace).\n");
             config_ok = 0;
         }
         if (world_size < 2)
@@ -164,7 +177,9 @@ int main(int argc, char **argv)
     int load_success = 1;
     if (world_rank == 0)
     {
-        if (!load_problem_instance(map_path, agents_path, &instance))
+        bool loaded = instance_path ? load_packed_instance(instance_path, &instance)
+                                    : load_problem_instance(map_path, agents_path, &selection, &instance);
+        if (!loaded)
         {
             fprintf(stderr, "Failed to load problem instance.\n");
             load_success = 0;
@@ -177,7 +192,7 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    broadcast_instance(&instance, 0, MPI_COMM_WORLD);
+    broadcast_problem_instance(&instance, 0, MPI_COMM_WORLD);
 
     if (world_rank == 0)
     {
@@ -220,6 +235,31 @@ int main(int argc, char **argv)
     LowLevelContext ll_ctx;
     ll_ctx.manager_world_rank = manager_rank;
     ll_ctx.pool_comm = MPI_COMM_NULL;
+    ll_ctx.engine = engine;
+    ll_ctx.workspace = NULL;
+    if (thread_count > 1 && thread_support < MPI_THREAD_FUNNELED)
+    {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "Warning: MPI does not support threads, running with --threads 1.\n");
+        }
+        thread_count = 1;
+    }
+    if (resident_nodes && suboptimality > 1.0)
+    {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "Warning: --w is not supported with --resident-nodes, running with --w 1.\n");
+        }
+        suboptimality = 1.0;
+    }
+    // the coordinator plans the root and expanders replan children on these threads
+    low_level_threads_init(&ll_ctx, thread_count);
+
+    // each expander caches its own low-level results
+    PathCache cache;
+    path_cache_init(&cache, (size_t)(cache_mb * 1024.0 * 1024.0));
+    ll_ctx.cache = &cache;
 
     MPI_Comm pool_comm = MPI_COMM_NULL;
     int color = (low_level_pool > 0 && world_rank >= pool_start && world_rank < pool_end) ? 1 : MPI_UNDEFINED;
@@ -242,13 +282,43 @@ int main(int argc, char **argv)
     }
 
     RunStats stats;
+    memset(&stats, 0, sizeof(RunStats));
     if (world_rank == 0)
     {
-        run_coordinator(&instance, &ll_ctx, &workers, timeout_seconds, &stats);
+        run_coordinator(&instance,
+                        &ll_ctx,
+                        &workers,
+                        inflight_depth,
+                        resident_nodes,
+                        (size_t)(open_mb * 1024.0 * 1024.0),
+                        suboptimality,
+                        timeout_seconds,
+                        &stats);
         low_level_request_shutdown(&ll_ctx);
+    }
+    else if (world_rank >= 1 && world_rank < 1 + worker_count)
+    {
+        run_worker(&instance, &ll_ctx, 0, resident_nodes);
+    }
+    else if (low_level_pool > 0 && world_rank >= pool_start && world_rank < pool_end)
+    {
+        low_level_service_loop(&instance, &ll_ctx);
+    }
+
+    long long cache_counts[2] = {cache.hits, cache.misses};
+    long long cache_totals[2] = {0, 0};
+    MPI_Reduce(cache_counts, cache_totals, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    path_cache_free(&cache);
+    low_level_threads_free(&ll_ctx);
 
-        const char *map_name = map_path ? strrchr(map_path, '/') : NULL;
-        map_name = map_name ? map_name + 1 : map_path ? map_path : "unknown";
+    if (world_rank == 0)
+    {
+        stats.ll_cache_hits = cache_totals[0];
+        stats.ll_cache_misses = cache_totals[1];
+
+        const char *source_path = instance_path ? instance_path : map_path;
+        const char *map_name = source_path ? strrchr(source_path, '/') : NULL;
+        map_name = map_name ? map_name + 1 : source_path ? source_path : "unknown";
         FILE *fp = NULL;
         int need_header = access(csv_path, F_OK) != 0;
         fp = fopen(csv_path, "a");
@@ -256,12 +326,14 @@ int main(int argc, char **argv)
         {
             if (need_header)
             {
-                fprintf(fp, "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,timeout_sec,status\n");
+                fprintf(fp, "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,ll_cache_hits,ll_cache_misses,open_peak_resident,open_compressed,open_spilled,w,lower_bound,suboptimality,timeout_sec,status\n");
             }
             const char *status = stats.solution_found ? "success" : (stats.timed_out ? "timeout" : "failure");
             double cost_out = stats.solution_found ? stats.best_cost : -1.0;
+            double lower_bound_out = stats.lower_bound < DBL_MAX / 2.0 ? stats.lower_bound : -1.0;
+            double achieved = stats.solution_found ? achieved_suboptimality(stats.best_cost, stats.lower_bound) : -1.0;
             fprintf(fp,
-                    "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%.2f,%s\n",
+                    "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%lld,%lld,%lld,%lld,%lld,%.2f,%.0f,%.4f,%.2f,%s\n",
                     map_name,
                     instance.num_agents,
                     instance.map.width,
@@ -271,6 +343,14 @@ int main(int argc, char **argv)
                     stats.conflicts_detected,
                     cost_out,
                     stats.runtime_sec,
+                    stats.ll_cache_hits,
+                    stats.ll_cache_misses,
+                    stats.open_peak_resident,
+                    stats.open_compressed,
+                    stats.open_spilled,
+                    suboptimality,
+                    lower_bound_out,
+                    achieved,
                     timeout_seconds,
                     status);
             fclose(fp);
@@ -280,14 +360,6 @@ int main(int argc, char **argv)
             fprintf(stderr, "Warning: could not open CSV file %s for writing.\n", csv_path);
         }
     }
-    else if (world_rank >= 1 && world_rank < 1 + worker_count)
-    {
-        run_worker(&instance, &ll_ctx, 0);
-    }
-    else if (low_level_pool > 0 && world_rank >= pool_start && world_rank < pool_end)
-    {
-        low_level_service_loop(&instance, &ll_ctx);
-    }
 
     if (pool_comm != MPI_COMM_NULL)
     {
@@ -297,6 +369,13 @@ int main(int argc, char **argv)
     problem_instance_free(&instance);
     free(workers.ranks);
 
+    if (profile_prefix)
+    {
+        const char *role = world_rank == 0 ? "coordinator" : (world_rank < 1 + worker_count ? "worker" : "ll_pool");
+        profile_write(profile_prefix, role);
+    }
+
+    log_flush();
     MPI_Finalize();
     return 0;
 }
@@ -1,89 +1,97 @@
+#include "batch.h"
 #include "coordinator.h"
 #include "instance_io.h"
+#include "log.h"
 #include "low_level.h"
+#include "profile.h"
 #include "worker.h"
 
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
-static void broadcast_instance(ProblemInstance *instance, int root, MPI_Comm comm)
-{
-    int rank = 0;
-    MPI_Comm_rank(comm, &rank);
-
-    int header[3] = {0, 0, 0};
-    if (rank == root)
-    {
-        header[0] = instance->map.width;
-        header[1] = instance->map.height;
-        header[2] = instance->num_agents;
-    }
-    MPI_Bcast(header, 3, MPI_INT, root, comm);
+#define CENTRAL_CSV_HEADER "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,comm_time_sec,compute_time_sec,ll_cache_hits,ll_cache_misses,open_peak_resident,open_compressed,open_spilled,w,lower_bound,suboptimality,timeout_sec,status"
 
-    int width = header[0];
-    int height = header[1];
-    int agents = header[2];
+/*
+Append the result of one instance to the CSV file and print its summary line
 
-    if (rank != root)
+@param csv_path Path of the CSV file, its header is already written
+@param map_name File name of the instance's map
+@param instance Pointer to the solved ProblemInstance
+@param stats Pointer to the RunStats of the run
+@param suboptimality Suboptimality bound of the run
+@param timeout_seconds Timeout of the run
+*/
+static void report_result(const char *csv_path,
+                          const char *map_name,
+                          const ProblemInstance *instance,
+                          const RunStats *stats,
+                          double suboptimality,
+                          double timeout_seconds)
+{
+    FILE *fp = fopen(csv_path, "a");
+    const char *status = stats->solution_found ? "success" : (stats->timed_out ? "timeout" : "failure");
+    double cost_out = stats->solution_found ? stats->best_cost : -1.0;
+    double lower_bound_out = stats->lower_bound < DBL_MAX / 2.0 ? stats->lower_bound : -1.0;
+    double achieved = stats->solution_found ? achieved_suboptimality(stats->best_cost, stats->lower_bound) : -1.0;
+    if (fp)
     {
-        problem_instance_init(instance, agents);
-        grid_init(&instance->map, width, height);
+        fprintf(fp,
+                "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%.6f,%.6f,%lld,%lld,%lld,%lld,%lld,%.2f,%.0f,%.4f,%.2f,%s\n",
+                map_name,
+                instance->num_agents,
+                instance->map.width,
+                instance->map.height,
+                stats->nodes_expanded,
+                stats->nodes_generated,
+                stats->conflicts_detected,
+                cost_out,
+                stats->runtime_sec,
+                stats->comm_time_sec,
+                stats->compute_time_sec,
+                stats->ll_cache_hits,
+                stats->ll_cache_misses,
+                stats->open_peak_resident,
+                stats->open_compressed,
+                stats->open_spilled,
+                suboptimality,
+                lower_bound_out,
+                achieved,
+                timeout_seconds,
+                status);
+        fclose(fp);
     }
-
-    size_t cell_count = (size_t)width * (size_t)height;
-    if (cell_count > 0)
+    else
     {
-        MPI_Bcast(instance->map.cells, (int)cell_count, MPI_UNSIGNED_CHAR, root, comm);
+        fprintf(stderr, "Warning: could not open CSV file %s for writing.\n", csv_path);
     }
 
-    if (agents > 0)
-    {
-        int *buffer = (int *)malloc(sizeof(int) * (size_t)agents * 2);
-        if (rank == root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                buffer[i * 2] = instance->starts[i].x;
-                buffer[i * 2 + 1] = instance->starts[i].y;
-            }
-        }
-        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
-        if (rank != root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                instance->starts[i].x = buffer[i * 2];
-                instance->starts[i].y = buffer[i * 2 + 1];
-            }
-        }
-
-        if (rank == root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                buffer[i * 2] = instance->goals[i].x;
-                buffer[i * 2 + 1] = instance->goals[i].y;
-            }
-        }
-        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
-        if (rank != root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                instance->goals[i].x = buffer[i * 2];
-                instance->goals[i].y = buffer[i * 2 + 1];
-            }
-        }
-        free(buffer);
-    }
+    log_flush();
+    printf("[Central] Summary: status=%s cost=%.0f runtime=%.3fs comm=%.3fs compute=%.3fs "
+           "expanded=%lld generated=%lld conflicts=%lld ll_cache=%lld/%lld open_resident=%lld compressed=%lld spilled=%lld w=%.2f subopt=%.4f\n",
+           status,
+           cost_out,
+           stats->runtime_sec,
+           stats->comm_time_sec,
+           stats->compute_time_sec,
+           stats->nodes_expanded,
+           stats->nodes_generated,
+           stats->conflicts_detected,
+           stats->ll_cache_hits,
+           stats->ll_cache_hits + stats->ll_cache_misses,
+           stats->open_peak_resident,
+           stats->open_compressed,
+           stats->open_spilled,
+           suboptimality,
+           achieved);
+    fflush(stdout);
 }
 
 int main(int argc, char **argv)
 {
-    MPI_Init(&argc, &argv);
+    int thread_support = MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
 
     int world_rank = 0;
     int world_size = 0;
@@ -92,10 +100,27 @@ int main(int argc, char **argv)
 
     const char *map_path = NULL;
     const char *agents_path = NULL;
+    const char *instance_path = NULL;
+    const char *manifest_path = NULL;
+    double batch_cache_mb = BATCH_DEFAULT_CACHE_MB;
+    int batch_groups = 1;
+    AgentSelection selection;
+    agent_selection_init(&selection);
     int expanders = -1;
     int low_level_pool = -1; /* centralized version: choose LL pool based on world size if not specified */
     double timeout_seconds = 0.0;
     const char *csv_path = "results_central.csv";
+    LowLevelEngine engine = LL_ENGINE_PARALLEL;
+    bool engine_ok = true;
+    int log_level = LOG_LEVEL_INFO;
+    bool log_ok = true;
+    const char *profile_prefix = NULL;
+    double cache_mb = 64.0;
+    double open_mb = 0.0;
+    double suboptimality = 1.0;
+    int inflight_depth = COORDINATOR_DEFAULT_INFLIGHT;
+    bool resident_nodes = false;
+    int thread_count = 1;
 
     for (int i = 1; i < argc; ++i)
     {
@@ -107,6 +132,42 @@ int main(int argc, char **argv)
         {
             agents_path = argv[++i];
         }
+        else if (strcmp(argv[i], "--instance") == 0 && i + 1 < argc)
+        {
+            instance_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc)
+        {
+            manifest_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--batch-cache-mb") == 0 && i + 1 < argc)
+        {
+            batch_cache_mb = atof(argv[++i]);
+            if (batch_cache_mb < 0.0)
+            {
+                batch_cache_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--batch-groups") == 0 && i + 1 < argc)
+        {
+            batch_groups = atoi(argv[++i]);
+            if (batch_groups < 1)
+            {
+                batch_groups = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--scen-bucket") == 0 && i + 1 < argc)
+        {
+            selection.bucket = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--num-agents") == 0 && i + 1 < argc)
+        {
+            selection.count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--agent-offset") == 0 && i + 1 < argc)
+        {
+            selection.offset = atoi(argv[++i]);
+        }
         else if (strcmp(argv[i], "--expanders") == 0 && i + 1 < argc)
         {
             expanders = atoi(argv[++i]);
@@ -123,19 +184,80 @@ int main(int argc, char **argv)
         {
             csv_path = argv[++i];
         }
+        else if (strcmp(argv[i], "--low-level") == 0 && i + 1 < argc)
+        {
+            engine_ok = low_level_engine_parse(argv[++i], &engine) && engine_ok;
+        }
+        else if (strcmp(argv[i], "--inflight") == 0 && i + 1 < argc)
+        {
+            inflight_depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+        {
+            log_ok = log_level_parse(argv[++i], &log_level) && log_ok;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            thread_count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--resident-nodes") == 0)
+        {
+            resident_nodes = true;
+        }
+        else if (strcmp(argv[i], "--ll-cache-mb") == 0 && i + 1 < argc)
+        {
+            cache_mb = atof(argv[++i]);
+            if (cache_mb < 0.0)
+            {
+                cache_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--w") == 0 && i + 1 < argc)
+        {
+            suboptimality = atof(argv[++i]);
+            if (suboptimality < 1.0)
+            {
+                suboptimality = 1.0;
+            }
+        }
+        else if (strcmp(argv[i], "--open-mem-mb") == 0 && i + 1 < argc)
+        {
+            open_mb = atof(argv[++i]);
+            if (open_mb < 0.0)
+            {
+                open_mb = 0.0;
+            }
+        }
     }
+    log_init(log_level);
+    profile_init(profile_prefix != NULL);
 
     int config_ok = 1;
     if (world_rank == 0)
     {
-        if (!map_path || !agents_path)
+        if (!manifest_path && !instance_path && (!map_path || !agents_path))
+        {
+            fprintf(stderr, "Usage: mpirun -n <procs> central_cbs (--map map --agents scen [--scen-bucket B] [--num-agents N] [--agent-offset K] | --instance packed | --manifest file [--batch-groups G] [--batch-cache-mb MB]) [--expanders N] [--ll-pool M] [--timeout SEC] [--csv path] [--low-level astar|sipp|parallel] [--ll-cache-mb MB] [--open-mem-mb MB] [--w bound] [--inflight N] [--resident-nodes] [--threads N] [--log-level error|info|debug|trace] [--profile prefix]\n");
+            config_ok = 0;
+        }
+        if (!engine_ok)
+        {
+            fprintf(stderr, "Unknown --low-level engine (expected astar, sipp or parallel).\n");
+            config_ok = 0;
+        }
+        if (!log_ok)
         {
-            fprintf(stderr, "Usage: mpirun -n <procs> central_cbs --map map.txt --agents agents.txt [--expanders N] [--ll-pool M] [--timeout SEC] [--csv path]\n");
+            fprintf(stderr, "Unknown --log-level (expected error, info, debug or trace).\n");
             config_ok = 0;
         }
-        if (world_size < 2)
+        if (world_size < 2 * batch_groups)
         {
-            fprintf(stderr, "At least two MPI ranks are required.\n");
+            fprintf(stderr, "At least two MPI ranks per group are required (%d group(s), %d rank(s)).\n",
+                    batch_groups, world_size);
             config_ok = 0;
         }
     }
@@ -146,29 +268,42 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    ProblemInstance instance;
-    memset(&instance, 0, sizeof(ProblemInstance));
-    int load_success = 1;
-    if (world_rank == 0)
+    // a single instance is a batch of one, without tables kept for later instances
+    Manifest manifest;
+    manifest_init(&manifest);
+    int manifest_ok = 1;
+    if (manifest_path)
     {
-        if (!load_problem_instance(map_path, agents_path, &instance))
-        {
-            fprintf(stderr, "Failed to load problem instance.\n");
-            load_success = 0;
-        }
+        manifest_ok = manifest_load(manifest_path, &manifest) ? 1 : 0;
+    }
+    else
+    {
+        manifest_add(&manifest, map_path, agents_path, instance_path, &selection);
+        batch_cache_mb = 0.0;
     }
-    MPI_Bcast(&load_success, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    if (!load_success)
+    MPI_Allreduce(MPI_IN_PLACE, &manifest_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!manifest_ok)
     {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "Failed to load manifest %s.\n", manifest_path);
+        }
+        manifest_free(&manifest);
         MPI_Finalize();
         return 1;
     }
 
-    broadcast_instance(&instance, 0, MPI_COMM_WORLD);
+    // every group is a coordinator with its workers and pool, solving its share of the instances
+    int group = 0;
+    MPI_Comm group_comm = batch_group_comm(batch_groups, &group);
+    int rank = 0;
+    int group_size = 0;
+    MPI_Comm_rank(group_comm, &rank);
+    MPI_Comm_size(group_comm, &group_size);
 
-    if (world_rank == 0)
+    if (rank == 0)
     {
-        int available = world_size - 1;
+        int available = group_size - 1;
         /* By default, don't use ll-pool unless explicitly requested.
          * The LL pool adds communication overhead that may not help on smaller instances. */
         if (low_level_pool < 0)
@@ -188,27 +323,29 @@ int main(int argc, char **argv)
         if (expanders < 1) expanders = 1;
     }
 
-    MPI_Bcast(&expanders, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&low_level_pool, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&expanders, 1, MPI_INT, 0, group_comm);
+    MPI_Bcast(&low_level_pool, 1, MPI_INT, 0, group_comm);
 
     int layout_ok = 1;
-    if (world_rank == 0)
+    if (rank == 0)
     {
         int needed = 1 + expanders + low_level_pool;
-        if (needed > world_size)
+        if (needed > group_size)
         {
             fprintf(stderr,
                     "Requested expanders/pool exceed MPI ranks: need %d, have %d (expanders=%d, pool=%d)\n",
                     needed,
-                    world_size,
+                    group_size,
                     expanders,
                     low_level_pool);
             layout_ok = 0;
         }
     }
-    MPI_Bcast(&layout_ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &layout_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
     if (!layout_ok)
     {
+        MPI_Comm_free(&group_comm);
+        manifest_free(&manifest);
         MPI_Finalize();
         return 1;
     }
@@ -221,10 +358,30 @@ int main(int argc, char **argv)
     LowLevelContext ll_ctx;
     ll_ctx.manager_world_rank = manager_rank;
     ll_ctx.pool_comm = MPI_COMM_NULL;
+    ll_ctx.engine = engine;
+    ll_ctx.workspace = NULL;
+    if (thread_count > 1 && thread_support < MPI_THREAD_FUNNELED)
+    {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "Warning: MPI does not support threads, running with --threads 1.\n");
+        }
+        thread_count = 1;
+    }
+    if (resident_nodes && suboptimality > 1.0)
+    {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "Warning: --w is not supported with --resident-nodes, running with --w 1.\n");
+        }
+        suboptimality = 1.0;
+    }
+    // the coordinator plans the root and expanders replan children on these threads
+    low_level_threads_init(&ll_ctx, thread_count);
 
     MPI_Comm pool_comm = MPI_COMM_NULL;
-    int color = (low_level_pool > 0 && world_rank >= pool_start && world_rank < pool_end) ? 1 : MPI_UNDEFINED;
-    MPI_Comm_split(MPI_COMM_WORLD, color, world_rank, &pool_comm);
+    int color = (low_level_pool > 0 && rank >= pool_start && rank < pool_end) ? 1 : MPI_UNDEFINED;
+    MPI_Comm_split(group_comm, color, rank, &pool_comm);
     if (color == 1)
     {
         ll_ctx.pool_comm = pool_comm;
@@ -242,75 +399,117 @@ int main(int argc, char **argv)
         }
     }
 
-    RunStats stats;
     if (world_rank == 0)
     {
-        run_coordinator(&instance, &ll_ctx, &workers, timeout_seconds, &stats);
-        low_level_request_shutdown(&ll_ctx);
+        batch_csv_header(csv_path, CENTRAL_CSV_HEADER);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    InstanceCache loader;
+    instance_cache_init(&loader, (size_t)(batch_cache_mb * 1024.0 * 1024.0));
+    int failures = 0;
+    double batch_start = MPI_Wtime();
+    for (int entry = group; entry < manifest.count; entry += batch_groups)
+    {
+        // a fresh communicator per instance, so messages left over from one search never match the next
+        MPI_Comm_dup(group_comm, &solver_comm);
 
-        const char *map_name = map_path ? strrchr(map_path, '/') : NULL;
-        map_name = map_name ? map_name + 1 : map_path ? map_path : "unknown";
-        int need_header = access(csv_path, F_OK) != 0;
-        FILE *fp = fopen(csv_path, "a");
-        const char *status = stats.solution_found ? "success" : (stats.timed_out ? "timeout" : "failure");
-        double cost_out = stats.solution_found ? stats.best_cost : -1.0;
-        if (fp)
-        {
-            if (need_header)
+        ProblemInstance instance;
+        memset(&instance, 0, sizeof(ProblemInstance));
+        int load_success = 1;
+        if (rank == 0)
+        {
+            if (!instance_cache_load(&loader, &manifest.entries[entry], &instance))
             {
-                fprintf(fp, "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,comm_time_sec,compute_time_sec,timeout_sec,status\n");
+                fprintf(stderr, "Failed to load problem instance %d of %d.\n", entry + 1, manifest.count);
+                load_success = 0;
             }
-            fprintf(fp,
-                    "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%.6f,%.6f,%.2f,%s\n",
-                    map_name,
-                    instance.num_agents,
-                    instance.map.width,
-                    instance.map.height,
-                    stats.nodes_expanded,
-                    stats.nodes_generated,
-                    stats.conflicts_detected,
-                    cost_out,
-                    stats.runtime_sec,
-                    stats.comm_time_sec,
-                    stats.compute_time_sec,
-                    timeout_seconds,
-                    status);
-            fclose(fp);
-        }
-        else
-        {
-            fprintf(stderr, "Warning: could not open CSV file %s for writing.\n", csv_path);
+            else if (manifest_path)
+            {
+                LOG_INFO("[Central] Instance %d/%d on group %d: %s with %d agents\n", entry + 1, manifest.count, group,
+                         manifest_entry_name(&manifest.entries[entry]), instance.num_agents);
+            }
+        }
+        MPI_Bcast(&load_success, 1, MPI_INT, 0, solver_comm);
+        if (!load_success)
+        {
+            failures++;
+            MPI_Comm_free(&solver_comm);
+            continue;
         }
 
-        printf("[Central] Summary: status=%s cost=%.0f runtime=%.3fs comm=%.3fs compute=%.3fs "
-               "expanded=%lld generated=%lld conflicts=%lld\n",
-               status,
-               cost_out,
-               stats.runtime_sec,
-               stats.comm_time_sec,
-               stats.compute_time_sec,
-               stats.nodes_expanded,
-               stats.nodes_generated,
-               stats.conflicts_detected);
-        fflush(stdout);
-    }
-    else if (world_rank >= 1 && world_rank < 1 + worker_count)
-    {
-        run_worker(&instance, &ll_ctx, 0);
+        broadcast_problem_instance(&instance, 0, solver_comm);
+
+        // each expander caches its own low-level results, they only hold for this instance
+        PathCache cache;
+        path_cache_init(&cache, (size_t)(cache_mb * 1024.0 * 1024.0));
+        ll_ctx.cache = &cache;
+
+        RunStats stats;
+        memset(&stats, 0, sizeof(RunStats));
+        if (rank == 0)
+        {
+            run_coordinator(&instance,
+                            &ll_ctx,
+                            &workers,
+                            inflight_depth,
+                            resident_nodes,
+                            (size_t)(open_mb * 1024.0 * 1024.0),
+                            suboptimality,
+                            timeout_seconds,
+                            &stats);
+            low_level_request_shutdown(&ll_ctx);
+        }
+        else if (rank >= 1 && rank < 1 + worker_count)
+        {
+            run_worker(&instance, &ll_ctx, 0, resident_nodes);
+        }
+        else if (low_level_pool > 0 && rank >= pool_start && rank < pool_end)
+        {
+            low_level_service_loop(&instance, &ll_ctx);
+        }
+
+        long long cache_counts[2] = {cache.hits, cache.misses};
+        long long cache_totals[2] = {0, 0};
+        MPI_Reduce(cache_counts, cache_totals, 2, MPI_LONG_LONG, MPI_SUM, 0, solver_comm);
+        path_cache_free(&cache);
+        ll_ctx.cache = NULL;
+
+        if (rank == 0)
+        {
+            stats.ll_cache_hits = cache_totals[0];
+            stats.ll_cache_misses = cache_totals[1];
+            report_result(csv_path, manifest_entry_name(&manifest.entries[entry]), &instance, &stats, suboptimality,
+                          timeout_seconds);
+        }
+        problem_instance_free(&instance);
+        MPI_Comm_free(&solver_comm);
     }
-    else if (low_level_pool > 0 && world_rank >= pool_start && world_rank < pool_end)
+    solver_comm = MPI_COMM_WORLD;
+    if (manifest_path && rank == 0)
     {
-        low_level_service_loop(&instance, &ll_ctx);
+        LOG_INFO("[Central] Group %d done in %.3fs, goal tables cached=%lld computed=%lld\n", group,
+                 MPI_Wtime() - batch_start, loader.table_hits, loader.table_misses);
     }
+    instance_cache_free(&loader);
+    manifest_free(&manifest);
+    low_level_threads_free(&ll_ctx);
 
     if (pool_comm != MPI_COMM_NULL)
     {
         MPI_Comm_free(&pool_comm);
     }
-
-    problem_instance_free(&instance);
+    MPI_Comm_free(&group_comm);
     free(workers.ranks);
 
+    if (profile_prefix)
+    {
+        const char *role = rank == 0 ? "coordinator" : (rank < 1 + worker_count ? "worker" : "ll_pool");
+        profile_write(profile_prefix, role);
+    }
+
+    log_flush();
+    MPI_Allreduce(MPI_IN_PLACE, &failures, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
     MPI_Finalize();
-    return 0;
+    return failures > 0 ? 1 : 0;
 }
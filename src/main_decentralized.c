@@ -1,8 +1,13 @@
+#include "batch.h"
 #include "coordinator.h"
+#include "global_state.h"
 #include "instance_io.h"
+#include "load_balance.h"
+#include "log.h"
 #include "low_level.h"
 #include "messages.h"
-#include "priority_queue.h"
+#include "open_list.h"
+#include "profile.h"
 #include "serialization.h"
 
 #include <float.h>
@@ -11,161 +16,43 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <unistd.h>
 
-static void broadcast_instance(ProblemInstance *instance, int root, MPI_Comm comm)
+static void replan_children(const ProblemInstance *instance,
+                            HighLevelNode **children,
+                            const int *agents,
+                            int count,
+                            LowLevelContext *ll_ctx,
+                            bool *out_ok)
 {
-    int rank = 0;
-    MPI_Comm_rank(comm, &rank);
-
-    int header[3] = {0, 0, 0};
-    if (rank == root)
+    PathRef *new_paths[2];
+    AgentPath *outputs[2];
+    const HighLevelNode *nodes[2];
+    for (int i = 0; i < count; ++i)
     {
-        header[0] = instance->map.width;
-        header[1] = instance->map.height;
-        header[2] = instance->num_agents;
+        new_paths[i] = path_ref_create();
+        outputs[i] = &new_paths[i]->path;
+        nodes[i] = children[i];
     }
-    MPI_Bcast(header, 3, MPI_INT, root, comm);
-
-    int width = header[0];
-    int height = header[1];
-    int agents = header[2];
 
-    if (rank != root)
-    {
-        problem_instance_init(instance, agents);
-        grid_init(&instance->map, width, height);
-    }
+    int world_rank = 0;
+    MPI_Comm_rank(solver_comm, &world_rank);
+    LOG_TRACE("[Decentral %d] replan_children: calling low_level for %d child(ren)\n", world_rank, count);
 
-    size_t cell_count = (size_t)width * (size_t)height;
-    if (cell_count > 0)
-    {
-        MPI_Bcast(instance->map.cells, (int)cell_count, MPI_UNSIGNED_CHAR, root, comm);
-    }
+    low_level_request_paths(instance, nodes, agents, count, ll_ctx, outputs, out_ok);
 
-    if (agents > 0)
+    for (int i = 0; i < count; ++i)
     {
-        int *buffer = (int *)malloc(sizeof(int) * (size_t)agents * 2);
-        if (rank == root)
+        LOG_TRACE("[Decentral %d] replan_children: low_level returned %s for agent %d\n",
+                  world_rank, out_ok[i] ? "SUCCESS" : "FAIL", agents[i]);
+        if (out_ok[i])
         {
-            for (int i = 0; i < agents; ++i)
-            {
-                buffer[i * 2] = instance->starts[i].x;
-                buffer[i * 2 + 1] = instance->starts[i].y;
-            }
+            cbs_node_set_path(children[i], agents[i], new_paths[i]);
         }
-        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
-        if (rank != root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                instance->starts[i].x = buffer[i * 2];
-                instance->starts[i].y = buffer[i * 2 + 1];
-            }
-        }
-
-        if (rank == root)
-        {
-            for (int i = 0; i < agents; ++i)
-            {
-                buffer[i * 2] = instance->goals[i].x;
-                buffer[i * 2 + 1] = instance->goals[i].y;
-            }
-        }
-        MPI_Bcast(buffer, agents * 2, MPI_INT, root, comm);
-        if (rank != root)
+        else
         {
-            for (int i = 0; i < agents; ++i)
-            {
-                instance->goals[i].x = buffer[i * 2];
-                instance->goals[i].y = buffer[i * 2 + 1];
-            }
+            path_ref_release(new_paths[i]);
         }
-        free(buffer);
-    }
-}
-
-static HighLevelNode *clone_parent_node(const HighLevelNode *parent)
-{
-    HighLevelNode *clone = cbs_node_create(parent->num_agents);
-    if (!clone)
-    {
-        return NULL;
-    }
-    clone->parent_id = parent->id;
-    clone->depth = parent->depth + 1;
-    clone->cost = parent->cost;
-    for (int i = 0; i < parent->constraints.count; ++i)
-    {
-        constraint_set_add(&clone->constraints, parent->constraints.items[i]);
     }
-    for (int i = 0; i < parent->num_agents; ++i)
-    {
-        path_copy(&clone->paths[i], &parent->paths[i]);
-    }
-    return clone;
-}
-
-static Constraint make_vertex_constraint(const Conflict *conflict, int agent_id)
-{
-    Constraint c = {.agent_id = agent_id,
-                    .time = conflict->time,
-                    .type = CONSTRAINT_VERTEX,
-                    .vertex = conflict->position,
-                    .edge_to = conflict->position};
-    return c;
-}
-
-static Constraint make_edge_constraint(const HighLevelNode *node,
-                                       const Conflict *conflict,
-                                       int agent_id)
-{
-    Constraint c = {.agent_id = agent_id,
-                    .time = conflict->time,
-                    .type = CONSTRAINT_EDGE,
-                    .vertex = conflict->position,
-                    .edge_to = conflict->edge_to};
-    if (agent_id == conflict->agent_b)
-    {
-        GridCoord from = path_step_at(&node->paths[agent_id], conflict->time);
-        GridCoord to = path_step_at(&node->paths[agent_id], conflict->time + 1);
-        c.vertex = from;
-        c.edge_to = to;
-    }
-    return c;
-}
-
-static bool replan_agent_path(const ProblemInstance *instance,
-                              HighLevelNode *node,
-                              int agent_id,
-                              LowLevelContext *ll_ctx)
-{
-    AgentPath new_path;
-    path_init(&new_path, 0);
-    
-    int world_rank = 0;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-    printf("[Decentral %d] replan_agent_path: calling low_level for agent %d\n", world_rank, agent_id);
-    fflush(stdout);
-    
-    bool ok = low_level_request_path(instance,
-                                     &node->constraints,
-                                     agent_id,
-                                     ll_ctx,
-                                     &new_path);
-    
-    printf("[Decentral %d] replan_agent_path: low_level returned %s for agent %d\n", 
-           world_rank, ok ? "SUCCESS" : "FAIL", agent_id);
-    fflush(stdout);
-    
-    if (!ok)
-    {
-        path_free(&new_path);
-        return false;
-    }
-    path_free(&node->paths[agent_id]);
-    node->paths[agent_id] = new_path;
-    return true;
 }
 
 // static bool replan_agent_path(const ProblemInstance *instance,
@@ -190,22 +77,26 @@ static bool replan_agent_path(const ProblemInstance *instance,
 //     return true;
 // }
 
-static void push_child(const HighLevelNode *child, int dest_rank, PendingSendPool *pool)
+static void push_child(const HighLevelNode *child,
+                       const HighLevelNode *root,
+                       int dest_rank,
+                       PendingSendPool *pool,
+                       TerminationDetector *detector)
 {
-    SerializedNode payload;
-    serialize_high_level_node(child, &payload);
+    NodeBatch batch;
+    node_batch_init(&batch);
+    node_batch_reset(&batch, 0);
+    /* Every rank computes the same root, so children travel as a delta against it */
+    node_batch_append_delta(&batch, child, root);
     
-    printf("[Decentral push] Sending node to rank %d (path_ints=%d, constraint_ints=%d)\n",
-           dest_rank, payload.path_int_count, payload.constraint_int_count);
-    fflush(stdout);
+    LOG_TRACE("[Decentral push] Sending node to rank %d (bytes=%d, constraints=%d)\n",
+              dest_rank, batch.size, child->constraint_count);
     
-    /* Use async send to avoid blocking */
-    send_serialized_node_async(dest_rank, TAG_DP_NODE, &payload, pool);
+    /* Use async send to avoid blocking, the pool takes over the buffer */
+    node_batch_send_async(dest_rank, TAG_DP_NODE, &batch, pool);
+    termination_on_send(detector, dest_rank);
     
-    printf("[Decentral push] Send initiated to rank %d\n", dest_rank);
-    fflush(stdout);
-    
-    free_serialized_node(&payload);
+    LOG_TRACE("[Decentral push] Send initiated to rank %d\n", dest_rank);
 }
 
 // static void push_child(const HighLevelNode *child, int dest_rank)
@@ -216,161 +107,156 @@ static void push_child(const HighLevelNode *child, int dest_rank, PendingSendPoo
 //     free_serialized_node(&payload);
 // }
 
-static void receive_buffered_nodes(PriorityQueue *open, int self_rank, double *comm_time_acc)
+static void receive_buffered_nodes(OpenList *open,
+                                   int self_rank,
+                                   NodeBatch *recv_batch,
+                                   const NodeWindow *root_window,
+                                   TerminationDetector *detector,
+                                   LoadBalancer *balancer,
+                                   double *comm_time_acc)
 {
     int flag = 0;
     MPI_Status status;
     while (1)
     {
-        MPI_Iprobe(MPI_ANY_SOURCE, TAG_DP_NODE, MPI_COMM_WORLD, &flag, &status);
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_DP_NODE, solver_comm, &flag, &status);
         if (!flag)
         {
             break;
         }
-        SerializedNode payload;
         double recv_start = MPI_Wtime();
-        receive_serialized_node(status.MPI_SOURCE, TAG_DP_NODE, &payload, NULL);
+        node_batch_receive(status.MPI_SOURCE, TAG_DP_NODE, recv_batch, NULL);
+        termination_on_receive(detector);
+        if (recv_batch->aux_value == STEAL_GRANT_AUX)
+        {
+            load_balancer_on_grant(balancer);
+        }
         if (comm_time_acc) *comm_time_acc += MPI_Wtime() - recv_start;
-        HighLevelNode *node = deserialize_high_level_node(&payload);
-        free_serialized_node(&payload);
-        if (node)
+        int cursor = 0;
+        HighLevelNode *node = NULL;
+        while ((node = node_batch_next(recv_batch, &cursor, root_window)) != NULL)
         {
             node->cost = cbs_compute_soc(node);
-            pq_push(open, node->cost, node);
-            printf("[Decentral %d] Received node cost=%.0f depth=%d from %d\n",
-                   self_rank,
-                   node->cost,
-                   node->depth,
-                   status.MPI_SOURCE);
-            fflush(stdout);
+            open_list_push(open, node);
+            LOG_DEBUG("[Decentral %d] Received node cost=%.0f depth=%d from %d\n",
+                      self_rank,
+                      node->cost,
+                      node->depth,
+                      status.MPI_SOURCE);
         }
     }
 }
 
-int main(int argc, char **argv)
-{
-    MPI_Init(&argc, &argv);
-
-    int world_rank = 0;
-    int world_size = 1;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
-
-    const char *map_path = NULL;
-    const char *agents_path = NULL;
-    double timeout_seconds = 0.0;
-    const char *csv_path = "results_decentral.csv";
-    double suboptimality = 1.5;
-
-    for (int i = 1; i < argc; ++i)
-    {
-        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
-        {
-            map_path = argv[++i];
-        }
-        else if (strcmp(argv[i], "--agents") == 0 && i + 1 < argc)
-        {
-            agents_path = argv[++i];
-        }
-        else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
-        {
-            timeout_seconds = atof(argv[++i]);
-        }
-        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
-        {
-            csv_path = argv[++i];
-        }
-        else if (strcmp(argv[i], "--w") == 0 && i + 1 < argc)
-        {
-            suboptimality = atof(argv[++i]);
-            if (suboptimality < 1.0)
-            {
-                suboptimality = 1.0;
-            }
-        }
-    }
-
-    int config_ok = 1;
-    if (world_rank == 0)
-    {
-        if (!map_path || !agents_path)
-        {
-            fprintf(stderr, "Usage: mpirun -n <procs> decentralized_cbs --map map.txt --agents agents.txt [--timeout SEC] [--csv path] [--w bound]\n");
-            config_ok = 0;
-        }
-        if (world_size < 1)
-        {
-            fprintf(stderr, "At least one MPI rank is required.\n");
-            config_ok = 0;
-        }
-    }
-    MPI_Bcast(&config_ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    if (!config_ok)
-    {
-        MPI_Finalize();
-        return 1;
-    }
-
-    ProblemInstance instance;
-    memset(&instance, 0, sizeof(ProblemInstance));
-    int load_success = 1;
-    if (world_rank == 0)
-    {
-        if (!load_problem_instance(map_path, agents_path, &instance))
-        {
-            fprintf(stderr, "Failed to load problem instance.\n");
-            load_success = 0;
-        }
-    }
-    MPI_Bcast(&load_success, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    if (!load_success)
-    {
-        MPI_Finalize();
-        return 1;
-    }
+#define DECENTRAL_CSV_HEADER "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,comm_time_sec,compute_time_sec,ll_cache_hits,ll_cache_misses,open_peak_resident,open_compressed,open_spilled,w,lower_bound,suboptimality,timeout_sec,status"
 
-    broadcast_instance(&instance, 0, MPI_COMM_WORLD);
-
-    LowLevelContext ll_ctx = {.manager_world_rank = -1, .pool_comm = MPI_COMM_NULL};
-
-    HighLevelNode *root = cbs_node_create(instance.num_agents);
+/* Search settings shared by every instance of a run */
+typedef struct
+{
+    const char *csv_path;
+    double timeout_seconds;
+    double suboptimality;
+    double cache_mb;
+    double open_mb;
+    long long sync_interval;
+    int steal_batch;
+    int offload_threshold;
+} PeerOptions;
+
+/*
+Solve one instance with every rank of solver_comm as a peer, then append
+its result to the CSV file and print its summary on rank 0
+
+@param instance Pointer to the ProblemInstance, broadcast to every rank
+@param map_name File name of the instance's map
+@param options Pointer to the PeerOptions of the run
+@param ll_ctx Pointer to the rank's LowLevelContext, given a path cache for this instance
+@return true if every rank planned the root, false otherwise
+*/
+static bool solve_instance(const ProblemInstance *instance,
+                           const char *map_name,
+                           const PeerOptions *options,
+                           LowLevelContext *ll_ctx)
+{
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(solver_comm, &rank);
+    MPI_Comm_size(solver_comm, &size);
+    const char *csv_path = options->csv_path;
+    double timeout_seconds = options->timeout_seconds;
+    double suboptimality = options->suboptimality;
+    double open_mb = options->open_mb;
+    long long sync_interval = options->sync_interval;
+    int steal_batch = options->steal_batch;
+    int offload_threshold = options->offload_threshold;
+
+    // low-level results only hold for this instance
+    PathCache cache;
+    path_cache_init(&cache, (size_t)(options->cache_mb * 1024.0 * 1024.0));
+    ll_ctx->cache = &cache;
+
+    HighLevelNode *root = cbs_node_create(instance->num_agents);
     root->id = 0;
     root->depth = 0;
     root->parent_id = -1;
-    int root_ok = 1;
-    for (int agent = 0; agent < instance.num_agents; ++agent)
+    // the whole root is one batch, planned on the rank's threads
+    const HighLevelNode **root_nodes = (const HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)instance->num_agents);
+    int *root_agents = (int *)malloc(sizeof(int) * (size_t)instance->num_agents);
+    AgentPath **root_paths = (AgentPath **)malloc(sizeof(AgentPath *) * (size_t)instance->num_agents);
+    if (!root_nodes || !root_agents || !root_paths)
     {
-        if (!low_level_request_path(&instance, &root->constraints, agent, &ll_ctx, &root->paths[agent]))
-        {
-            root_ok = 0;
-            break;
-        }
+        fprintf(stderr, "Failed to allocate the root batch.\n");
+        exit(EXIT_FAILURE);
     }
+    for (int agent = 0; agent < instance->num_agents; ++agent)
+    {
+        root_nodes[agent] = root;
+        root_agents[agent] = agent;
+        root_paths[agent] = &root->paths[agent]->path;
+    }
+    int root_ok = low_level_request_paths(instance, root_nodes, root_agents, instance->num_agents, ll_ctx, root_paths, NULL) ? 1 : 0;
+    free(root_nodes);
+    free(root_agents);
+    free(root_paths);
     root->cost = cbs_compute_soc(root);
-    printf("[Decentral %d] Root ready cost=%.0f agents=%d\n", world_rank, root->cost, instance.num_agents);
-    fflush(stdout);
+    LOG_INFO("[Decentral %d] Root ready cost=%.0f agents=%d\n", rank, root->cost, instance->num_agents);
 
     int all_root_ok = 0;
-    MPI_Allreduce(&root_ok, &all_root_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&root_ok, &all_root_ok, 1, MPI_INT, MPI_MIN, solver_comm);
     if (!all_root_ok)
     {
-        if (world_rank == 0)
+        if (rank == 0)
         {
             fprintf(stderr, "Failed to compute initial paths.\n");
         }
         cbs_node_free(root);
-        problem_instance_free(&instance);
-        MPI_Finalize();
-        return 1;
+        ll_ctx->cache = NULL;
+        path_cache_free(&cache);
+        return false;
     }
 
-    PriorityQueue open;
-    pq_init(&open);
-    pq_push(&open, root->cost, root);
+    /* Shared copy of the root kept as the delta base for node transfers */
+    NodeWindow root_window;
+    node_window_init(&root_window, 1);
+    node_window_push(&root_window, cbs_node_share(root));
+
+    /* Only rank 0 expands the root, the other ranks start idle and steal */
+    OpenList open;
+    open_list_init(&open, instance, ll_ctx, (size_t)(open_mb * 1024.0 * 1024.0), suboptimality);
+    double root_cost = root->cost;
+    if (rank == 0)
+    {
+        open_list_push(&open, root);
+    }
+    else
+    {
+        cbs_node_free(root);
+    }
 
     /* Initialize pending send pool for async MPI operations */
     PendingSendPool send_pool;
     pending_send_pool_init(&send_pool);
+    NodeBatch recv_batch;
+    node_batch_init(&recv_batch);
 
     double start_time = MPI_Wtime();
     long long nodes_expanded = 0;
@@ -379,227 +265,246 @@ int main(int argc, char **argv)
     long long conflicts_detected = 0;
     int timed_out = 0;
     double local_solution_cost = DBL_MAX;
+    /* Cheapest node dropped against the incumbent, for the final lower bound */
+    double pruned_lb = DBL_MAX;
     double local_comm_time = 0.0;  /* Track MPI communication time */
 
-    int rr_dest = (world_rank + 1) % world_size;
+    int rr_dest = (rank + 1) % size;
 
-    int active = 1;
-    while (active)
+    /* Global bound, incumbent and timeout are refreshed asynchronously every sync_interval expansions */
+    GlobalState global;
+    global_state_init(&global, solver_comm, root_cost);
+    TerminationDetector detector;
+    termination_init(&detector, solver_comm);
+    LoadBalancer balancer;
+    load_balancer_init(&balancer, solver_comm, steal_batch);
+    long long expanded_since_sync = 0;
+    bool refresh_now = true;
+    bool was_passive = false;
+
+    while (1)
     {
-        /* Check local timeout and broadcast to all processes so they exit together */
-        double elapsed = MPI_Wtime() - start_time;
-        int local_timeout = (timeout_seconds > 0.0 && elapsed > timeout_seconds) ? 1 : 0;
-        int any_timeout = 0;
+        double iteration_start = profile_start();
+        receive_buffered_nodes(&open, rank, &recv_batch, &root_window, &detector, &balancer, &local_comm_time);
+        pending_send_pool_progress(&send_pool);
+        profile_sample_open(open_list_count(&open));
+
         double comm_start = MPI_Wtime();
-        MPI_Allreduce(&local_timeout, &any_timeout, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        double collective_start = profile_start();
+        bool round_done = global_state_test(&global);
+        profile_stop(PROFILE_COLLECTIVE, collective_start);
         local_comm_time += MPI_Wtime() - comm_start;
-        
-        if (any_timeout)
+        if (round_done)
         {
-            timed_out = 1;
-            printf("[Decentral %d] TIMEOUT at %.2fs (coordinated exit)\n", world_rank, elapsed);
-            fflush(stdout);
-            break;
+            /* Every rank sees the same round result, so they all leave after the same round */
+            if (global.timeout)
+            {
+                timed_out = 1;
+                LOG_INFO("[Decentral %d] TIMEOUT at %.2fs (coordinated exit)\n", rank, MPI_Wtime() - start_time);
+                break;
+            }
+            if (global.terminated)
+            {
+                LOG_INFO("[Decentral %d] Termination detected after %lld round(s), incumbent=%.0f\n",
+                         rank,
+                         global.rounds,
+                         global.incumbent < DBL_MAX / 2.0 ? global.incumbent : -1.0);
+                break;
+            }
         }
-        
-        receive_buffered_nodes(&open, world_rank, &local_comm_time);
 
+        /* Drop nodes that cannot lead to a solution within the bound of the incumbent */
+        double incumbent = local_solution_cost < global.incumbent ? local_solution_cost : global.incumbent;
         double local_lb = DBL_MAX;
-        if (open.count > 0)
+        if (open_list_count(&open) > 0)
         {
-            double key = 0.0;
-            pq_peek(&open, &key);
-            local_lb = key;
+            double lb = open_list_lower_bound(&open);
+            if (incumbent < DBL_MAX / 2.0 && lb * suboptimality >= incumbent - 1e-6)
+            {
+                // lb is the cheapest node left, so every node is pruned as well
+                pruned_lb = lb < pruned_lb ? lb : pruned_lb;
+                open_list_clear(&open);
+            }
+            else
+            {
+                local_lb = lb;
+            }
         }
 
-        double global_lb = DBL_MAX;
-        comm_start = MPI_Wtime();
-        MPI_Allreduce(&local_lb, &global_lb, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
-        local_comm_time += MPI_Wtime() - comm_start;
-
-        if (global_lb >= DBL_MAX / 2.0)
+        load_balancer_poll(&balancer, &open, root_window.nodes[0], &send_pool, &detector);
+        bool passive = open_list_count(&open) == 0;
+        termination_poll(&detector, passive);
+        if (passive)
         {
-            /* All queues empty and no solution */
-            printf("[Decentral %d] All queues empty, no solution\n", world_rank);
-            fflush(stdout);
-            break;
+            load_balancer_request(&balancer);
         }
+        if (passive && !was_passive)
+        {
+            LOG_DEBUG("[Decentral %d] Queue empty, waiting for work (lb=%.0f)\n", rank, global.lower_bound);
+        }
+        was_passive = passive;
 
-        double bound = suboptimality * global_lb;
-
-        double global_sol = DBL_MAX;
-        comm_start = MPI_Wtime();
-        MPI_Allreduce(&local_solution_cost, &global_sol, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
-        local_comm_time += MPI_Wtime() - comm_start;
-        if (global_sol < DBL_MAX / 2.0)
+        if (!global.in_flight && (passive || refresh_now || expanded_since_sync >= sync_interval))
         {
-            /* Only stop when solution respects the current bound (w=1 => optimal) */
-            if (global_sol <= bound + 1e-6)
-            {
-                printf("[Decentral %d] Global solution within bound: %.0f (bound=%.0f)\n",
-                       world_rank, global_sol, bound);
-                fflush(stdout);
-                break;
-            }
-            else
-            {
-                printf("[Decentral %d] Solution %.0f found but above bound %.0f, continue search\n",
-                       world_rank, global_sol, bound);
-                fflush(stdout);
-            }
+            double elapsed = MPI_Wtime() - start_time;
+            int local_timeout = (timeout_seconds > 0.0 && elapsed > timeout_seconds) ? 1 : 0;
+            comm_start = MPI_Wtime();
+            collective_start = profile_start();
+            global_state_start(&global, local_lb, local_solution_cost, local_timeout, detector.detected);
+            profile_stop(PROFILE_COLLECTIVE, collective_start);
+            local_comm_time += MPI_Wtime() - comm_start;
+            expanded_since_sync = 0;
+            refresh_now = false;
         }
 
-        if (open.count == 0)
+        if (passive)
         {
-            /* Wait for more work */
-            printf("[Decentral %d] Queue empty, waiting for work (lb=%.0f)\n", world_rank, global_lb);
-            fflush(stdout);
+            profile_stop(PROFILE_IDLE, iteration_start);
             continue;
         }
 
-        double key = 0.0;
-        HighLevelNode *node = (HighLevelNode *)pq_pop(&open, &key);
-        if (node->cost > bound + 1e-6)
+        double global_lb = global.lower_bound < local_lb ? global.lower_bound : local_lb;
+        double bound = suboptimality * global_lb;
+        open_list_cap_focal(&open, global_lb);
+
+        /* Not eligible yet; leave it queued and wait for bound to catch up */
+        if (open_list_peek(&open)->cost > bound + 1e-6)
+        {
+            refresh_now = true;
+            continue;
+        }
+        HighLevelNode *node = open_list_pop(&open);
+        if (!node)
         {
-            /* Not eligible yet; reinsert and wait for bound to catch up */
-            pq_push(&open, node->cost, node);
             continue;
         }
 
         nodes_expanded++;
-        printf("[Decentral %d] Expanding node id=%d depth=%d cost=%.0f bound=%.0f lb=%.0f\n",
-               world_rank,
-               node->id,
-               node->depth,
-               node->cost,
-               bound,
-               global_lb);
-        fflush(stdout);
+        expanded_since_sync++;
+        profile_hl_expand();
+        LOG_DEBUG("[Decentral %d] Expanding node id=%d depth=%d cost=%.0f bound=%.0f lb=%.0f\n",
+                  rank,
+                  node->id,
+                  node->depth,
+                  node->cost,
+                  bound,
+                  global_lb);
 
         Conflict conflict;
-        if (!cbs_detect_conflict(node, &conflict))
-        {
-            local_solution_cost = node->cost;
-            printf("[Decentral %d] Found solution cost=%.0f depth=%d\n",
-                   world_rank,
-                   node->cost,
-                   node->depth);
-            fflush(stdout);
+        cbs_prepare_mdds(node, instance, ll_ctx->threads);
+        if (!cbs_select_conflict(node, instance, &conflict, NULL))
+        {
+            if (node->cost < local_solution_cost)
+            {
+                local_solution_cost = node->cost;
+                refresh_now = true;
+            }
+            LOG_INFO("[Decentral %d] Found solution cost=%.0f depth=%d\n",
+                     rank,
+                     node->cost,
+                     node->depth);
             cbs_node_free(node);
             continue;
         }
 
         conflicts_detected++;
-        printf("[Decentral %d] Conflict agents=(%d,%d) time=%d, generating children\n",
-               world_rank, conflict.agent_a, conflict.agent_b, conflict.time);
-        fflush(stdout);
+        LOG_DEBUG("[Decentral %d] Conflict agents=(%d,%d) time=%d, generating children\n",
+                  rank, conflict.agent_a, conflict.agent_b, conflict.time);
         
-        int child_agents[2] = {conflict.agent_a, conflict.agent_b};
+        HighLevelNode *children[2] = {NULL, NULL};
+        int child_agents[2];
+        int child_count = 0;
+        int conflict_agents[2] = {conflict.agent_a, conflict.agent_b};
         for (int idx = 0; idx < 2; ++idx)
         {
-            printf("[Decentral %d] Processing child %d for agent %d\n", world_rank, idx, child_agents[idx]);
-            fflush(stdout);
-            
-            // CRITICAL: Drain incoming messages to prevent send deadlock
-            receive_buffered_nodes(&open, world_rank, &local_comm_time);
-            
-            HighLevelNode *child = clone_parent_node(node);
+            HighLevelNode *child = cbs_node_create_child(node, cbs_conflict_constraint(node, &conflict, conflict_agents[idx]));
             if (!child)
             {
-                printf("[Decentral %d] Failed to clone parent node\n", world_rank);
-                fflush(stdout);
+                LOG_DEBUG("[Decentral %d] Failed to create child node\n", rank);
                 continue;
             }
-            Constraint c = conflict.is_vertex_conflict
-                               ? make_vertex_constraint(&conflict, child_agents[idx])
-                               : make_edge_constraint(node, &conflict, child_agents[idx]);
-            constraint_set_add(&child->constraints, c);
+            children[child_count] = child;
+            child_agents[child_count++] = conflict_agents[idx];
+        }
+        // both children are replanned together, concurrently when the rank has threads
+        bool replanned[2] = {false, false};
+        replan_children(instance, children, child_agents, child_count, ll_ctx, replanned);
 
-            printf("[Decentral %d] Calling replan for agent %d\n", world_rank, child_agents[idx]);
-            fflush(stdout);
+        for (int idx = 0; idx < child_count; ++idx)
+        {
+            HighLevelNode *child = children[idx];
+            LOG_TRACE("[Decentral %d] Processing child %d for agent %d\n", rank, idx, child_agents[idx]);
+            
+            // CRITICAL: Drain incoming messages to prevent send deadlock
+            receive_buffered_nodes(&open, rank, &recv_batch, &root_window, &detector, &balancer, &local_comm_time);
 
-            if (!replan_agent_path(&instance, child, child_agents[idx], &ll_ctx))
+            if (!replanned[idx])
             {
-                printf("[Decentral %d] Replan FAILED for agent %d, discarding child\n", world_rank, child_agents[idx]);
-                fflush(stdout);
+                LOG_DEBUG("[Decentral %d] Replan FAILED for agent %d, discarding child\n", rank, child_agents[idx]);
                 cbs_node_free(child);
                 continue;
             }
 
             child->cost = cbs_compute_soc(child);
-            int dest = rr_dest;
-            rr_dest = (rr_dest + 1) % world_size;
+            /* Children stay local unless the queue is long, then go round-robin to the other ranks */
+            int dest = rank;
+            if (size > 1 && open_list_count(&open) >= offload_threshold)
+            {
+                if (rr_dest == rank)
+                {
+                    rr_dest = (rr_dest + 1) % size;
+                }
+                dest = rr_dest;
+                rr_dest = (rr_dest + 1) % size;
+            }
             
-            printf("[Decentral %d] Child ready cost=%.0f, dest=%d (self=%d)\n",
-                   world_rank, child->cost, dest, world_rank);
-            fflush(stdout);
+            LOG_TRACE("[Decentral %d] Child ready cost=%.0f, dest=%d (self=%d)\n",
+                      rank, child->cost, dest, rank);
             
-            if (dest == world_rank)
+            if (dest == rank)
             {
-                pq_push(&open, child->cost, child);
-                printf("[Decentral %d] Pushed child to local queue\n", world_rank);
-                fflush(stdout);
+                open_list_push(&open, child);
+                LOG_TRACE("[Decentral %d] Pushed child to local queue\n", rank);
             }
             else
             {
-                printf("[Decentral %d] About to push_child to rank %d\n", world_rank, dest);
-                fflush(stdout);
-                push_child(child, dest, &send_pool);
-                printf("[Decentral %d] push_child completed to rank %d\n", world_rank, dest);
-                fflush(stdout);
+                LOG_TRACE("[Decentral %d] About to push_child to rank %d\n", rank, dest);
+                push_child(child, root_window.nodes[0], dest, &send_pool, &detector);
+                LOG_TRACE("[Decentral %d] push_child completed to rank %d\n", rank, dest);
                 cbs_node_free(child);
             }
             nodes_generated++;
             
             /* Progress sends and receive any incoming nodes */
             pending_send_pool_progress(&send_pool);
-            receive_buffered_nodes(&open, world_rank, &local_comm_time);
+            receive_buffered_nodes(&open, rank, &recv_batch, &root_window, &detector, &balancer, &local_comm_time);
         }
         
-        printf("[Decentral %d] Finished generating children, freeing parent node\n", world_rank);
-        fflush(stdout);
+        LOG_TRACE("[Decentral %d] Finished generating children, freeing parent node\n", rank);
 
         cbs_node_free(node);
     }
 
-    /* Drain any in-flight node transfers and allow async sends to progress before shutdown */
-    double drain_start = MPI_Wtime();
-    while (1)
+    /* Receive every node still addressed to this rank so all sends can complete */
+    long long expected_nodes = termination_finish(&detector);
+    while (detector.node_received < expected_nodes)
     {
-        receive_buffered_nodes(&open, world_rank, &local_comm_time);
+        receive_buffered_nodes(&open, rank, &recv_batch, &root_window, &detector, &balancer, &local_comm_time);
         pending_send_pool_progress(&send_pool);
-
-        MPI_Status probe_status;
-        int has_pending = 0;
-        MPI_Iprobe(MPI_ANY_SOURCE, TAG_DP_NODE, MPI_COMM_WORLD, &has_pending, &probe_status);
-        int outstanding_sends = send_pool.count;
-        double drain_elapsed = MPI_Wtime() - drain_start;
-
-        if (!has_pending && outstanding_sends == 0)
-        {
-            break;
-        }
-        if (drain_elapsed > 2.0)
-        {
-            printf("[Decentral %d] Drain timeout after %.2fs (pending_recv=%d pending_send=%d)\n",
-                   world_rank, drain_elapsed, has_pending, outstanding_sends);
-            fflush(stdout);
-            break;
-        }
-        usleep(1000);
     }
+    termination_free(&detector);
+    load_balancer_finish(&balancer);
 
     /* Wait for any pending async sends to complete before cleanup */
-    pending_send_pool_wait_all(&send_pool);
+    pending_send_pool_free(&send_pool);
+    node_batch_free(&recv_batch);
+    node_window_free(&root_window);
 
     /* Cleanup remaining queued nodes */
-    while (open.count > 0)
-    {
-        double dummy = 0.0;
-        HighLevelNode *node = (HighLevelNode *)pq_pop(&open, &dummy);
-        cbs_node_free(node);
-    }
-    pq_free(&open);
+    long long open_counts[3] = {open.peak_resident, open.nodes_compressed, open.nodes_spilled};
+    double rank_lb = open_list_count(&open) > 0 ? open_list_lower_bound(&open) : DBL_MAX;
+    rank_lb = pruned_lb < rank_lb ? pruned_lb : rank_lb;
+    open_list_free(&open);
 
     double runtime = MPI_Wtime() - start_time;
 
@@ -608,41 +513,55 @@ int main(int argc, char **argv)
     long long total_conflicts = 0;
     double total_comm_time = 0.0;
     int any_timeout = 0;
-    MPI_Reduce(&nodes_expanded, &total_expanded, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&nodes_generated, &total_generated, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&conflicts_detected, &total_conflicts, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&local_comm_time, &total_comm_time, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Allreduce(&timed_out, &any_timeout, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Reduce(&nodes_expanded, &total_expanded, 1, MPI_LONG_LONG, MPI_SUM, 0, solver_comm);
+    MPI_Reduce(&nodes_generated, &total_generated, 1, MPI_LONG_LONG, MPI_SUM, 0, solver_comm);
+    MPI_Reduce(&conflicts_detected, &total_conflicts, 1, MPI_LONG_LONG, MPI_SUM, 0, solver_comm);
+    MPI_Reduce(&local_comm_time, &total_comm_time, 1, MPI_DOUBLE, MPI_SUM, 0, solver_comm);
+    long long cache_counts[2] = {cache.hits, cache.misses};
+    long long cache_totals[2] = {0, 0};
+    MPI_Reduce(cache_counts, cache_totals, 2, MPI_LONG_LONG, MPI_SUM, 0, solver_comm);
+    long long steal_counts[3] = {balancer.steals_sent, balancer.steals_granted, balancer.nodes_donated};
+    long long steal_totals[3] = {0, 0, 0};
+    MPI_Reduce(steal_counts, steal_totals, 3, MPI_LONG_LONG, MPI_SUM, 0, solver_comm);
+    load_balancer_free(&balancer);
+    // peak residency is per rank, so report the largest
+    long long open_totals[3] = {0, 0, 0};
+    MPI_Reduce(&open_counts[0], &open_totals[0], 1, MPI_LONG_LONG, MPI_MAX, 0, solver_comm);
+    MPI_Reduce(&open_counts[1], &open_totals[1], 2, MPI_LONG_LONG, MPI_SUM, 0, solver_comm);
+    MPI_Allreduce(&timed_out, &any_timeout, 1, MPI_INT, MPI_MAX, solver_comm);
 
     double global_solution = DBL_MAX;
-    MPI_Allreduce(&local_solution_cost, &global_solution, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&local_solution_cost, &global_solution, 1, MPI_DOUBLE, MPI_MIN, solver_comm);
+    // the optimum is at least the cheapest node pruned or left open on any rank
+    double lower_bound = DBL_MAX;
+    MPI_Allreduce(&rank_lb, &lower_bound, 1, MPI_DOUBLE, MPI_MIN, solver_comm);
+    lower_bound = global_solution < lower_bound ? global_solution : lower_bound;
+    if (any_timeout && global_solution >= DBL_MAX / 2.0)
+    {
+        lower_bound = DBL_MAX;
+    }
 
-    if (world_rank == 0)
+    if (rank == 0)
     {
-        const char *map_name = map_path ? strrchr(map_path, '/') : NULL;
-        map_name = map_name ? map_name + 1 : map_path ? map_path : "unknown";
-        int need_header = access(csv_path, F_OK) != 0;
         FILE *fp = fopen(csv_path, "a");
         /* For decentralized: use totals across all ranks */
-        double compute_time = runtime * world_size - total_comm_time;
+        double compute_time = runtime * size - total_comm_time;
         if (compute_time < 0.0)
         {
             compute_time = 0.0;
         }
         const char *status = (global_solution < DBL_MAX / 2.0) ? "success" : (any_timeout ? "timeout" : "failure");
         double cost_out = (global_solution < DBL_MAX / 2.0) ? global_solution : -1.0;
+        double lower_bound_out = lower_bound < DBL_MAX / 2.0 ? lower_bound : -1.0;
+        double achieved = global_solution < DBL_MAX / 2.0 ? achieved_suboptimality(global_solution, lower_bound) : -1.0;
         if (fp)
         {
-            if (need_header)
-            {
-                fprintf(fp, "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,comm_time_sec,compute_time_sec,timeout_sec,status\n");
-            }
             fprintf(fp,
-                    "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%.6f,%.6f,%.2f,%s\n",
+                    "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%.6f,%.6f,%lld,%lld,%lld,%lld,%lld,%.2f,%.0f,%.4f,%.2f,%s\n",
                     map_name,
-                    instance.num_agents,
-                    instance.map.width,
-                    instance.map.height,
+                    instance->num_agents,
+                    instance->map.width,
+                    instance->map.height,
                     total_expanded,
                     total_generated,
                     total_conflicts,
@@ -650,6 +569,14 @@ int main(int argc, char **argv)
                     runtime,
                     total_comm_time,
                     compute_time,
+                    cache_totals[0],
+                    cache_totals[1],
+                    open_totals[0],
+                    open_totals[1],
+                    open_totals[2],
+                    suboptimality,
+                    lower_bound_out,
+                    achieved,
                     timeout_seconds,
                     status);
             fclose(fp);
@@ -659,8 +586,9 @@ int main(int argc, char **argv)
             fprintf(stderr, "Warning: could not open CSV file %s for writing.\n", csv_path);
         }
 
+        log_flush();
         printf("[Decentral] Summary: status=%s cost=%.0f runtime=%.3fs comm=%.3fs compute=%.3fs "
-               "expanded=%lld generated=%lld conflicts=%lld\n",
+               "expanded=%lld generated=%lld conflicts=%lld ll_cache=%lld/%lld steals=%lld/%lld donated=%lld open_resident=%lld compressed=%lld spilled=%lld w=%.2f subopt=%.4f\n",
                status,
                cost_out,
                runtime,
@@ -668,11 +596,329 @@ int main(int argc, char **argv)
                compute_time,
                total_expanded,
                total_generated,
-               total_conflicts);
-        fflush(stdout);
+               total_conflicts,
+               cache_totals[0],
+               cache_totals[0] + cache_totals[1],
+               steal_totals[1],
+               steal_totals[0],
+               steal_totals[2],
+               open_totals[0],
+               open_totals[1],
+               open_totals[2],
+               suboptimality,
+               achieved);
+    }
+
+    ll_ctx->cache = NULL;
+    path_cache_free(&cache);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int thread_support = MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+
+    int world_rank = 0;
+    int world_size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    const char *map_path = NULL;
+    const char *agents_path = NULL;
+    const char *instance_path = NULL;
+    const char *manifest_path = NULL;
+    double batch_cache_mb = BATCH_DEFAULT_CACHE_MB;
+    int batch_groups = 1;
+    AgentSelection selection;
+    agent_selection_init(&selection);
+    double timeout_seconds = 0.0;
+    const char *csv_path = "results_decentral.csv";
+    LowLevelEngine engine = LL_ENGINE_ASTAR;
+    bool engine_ok = true;
+    int log_level = LOG_LEVEL_INFO;
+    bool log_ok = true;
+    const char *profile_prefix = NULL;
+    double suboptimality = 1.5;
+    double cache_mb = 64.0;
+    double open_mb = 0.0;
+    long long sync_interval = 16;
+    int steal_batch = 4;
+    int offload_threshold = 64;
+    int thread_count = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+        {
+            map_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--agents") == 0 && i + 1 < argc)
+        {
+            agents_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--instance") == 0 && i + 1 < argc)
+        {
+            instance_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc)
+        {
+            manifest_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--batch-cache-mb") == 0 && i + 1 < argc)
+        {
+            batch_cache_mb = atof(argv[++i]);
+            if (batch_cache_mb < 0.0)
+            {
+                batch_cache_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--batch-groups") == 0 && i + 1 < argc)
+        {
+            batch_groups = atoi(argv[++i]);
+            if (batch_groups < 1)
+            {
+                batch_groups = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--scen-bucket") == 0 && i + 1 < argc)
+        {
+            selection.bucket = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--num-agents") == 0 && i + 1 < argc)
+        {
+            selection.count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--agent-offset") == 0 && i + 1 < argc)
+        {
+            selection.offset = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
+        {
+            timeout_seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            csv_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--low-level") == 0 && i + 1 < argc)
+        {
+            engine_ok = low_level_engine_parse(argv[++i], &engine) && engine_ok;
+        }
+        else if (strcmp(argv[i], "--ll-cache-mb") == 0 && i + 1 < argc)
+        {
+            cache_mb = atof(argv[++i]);
+            if (cache_mb < 0.0)
+            {
+                cache_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--open-mem-mb") == 0 && i + 1 < argc)
+        {
+            open_mb = atof(argv[++i]);
+            if (open_mb < 0.0)
+            {
+                open_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--sync-interval") == 0 && i + 1 < argc)
+        {
+            sync_interval = atoll(argv[++i]);
+            if (sync_interval < 1)
+            {
+                sync_interval = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--steal-batch") == 0 && i + 1 < argc)
+        {
+            steal_batch = atoi(argv[++i]);
+            if (steal_batch < 1)
+            {
+                steal_batch = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--offload-threshold") == 0 && i + 1 < argc)
+        {
+            offload_threshold = atoi(argv[++i]);
+            if (offload_threshold < 0)
+            {
+                offload_threshold = 0;
+            }
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+        {
+            log_ok = log_level_parse(argv[++i], &log_level) && log_ok;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            thread_count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--w") == 0 && i + 1 < argc)
+        {
+            suboptimality = atof(argv[++i]);
+            if (suboptimality < 1.0)
+            {
+                suboptimality = 1.0;
+            }
+        }
     }
+    log_init(log_level);
+    profile_init(profile_prefix != NULL);
 
-    problem_instance_free(&instance);
+    int config_ok = 1;
+    if (world_rank == 0)
+    {
+        if (!manifest_path && !instance_path && (!map_path || !agents_path))
+        {
+            fprintf(stderr, "Usage: mpirun -n <procs> decentralized_cbs (--map map --agents scen [--scen-bucket B] [--num-agents N] [--agent-offset K] | --instance packed | --manifest file [--batch-groups G] [--batch-cache-mb MB]) [--timeout SEC] [--csv path] [--w bound] [--low-level astar|sipp] [--ll-cache-mb MB] [--open-mem-mb MB] [--sync-interval N] [--steal-batch N] [--offload-threshold N] [--threads N] [--log-level error|info|debug|trace] [--profile prefix]\n");
+            config_ok = 0;
+        }
+        if (!engine_ok)
+        {
+            fprintf(stderr, "Unknown --low-level engine (expected astar, sipp or parallel).\n");
+            config_ok = 0;
+        }
+        if (!log_ok)
+        {
+            fprintf(stderr, "Unknown --log-level (expected error, info, debug or trace).\n");
+            config_ok = 0;
+        }
+        if (world_size < batch_groups)
+        {
+            fprintf(stderr, "At least one MPI rank per group is required (%d group(s), %d rank(s)).\n",
+                    batch_groups, world_size);
+            config_ok = 0;
+        }
+    }
+    MPI_Bcast(&config_ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!config_ok)
+    {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // a single instance is a batch of one, without tables kept for later instances
+    Manifest manifest;
+    manifest_init(&manifest);
+    int manifest_ok = 1;
+    if (manifest_path)
+    {
+        manifest_ok = manifest_load(manifest_path, &manifest) ? 1 : 0;
+    }
+    else
+    {
+        manifest_add(&manifest, map_path, agents_path, instance_path, &selection);
+        batch_cache_mb = 0.0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &manifest_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!manifest_ok)
+    {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "Failed to load manifest %s.\n", manifest_path);
+        }
+        manifest_free(&manifest);
+        MPI_Finalize();
+        return 1;
+    }
+
+    // the peers of every group solve their share of the instances together
+    int group = 0;
+    MPI_Comm group_comm = batch_group_comm(batch_groups, &group);
+    int rank = 0;
+    MPI_Comm_rank(group_comm, &rank);
+
+    AStarWorkspace workspace;
+    a_star_workspace_init(&workspace);
+    LowLevelContext ll_ctx = {.manager_world_rank = -1,
+                              .pool_comm = MPI_COMM_NULL,
+                              .engine = engine,
+                              .workspace = &workspace,
+                              .cache = NULL};
+    if (thread_count > 1 && thread_support < MPI_THREAD_FUNNELED)
+    {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "Warning: MPI does not support threads, running with --threads 1.\n");
+        }
+        thread_count = 1;
+    }
+    low_level_threads_init(&ll_ctx, thread_count);
+    PeerOptions options = {.csv_path = csv_path,
+                           .timeout_seconds = timeout_seconds,
+                           .suboptimality = suboptimality,
+                           .cache_mb = cache_mb,
+                           .open_mb = open_mb,
+                           .sync_interval = sync_interval,
+                           .steal_batch = steal_batch,
+                           .offload_threshold = offload_threshold};
+
+    if (world_rank == 0)
+    {
+        batch_csv_header(csv_path, DECENTRAL_CSV_HEADER);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    InstanceCache loader;
+    instance_cache_init(&loader, (size_t)(batch_cache_mb * 1024.0 * 1024.0));
+    int failures = 0;
+    double batch_start = MPI_Wtime();
+    for (int entry = group; entry < manifest.count; entry += batch_groups)
+    {
+        // a fresh communicator per instance, so messages left over from one search never match the next
+        MPI_Comm_dup(group_comm, &solver_comm);
+
+        ProblemInstance instance;
+        memset(&instance, 0, sizeof(ProblemInstance));
+        int load_success = 1;
+        if (rank == 0)
+        {
+            if (!instance_cache_load(&loader, &manifest.entries[entry], &instance))
+            {
+                fprintf(stderr, "Failed to load problem instance %d of %d.\n", entry + 1, manifest.count);
+                load_success = 0;
+            }
+            else if (manifest_path)
+            {
+                LOG_INFO("[Decentral] Instance %d/%d on group %d: %s with %d agents\n", entry + 1, manifest.count,
+                         group, manifest_entry_name(&manifest.entries[entry]), instance.num_agents);
+            }
+        }
+        MPI_Bcast(&load_success, 1, MPI_INT, 0, solver_comm);
+        if (load_success)
+        {
+            broadcast_problem_instance(&instance, 0, solver_comm);
+            if (!solve_instance(&instance, manifest_entry_name(&manifest.entries[entry]), &options, &ll_ctx))
+            {
+                load_success = 0;
+            }
+            problem_instance_free(&instance);
+        }
+        failures += load_success ? 0 : 1;
+        MPI_Comm_free(&solver_comm);
+    }
+    solver_comm = MPI_COMM_WORLD;
+    if (manifest_path && rank == 0)
+    {
+        LOG_INFO("[Decentral] Group %d done in %.3fs, goal tables cached=%lld computed=%lld\n", group,
+                 MPI_Wtime() - batch_start, loader.table_hits, loader.table_misses);
+    }
+    instance_cache_free(&loader);
+    manifest_free(&manifest);
+    low_level_threads_free(&ll_ctx);
+    a_star_workspace_free(&workspace);
+    MPI_Comm_free(&group_comm);
+
+    if (profile_prefix)
+    {
+        profile_write(profile_prefix, "peer");
+    }
+    log_flush();
+    MPI_Allreduce(MPI_IN_PLACE, &failures, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
     MPI_Finalize();
-    return 0;
+    return failures > 0 ? 1 : 0;
 }
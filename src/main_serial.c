@@ -1,7 +1,10 @@
+#include "batch.h"
 #include "coordinator.h"
 #include "instance_io.h"
+#include "log.h"
 #include "low_level.h"
-#include "priority_queue.h"
+#include "open_list.h"
+#include "profile.h"
 
 #include <float.h>
 #include <mpi.h>
@@ -9,7 +12,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <unistd.h>
 
 typedef struct
 {
@@ -17,90 +19,97 @@ typedef struct
     LowLevelContext *ll_ctx;
 } SerialContext;
 
-static double wall_time_seconds(void)
-{
-    struct timespec ts;
-    timespec_get(&ts, TIME_UTC);
-    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
-}
+/*
+Replan the constrained agent of each child in one low-level batch,
+planned concurrently when the context has threads
 
-static HighLevelNode *clone_parent_node(const HighLevelNode *parent)
+@param ctx Pointer to the SerialContext
+@param children Children to replan
+@param agents Agent to replan per child
+@param count Number of children
+@param out_ok Output success flag per child
+*/
+static void replan_children(const SerialContext *ctx,
+                            HighLevelNode **children,
+                            const int *agents,
+                            int count,
+                            bool *out_ok)
 {
-    HighLevelNode *clone = cbs_node_create(parent->num_agents);
-    if (!clone)
-    {
-        return NULL;
-    }
-    clone->parent_id = parent->id;
-    clone->depth = parent->depth + 1;
-    clone->cost = parent->cost;
-    for (int i = 0; i < parent->constraints.count; ++i)
+    PathRef *new_paths[2];
+    AgentPath *outputs[2];
+    const HighLevelNode *nodes[2];
+    for (int i = 0; i < count; ++i)
     {
-        constraint_set_add(&clone->constraints, parent->constraints.items[i]);
+        new_paths[i] = path_ref_create();
+        outputs[i] = &new_paths[i]->path;
+        nodes[i] = children[i];
     }
-    for (int i = 0; i < parent->num_agents; ++i)
+    low_level_request_paths(ctx->instance, nodes, agents, count, ctx->ll_ctx, outputs, out_ok);
+    for (int i = 0; i < count; ++i)
     {
-        path_copy(&clone->paths[i], &parent->paths[i]);
+        if (out_ok[i])
+        {
+            cbs_node_set_path(children[i], agents[i], new_paths[i]);
+        }
+        else
+        {
+            path_ref_release(new_paths[i]);
+        }
     }
-    return clone;
 }
 
-static Constraint make_vertex_constraint(const Conflict *conflict, int agent_id)
-{
-    Constraint c = {.agent_id = agent_id,
-                    .time = conflict->time,
-                    .type = CONSTRAINT_VERTEX,
-                    .vertex = conflict->position,
-                    .edge_to = conflict->position};
-    return c;
-}
+/*
+Plan every root path in one low-level batch
 
-static Constraint make_edge_constraint(const HighLevelNode *node,
-                                       const Conflict *conflict,
-                                       int agent_id)
+@param instance Pointer to the ProblemInstance
+@param ll_ctx Pointer to the LowLevelContext
+@param root Pointer to the root node
+@return true if every agent has a path, false otherwise
+*/
+static bool plan_root(const ProblemInstance *instance, const LowLevelContext *ll_ctx, HighLevelNode *root)
 {
-    Constraint c = {.agent_id = agent_id,
-                    .time = conflict->time,
-                    .type = CONSTRAINT_EDGE,
-                    .vertex = conflict->position,
-                    .edge_to = conflict->edge_to};
-    if (agent_id == conflict->agent_b)
+    int count = instance->num_agents;
+    const HighLevelNode **nodes = (const HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)count);
+    int *agents = (int *)malloc(sizeof(int) * (size_t)count);
+    AgentPath **paths = (AgentPath **)malloc(sizeof(AgentPath *) * (size_t)count);
+    if (!nodes || !agents || !paths)
     {
-        GridCoord from = path_step_at(&node->paths[agent_id], conflict->time);
-        GridCoord to = path_step_at(&node->paths[agent_id], conflict->time + 1);
-        c.vertex = from;
-        c.edge_to = to;
+        fprintf(stderr, "plan_root: failed to allocate root batch (agents=%d)\n", count);
+        exit(EXIT_FAILURE);
     }
-    return c;
-}
-
-static bool replan_agent_path(const SerialContext *ctx,
-                              HighLevelNode *node,
-                              int agent_id)
-{
-    AgentPath new_path;
-    path_init(&new_path, 0);
-    bool ok = low_level_request_path(ctx->instance,
-                                     &node->constraints,
-                                     agent_id,
-                                     ctx->ll_ctx,
-                                     &new_path);
-    if (!ok)
+    for (int agent = 0; agent < count; ++agent)
     {
-        path_free(&new_path);
-        return false;
+        nodes[agent] = root;
+        agents[agent] = agent;
+        paths[agent] = &root->paths[agent]->path;
     }
-    path_free(&node->paths[agent_id]);
-    node->paths[agent_id] = new_path;
-    return true;
+    bool ok = low_level_request_paths(instance, nodes, agents, count, ll_ctx, paths, NULL);
+    free(nodes);
+    free(agents);
+    free(paths);
+    return ok;
 }
 
 static void run_serial_cbs(const ProblemInstance *instance,
+                           LowLevelEngine engine,
+                           size_t cache_bytes,
+                           size_t open_bytes,
+                           double suboptimality,
+                           int thread_count,
                            double timeout_seconds,
                            RunStats *stats)
 {
     double start = wall_time_seconds();
-    LowLevelContext ll_ctx = {.manager_world_rank = -1, .pool_comm = MPI_COMM_NULL};
+    AStarWorkspace workspace;
+    a_star_workspace_init(&workspace);
+    PathCache cache;
+    path_cache_init(&cache, cache_bytes);
+    LowLevelContext ll_ctx = {.manager_world_rank = -1,
+                              .pool_comm = MPI_COMM_NULL,
+                              .engine = engine,
+                              .workspace = &workspace,
+                              .cache = &cache};
+    low_level_threads_init(&ll_ctx, thread_count);
     SerialContext sctx = {.instance = instance, .ll_ctx = &ll_ctx};
 
     HighLevelNode *root = cbs_node_create(instance->num_agents);
@@ -108,20 +117,20 @@ static void run_serial_cbs(const ProblemInstance *instance,
     root->depth = 0;
     root->parent_id = -1;
 
-    for (int agent = 0; agent < instance->num_agents; ++agent)
+    if (!plan_root(instance, &ll_ctx, root))
     {
-        if (!low_level_request_path(instance, &root->constraints, agent, &ll_ctx, &root->paths[agent]))
-        {
-            fprintf(stderr, "Failed to compute initial path for agent %d.\n", agent);
-            cbs_node_free(root);
-            return;
-        }
+        fprintf(stderr, "Failed to compute initial paths.\n");
+        cbs_node_free(root);
+        low_level_threads_free(&ll_ctx);
+        a_star_workspace_free(&workspace);
+        path_cache_free(&cache);
+        return;
     }
     root->cost = cbs_compute_soc(root);
 
-    PriorityQueue open;
-    pq_init(&open);
-    pq_push(&open, root->cost, root);
+    OpenList open;
+    open_list_init(&open, instance, &ll_ctx, open_bytes, suboptimality);
+    open_list_push(&open, root);
 
     long long nodes_expanded = 0;
     long long nodes_generated = 0;
@@ -129,8 +138,9 @@ static void run_serial_cbs(const ProblemInstance *instance,
     long long max_nodes_expanded = 20000;
     HighLevelNode *incumbent = NULL;
     int timed_out = 0;
+    double lower_bound = DBL_MAX;
 
-    while (open.count > 0)
+    while (open_list_count(&open) > 0)
     {
         if (nodes_expanded >= max_nodes_expanded)
         {
@@ -143,59 +153,69 @@ static void run_serial_cbs(const ProblemInstance *instance,
             break;
         }
 
-        double key = 0.0;
-        HighLevelNode *node = (HighLevelNode *)pq_pop(&open, &key);
+        double frontier_lb = open_list_lower_bound(&open);
+        HighLevelNode *node = open_list_pop(&open);
+        if (!node)
+        {
+            break;
+        }
         nodes_expanded++;
+        profile_hl_expand();
+        profile_sample_open(open_list_count(&open));
 
         Conflict conflict;
-        if (!cbs_detect_conflict(node, &conflict))
+        cbs_prepare_mdds(node, instance, ll_ctx.threads);
+        if (!cbs_select_conflict(node, instance, &conflict, NULL))
         {
             if (incumbent)
             {
                 cbs_node_free(incumbent);
             }
             incumbent = node;
+            lower_bound = frontier_lb;
             break;
         }
 
         conflicts_detected++;
-        int child_agents[2] = {conflict.agent_a, conflict.agent_b};
+        HighLevelNode *children[2] = {NULL, NULL};
+        int child_agents[2];
+        int child_count = 0;
+        int conflict_agents[2] = {conflict.agent_a, conflict.agent_b};
         for (int idx = 0; idx < 2; ++idx)
         {
-            HighLevelNode *child = clone_parent_node(node);
-            if (!child)
+            HighLevelNode *child = cbs_node_create_child(node, cbs_conflict_constraint(node, &conflict, conflict_agents[idx]));
+            if (child)
             {
-                continue;
+                children[child_count] = child;
+                child_agents[child_count++] = conflict_agents[idx];
             }
-            Constraint c = conflict.is_vertex_conflict
-                               ? make_vertex_constraint(&conflict, child_agents[idx])
-                               : make_edge_constraint(node, &conflict, child_agents[idx]);
-            constraint_set_add(&child->constraints, c);
-
-            if (!replan_agent_path(&sctx, child, child_agents[idx]))
+        }
+        bool replanned[2] = {false, false};
+        replan_children(&sctx, children, child_agents, child_count, replanned);
+        for (int idx = 0; idx < child_count; ++idx)
+        {
+            HighLevelNode *child = children[idx];
+            if (!replanned[idx])
             {
                 cbs_node_free(child);
                 continue;
             }
 
             child->cost = cbs_compute_soc(child);
-            pq_push(&open, child->cost, child);
+            open_list_push(&open, child);
             nodes_generated++;
         }
 
         cbs_node_free(node);
     }
 
-    while (open.count > 0)
+    if (!incumbent && timed_out)
     {
-        double dummy = 0.0;
-        HighLevelNode *n = (HighLevelNode *)pq_pop(&open, &dummy);
-        if (n != incumbent)
-        {
-            cbs_node_free(n);
-        }
+        lower_bound = open_list_lower_bound(&open);
     }
-    pq_free(&open);
+    open_list_free(&open);
+    low_level_threads_free(&ll_ctx);
+    a_star_workspace_free(&workspace);
 
     if (stats)
     {
@@ -206,11 +226,26 @@ static void run_serial_cbs(const ProblemInstance *instance,
         stats->timed_out = timed_out;
         stats->best_cost = incumbent ? cbs_compute_soc(incumbent) : DBL_MAX;
         stats->runtime_sec = wall_time_seconds() - start;
+        stats->ll_cache_hits = cache.hits;
+        stats->ll_cache_misses = cache.misses;
+        stats->open_peak_resident = open.peak_resident;
+        stats->open_compressed = open.nodes_compressed;
+        stats->open_spilled = open.nodes_spilled;
+        stats->lower_bound = lower_bound;
     }
+    path_cache_free(&cache);
 
+    log_flush();
     if (incumbent)
     {
-        printf("[Serial] Solution cost: %.0f (nodes expanded=%lld)\n", incumbent->cost, nodes_expanded);
+        printf("[Serial] Solution cost: %.0f (nodes expanded=%lld, open resident=%lld compressed=%lld spilled=%lld, w=%.2f subopt=%.4f)\n",
+               incumbent->cost,
+               nodes_expanded,
+               open.peak_resident,
+               open.nodes_compressed,
+               open.nodes_spilled,
+               suboptimality,
+               achieved_suboptimality(incumbent->cost, lower_bound));
         cbs_node_free(incumbent);
     }
     else
@@ -219,21 +254,97 @@ static void run_serial_cbs(const ProblemInstance *instance,
     }
 }
 
+#define SERIAL_CSV_HEADER "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,ll_cache_hits,ll_cache_misses,open_peak_resident,open_compressed,open_spilled,w,lower_bound,suboptimality,timeout_sec,status"
+
+/*
+Append the result of one instance to the CSV file
+
+@param csv_path Path of the CSV file, its header is already written
+@param map_name File name of the instance's map
+@param instance Pointer to the solved ProblemInstance
+@param stats Pointer to the RunStats of the run
+@param suboptimality Suboptimality bound of the run
+@param timeout_seconds Timeout of the run
+*/
+static void append_result(const char *csv_path,
+                          const char *map_name,
+                          const ProblemInstance *instance,
+                          const RunStats *stats,
+                          double suboptimality,
+                          double timeout_seconds)
+{
+    FILE *fp = fopen(csv_path, "a");
+    if (!fp)
+    {
+        fprintf(stderr, "Warning: could not open CSV file %s for writing.\n", csv_path);
+        return;
+    }
+    const char *status = stats->solution_found ? "success" : (stats->timed_out ? "timeout" : "failure");
+    double cost_out = stats->solution_found ? stats->best_cost : -1.0;
+    double lower_bound_out = stats->lower_bound < DBL_MAX / 2.0 ? stats->lower_bound : -1.0;
+    double achieved = stats->solution_found ? achieved_suboptimality(stats->best_cost, stats->lower_bound) : -1.0;
+    fprintf(fp,
+            "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%lld,%lld,%lld,%lld,%lld,%.2f,%.0f,%.4f,%.2f,%s\n",
+            map_name,
+            instance->num_agents,
+            instance->map.width,
+            instance->map.height,
+            stats->nodes_expanded,
+            stats->nodes_generated,
+            stats->conflicts_detected,
+            cost_out,
+            stats->runtime_sec,
+            stats->ll_cache_hits,
+            stats->ll_cache_misses,
+            stats->open_peak_resident,
+            stats->open_compressed,
+            stats->open_spilled,
+            suboptimality,
+            lower_bound_out,
+            achieved,
+            timeout_seconds,
+            status);
+    fclose(fp);
+}
+
 int main(int argc, char **argv)
 {
     int mpi_initialized = 0;
     MPI_Initialized(&mpi_initialized);
     int did_mpi_init = 0;
+    int thread_support = MPI_THREAD_SINGLE;
     if (!mpi_initialized)
     {
-        MPI_Init(&argc, &argv);
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
         did_mpi_init = 1;
     }
+    else
+    {
+        MPI_Query_thread(&thread_support);
+    }
+    int world_rank = 0;
+    int world_size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
 
     const char *map_path = NULL;
     const char *agents_path = NULL;
+    const char *instance_path = NULL;
+    const char *manifest_path = NULL;
+    AgentSelection selection;
+    agent_selection_init(&selection);
     double timeout_seconds = 0.0;
     const char *csv_path = "results_serial.csv";
+    LowLevelEngine engine = LL_ENGINE_ASTAR;
+    bool engine_ok = true;
+    int log_level = LOG_LEVEL_INFO;
+    bool log_ok = true;
+    const char *profile_prefix = NULL;
+    double cache_mb = 64.0;
+    double open_mb = 0.0;
+    double batch_cache_mb = BATCH_DEFAULT_CACHE_MB;
+    double suboptimality = 1.0;
+    int thread_count = 1;
 
     for (int i = 1; i < argc; ++i)
     {
@@ -245,6 +356,34 @@ int main(int argc, char **argv)
         {
             agents_path = argv[++i];
         }
+        else if (strcmp(argv[i], "--instance") == 0 && i + 1 < argc)
+        {
+            instance_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc)
+        {
+            manifest_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--batch-cache-mb") == 0 && i + 1 < argc)
+        {
+            batch_cache_mb = atof(argv[++i]);
+            if (batch_cache_mb < 0.0)
+            {
+                batch_cache_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--scen-bucket") == 0 && i + 1 < argc)
+        {
+            selection.bucket = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--num-agents") == 0 && i + 1 < argc)
+        {
+            selection.count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--agent-offset") == 0 && i + 1 < argc)
+        {
+            selection.offset = atoi(argv[++i]);
+        }
         else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
         {
             timeout_seconds = atof(argv[++i]);
@@ -253,62 +392,145 @@ int main(int argc, char **argv)
         {
             csv_path = argv[++i];
         }
+        else if (strcmp(argv[i], "--low-level") == 0 && i + 1 < argc)
+        {
+            engine_ok = low_level_engine_parse(argv[++i], &engine) && engine_ok;
+        }
+        else if (strcmp(argv[i], "--ll-cache-mb") == 0 && i + 1 < argc)
+        {
+            cache_mb = atof(argv[++i]);
+            if (cache_mb < 0.0)
+            {
+                cache_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--w") == 0 && i + 1 < argc)
+        {
+            suboptimality = atof(argv[++i]);
+            if (suboptimality < 1.0)
+            {
+                suboptimality = 1.0;
+            }
+        }
+        else if (strcmp(argv[i], "--open-mem-mb") == 0 && i + 1 < argc)
+        {
+            open_mb = atof(argv[++i]);
+            if (open_mb < 0.0)
+            {
+                open_mb = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+        {
+            log_ok = log_level_parse(argv[++i], &log_level) && log_ok;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            thread_count = atoi(argv[++i]);
+        }
+    }
+    log_init(log_level);
+    profile_init(profile_prefix != NULL);
+    if (thread_count > 1 && thread_support < MPI_THREAD_FUNNELED)
+    {
+        fprintf(stderr, "Warning: MPI does not support threads, running with --threads 1.\n");
+        thread_count = 1;
     }
 
-    if (!map_path || !agents_path)
+    if (!engine_ok)
     {
-        fprintf(stderr, "Usage: serial_cbs --map map.txt --agents agents.txt [--timeout SEC] [--csv path]\n");
+        fprintf(stderr, "Unknown --low-level engine (expected astar, sipp or parallel).\n");
         return 1;
     }
-
-    ProblemInstance instance;
-    memset(&instance, 0, sizeof(instance));
-    if (!load_problem_instance(map_path, agents_path, &instance))
+    if (!log_ok)
     {
-        fprintf(stderr, "Failed to load problem instance.\n");
+        fprintf(stderr, "Unknown --log-level (expected error, info, debug or trace).\n");
+        return 1;
+    }
+    if (!manifest_path && !instance_path && (!map_path || !agents_path))
+    {
+        fprintf(stderr, "Usage: serial_cbs (--map map --agents scen [--scen-bucket B] [--num-agents N] [--agent-offset K] | --instance packed | --manifest file [--batch-cache-mb MB]) [--timeout SEC] [--csv path] [--low-level astar|sipp] [--ll-cache-mb MB] [--w bound] [--open-mem-mb MB] [--threads N] [--log-level error|info|debug|trace] [--profile prefix]\n");
         return 1;
     }
 
-    RunStats stats;
-    memset(&stats, 0, sizeof(RunStats));
-    run_serial_cbs(&instance, timeout_seconds, &stats);
-
-    const char *map_name = strrchr(map_path, '/');
-    map_name = map_name ? map_name + 1 : map_path;
-    int need_header = access(csv_path, F_OK) != 0;
-    FILE *fp = fopen(csv_path, "a");
-    if (fp)
+    // a single instance is a batch of one, without tables kept for later instances
+    Manifest manifest;
+    manifest_init(&manifest);
+    if (manifest_path)
     {
-        if (need_header)
+        if (!manifest_load(manifest_path, &manifest))
         {
-            fprintf(fp, "map,agents,width,height,nodes_expanded,nodes_generated,conflicts,cost,runtime_sec,timeout_sec,status\n");
+            fprintf(stderr, "Failed to load manifest %s.\n", manifest_path);
+            return 1;
         }
-        const char *status = stats.solution_found ? "success" : (stats.timed_out ? "timeout" : "failure");
-        double cost_out = stats.solution_found ? stats.best_cost : -1.0;
-        fprintf(fp,
-                "%s,%d,%d,%d,%lld,%lld,%lld,%.0f,%.6f,%.2f,%s\n",
-                map_name,
-                instance.num_agents,
-                instance.map.width,
-                instance.map.height,
-                stats.nodes_expanded,
-                stats.nodes_generated,
-                stats.conflicts_detected,
-                cost_out,
-                stats.runtime_sec,
-                timeout_seconds,
-                status);
-        fclose(fp);
     }
     else
     {
-        fprintf(stderr, "Warning: could not open CSV file %s for writing.\n", csv_path);
+        manifest_add(&manifest, map_path, agents_path, instance_path, &selection);
+        batch_cache_mb = 0.0;
     }
+    InstanceCache loader;
+    instance_cache_init(&loader, (size_t)(batch_cache_mb * 1024.0 * 1024.0));
 
-    problem_instance_free(&instance);
+    // every rank solves its share of the instances on its own
+    if (world_rank == 0)
+    {
+        batch_csv_header(csv_path, SERIAL_CSV_HEADER);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    int failures = 0;
+    double batch_start = wall_time_seconds();
+    for (int entry = world_rank; entry < manifest.count; entry += world_size)
+    {
+        ProblemInstance instance;
+        memset(&instance, 0, sizeof(instance));
+        if (!instance_cache_load(&loader, &manifest.entries[entry], &instance))
+        {
+            fprintf(stderr, "Failed to load problem instance %d of %d.\n", entry + 1, manifest.count);
+            failures++;
+            continue;
+        }
+        if (manifest_path)
+        {
+            LOG_INFO("[Serial %d] Instance %d/%d: %s with %d agents\n", world_rank, entry + 1, manifest.count,
+                     manifest_entry_name(&manifest.entries[entry]), instance.num_agents);
+        }
+
+        RunStats stats;
+        memset(&stats, 0, sizeof(RunStats));
+        stats.lower_bound = DBL_MAX;
+        run_serial_cbs(&instance,
+                       engine,
+                       (size_t)(cache_mb * 1024.0 * 1024.0),
+                       (size_t)(open_mb * 1024.0 * 1024.0),
+                       suboptimality,
+                       thread_count,
+                       timeout_seconds,
+                       &stats);
+        append_result(csv_path, manifest_entry_name(&manifest.entries[entry]), &instance, &stats, suboptimality,
+                      timeout_seconds);
+        problem_instance_free(&instance);
+    }
+    if (manifest_path)
+    {
+        LOG_INFO("[Serial %d] Batch done in %.3fs, goal tables cached=%lld computed=%lld\n", world_rank,
+                 wall_time_seconds() - batch_start, loader.table_hits, loader.table_misses);
+    }
+    instance_cache_free(&loader);
+    manifest_free(&manifest);
+
+    if (profile_prefix)
+    {
+        profile_write(profile_prefix, "serial");
+    }
+    log_flush();
     if (did_mpi_init)
     {
         MPI_Finalize();
     }
-    return 0;
+    return failures > 0 ? 1 : 0;
 }
@@ -0,0 +1,190 @@
+#include "mdd.h"
+
+#include "heuristic.h"
+#include "profile.h"
+#include "state_table.h"
+
+#include <stdio.h>
+
+/* Cells of all forward layers, layer t occupies [offsets[t], offsets[t + 1]) */
+typedef struct
+{
+    /** Linear cell indices */
+    int *cells;
+    /** Number of cells */
+    int count;
+    /** Capacity of the cells array */
+    int capacity;
+} LayerCells;
+
+static void layer_cells_push(LayerCells *layers, int cell)
+{
+    if (layers->count >= layers->capacity)
+    {
+        int new_cap = layers->capacity == 0 ? 256 : layers->capacity * 2;
+        int *new_cells = (int *)realloc(layers->cells, sizeof(int) * (size_t)new_cap);
+        if (!new_cells)
+        {
+            fprintf(stderr, "layer_cells_push: failed to allocate MDD layers (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        layers->cells = new_cells;
+        layers->capacity = new_cap;
+    }
+    layers->cells[layers->count++] = cell;
+}
+
+/*
+Initialize an empty Mdd
+
+@param mdd Pointer to the Mdd to initialize
+*/
+void mdd_init(Mdd *mdd)
+{
+    mdd->depth = -1;
+    mdd->widths = NULL;
+    mdd->singletons = NULL;
+}
+
+/*
+Free memory used by Mdd
+
+@param mdd Pointer to the Mdd to free
+*/
+void mdd_free(Mdd *mdd)
+{
+    free(mdd->widths);
+    free(mdd->singletons);
+    mdd_init(mdd);
+}
+
+/*
+Build the MDD of an agent for a given arrival time.
+A forward pass keeps the states reachable under the constraints that can
+still reach the goal in time (t + h <= depth), then a backward pass from
+(goal, depth) keeps only states lying on some complete path.
+
+@param grid Pointer to the Grid
+@param constraints Pointer to the ConstraintSet (may hold other agents' constraints)
+@param start Starting GridCoord
+@param goal Goal GridCoord
+@param heuristic Exact goal distance table for this agent (NULL uses Manhattan distance)
+@param agent_id ID of the agent
+@param depth Arrival time of the agent's optimal path (path length - 1)
+@param out Pointer to the Mdd to fill (previous contents are freed)
+@return true if the goal is reachable at depth, false otherwise
+*/
+bool mdd_build(const Grid *grid,
+               const ConstraintSet *constraints,
+               GridCoord start,
+               GridCoord goal,
+               const int *heuristic,
+               int agent_id,
+               int depth,
+               Mdd *out)
+{
+    mdd_free(out);
+    if (depth < 0)
+    {
+        return false;
+    }
+    double phase_start = profile_start();
+
+    ConstraintIndex index;
+    constraint_index_init(&index);
+    constraint_index_build(&index, constraints, agent_id);
+
+    int *offsets = (int *)malloc(sizeof(int) * (size_t)(depth + 2));
+    LayerCells layers = {.cells = NULL, .count = 0, .capacity = 0};
+    StateTable reached;
+    state_table_init(&reached);
+
+    offsets[0] = 0;
+    layer_cells_push(&layers, start.y * grid->width + start.x);
+    offsets[1] = 1;
+    for (int t = 0; t < depth; ++t)
+    {
+        for (int i = offsets[t]; i < offsets[t + 1]; ++i)
+        {
+            int cell = layers.cells[i];
+            GridCoord position = {.x = cell % grid->width, .y = cell / grid->width};
+            // mask bits follow the low-level successor order, wait first
+            int m = 0;
+            for (unsigned int mask = grid_moves(grid, cell); mask != 0; mask >>= 1, ++m)
+            {
+                if ((mask & 1u) == 0)
+                {
+                    continue;
+                }
+                int next = grid_move_cell(grid, cell, m);
+                int h = heuristic_lookup(heuristic, grid, grid_apply_move(position, m), goal);
+                if (h == HEURISTIC_UNREACHABLE || t + 1 + h > depth)
+                {
+                    continue;
+                }
+                if (constraint_index_blocks(&index, t, cell, next))
+                {
+                    continue;
+                }
+                if (state_table_improve(&reached, t + 1, next, 0))
+                {
+                    layer_cells_push(&layers, next);
+                }
+            }
+        }
+        offsets[t + 2] = layers.count;
+    }
+
+    int goal_cell = goal.y * grid->width + goal.x;
+    bool found = depth == 0 ? goal_cell == layers.cells[0] : state_table_contains(&reached, depth, goal_cell);
+    if (found)
+    {
+        out->depth = depth;
+        out->widths = (int *)calloc((size_t)(depth + 1), sizeof(int));
+        out->singletons = (int *)calloc((size_t)(depth + 1), sizeof(int));
+        if (!out->widths || !out->singletons)
+        {
+            fprintf(stderr, "mdd_build: failed to allocate MDD (depth=%d)\n", depth);
+            exit(EXIT_FAILURE);
+        }
+        out->widths[depth] = 1;
+        out->singletons[depth] = goal_cell;
+
+        // backward pass: alive states have a successor that is alive
+        StateTable alive;
+        state_table_init(&alive);
+        state_table_improve(&alive, depth, goal_cell, 0);
+        for (int t = depth - 1; t >= 0; --t)
+        {
+            for (int i = offsets[t]; i < offsets[t + 1]; ++i)
+            {
+                int cell = layers.cells[i];
+                int m = 0;
+                for (unsigned int mask = grid_moves(grid, cell); mask != 0; mask >>= 1, ++m)
+                {
+                    if ((mask & 1u) == 0)
+                    {
+                        continue;
+                    }
+                    int next = grid_move_cell(grid, cell, m);
+                    if (!state_table_contains(&alive, t + 1, next) || constraint_index_blocks(&index, t, cell, next))
+                    {
+                        continue;
+                    }
+                    state_table_improve(&alive, t, cell, 0);
+                    out->widths[t]++;
+                    out->singletons[t] = cell;
+                    break;
+                }
+            }
+        }
+        state_table_free(&alive);
+    }
+
+    state_table_free(&reached);
+    free(layers.cells);
+    free(offsets);
+    constraint_index_free(&index);
+    profile_stop(PROFILE_MDD, phase_start);
+    return found;
+}
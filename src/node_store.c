@@ -0,0 +1,298 @@
+#include "node_store.h"
+
+#include <stdio.h>
+
+static bool handle_before(const NodeHandle *a, const NodeHandle *b)
+{
+    if (a->cost != b->cost)
+    {
+        return a->cost < b->cost;
+    }
+    return a->conflicts < b->conflicts;
+}
+
+/*
+Initialize an empty HandleQueue
+
+@param queue Pointer to the HandleQueue to initialize
+*/
+void handle_queue_init(HandleQueue *queue)
+{
+    queue->items = NULL;
+    queue->count = 0;
+    queue->capacity = 0;
+}
+
+/*
+Free memory used by HandleQueue
+
+@param queue Pointer to the HandleQueue to free
+*/
+void handle_queue_free(HandleQueue *queue)
+{
+    free(queue->items);
+    handle_queue_init(queue);
+}
+
+/*
+Push a handle onto the queue
+
+@param queue Pointer to the HandleQueue
+@param handle Handle to push (copied)
+*/
+void handle_queue_push(HandleQueue *queue, NodeHandle handle)
+{
+    if (queue->count >= queue->capacity)
+    {
+        int new_cap = queue->capacity == 0 ? 64 : queue->capacity * 2;
+        NodeHandle *new_items = (NodeHandle *)realloc(queue->items, sizeof(NodeHandle) * (size_t)new_cap);
+        if (!new_items)
+        {
+            fprintf(stderr, "handle_queue_push: failed to allocate memory for HandleQueue (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        queue->items = new_items;
+        queue->capacity = new_cap;
+    }
+    int idx = queue->count++;
+    while (idx > 0)
+    {
+        int parent = (idx - 1) / 2;
+        if (!handle_before(&handle, &queue->items[parent]))
+        {
+            break;
+        }
+        queue->items[idx] = queue->items[parent];
+        idx = parent;
+    }
+    queue->items[idx] = handle;
+}
+
+/*
+Pop the best handle
+
+@param queue Pointer to the HandleQueue
+@param out_handle Output popped handle
+@return true if a handle was popped, false if the queue is empty
+*/
+bool handle_queue_pop(HandleQueue *queue, NodeHandle *out_handle)
+{
+    if (queue->count == 0)
+    {
+        return false;
+    }
+    *out_handle = queue->items[0];
+    NodeHandle last = queue->items[--queue->count];
+    int idx = 0;
+    while (true)
+    {
+        int child = idx * 2 + 1;
+        if (child >= queue->count)
+        {
+            break;
+        }
+        if (child + 1 < queue->count && handle_before(&queue->items[child + 1], &queue->items[child]))
+        {
+            child++;
+        }
+        if (!handle_before(&queue->items[child], &last))
+        {
+            break;
+        }
+        queue->items[idx] = queue->items[child];
+        idx = child;
+    }
+    if (queue->count > 0)
+    {
+        queue->items[idx] = last;
+    }
+    return true;
+}
+
+/*
+@param queue Pointer to the HandleQueue
+@return Best handle, or NULL if the queue is empty
+*/
+const NodeHandle *handle_queue_peek(const HandleQueue *queue)
+{
+    return queue->count > 0 ? &queue->items[0] : NULL;
+}
+
+static inline int store_slot(int node_id, int capacity)
+{
+    return (int)(((unsigned int)node_id * 2654435761u) & (unsigned int)(capacity - 1));
+}
+
+static void store_grow(NodeStore *store)
+{
+    int old_capacity = store->capacity;
+    int *old_ids = store->ids;
+    HighLevelNode **old_nodes = store->nodes;
+
+    store->capacity = old_capacity == 0 ? 256 : old_capacity * 2;
+    store->ids = (int *)malloc(sizeof(int) * (size_t)store->capacity);
+    store->nodes = (HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)store->capacity);
+    if (!store->ids || !store->nodes)
+    {
+        fprintf(stderr, "store_grow: failed to allocate NodeStore (size=%d)\n", store->capacity);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < store->capacity; ++i)
+    {
+        store->ids[i] = -1;
+    }
+    store->count = 0;
+    for (int i = 0; i < old_capacity; ++i)
+    {
+        if (old_ids[i] >= 0)
+        {
+            node_store_put(store, old_nodes[i]);
+        }
+    }
+    free(old_ids);
+    free(old_nodes);
+}
+
+/*
+Initialize an empty NodeStore
+
+@param store Pointer to the NodeStore to initialize
+*/
+void node_store_init(NodeStore *store)
+{
+    store->ids = NULL;
+    store->nodes = NULL;
+    store->capacity = 0;
+    store->count = 0;
+}
+
+/*
+Free the NodeStore and every node still in it
+
+@param store Pointer to the NodeStore to free
+*/
+void node_store_free(NodeStore *store)
+{
+    for (int i = 0; i < store->capacity; ++i)
+    {
+        if (store->ids[i] >= 0)
+        {
+            cbs_node_free(store->nodes[i]);
+        }
+    }
+    free(store->ids);
+    free(store->nodes);
+    node_store_init(store);
+}
+
+/*
+Insert a node, the store takes ownership
+
+@param store Pointer to the NodeStore
+@param node Node with a unique non-negative id
+*/
+void node_store_put(NodeStore *store, HighLevelNode *node)
+{
+    // keep the load factor at or below one half
+    if ((store->count + 1) * 2 > store->capacity)
+    {
+        store_grow(store);
+    }
+    int slot = store_slot(node->id, store->capacity);
+    while (store->ids[slot] >= 0)
+    {
+        slot = (slot + 1) & (store->capacity - 1);
+    }
+    store->ids[slot] = node->id;
+    store->nodes[slot] = node;
+    store->count++;
+}
+
+/*
+Remove a node from the store and hand it to the caller
+
+@param store Pointer to the NodeStore
+@param node_id ID of the node
+@return The node (now owned by the caller), or NULL if not stored
+*/
+HighLevelNode *node_store_take(NodeStore *store, int node_id)
+{
+    if (store->count == 0)
+    {
+        return NULL;
+    }
+    int mask = store->capacity - 1;
+    int slot = store_slot(node_id, store->capacity);
+    while (store->ids[slot] != node_id)
+    {
+        if (store->ids[slot] < 0)
+        {
+            return NULL;
+        }
+        slot = (slot + 1) & mask;
+    }
+    HighLevelNode *node = store->nodes[slot];
+    store->count--;
+
+    // shift later entries of the probe run back so lookups never hit a gap
+    int hole = slot;
+    int next = (hole + 1) & mask;
+    while (store->ids[next] >= 0)
+    {
+        int home = store_slot(store->ids[next], store->capacity);
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            store->ids[hole] = store->ids[next];
+            store->nodes[hole] = store->nodes[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    store->ids[hole] = -1;
+    store->nodes[hole] = NULL;
+    return node;
+}
+
+/*
+Free every stored node whose cost is at or above a bound
+
+@param store Pointer to the NodeStore
+@param bound Incumbent cost
+@return Number of nodes freed
+*/
+int node_store_prune(NodeStore *store, double bound)
+{
+    int pruned = 0;
+    int kept = 0;
+    HighLevelNode **survivors = store->count > 0 ? (HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)store->count) : NULL;
+    if (store->count > 0 && !survivors)
+    {
+        fprintf(stderr, "node_store_prune: failed to allocate survivors (count=%d)\n", store->count);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < store->capacity; ++i)
+    {
+        if (store->ids[i] < 0)
+        {
+            continue;
+        }
+        if (store->nodes[i]->cost >= bound)
+        {
+            cbs_node_free(store->nodes[i]);
+            pruned++;
+        }
+        else
+        {
+            survivors[kept++] = store->nodes[i];
+        }
+        store->ids[i] = -1;
+        store->nodes[i] = NULL;
+    }
+    store->count = 0;
+    for (int i = 0; i < kept; ++i)
+    {
+        node_store_put(store, survivors[i]);
+    }
+    free(survivors);
+    return pruned;
+}
@@ -0,0 +1,749 @@
+#define _DEFAULT_SOURCE  /* For mkstemp() and fdopen() on Linux */
+#include "open_list.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Fixed part of a run record: id, parent id, depth, constraint count and conflict count */
+#define SPILL_HEADER_INTS 5
+
+static bool entry_before(const OpenHeap *heap, const OpenEntry *a, const OpenEntry *b)
+{
+    if (heap->by_conflicts && a->conflicts != b->conflicts)
+    {
+        return a->conflicts < b->conflicts;
+    }
+    return a->cost < b->cost;
+}
+
+static void heap_init(OpenHeap *heap, bool by_conflicts)
+{
+    heap->items = NULL;
+    heap->count = 0;
+    heap->capacity = 0;
+    heap->by_conflicts = by_conflicts;
+}
+
+static void heap_free(OpenHeap *heap)
+{
+    free(heap->items);
+    heap_init(heap, heap->by_conflicts);
+}
+
+static void heap_push(OpenHeap *heap, OpenEntry entry)
+{
+    if (heap->count >= heap->capacity)
+    {
+        int new_cap = heap->capacity == 0 ? 16 : heap->capacity * 2;
+        OpenEntry *new_items = (OpenEntry *)realloc(heap->items, sizeof(OpenEntry) * (size_t)new_cap);
+        if (!new_items)
+        {
+            fprintf(stderr, "heap_push: failed to allocate memory for OpenHeap (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        heap->items = new_items;
+        heap->capacity = new_cap;
+    }
+    int idx = heap->count++;
+    while (idx > 0)
+    {
+        int parent = (idx - 1) / 2;
+        if (!entry_before(heap, &entry, &heap->items[parent]))
+        {
+            break;
+        }
+        heap->items[idx] = heap->items[parent];
+        idx = parent;
+    }
+    heap->items[idx] = entry;
+}
+
+static void heap_sift_down(OpenHeap *heap, int idx)
+{
+    OpenEntry entry = heap->items[idx];
+    while (true)
+    {
+        int child = idx * 2 + 1;
+        if (child >= heap->count)
+        {
+            break;
+        }
+        if (child + 1 < heap->count && entry_before(heap, &heap->items[child + 1], &heap->items[child]))
+        {
+            child++;
+        }
+        if (!entry_before(heap, &heap->items[child], &entry))
+        {
+            break;
+        }
+        heap->items[idx] = heap->items[child];
+        idx = child;
+    }
+    heap->items[idx] = entry;
+}
+
+static bool heap_pop(OpenHeap *heap, OpenEntry *out_entry)
+{
+    if (heap->count == 0)
+    {
+        return false;
+    }
+    *out_entry = heap->items[0];
+    heap->items[0] = heap->items[--heap->count];
+    if (heap->count > 0)
+    {
+        heap_sift_down(heap, 0);
+    }
+    return true;
+}
+
+/* Restore the heap order of an arbitrary items array */
+static void heap_build(OpenHeap *heap)
+{
+    for (int i = heap->count / 2 - 1; i >= 0; --i)
+    {
+        heap_sift_down(heap, i);
+    }
+}
+
+/*
+Estimated memory held by a queued node alone. Paths are shared along the
+tree, so a node is charged its own structures and the path of the agent
+its newest constraint replanned (every path at the root).
+
+@param node Pointer to the HighLevelNode
+@return Estimated bytes
+*/
+static size_t node_bytes(const HighLevelNode *node)
+{
+    size_t bytes = sizeof(HighLevelNode) + sizeof(ConstraintLink);
+    if (node->paths == NULL)
+    {
+        return bytes;
+    }
+    bytes += sizeof(PathRef *) * (size_t)node->num_agents;
+    bytes += sizeof(Conflict) * (size_t)node->conflicts.capacity;
+    int agent = node->constraints ? node->constraints->constraint.agent_id : -1;
+    for (int i = 0; i < node->num_agents; ++i)
+    {
+        if (agent < 0 || agent >= node->num_agents || i == agent)
+        {
+            bytes += sizeof(PathRef) + sizeof(int) * (size_t)node->paths[i]->path.length;
+        }
+    }
+    return bytes;
+}
+
+static size_t max_size(size_t a, size_t b)
+{
+    return a > b ? a : b;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    double ka = ((const OpenEntry *)a)->cost;
+    double kb = ((const OpenEntry *)b)->cost;
+    return (ka > kb) - (ka < kb);
+}
+
+/*
+Initialize an empty OpenList
+
+@param open Pointer to the OpenList to initialize
+@param instance Pointer to the ProblemInstance compressed nodes are replanned on
+@param ll_ctx Pointer to the LowLevelContext compressed nodes are replanned with
+@param budget_bytes Memory budget in bytes (0 keeps every node resident)
+@param suboptimality Focal bound w (1 or less pops strictly by cost)
+*/
+void open_list_init(OpenList *open,
+                    const ProblemInstance *instance,
+                    const LowLevelContext *ll_ctx,
+                    size_t budget_bytes,
+                    double suboptimality)
+{
+    memset(open, 0, sizeof(OpenList));
+    heap_init(&open->queue, false);
+    heap_init(&open->focal, true);
+    pq_init(&open->focal_costs);
+    pq_init(&open->focal_removed);
+    open->focal_bound = -1.0;
+    open->focal_lb_cap = DBL_MAX;
+    open->suboptimality = suboptimality > 1.0 ? suboptimality : 1.0;
+    open->instance = instance;
+    open->ll_ctx = ll_ctx;
+    open->budget_bytes = budget_bytes;
+    open->compress_at = (size_t)((double)budget_bytes * OPEN_COMPRESS_FRACTION);
+    open->spill_at = budget_bytes;
+}
+
+/*
+Free every open node, in memory and spilled, and close the run files.
+The settings and the counters are kept.
+
+@param open Pointer to the OpenList
+*/
+void open_list_clear(OpenList *open)
+{
+    for (int i = 0; i < open->queue.count; ++i)
+    {
+        cbs_node_free(open->queue.items[i].node);
+    }
+    open->queue.count = 0;
+    for (int i = 0; i < open->focal.count; ++i)
+    {
+        cbs_node_free(open->focal.items[i].node);
+    }
+    open->focal.count = 0;
+    open->focal_costs.count = 0;
+    open->focal_removed.count = 0;
+    open->focal_bound = -1.0;
+    for (int r = 0; r < open->run_count; ++r)
+    {
+        cbs_node_free(open->runs[r].head.node);
+        fclose(open->runs[r].file);
+    }
+    open->run_count = 0;
+    open->bytes = 0;
+    open->compressed_count = 0;
+    open->spilled_count = 0;
+}
+
+/*
+Free memory used by OpenList, including every node still open
+
+@param open Pointer to the OpenList to free
+*/
+void open_list_free(OpenList *open)
+{
+    open_list_clear(open);
+    heap_free(&open->queue);
+    heap_free(&open->focal);
+    pq_free(&open->focal_costs);
+    pq_free(&open->focal_removed);
+    free(open->runs);
+    open->runs = NULL;
+    open->run_capacity = 0;
+}
+
+/*
+Lowest cost among the focal nodes, dropping the costs of popped ones
+
+@param open Pointer to the OpenList
+@return Lowest focal cost, DBL_MAX if the focal list is empty
+*/
+static double focal_min_cost(OpenList *open)
+{
+    PriorityQueue *costs = &open->focal_costs;
+    PriorityQueue *removed = &open->focal_removed;
+    while (removed->count > 0 && costs->count > 0 && removed->items[0].key <= costs->items[0].key)
+    {
+        pq_pop(costs, NULL);
+        pq_pop(removed, NULL);
+    }
+    return costs->count > 0 ? costs->items[0].key : DBL_MAX;
+}
+
+/*
+Lowest cost among the nodes in memory. Run heads never undercut it, see
+merge_runs.
+
+@param open Pointer to the OpenList
+@return Lowest cost, DBL_MAX if no node is in memory
+*/
+static double memory_lower_bound(OpenList *open)
+{
+    double lower_bound = focal_min_cost(open);
+    if (open->queue.count > 0 && open->queue.items[0].cost < lower_bound)
+    {
+        lower_bound = open->queue.items[0].cost;
+    }
+    return lower_bound;
+}
+
+/*
+Create an unlinked temporary file under $TMPDIR (or /tmp)
+
+@return Open file, or NULL on failure
+*/
+static FILE *create_run_file(void)
+{
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0')
+    {
+        dir = "/tmp";
+    }
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/cbs_open_XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    // the file lives as long as it is open
+    unlink(path);
+    FILE *file = fdopen(fd, "w+b");
+    if (!file)
+    {
+        close(fd);
+    }
+    return file;
+}
+
+/*
+Write a node's search state (everything but its paths) as one run record
+
+@param file Run file
+@param entry Queued entry of the node
+@param chain Scratch array of at least the node's constraint_count constraints
+@return true on success, false on a write error
+*/
+static bool write_record(FILE *file, const OpenEntry *entry, Constraint *chain)
+{
+    const HighLevelNode *node = entry->node;
+    int header[SPILL_HEADER_INTS] = {node->id, node->parent_id, node->depth, node->constraint_count, entry->conflicts};
+    int count = 0;
+    // the chain runs newest first, records store it oldest first
+    for (const ConstraintLink *link = node->constraints; link && count < node->constraint_count; link = link->parent)
+    {
+        chain[node->constraint_count - 1 - count++] = link->constraint;
+    }
+    return fwrite(header, sizeof(int), SPILL_HEADER_INTS, file) == SPILL_HEADER_INTS &&
+           fwrite(&entry->cost, sizeof(double), 1, file) == 1 &&
+           fwrite(chain, sizeof(Constraint), (size_t)count, file) == (size_t)count;
+}
+
+/*
+Read the next record of a run into its head as a compressed node
+
+@param run Pointer to the SpillRun
+@param num_agents Number of agents in the problem instance
+@return true if a node was read, false if the run is exhausted
+*/
+static bool read_record(SpillRun *run, int num_agents)
+{
+    run->head.node = NULL;
+    if (run->remaining == 0)
+    {
+        return false;
+    }
+    run->remaining--;
+    int header[SPILL_HEADER_INTS];
+    double cost = 0.0;
+    if (fread(header, sizeof(int), SPILL_HEADER_INTS, run->file) != SPILL_HEADER_INTS ||
+        fread(&cost, sizeof(double), 1, run->file) != 1 ||
+        header[3] < 0)
+    {
+        fprintf(stderr, "read_record: truncated open list run file\n");
+        exit(EXIT_FAILURE);
+    }
+    HighLevelNode *node = cbs_node_create(num_agents);
+    if (!node)
+    {
+        fprintf(stderr, "read_record: failed to allocate HighLevelNode (agents=%d)\n", num_agents);
+        exit(EXIT_FAILURE);
+    }
+    cbs_node_compress(node);
+    node->id = header[0];
+    node->parent_id = header[1];
+    node->depth = header[2];
+    node->cost = cost;
+    for (int i = 0; i < header[3]; ++i)
+    {
+        Constraint constraint;
+        if (fread(&constraint, sizeof(Constraint), 1, run->file) != 1)
+        {
+            fprintf(stderr, "read_record: truncated open list run file\n");
+            exit(EXIT_FAILURE);
+        }
+        cbs_node_add_constraint(node, constraint);
+    }
+    run->head = (OpenEntry){.cost = cost, .conflicts = header[4], .node = node};
+    return true;
+}
+
+/*
+Compress queued nodes costlier than the lower bound, starting from the
+heap's leaves where the costliest nodes sit, until the estimate is back
+under half of the compression threshold
+
+@param open Pointer to the OpenList
+*/
+static void compress_far_nodes(OpenList *open)
+{
+    size_t threshold = (size_t)((double)open->budget_bytes * OPEN_COMPRESS_FRACTION);
+    size_t target = threshold / 2;
+    double lower_bound = memory_lower_bound(open);
+    for (int i = open->queue.count - 1; i >= 0 && open->bytes > target; --i)
+    {
+        HighLevelNode *node = open->queue.items[i].node;
+        if (node->paths == NULL || open->queue.items[i].cost <= lower_bound + 1e-6)
+        {
+            continue;
+        }
+        open->bytes -= node_bytes(node);
+        cbs_node_compress(node);
+        open->bytes += node_bytes(node);
+        open->compressed_count++;
+        open->nodes_compressed++;
+    }
+    // when too few nodes could be compressed, wait for some growth before scanning again
+    open->compress_at = max_size(threshold, open->bytes + open->budget_bytes / 8);
+}
+
+/*
+Move the costlier half of the queue, but no node at the lower bound, to a
+new run file sorted by cost
+
+@param open Pointer to the OpenList
+*/
+static void spill_far_nodes(OpenList *open)
+{
+    OpenHeap *queue = &open->queue;
+    double lower_bound = memory_lower_bound(open);
+    // a cost-sorted array is a valid heap, so the kept half needs no rebuild
+    qsort(queue->items, (size_t)queue->count, sizeof(OpenEntry), compare_entries);
+    int keep = queue->count / 2;
+    while (keep < queue->count && queue->items[keep].cost <= lower_bound + 1e-6)
+    {
+        keep++;
+    }
+    if (keep == queue->count)
+    {
+        open->spill_at = max_size(open->budget_bytes, open->bytes + open->budget_bytes / 8);
+        return;
+    }
+
+    FILE *file = create_run_file();
+    if (!file)
+    {
+        fprintf(stderr, "Warning: could not create an open list run file, keeping every node in memory.\n");
+        open->spill_failed = true;
+        return;
+    }
+    int max_constraints = 0;
+    for (int i = keep; i < queue->count; ++i)
+    {
+        const HighLevelNode *node = queue->items[i].node;
+        if (node->constraint_count > max_constraints)
+        {
+            max_constraints = node->constraint_count;
+        }
+    }
+    Constraint *chain = (Constraint *)malloc(sizeof(Constraint) * (size_t)(max_constraints > 0 ? max_constraints : 1));
+    if (!chain)
+    {
+        fprintf(stderr, "spill_far_nodes: failed to allocate constraint buffer (count=%d)\n", max_constraints);
+        exit(EXIT_FAILURE);
+    }
+    bool ok = true;
+    for (int i = keep; i < queue->count && ok; ++i)
+    {
+        ok = write_record(file, &queue->items[i], chain);
+    }
+    free(chain);
+    if (!ok || fflush(file) != 0)
+    {
+        fprintf(stderr, "Warning: could not write the open list run file, keeping every node in memory.\n");
+        fclose(file);
+        open->spill_failed = true;
+        return;
+    }
+    rewind(file);
+
+    if (open->run_count >= open->run_capacity)
+    {
+        int new_cap = open->run_capacity == 0 ? 4 : open->run_capacity * 2;
+        SpillRun *new_runs = (SpillRun *)realloc(open->runs, sizeof(SpillRun) * (size_t)new_cap);
+        if (!new_runs)
+        {
+            fprintf(stderr, "spill_far_nodes: failed to allocate run list (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        open->runs = new_runs;
+        open->run_capacity = new_cap;
+    }
+    int spilled = queue->count - keep;
+    for (int i = keep; i < queue->count; ++i)
+    {
+        HighLevelNode *node = queue->items[i].node;
+        open->bytes -= node_bytes(node);
+        if (node->paths == NULL)
+        {
+            open->compressed_count--;
+        }
+        cbs_node_free(node);
+    }
+    queue->count = keep;
+    SpillRun *run = &open->runs[open->run_count++];
+    run->file = file;
+    run->remaining = spilled;
+    read_record(run, open->instance->num_agents);
+    open->spilled_count += spilled;
+    open->nodes_spilled += spilled;
+    open->spill_at = max_size(open->budget_bytes, open->bytes + open->budget_bytes / 8);
+    open->compress_at = max_size((size_t)((double)open->budget_bytes * OPEN_COMPRESS_FRACTION),
+                                 open->bytes + open->budget_bytes / 8);
+}
+
+/*
+Insert an entry into the focal list or the queue and update the estimate
+
+@param open Pointer to the OpenList
+@param entry Entry to insert (its node is owned by the list)
+*/
+static void entry_insert(OpenList *open, OpenEntry entry)
+{
+    if (open->suboptimality > 1.0 && entry.cost <= open->focal_bound + 1e-6)
+    {
+        heap_push(&open->focal, entry);
+        pq_push(&open->focal_costs, entry.cost, NULL);
+    }
+    else
+    {
+        heap_push(&open->queue, entry);
+    }
+    open->bytes += node_bytes(entry.node);
+    if (entry.node->paths == NULL)
+    {
+        open->compressed_count++;
+    }
+    if (open->queue.count + open->focal.count > open->peak_resident)
+    {
+        open->peak_resident = open->queue.count + open->focal.count;
+    }
+}
+
+/*
+Move run heads cheaper than the best queued node into memory, so the
+queue's top is always the cheapest node outside the focal list
+
+@param open Pointer to the OpenList
+*/
+static void merge_runs(OpenList *open)
+{
+    while (open->run_count > 0)
+    {
+        int best = 0;
+        for (int r = 1; r < open->run_count; ++r)
+        {
+            if (open->runs[r].head.cost < open->runs[best].head.cost)
+            {
+                best = r;
+            }
+        }
+        SpillRun *run = &open->runs[best];
+        if (open->queue.count > 0 && run->head.cost >= open->queue.items[0].cost)
+        {
+            return;
+        }
+        entry_insert(open, run->head);
+        open->spilled_count--;
+        if (!read_record(run, open->instance->num_agents))
+        {
+            fclose(run->file);
+            open->runs[best] = open->runs[--open->run_count];
+        }
+    }
+}
+
+/*
+Bring the focal list up to date with the current lower bound: nodes over
+a lowered bound go back to the queue, queued nodes under a raised bound
+move in
+
+@param open Pointer to the OpenList
+*/
+static void refresh_focal(OpenList *open)
+{
+    merge_runs(open);
+    if (open->suboptimality <= 1.0)
+    {
+        return;
+    }
+    double lower_bound = memory_lower_bound(open);
+    if (lower_bound == DBL_MAX)
+    {
+        return;
+    }
+    if (open->focal_lb_cap < lower_bound)
+    {
+        lower_bound = open->focal_lb_cap;
+    }
+    double bound = open->suboptimality * lower_bound;
+    if (bound < open->focal_bound - 1e-6)
+    {
+        // only when a node cheaper than every open one arrived, so rebuilding is rare
+        int kept = 0;
+        open->focal_costs.count = 0;
+        open->focal_removed.count = 0;
+        for (int i = 0; i < open->focal.count; ++i)
+        {
+            OpenEntry entry = open->focal.items[i];
+            if (entry.cost <= bound + 1e-6)
+            {
+                open->focal.items[kept++] = entry;
+                pq_push(&open->focal_costs, entry.cost, NULL);
+            }
+            else
+            {
+                heap_push(&open->queue, entry);
+            }
+        }
+        open->focal.count = kept;
+        heap_build(&open->focal);
+    }
+    open->focal_bound = bound;
+    OpenEntry entry;
+    while (open->queue.count > 0 && open->queue.items[0].cost <= bound + 1e-6)
+    {
+        heap_pop(&open->queue, &entry);
+        heap_push(&open->focal, entry);
+        pq_push(&open->focal_costs, entry.cost, NULL);
+        // the queue's next node may sit in a run
+        merge_runs(open);
+    }
+}
+
+/*
+Plan every path of a compressed node again from its constraints
+
+@param open Pointer to the OpenList
+@param node Compressed node
+@return true if every agent has a path, false otherwise
+*/
+static bool restore_paths(const OpenList *open, HighLevelNode *node)
+{
+    int count = node->num_agents;
+    node->paths = (PathRef **)malloc(sizeof(PathRef *) * (size_t)count);
+    const HighLevelNode **nodes = (const HighLevelNode **)malloc(sizeof(HighLevelNode *) * (size_t)count);
+    int *agents = (int *)malloc(sizeof(int) * (size_t)count);
+    AgentPath **paths = (AgentPath **)malloc(sizeof(AgentPath *) * (size_t)count);
+    if (!node->paths || !nodes || !agents || !paths)
+    {
+        fprintf(stderr, "restore_paths: failed to allocate replanning batch (agents=%d)\n", count);
+        exit(EXIT_FAILURE);
+    }
+    for (int agent = 0; agent < count; ++agent)
+    {
+        node->paths[agent] = path_ref_create();
+        nodes[agent] = node;
+        agents[agent] = agent;
+        paths[agent] = &node->paths[agent]->path;
+    }
+    bool ok = low_level_request_paths(open->instance, nodes, agents, count, open->ll_ctx, paths, NULL);
+    free(nodes);
+    free(agents);
+    free(paths);
+    return ok;
+}
+
+/*
+Push a node, compressing or spilling far nodes when the estimate passes
+the budget's thresholds
+
+@param open Pointer to the OpenList
+@param node Node to push (owned by the list), keyed by its cost
+*/
+void open_list_push(OpenList *open, HighLevelNode *node)
+{
+    // counted before the estimate, counting may build the conflict table
+    int conflicts = open->suboptimality > 1.0 && node->paths != NULL ? cbs_count_conflicts(node) : 0;
+    entry_insert(open, (OpenEntry){.cost = node->cost, .conflicts = conflicts, .node = node});
+    if (open->budget_bytes == 0)
+    {
+        return;
+    }
+    if (open->bytes > open->compress_at)
+    {
+        compress_far_nodes(open);
+    }
+    if (open->bytes > open->spill_at && !open->spill_failed)
+    {
+        spill_far_nodes(open);
+    }
+}
+
+/*
+Pop the next node with its paths: the focal node with the fewest
+conflicts, or the cheapest node when the focal list is off or empty.
+A compressed node is replanned first; it is dropped if an agent has no
+path and pushed back if its cost came out higher than its key.
+
+@param open Pointer to the OpenList
+@return The node (now owned by the caller), or NULL if the list is empty
+*/
+HighLevelNode *open_list_pop(OpenList *open)
+{
+    while (1)
+    {
+        refresh_focal(open);
+        OpenEntry entry;
+        if (heap_pop(&open->focal, &entry))
+        {
+            pq_push(&open->focal_removed, entry.cost, NULL);
+        }
+        else if (!heap_pop(&open->queue, &entry))
+        {
+            return NULL;
+        }
+        HighLevelNode *node = entry.node;
+        open->bytes -= node_bytes(node);
+        if (node->paths != NULL)
+        {
+            return node;
+        }
+        open->compressed_count--;
+        open->nodes_restored++;
+        if (!restore_paths(open, node))
+        {
+            cbs_node_free(node);
+            continue;
+        }
+        node->cost = cbs_compute_soc(node);
+        if (node->cost > entry.cost + 1e-6)
+        {
+            open_list_push(open, node);
+            continue;
+        }
+        return node;
+    }
+}
+
+/*
+@param open Pointer to the OpenList
+@return Node the next pop starts from, possibly compressed (id, parent,
+depth, cost and constraints are valid), or NULL if the list is empty
+*/
+const HighLevelNode *open_list_peek(OpenList *open)
+{
+    refresh_focal(open);
+    if (open->focal.count > 0)
+    {
+        return open->focal.items[0].node;
+    }
+    return open->queue.count > 0 ? open->queue.items[0].node : NULL;
+}
+
+/*
+@param open Pointer to the OpenList
+@return Lowest cost of any open node, DBL_MAX if the list is empty
+*/
+double open_list_lower_bound(OpenList *open)
+{
+    merge_runs(open);
+    return memory_lower_bound(open);
+}
+
+/*
+Cap the focal bound at w times an external lower bound, for a list that
+holds only part of the frontier (a decentralized rank's)
+
+@param open Pointer to the OpenList
+@param lower_bound Lower bound over the whole frontier (DBL_MAX for none)
+*/
+void open_list_cap_focal(OpenList *open, double lower_bound)
+{
+    open->focal_lb_cap = lower_bound;
+}
@@ -1,49 +1,22 @@
 #include "parallel_a_star.h"
 
+#include "heuristic.h"
+#include "log.h"
 #include "messages.h"
-#include "priority_queue.h"
+#include "profile.h"
 
 #include <limits.h>
-#include <math.h>
-#include <memory.h>
 #include <stdio.h>
 
 // Define maximum number of neighbors (4 directions + wait)
-#define MAX_NEIGHBORS 5
+#define MAX_NEIGHBORS GRID_MOVE_COUNT
 
-/* 
-Message structure for low-level A* task 
-This is all the information sent from the low level coordinator to the low
-level workers, they use this to expand A* nodes
-*/
-typedef struct
-{
-    /* Index of the node in the buffer */
-    int node_index;
-    /* X coordinate */
-    int x;
-    /* Y coordinate */
-    int y;
-    /* Cost from start to this node */
-    int g;
-    /* Time step */
-    int time;
-} LLTaskMessage;
-
-/* Message structure for low-level A* result */
-typedef struct
-{
-    /* Index of the originating node in the A* buffer (parent node) */
-    int from_node_index;
-    /* Number of neighbors */
-    int neighbor_count;
-    /* Neighbor data: for each neighbor, store x, y, g, time, used to add child nodes to the buffer */
-    int data[MAX_NEIGHBORS][4];
-} LLResultMessage;
-
-// Ensure no padding in message structs
-_Static_assert(sizeof(LLTaskMessage) == sizeof(int) * 5, "LLTaskMessage padding mismatch");
-_Static_assert(sizeof(LLResultMessage) == sizeof(int) * (2 + MAX_NEIGHBORS * 4), "LLResultMessage padding mismatch");
+/* Ints per state forwarded to its owner: cell, g-cost, time, parent handle */
+#define HDA_STATE_INTS 4
+/* States queued for one rank before its batch is sent without waiting for the next poll */
+#define HDA_BATCH_STATES 64
+/* Expansions between polls for incoming states */
+#define HDA_POLL_INTERVAL 32
 
 /*
 Initialize AStarNodeBuffer
@@ -98,83 +71,143 @@ int a_star_buffer_add(AStarNodeBuffer *buffer, AStarNode node)
 }
 
 /*
-Heuristic function: Manhattan distance
+Initialize an empty AStarWorkspace
 
-@param a First GridCoord
-@param b Second GridCoord
-@return Heuristic cost between a and b
+@param workspace Pointer to the AStarWorkspace to initialize
 */
-static inline double heuristic(GridCoord a, GridCoord b)
+void a_star_workspace_init(AStarWorkspace *workspace)
 {
-    return fabs((double)a.x - (double)b.x) + fabs((double)a.y - (double)b.y);
+    a_star_buffer_init(&workspace->buffer);
+    bucket_queue_init(&workspace->open);
+    state_table_init(&workspace->closed);
+    constraint_index_init(&workspace->index);
+    workspace->scratch = NULL;
+    workspace->scratch_capacity = 0;
+    workspace->outboxes = NULL;
+    workspace->outbox_count = 0;
 }
 
 /*
-Calculate a unique state index based on grid dimensions, time, and coordinates
+Free memory used by AStarWorkspace
 
-@param grid Pointer to the Grid
-@param time Time step
-@param x X coordinate
-@param y Y coordinate
-@return Unique state index
+@param workspace Pointer to the AStarWorkspace to free
 */
-static inline size_t state_index(const Grid *grid, int time, int x, int y)
+void a_star_workspace_free(AStarWorkspace *workspace)
 {
-    size_t plane = (size_t)grid->width * (size_t)grid->height;
-    return (size_t)time * plane + (size_t)y * (size_t)grid->width + (size_t)x;
+    a_star_buffer_free(&workspace->buffer);
+    bucket_queue_free(&workspace->open);
+    state_table_free(&workspace->closed);
+    constraint_index_free(&workspace->index);
+    free(workspace->scratch);
+    workspace->scratch = NULL;
+    workspace->scratch_capacity = 0;
+    for (int i = 0; i < workspace->outbox_count; ++i)
+    {
+        free(workspace->outboxes[i].pending);
+        free(workspace->outboxes[i].sending);
+    }
+    free(workspace->outboxes);
+    workspace->outboxes = NULL;
+    workspace->outbox_count = 0;
 }
 
 /*
-Check if agent_id moving from 'from' to 'to' at given times violates any constraints
+Empty the workspace for a new search without releasing its memory
 
-@param set Pointer to the ConstraintSet
-@param agent_id ID of the agent
-@param time_from Time step of the starting position
-@param time_to Time step of the ending position
-@param from Starting GridCoord
-@param to Ending GridCoord
-@return true if the move violates a constraint, false otherwise
+@param workspace Pointer to the AStarWorkspace to reset
+*/
+void a_star_workspace_reset(AStarWorkspace *workspace)
+{
+    workspace->buffer.count = 0;
+    bucket_queue_clear(&workspace->open);
+    state_table_clear(&workspace->closed);
+}
+
+/*
+Get scratch space of at least count ints, growing it if needed.
+The contents are not preserved across growth.
+
+@param workspace Pointer to the AStarWorkspace
+@param count Number of ints required
+@return Pointer to the scratch space
 */
-static bool violates_constraint(const ConstraintSet *set,
-                                int agent_id,
-                                int time_from,
-                                int time_to,
-                                GridCoord from,
-                                GridCoord to)
+int *a_star_workspace_scratch(AStarWorkspace *workspace, int count)
 {
-    // check all constraints in the set
-    for (int i = 0; i < set->count; ++i)
+    if (count > workspace->scratch_capacity)
     {
-        // create pointer to current constraint
-        const Constraint *c = &set->items[i];
-        // skip constraints not relevant to this agent
-        if (c->agent_id >= 0 && c->agent_id != agent_id)
-        {
-            continue;
-        }
-        // check vertex constraint
-        if (c->type == CONSTRAINT_VERTEX && c->time == time_to &&
-            c->vertex.x == to.x && c->vertex.y == to.y)
+        int new_cap = workspace->scratch_capacity == 0 ? 64 : workspace->scratch_capacity;
+        while (new_cap < count)
         {
-            return true;
+            new_cap *= 2;
         }
-        // check edge constraint
-        if (c->type == CONSTRAINT_EDGE && c->time == time_from &&
-            c->vertex.x == from.x && c->vertex.y == from.y &&
-            c->edge_to.x == to.x && c->edge_to.y == to.y)
+        free(workspace->scratch);
+        workspace->scratch = (int *)malloc(sizeof(int) * (size_t)new_cap);
+        if (!workspace->scratch)
         {
-            return true;
+            fprintf(stderr, "a_star_workspace_scratch: failed to allocate scratch space (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
         }
+        workspace->scratch_capacity = new_cap;
     }
-    return false;
+    return workspace->scratch;
+}
+
+/*
+Time bounds of the time-expanded search for one low-level call
+*/
+typedef struct
+{
+    /** First timestep after the last constraint on the agent; later states differ only in g */
+    int settle_time;
+    /** Latest arrival time an optimal path can have (INT_MAX when unbounded) */
+    int max_time;
+    /** Earliest time the agent may stop at its goal (it waits there forever afterwards) */
+    int goal_time;
+} SearchHorizon;
+
+/*
+Derive the search horizon from the agent's constraint index.
+After settle_time nothing constrains the agent, so it can walk any
+shortest path to the goal. Every cell reachable by settle_time is within
+settle_time moves of start, so with exact distances its goal distance is
+at most start_h + settle_time, which bounds the optimal arrival time.
+
+@param index Pointer to the agent's ConstraintIndex
+@param goal_cell Linear index of the goal cell
+@param heuristic Exact goal distance table (NULL: Manhattan, no arrival bound)
+@param start_h Goal distance of the start cell
+@return SearchHorizon for the call
+*/
+static SearchHorizon compute_horizon(const ConstraintIndex *index,
+                                     int goal_cell,
+                                     const int *heuristic,
+                                     int start_h)
+{
+    SearchHorizon horizon;
+    horizon.settle_time = index->last_time + 1;
+    horizon.max_time = heuristic != NULL ? 2 * horizon.settle_time + start_h : INT_MAX;
+    horizon.goal_time = constraint_index_last_vertex_time(index, goal_cell) + 1;
+    return horizon;
+}
+
+/*
+Map a timestep to the time key used in the closed set: all states at or
+after settle_time share one layer since constraints no longer distinguish them
+
+@param horizon Pointer to the SearchHorizon
+@param time Time step of the state
+@return Time key for the closed set
+*/
+static inline int closed_time(const SearchHorizon *horizon, int time)
+{
+    return time < horizon->settle_time ? time : horizon->settle_time;
 }
 
 /*
 Generate valid neighboring nodes for the given AStarNode
 
 @param grid Pointer to the Grid
-@param constraints Pointer to the ConstraintSet
-@param agent_id ID of the agent
+@param constraints Pointer to the agent's ConstraintIndex
 @param node Pointer to the current AStarNode
 @param neighbors Output array of neighboring GridCoords
 @param g_costs Output array of g_costs for neighbors
@@ -182,59 +215,34 @@ Generate valid neighboring nodes for the given AStarNode
 @return Number of valid neighbors generated
 */
 static int generate_neighbors(const Grid *grid,
-                              const ConstraintSet *constraints,
-                              int agent_id,
+                              const ConstraintIndex *constraints,
                               const AStarNode *node,
                               GridCoord neighbors[MAX_NEIGHBORS],
                               int g_costs[MAX_NEIGHBORS],
                               int times[MAX_NEIGHBORS])
 {
-    // all possible moves: wait, up, down, left, right
-    static const GridCoord moves[MAX_NEIGHBORS] = {
-        {0, 0},  /* wait */
-        {1, 0},
-        {-1, 0},
-        {0, 1},
-        {0, -1}};
-
-    // generate neighbors by applying all possible moves
+    // the precomputed mask already excludes moves off the grid or into obstacles
+    int cell = node->position.y * grid->width + node->position.x;
     int produced = 0;
-    for (int i = 0; i < MAX_NEIGHBORS; ++i)
+    int move = 0;
+    for (unsigned int mask = grid_moves(grid, cell); mask != 0; mask >>= 1, ++move)
     {
-        // calculate next position and time
-        GridCoord next = {node->position.x + moves[i].x, node->position.y + moves[i].y};
-        int next_time = node->time + 1;
-
-        // check if next position is within grid bounds
-        if (!grid_in_bounds(grid, next.x, next.y))
+        if ((mask & 1u) == 0)
         {
             continue;
         }
-        // check if next position is an obstacle (if not waiting)
-        if (moves[i].x != 0 || moves[i].y != 0)
-        {
-            if (grid_is_obstacle(grid, next.x, next.y))
-            {
-                continue;
-            }
-        }
         // check if move violates any constraints
-        if (violates_constraint(constraints,
-                                agent_id,
-                                node->time,
-                                next_time,
-                                node->position,
-                                next))
+        int next_cell = grid_move_cell(grid, cell, move);
+        if (constraint_index_blocks(constraints, node->time, cell, next_cell))
         {
             continue;
         }
         // add valid neighbor to the list
-        neighbors[produced] = next;
+        neighbors[produced] = grid_apply_move(node->position, move);
         g_costs[produced] = node->g_cost + 1;
-        times[produced] = next_time;
+        times[produced] = node->time + 1;
         produced++;
     }
-
     return produced;
 }
 
@@ -243,9 +251,10 @@ Reconstruct path from A* search by following parent indices
 
 @param buffer Pointer to the AStarNodeBuffer
 @param goal_index Index of the goal node in the buffer
+@param width Grid width used to linearize cells
 @param path Pointer to the AgentPath to store the reconstructed path
 */
-static void reconstruct_path(const AStarNodeBuffer *buffer, int goal_index, AgentPath *path)
+static void reconstruct_path(const AStarNodeBuffer *buffer, int goal_index, int width, AgentPath *path)
 {
     // allocate path memory
     const AStarNode *node = &buffer->nodes[goal_index];
@@ -260,7 +269,7 @@ static void reconstruct_path(const AStarNodeBuffer *buffer, int goal_index, Agen
     while (idx >= 0 && write_pos >= 0)
     {
         const AStarNode *current = &buffer->nodes[idx];
-        path->steps[write_pos] = current->position;
+        path->steps[write_pos] = current->position.y * width + current->position.x;
         idx = current->parent_index;
         write_pos--;
     }
@@ -274,7 +283,9 @@ Sequential A* search algorithm
 @param constraints Pointer to the ConstraintSet
 @param start Starting GridCoord
 @param goal Goal GridCoord
+@param heuristic Exact goal distance table for this agent (NULL uses Manhattan distance)
 @param agent_id ID of the agent
+@param workspace Reusable search memory (NULL allocates a temporary one)
 @param out_path Pointer to the AgentPath to store the found path
 @return true if a path is found, false otherwise
 */
@@ -282,76 +293,67 @@ bool sequential_a_star(const Grid *grid,
                        const ConstraintSet *constraints,
                        GridCoord start,
                        GridCoord goal,
+                       const int *heuristic,
                        int agent_id,
+                       AStarWorkspace *workspace,
                        AgentPath *out_path)
 {
-    double astar_start = MPI_Wtime();
-    printf("[A*] Starting sequential A* for agent %d (start=%d,%d goal=%d,%d)\n",
-           agent_id, start.x, start.y, goal.x, goal.y);
-    fflush(stdout);
-
-    // initialize A* buffer and priority queue
-    AStarNodeBuffer buffer;
-    a_star_buffer_init(&buffer);
-
-    PriorityQueue open;
-    pq_init(&open);
+    double astar_start = wall_time_seconds();
+    LOG_TRACE("[A*] Starting sequential A* for agent %d (start=%d,%d goal=%d,%d)\n",
+              agent_id, start.x, start.y, goal.x, goal.y);
 
-    /* Cap horizon to a reasonable bound: 4 times the number of grid cells */
-    int max_time = grid->width * grid->height * 4;
-    if (max_time < 0 || max_time < MAX_PATH_LENGTH)
+    // goal not reachable from start on the static grid
+    int start_h = heuristic_lookup(heuristic, grid, start, goal);
+    if (start_h == HEURISTIC_UNREACHABLE)
     {
-        max_time = MAX_PATH_LENGTH;
-    }
-    int plane = grid->width * grid->height;
-    int total = max_time * plane;
-    int *best_cost = (int *)malloc(sizeof(int) * (size_t)total);
-    if (!best_cost)
-    {
-        fprintf(stderr, "sequential_a_star: failed to allocate best_cost (size=%d)\n", total);
+        LOG_DEBUG("[A*] agent=%d: goal unreachable from start\n", agent_id);
         return false;
     }
-    for (int i = 0; i < total; ++i)
+
+    AStarWorkspace local_workspace;
+    if (workspace == NULL)
     {
-        best_cost[i] = INT_MAX;
+        a_star_workspace_init(&local_workspace);
+        workspace = &local_workspace;
     }
+    a_star_workspace_reset(workspace);
+    AStarNodeBuffer *buffer = &workspace->buffer;
+    BucketQueue *open = &workspace->open;
+    StateTable *best_cost = &workspace->closed;
+
+    // index the agent's constraints once for constant-time move checks
+    ConstraintIndex *index = &workspace->index;
+    constraint_index_build(index, constraints, agent_id);
 
-    AStarNode root = {.position = start, .g_cost = 0, .f_cost = (int)heuristic(start, goal), .parent_index = -1, .time = 0};
-    int root_index = a_star_buffer_add(&buffer, root);
-    pq_push(&open, root.f_cost, (void *)(intptr_t)root_index);
-    best_cost[state_index(grid, 0, start.x, start.y)] = 0;
+    // closed-set time keys collapse at the constraint horizon
+    SearchHorizon horizon = compute_horizon(index, goal.y * grid->width + goal.x, heuristic, start_h);
+
+    AStarNode root = {.position = start, .g_cost = 0, .f_cost = start_h, .parent_index = -1, .time = 0};
+    int root_index = a_star_buffer_add(buffer, root);
+    bucket_queue_push(open, root.f_cost, root_index);
+    state_table_improve(best_cost, 0, start.y * grid->width + start.x, 0);
 
     bool found = false;
     int goal_index = -1;
     long long iterations = 0;
     double last_progress_time = astar_start;
 
-    while (open.count > 0)
+    while (open->count > 0)
     {
         iterations++;
 
         // Progress indicatior every 10000 iterations or 5 seconds
-        double now = MPI_Wtime();
+        double now = wall_time_seconds();
         if (iterations % 10000 == 0 || (now - last_progress_time) >= 5.0)
         {
-            printf("[A*] agent=%d: iter=%lld open=%d buffer=%d elapsed=%.1fs\n",
-                   agent_id, iterations, open.count, buffer.count, now - astar_start);
-            fflush(stdout);
+            LOG_TRACE("[A*] agent=%d: iter=%lld open=%d buffer=%d elapsed=%.1fs\n",
+                      agent_id, iterations, open->count, buffer->count, now - astar_start);
             last_progress_time = now;
         }
 
-        if (open.count > plane * max_time)
-        {
-            /* Defensive: bail if queue explodes beyond expected horizon */
-            printf("[A*] agent=%d: Queue explosion detected (open=%d > %d), aborting\n",
-                   agent_id, open.count, plane * max_time);
-            fflush(stdout);
-            break;
-        }
-        double key = 0.0;
-        int node_index = (int)(intptr_t)pq_pop(&open, &key);
-        AStarNode *node = &buffer.nodes[node_index];
-        if (node->position.x == goal.x && node->position.y == goal.y)
+        int node_index = bucket_queue_pop(open, NULL);
+        AStarNode *node = &buffer->nodes[node_index];
+        if (node->position.x == goal.x && node->position.y == goal.y && node->time >= horizon.goal_time)
         {
             found = true;
             goal_index = node_index;
@@ -361,288 +363,581 @@ bool sequential_a_star(const Grid *grid,
         GridCoord neighbors[MAX_NEIGHBORS];
         int g_costs[MAX_NEIGHBORS];
         int times[MAX_NEIGHBORS];
-        int count = generate_neighbors(grid, constraints, agent_id, node, neighbors, g_costs, times);
+        int count = generate_neighbors(grid, index, node, neighbors, g_costs, times);
         for (int i = 0; i < count; ++i)
         {
-            if (times[i] >= max_time)
+            int h = heuristic_lookup(heuristic, grid, neighbors[i], goal);
+            // unreachable cells and states that cannot arrive within the horizon
+            if (h == HEURISTIC_UNREACHABLE || g_costs[i] + h > horizon.max_time)
             {
-                fprintf(stderr, "EXCEEDED MAX TIME\n");
                 continue;
             }
-            size_t idx = state_index(grid, times[i], neighbors[i].x, neighbors[i].y);
-            if (idx >= (size_t)total) 
+            int cell = neighbors[i].y * grid->width + neighbors[i].x;
+            if (!state_table_improve(best_cost, closed_time(&horizon, times[i]), cell, g_costs[i]))
             {
-                fprintf(stderr, "state_index out of bounds: %zu (total=%zu)\n", idx, (size_t)total);
                 continue;
             }
-            if (best_cost[idx] <= g_costs[i])
-            {
-                continue;
-            }
-            best_cost[idx] = g_costs[i];
-            int h = (int)heuristic(neighbors[i], goal);
             AStarNode child = {.position = neighbors[i],
                                .g_cost = g_costs[i],
                                .f_cost = g_costs[i] + h,
                                .parent_index = node_index,
                                .time = times[i]};
-            int child_index = a_star_buffer_add(&buffer, child);
-            pq_push(&open, child.f_cost, (void *)(intptr_t)child_index);
+            int child_index = a_star_buffer_add(buffer, child);
+            bucket_queue_push(open, child.f_cost, child_index);
         }
     }
 
     if (found)
     {
-        reconstruct_path(&buffer, goal_index, out_path);
+        reconstruct_path(buffer, goal_index, grid->width, out_path);
     }
 
-    double astar_end = MPI_Wtime();
-    printf("[A*] agent=%d: %s in %.3fs (%lld iterations, %d nodes)\n",
-           agent_id, found ? "SUCCESS" : "FAILED", astar_end - astar_start, iterations, buffer.count);
-    fflush(stdout);
-    free(best_cost);
-    pq_free(&open);
-    a_star_buffer_free(&buffer);
+    double astar_end = wall_time_seconds();
+    LOG_DEBUG("[A*] agent=%d: %s in %.3fs (%lld iterations, %d nodes)\n",
+              agent_id, found ? "SUCCESS" : "FAILED", astar_end - astar_start, iterations, buffer->count);
+    profile_ll_call(astar_end - astar_start, iterations);
+    if (workspace == &local_workspace)
+    {
+        a_star_workspace_free(&local_workspace);
+    }
     return found;
 }
 
-bool parallel_a_star(const Grid *grid,
-                     const ConstraintSet *constraints,
-                     GridCoord start,
-                     GridCoord goal,
-                     int agent_id,
-                     MPI_Comm comm,
-                     AgentPath *out_path)
+/*
+Rank that owns a state of the parallel search: a hash of the cell and the
+closed-set time key, so every duplicate of a state meets on one rank
+
+@param cell Linear index of the cell
+@param time Closed-set time key of the state
+@param size Number of ranks
+@return Owning rank
+*/
+static inline int state_owner(int cell, int time, int size)
 {
-    int rank = 0;
-    int size = 1;
-    MPI_Comm_rank(comm, &rank);
-    MPI_Comm_size(comm, &size);
+    uint32_t h = (uint32_t)cell * 2654435761u ^ (uint32_t)time * 2246822519u;
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    return (int)(h % (uint32_t)size);
+}
 
-    if (size == 1)
+/*
+Per-call state of one rank in the parallel search
+*/
+typedef struct
+{
+    const Grid *grid;
+    const int *heuristic;
+    GridCoord goal;
+    SearchHorizon horizon;
+    AStarWorkspace *workspace;
+    MPI_Comm comm;
+    int rank;
+    int size;
+    /** Best solution cost known to this rank (INT_MAX if none), nothing at or above it is expanded */
+    int bound;
+    /** Cost of the best goal state expanded on this rank (INT_MAX if none) */
+    int goal_cost;
+    /** Buffer index of that goal state */
+    int goal_index;
+    /** State batches sent to other ranks */
+    long long sent;
+    /** State batches received from other ranks */
+    long long received;
+    /** Nodes expanded on this rank */
+    long long expanded;
+} HdaSearch;
+
+/*
+Give every rank of the search an empty outbox
+
+@param workspace Pointer to the AStarWorkspace
+@param size Number of ranks
+*/
+static void outboxes_prepare(AStarWorkspace *workspace, int size)
+{
+    if (workspace->outbox_count < size)
+    {
+        StateOutbox *grown = (StateOutbox *)realloc(workspace->outboxes, sizeof(StateOutbox) * (size_t)size);
+        if (!grown)
+        {
+            fprintf(stderr, "outboxes_prepare: failed to allocate outboxes (ranks=%d)\n", size);
+            exit(EXIT_FAILURE);
+        }
+        for (int i = workspace->outbox_count; i < size; ++i)
+        {
+            grown[i].pending = NULL;
+            grown[i].pending_capacity = 0;
+            grown[i].sending = NULL;
+            grown[i].sending_capacity = 0;
+        }
+        workspace->outboxes = grown;
+        workspace->outbox_count = size;
+    }
+    for (int i = 0; i < size; ++i)
+    {
+        workspace->outboxes[i].pending_count = 0;
+        workspace->outboxes[i].request = MPI_REQUEST_NULL;
+    }
+}
+
+/*
+Queue a generated state for its owner
+
+@param box Pointer to the owner's StateOutbox
+@param cell Linear index of the cell
+@param g_cost Cost from start
+@param time Time step
+@param parent Global handle of the parent node
+*/
+static void outbox_append(StateOutbox *box, int cell, int g_cost, int time, int parent)
+{
+    if (box->pending_count + HDA_STATE_INTS > box->pending_capacity)
     {
-        return sequential_a_star(grid, constraints, start, goal, agent_id, out_path);
+        int new_cap = box->pending_capacity == 0 ? HDA_BATCH_STATES * HDA_STATE_INTS : box->pending_capacity * 2;
+        int *grown = (int *)realloc(box->pending, sizeof(int) * (size_t)new_cap);
+        if (!grown)
+        {
+            fprintf(stderr, "outbox_append: failed to allocate outbox (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        box->pending = grown;
+        box->pending_capacity = new_cap;
     }
+    int *state = &box->pending[box->pending_count];
+    state[0] = cell;
+    state[1] = g_cost;
+    state[2] = time;
+    state[3] = parent;
+    box->pending_count += HDA_STATE_INTS;
+}
 
-    /* Copy grid to all ranks */
-    Grid local_grid = *grid;
-    size_t cell_count = (size_t)grid->width * (size_t)grid->height;
-    local_grid.cells = (uint8_t *)malloc(cell_count);
-    memcpy(local_grid.cells, grid->cells, cell_count);
+/*
+Send the queued states of an outbox unless its previous batch is still in flight
 
-    ConstraintSet local_constraints = *constraints;
-    local_constraints.items = NULL;
-    local_constraints.count = constraints->count;
-    local_constraints.capacity = constraints->count;
-    if (constraints->count > 0)
+@param search Pointer to the HdaSearch
+@param dest Rank of the outbox
+*/
+static void outbox_flush(HdaSearch *search, int dest)
+{
+    StateOutbox *box = &search->workspace->outboxes[dest];
+    if (box->pending_count == 0)
+    {
+        return;
+    }
+    if (box->request != MPI_REQUEST_NULL)
     {
-        local_constraints.items = (Constraint *)malloc(sizeof(Constraint) * (size_t)constraints->count);
-        memcpy(local_constraints.items, constraints->items, sizeof(Constraint) * (size_t)constraints->count);
+        int done = 0;
+        MPI_Test(&box->request, &done, MPI_STATUS_IGNORE);
+        if (!done)
+        {
+            return;
+        }
     }
+    // swap the buffers so new states queue up while this batch travels
+    int *batch = box->pending;
+    int batch_capacity = box->pending_capacity;
+    box->pending = box->sending;
+    box->pending_capacity = box->sending_capacity;
+    box->sending = batch;
+    box->sending_capacity = batch_capacity;
+    MPI_Isend(box->sending, box->pending_count, MPI_INT, dest, TAG_LL_TASK, search->comm, &box->request);
+    box->pending_count = 0;
+    search->sent++;
+}
 
-    bool success = false;
-    int success_flag = 0;
+/*
+@param search Pointer to the HdaSearch
+@return true if some outbox still holds unsent states
+*/
+static bool outboxes_pending(const HdaSearch *search)
+{
+    for (int i = 0; i < search->size; ++i)
+    {
+        if (search->workspace->outboxes[i].pending_count > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (rank == 0)
+/*
+Add a state owned by this rank unless its state is already known with a
+lower or equal g-cost or it cannot beat the bound
+
+@param search Pointer to the HdaSearch
+@param cell Linear index of the cell
+@param g_cost Cost from start
+@param time Time step
+@param parent Global handle of the parent node (-1 for the root)
+*/
+static void insert_state(HdaSearch *search, int cell, int g_cost, int time, int parent)
+{
+    GridCoord pos = {.x = cell % search->grid->width, .y = cell / search->grid->width};
+    int h = heuristic_lookup(search->heuristic, search->grid, pos, search->goal);
+    if (h == HEURISTIC_UNREACHABLE || g_cost + h >= search->bound)
     {
-        AStarNodeBuffer buffer;
-        a_star_buffer_init(&buffer);
+        return;
+    }
+    if (!state_table_improve(&search->workspace->closed, closed_time(&search->horizon, time), cell, g_cost))
+    {
+        return;
+    }
+    AStarNode node = {.position = pos,
+                      .g_cost = g_cost,
+                      .f_cost = g_cost + h,
+                      .parent_index = parent,
+                      .time = time};
+    int node_index = a_star_buffer_add(&search->workspace->buffer, node);
+    bucket_queue_push(&search->workspace->open, node.f_cost, node_index);
+}
 
-        PriorityQueue open;
-        pq_init(&open);
+/*
+Insert every state batch that arrived from other ranks
 
-        /* Cap horizon to a reasonable bound: 4 times the number of grid cells */
-        int max_time = grid->width * grid->height * 4;
-        if (max_time < 0 || max_time < MAX_PATH_LENGTH)
+@param search Pointer to the HdaSearch
+*/
+static void receive_states(HdaSearch *search)
+{
+    while (1)
+    {
+        int flag = 0;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_LL_TASK, search->comm, &flag, &status);
+        if (!flag)
         {
-            max_time = MAX_PATH_LENGTH;
+            break;
         }
-        int plane = local_grid.width * local_grid.height;
-        int total = max_time * plane;
-        int *best_cost = (int *)malloc(sizeof(int) * (size_t)total);
-        for (int i = 0; i < total; ++i)
+        int count = 0;
+        MPI_Get_count(&status, MPI_INT, &count);
+        int *states = a_star_workspace_scratch(search->workspace, count > 0 ? count : 1);
+        MPI_Recv(states, count, MPI_INT, status.MPI_SOURCE, TAG_LL_TASK, search->comm, MPI_STATUS_IGNORE);
+        search->received++;
+        for (int i = 0; i + HDA_STATE_INTS <= count; i += HDA_STATE_INTS)
         {
-            best_cost[i] = INT_MAX;
+            insert_state(search, states[i], states[i + 1], states[i + 2], states[i + 3]);
         }
+    }
+}
 
-        AStarNode root = {.position = start,
-                          .g_cost = 0,
-                          .f_cost = (int)heuristic(start, goal),
-                          .parent_index = -1,
-                          .time = 0};
-        int root_index = a_star_buffer_add(&buffer, root);
-        pq_push(&open, root.f_cost, (void *)(intptr_t)root_index);
-        best_cost[state_index(&local_grid, 0, start.x, start.y)] = 0;
+/*
+@param search Pointer to the HdaSearch
+@return true if the open list holds a node below the bound
+*/
+static bool has_open_work(HdaSearch *search)
+{
+    int key = bucket_queue_peek_key(&search->workspace->open);
+    return key >= 0 && key < search->bound;
+}
 
-        int next_worker = 1;
-        int goal_index = -1;
+/*
+Expand the best open node, keeping children owned by this rank and
+queueing the others for their owners
 
-        while (open.count > 0)
+@param search Pointer to the HdaSearch
+*/
+static void expand_next(HdaSearch *search)
+{
+    AStarWorkspace *workspace = search->workspace;
+    int node_index = bucket_queue_pop(&workspace->open, NULL);
+    // copy, inserting children may move the buffer
+    AStarNode node = workspace->buffer.nodes[node_index];
+    if (node.position.x == search->goal.x && node.position.y == search->goal.y && node.time >= search->horizon.goal_time)
+    {
+        if (node.g_cost < search->goal_cost)
         {
-            int max_tasks = size - 1;
-            if (max_tasks <= 0)
-            {
-                break;
-            }
+            search->goal_cost = node.g_cost;
+            search->goal_index = node_index;
+        }
+        if (node.g_cost < search->bound)
+        {
+            search->bound = node.g_cost;
+        }
+        return;
+    }
+    search->expanded++;
+
+    GridCoord neighbors[MAX_NEIGHBORS];
+    int g_costs[MAX_NEIGHBORS];
+    int times[MAX_NEIGHBORS];
+    int count = generate_neighbors(search->grid, &workspace->index, &node, neighbors, g_costs, times);
+    // handles are ints on the wire and in parent links, so a rank can only address INT_MAX / size nodes
+    if (node_index > (INT_MAX - search->rank) / search->size)
+    {
+        fprintf(stderr, "expand_next: rank %d holds too many nodes for a state handle (nodes=%d ranks=%d)\n",
+                search->rank, node_index + 1, search->size);
+        exit(EXIT_FAILURE);
+    }
+    int handle = node_index * search->size + search->rank;
+    for (int i = 0; i < count; ++i)
+    {
+        int h = heuristic_lookup(search->heuristic, search->grid, neighbors[i], search->goal);
+        // unreachable cells, states that cannot arrive within the horizon or beat the bound
+        if (h == HEURISTIC_UNREACHABLE || g_costs[i] + h > search->horizon.max_time || g_costs[i] + h >= search->bound)
+        {
+            continue;
+        }
+        int cell = neighbors[i].y * search->grid->width + neighbors[i].x;
+        int owner = state_owner(cell, closed_time(&search->horizon, times[i]), search->size);
+        if (owner == search->rank)
+        {
+            insert_state(search, cell, g_costs[i], times[i], handle);
+            continue;
+        }
+        StateOutbox *box = &workspace->outboxes[owner];
+        outbox_append(box, cell, g_costs[i], times[i], handle);
+        if (box->pending_count >= HDA_BATCH_STATES * HDA_STATE_INTS)
+        {
+            outbox_flush(search, owner);
+        }
+    }
+}
 
-            int task_count = 0;
-            int max_batch = max_tasks > 0 ? max_tasks : 0;
-            int *task_nodes = max_batch > 0 ? (int *)malloc(sizeof(int) * (size_t)max_batch) : NULL;
-            while (task_count < max_tasks && open.count > 0)
-            {
-                double key = 0.0;
-                int node_index = (int)(intptr_t)pq_pop(&open, &key);
-                task_nodes[task_count++] = node_index;
-            }
+/*
+Write the cells of the solution path held by this rank, starting at a
+node handle and following parents until one lives on another rank
 
-            if (task_count == 0)
-            {
-                free(task_nodes);
-                break;
-            }
+@param search Pointer to the HdaSearch
+@param handle Global handle of the first node
+@param cells Path cells indexed by time
+@return Handle of the first parent owned by another rank, or -1 at the root
+*/
+static int trace_local(const HdaSearch *search, int handle, int *cells)
+{
+    while (handle >= 0 && handle % search->size == search->rank)
+    {
+        const AStarNode *node = &search->workspace->buffer.nodes[handle / search->size];
+        cells[node->time] = node->position.y * search->grid->width + node->position.x;
+        handle = node->parent_index;
+    }
+    return handle;
+}
 
-            int num_workers_used = task_count;
+/*
+Pass the trace on to the owner of the next node, or end it at the root
 
-            for (int i = 0; i < task_count; ++i)
-            {
-                int worker_rank = next_worker;
-                next_worker++;
-                if (next_worker >= size)
-                {
-                    next_worker = 1;
-                }
-
-                AStarNode *node = &buffer.nodes[task_nodes[i]];
-                LLTaskMessage msg = {.node_index = task_nodes[i],
-                                     .x = node->position.x,
-                                     .y = node->position.y,
-                                     .g = node->g_cost,
-                                     .time = node->time};
-                MPI_Send(&msg, sizeof(LLTaskMessage) / sizeof(int), MPI_INT, worker_rank, TAG_LL_TASK, comm);
-            }
+@param search Pointer to the HdaSearch
+@param handle Handle returned by trace_local
+@return true if the trace ended
+*/
+static bool trace_forward(const HdaSearch *search, int handle)
+{
+    if (handle >= 0)
+    {
+        MPI_Send(&handle, 1, MPI_INT, handle % search->size, TAG_LL_RESULT, search->comm);
+        return false;
+    }
+    for (int r = 0; r < search->size; ++r)
+    {
+        if (r != search->rank)
+        {
+            MPI_Send(NULL, 0, MPI_INT, r, TAG_LL_TERMINATE, search->comm);
+        }
+    }
+    return true;
+}
 
-            for (int i = 0; i < num_workers_used; ++i)
-            {
-                LLResultMessage result;
-                MPI_Status status;
-                MPI_Recv(&result,
-                         sizeof(result) / sizeof(int),
-                         MPI_INT,
-                         MPI_ANY_SOURCE,
-                         TAG_LL_RESULT,
-                         comm,
-                         &status);
-
-                for (int n = 0; n < result.neighbor_count; ++n)
-                {
-                    GridCoord pos = {.x = result.data[n][0], .y = result.data[n][1]};
-                    int g_val = result.data[n][2];
-                    int time_val = result.data[n][3];
-                    if (time_val >= max_time)
-                    {
-                        continue;
-                    }
-                    int idx = state_index(&local_grid, time_val, pos.x, pos.y);
-                    if (best_cost[idx] <= g_val)
-                    {
-                        continue;
-                    }
-                    best_cost[idx] = g_val;
-                    int h = (int)heuristic(pos, goal);
-                    AStarNode child = {.position = pos,
-                                       .g_cost = g_val,
-                                       .f_cost = g_val + h,
-                                       .parent_index = result.from_node_index,
-                                       .time = time_val};
-                    int child_index = a_star_buffer_add(&buffer, child);
-                    pq_push(&open, child.f_cost, (void *)(intptr_t)child_index);
-
-                    if (pos.x == goal.x && pos.y == goal.y)
-                    {
-                        goal_index = child_index;
-                        success_flag = 1;
-                    }
-                }
-            }
+/*
+Parallel A* search with hash-distributed states (HDA*): every state is
+owned by the rank given by state_owner and each rank runs A* on the
+states it owns, forwarding generated states to their owners in batches.
+Non-blocking reductions spread the best goal found and stop the search
+once every rank is out of nodes below it and two consecutive rounds saw
+the same number of batches sent and received, so no state is in flight.
+The path is then traced back across ranks and gathered on rank 0.
+Collective over comm.
 
-            free(task_nodes);
+@param grid Pointer to the Grid
+@param constraints Pointer to the ConstraintSet
+@param start Starting GridCoord
+@param goal Goal GridCoord
+@param heuristic Exact goal distance table for this agent (NULL uses Manhattan distance)
+@param agent_id ID of the agent
+@param comm Communicator of the cooperating ranks
+@param workspace Reusable search memory of this rank (NULL allocates a temporary one)
+@param out_path Pointer to the AgentPath to store the found path (filled on rank 0)
+@return true if a path is found, false otherwise
+*/
+bool parallel_a_star(const Grid *grid,
+                     const ConstraintSet *constraints,
+                     GridCoord start,
+                     GridCoord goal,
+                     const int *heuristic,
+                     int agent_id,
+                     MPI_Comm comm,
+                     AStarWorkspace *workspace,
+                     AgentPath *out_path)
+{
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    if (size == 1)
+    {
+        return sequential_a_star(grid, constraints, start, goal, heuristic, agent_id, workspace, out_path);
+    }
+
+    // every rank sees the same tables, so they all leave here together
+    int start_h = heuristic_lookup(heuristic, grid, start, goal);
+    if (start_h == HEURISTIC_UNREACHABLE)
+    {
+        return false;
+    }
+
+    double astar_start = MPI_Wtime();
+    AStarWorkspace local_workspace;
+    if (workspace == NULL)
+    {
+        a_star_workspace_init(&local_workspace);
+        workspace = &local_workspace;
+    }
+    a_star_workspace_reset(workspace);
+    outboxes_prepare(workspace, size);
+
+    /* Every rank checks moves against the same per-agent index */
+    ConstraintIndex *index = &workspace->index;
+    constraint_index_build(index, constraints, agent_id);
+
+    HdaSearch search = {.grid = grid,
+                        .heuristic = heuristic,
+                        .goal = goal,
+                        .horizon = compute_horizon(index, goal.y * grid->width + goal.x, heuristic, start_h),
+                        .workspace = workspace,
+                        .comm = comm,
+                        .rank = rank,
+                        .size = size,
+                        .bound = INT_MAX,
+                        .goal_cost = INT_MAX,
+                        .goal_index = -1,
+                        .sent = 0,
+                        .received = 0,
+                        .expanded = 0};
+
+    int start_cell = start.y * grid->width + start.x;
+    if (state_owner(start_cell, 0, size) == rank)
+    {
+        insert_state(&search, start_cell, 0, 0, -1);
+    }
 
-            if (success_flag)
+    /* Round state: MIN of {best goal as cost * size + rank, passive}, SUM of {sent, received, expanded} */
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    long long min_send[2] = {0, 0};
+    long long min_recv[2] = {LLONG_MAX, 0};
+    long long sum_send[3] = {0, 0, 0};
+    long long sum_recv[3] = {0, 0, 0};
+    bool round_in_flight = false;
+    bool previous_quiet = false;
+    long long previous_sent = -1;
+    long long previous_received = -1;
+    int rounds = 0;
+
+    while (1)
+    {
+        receive_states(&search);
+        for (int i = 0; i < HDA_POLL_INTERVAL && has_open_work(&search); ++i)
+        {
+            expand_next(&search);
+        }
+        for (int r = 0; r < size; ++r)
+        {
+            if (r != rank)
             {
-                break;
+                outbox_flush(&search, r);
             }
         }
 
-        if (success_flag && goal_index >= 0)
+        if (!round_in_flight)
         {
-            reconstruct_path(&buffer, goal_index, out_path);
-            success = true;
+            min_send[0] = search.goal_cost < INT_MAX ? (long long)search.goal_cost * size + rank : LLONG_MAX;
+            min_send[1] = !has_open_work(&search) && !outboxes_pending(&search) ? 1 : 0;
+            sum_send[0] = search.sent;
+            sum_send[1] = search.received;
+            sum_send[2] = search.expanded;
+            MPI_Iallreduce(min_send, min_recv, 2, MPI_LONG_LONG, MPI_MIN, comm, &requests[0]);
+            MPI_Iallreduce(sum_send, sum_recv, 3, MPI_LONG_LONG, MPI_SUM, comm, &requests[1]);
+            round_in_flight = true;
+            continue;
         }
-
-        /* Inform workers to stop */
-        for (int worker_rank = 1; worker_rank < size; ++worker_rank)
+        int done = 0;
+        MPI_Testall(2, requests, &done, MPI_STATUSES_IGNORE);
+        if (!done)
+        {
+            continue;
+        }
+        round_in_flight = false;
+        rounds++;
+        if (min_recv[0] != LLONG_MAX && min_recv[0] / size < search.bound)
         {
-            MPI_Send(NULL, 0, MPI_INT, worker_rank, TAG_LL_TERMINATE, comm);
+            search.bound = (int)(min_recv[0] / size);
         }
+        // passive everywhere with unchanged counters over two rounds means nothing is in flight
+        bool quiet = min_recv[1] == 1 && sum_recv[0] == sum_recv[1];
+        if (quiet && previous_quiet && sum_recv[0] == previous_sent && sum_recv[1] == previous_received)
+        {
+            break;
+        }
+        previous_quiet = quiet;
+        previous_sent = sum_recv[0];
+        previous_received = sum_recv[1];
+    }
 
-        MPI_Barrier(comm); // ensure all workers have terminated
-        MPI_Bcast(&success_flag, 1, MPI_INT, 0, comm);
-        free(best_cost);
-        pq_free(&open);
-        a_star_buffer_free(&buffer);
+    // every batch was received, so these complete right away
+    for (int r = 0; r < size; ++r)
+    {
+        if (workspace->outboxes[r].request != MPI_REQUEST_NULL)
+        {
+            MPI_Wait(&workspace->outboxes[r].request, MPI_STATUS_IGNORE);
+        }
     }
-    else
+
+    bool found = min_recv[0] != LLONG_MAX;
+    if (found)
     {
-        int agent = agent_id; /* unused but kept for parity */
-        (void)agent;
+        int cost = (int)(min_recv[0] / size);
+        int goal_rank = (int)(min_recv[0] % size);
+        int *cells = a_star_workspace_scratch(workspace, cost + 1);
+        for (int t = 0; t <= cost; ++t)
+        {
+            cells[t] = -1;
+        }
 
-        while (true)
+        bool traced = false;
+        if (rank == goal_rank)
+        {
+            traced = trace_forward(&search, trace_local(&search, search.goal_index * size + rank, cells));
+        }
+        while (!traced)
         {
+            int handle = -1;
             MPI_Status status;
-            MPI_Probe(0, MPI_ANY_TAG, comm, &status);
+            MPI_Recv(&handle, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
             if (status.MPI_TAG == TAG_LL_TERMINATE)
             {
-                MPI_Recv(NULL, 0, MPI_INT, 0, TAG_LL_TERMINATE, comm, MPI_STATUS_IGNORE);
                 break;
             }
-            else if (status.MPI_TAG == TAG_LL_TASK)
-            {
-                LLTaskMessage task;
-                MPI_Recv(&task, sizeof(LLTaskMessage) / sizeof(int), MPI_INT, 0, TAG_LL_TASK, comm, MPI_STATUS_IGNORE);
-                AStarNode node = {.position = {.x = task.x, .y = task.y},
-                                  .g_cost = task.g,
-                                  .time = task.time};
-                GridCoord neighbors[MAX_NEIGHBORS];
-                int g_costs[MAX_NEIGHBORS];
-                int times[MAX_NEIGHBORS];
-                int count = generate_neighbors(&local_grid,
-                                               &local_constraints,
-                                               agent_id,
-                                               &node,
-                                               neighbors,
-                                               g_costs,
-                                               times);
-
-                LLResultMessage result = {.from_node_index = task.node_index, .neighbor_count = count};
-                for (int i = 0; i < count; ++i)
-                {
-                    result.data[i][0] = neighbors[i].x;
-                    result.data[i][1] = neighbors[i].y;
-                    result.data[i][2] = g_costs[i];
-                    result.data[i][3] = times[i];
-                }
-                MPI_Send(&result, sizeof(result) / sizeof(int), MPI_INT, 0, TAG_LL_RESULT, comm);
-            }
+            traced = trace_forward(&search, trace_local(&search, handle, cells));
+        }
+
+        MPI_Reduce(rank == 0 ? MPI_IN_PLACE : cells, rank == 0 ? cells : NULL, cost + 1, MPI_INT, MPI_MAX, 0, comm);
+        if (rank == 0)
+        {
+            path_reserve(out_path, cost + 1);
+            memcpy(out_path->steps, cells, sizeof(int) * (size_t)(cost + 1));
+            out_path->length = cost + 1;
         }
     }
-    MPI_Barrier(comm); // ensure all ranks reach this point
-    MPI_Bcast(&success_flag, 1, MPI_INT, 0, comm);
-    if (rank != 0)
+
+    profile_ll_call(MPI_Wtime() - astar_start, search.expanded);
+    if (rank == 0)
+    {
+        LOG_DEBUG("[HDA*] agent=%d: %s in %.3fs (%lld expansions on %d ranks, %lld batches, %d rounds)\n",
+                  agent_id, found ? "SUCCESS" : "FAILED", MPI_Wtime() - astar_start, sum_recv[2], size, sum_recv[0], rounds);
+    }
+    if (workspace == &local_workspace)
     {
-        success = success_flag != 0;
+        a_star_workspace_free(&local_workspace);
     }
-
-    free(local_grid.cells);
-    free(local_constraints.items);
-    return success;
+    return found;
 }
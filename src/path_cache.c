@@ -0,0 +1,366 @@
+#include "path_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PATH_CACHE_INITIAL_BUCKETS 256
+
+static int compare_records(const void *a, const void *b)
+{
+    const int *ra = (const int *)a;
+    const int *rb = (const int *)b;
+    for (int i = 0; i < PATH_CACHE_RECORD_INTS; ++i)
+    {
+        if (ra[i] != rb[i])
+        {
+            return ra[i] < rb[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/*
+Build the canonical key of an agent's constraints into the cache scratch space.
+Only the constraints that apply to the agent are kept, sorted and with
+duplicates removed since repeating a constraint does not change the search.
+
+@param cache Pointer to the PathCache
+@param constraints Pointer to the ConstraintSet (may hold other agents' constraints)
+@param agent_id ID of the agent
+@param out_fingerprint Output hash of the agent and its records
+@return Number of records written to cache->scratch
+*/
+static int build_key(PathCache *cache, const ConstraintSet *constraints, int agent_id, uint64_t *out_fingerprint)
+{
+    if (constraints->count > cache->scratch_capacity)
+    {
+        int new_cap = cache->scratch_capacity == 0 ? 64 : cache->scratch_capacity;
+        while (new_cap < constraints->count)
+        {
+            new_cap *= 2;
+        }
+        int *new_scratch = (int *)realloc(cache->scratch, sizeof(int) * (size_t)new_cap * PATH_CACHE_RECORD_INTS);
+        if (!new_scratch)
+        {
+            fprintf(stderr, "build_key: failed to allocate PathCache scratch (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        cache->scratch = new_scratch;
+        cache->scratch_capacity = new_cap;
+    }
+
+    int count = 0;
+    for (int i = 0; i < constraints->count; ++i)
+    {
+        const Constraint *c = &constraints->items[i];
+        if (!constraint_applies_to(c, agent_id))
+        {
+            continue;
+        }
+        int *record = &cache->scratch[count * PATH_CACHE_RECORD_INTS];
+        record[0] = c->time;
+        record[1] = (int)c->type;
+        record[2] = c->vertex;
+        // vertex constraints leave edge_to unspecified
+        record[3] = c->type == CONSTRAINT_EDGE ? c->edge_to : 0;
+        count++;
+    }
+    if (count > 1)
+    {
+        qsort(cache->scratch, (size_t)count, sizeof(int) * PATH_CACHE_RECORD_INTS, compare_records);
+    }
+
+    int write = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        int *record = &cache->scratch[i * PATH_CACHE_RECORD_INTS];
+        if (write > 0 && compare_records(record, &cache->scratch[(write - 1) * PATH_CACHE_RECORD_INTS]) == 0)
+        {
+            continue;
+        }
+        memmove(&cache->scratch[write * PATH_CACHE_RECORD_INTS], record, sizeof(int) * PATH_CACHE_RECORD_INTS);
+        write++;
+    }
+
+    // FNV-1a over the agent and the records
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = (h ^ (uint64_t)(uint32_t)agent_id) * 0x100000001B3ULL;
+    for (int i = 0; i < write * PATH_CACHE_RECORD_INTS; ++i)
+    {
+        h = (h ^ (uint64_t)(uint32_t)cache->scratch[i]) * 0x100000001B3ULL;
+    }
+    *out_fingerprint = h;
+    return write;
+}
+
+static inline size_t bucket_index(uint64_t fingerprint, int bucket_count)
+{
+    return (size_t)(fingerprint ^ (fingerprint >> 32)) & (size_t)(bucket_count - 1);
+}
+
+static void lru_unlink(PathCache *cache, PathCacheEntry *entry)
+{
+    if (entry->lru_prev)
+    {
+        entry->lru_prev->lru_next = entry->lru_next;
+    }
+    else
+    {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next)
+    {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }
+    else
+    {
+        cache->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void lru_push_front(PathCache *cache, PathCacheEntry *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head)
+    {
+        cache->lru_head->lru_prev = entry;
+    }
+    cache->lru_head = entry;
+    if (!cache->lru_tail)
+    {
+        cache->lru_tail = entry;
+    }
+}
+
+static void entry_free(PathCacheEntry *entry)
+{
+    free(entry->records);
+    path_free(&entry->path);
+    free(entry);
+}
+
+/*
+Find the entry matching a canonical key held in cache->scratch
+
+@param cache Pointer to the PathCache
+@param agent_id ID of the agent
+@param fingerprint Hash produced by build_key
+@param record_count Number of records in cache->scratch
+@return Matching entry, or NULL if none
+*/
+static PathCacheEntry *find_entry(const PathCache *cache, int agent_id, uint64_t fingerprint, int record_count)
+{
+    if (cache->bucket_count == 0)
+    {
+        return NULL;
+    }
+    PathCacheEntry *entry = cache->buckets[bucket_index(fingerprint, cache->bucket_count)];
+    for (; entry != NULL; entry = entry->bucket_next)
+    {
+        // a fingerprint match is confirmed against the records to rule out collisions
+        if (entry->fingerprint == fingerprint &&
+            entry->agent_id == agent_id &&
+            entry->record_count == record_count &&
+            (record_count == 0 ||
+             memcmp(entry->records, cache->scratch, sizeof(int) * (size_t)record_count * PATH_CACHE_RECORD_INTS) == 0))
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+Remove an entry from its bucket and the LRU list and free it
+
+@param cache Pointer to the PathCache
+@param entry Pointer to the cached entry
+*/
+static void remove_entry(PathCache *cache, PathCacheEntry *entry)
+{
+    PathCacheEntry **link = &cache->buckets[bucket_index(entry->fingerprint, cache->bucket_count)];
+    while (*link != entry)
+    {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->bytes;
+    cache->count--;
+    entry_free(entry);
+}
+
+/*
+Double the number of buckets and rehash every entry
+
+@param cache Pointer to the PathCache
+*/
+static void grow_buckets(PathCache *cache)
+{
+    int new_count = cache->bucket_count == 0 ? PATH_CACHE_INITIAL_BUCKETS : cache->bucket_count * 2;
+    PathCacheEntry **new_buckets = (PathCacheEntry **)calloc((size_t)new_count, sizeof(PathCacheEntry *));
+    if (!new_buckets)
+    {
+        fprintf(stderr, "grow_buckets: failed to allocate PathCache buckets (size=%d)\n", new_count);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < cache->bucket_count; ++i)
+    {
+        PathCacheEntry *entry = cache->buckets[i];
+        while (entry)
+        {
+            PathCacheEntry *next = entry->bucket_next;
+            size_t slot = bucket_index(entry->fingerprint, new_count);
+            entry->bucket_next = new_buckets[slot];
+            new_buckets[slot] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = new_buckets;
+    cache->bucket_count = new_count;
+}
+
+/*
+Initialize an empty PathCache
+
+@param cache Pointer to the PathCache to initialize
+@param budget_bytes Memory budget for cached entries (0 disables the cache)
+*/
+void path_cache_init(PathCache *cache, size_t budget_bytes)
+{
+    memset(cache, 0, sizeof(PathCache));
+    cache->budget = budget_bytes;
+}
+
+/*
+Free every cached entry
+
+@param cache Pointer to the PathCache to free
+*/
+void path_cache_free(PathCache *cache)
+{
+    PathCacheEntry *entry = cache->lru_head;
+    while (entry)
+    {
+        PathCacheEntry *next = entry->lru_next;
+        entry_free(entry);
+        entry = next;
+    }
+    free(cache->buckets);
+    free(cache->scratch);
+    path_cache_init(cache, cache->budget);
+}
+
+/*
+Look up the low-level result of an agent under a set of constraints
+
+@param cache Pointer to the PathCache
+@param constraints Pointer to the ConstraintSet (may hold other agents' constraints)
+@param agent_id ID of the agent
+@param out_found Output whether the cached search found a path
+@param out_path Pointer to the AgentPath receiving the cached path on a hit
+@return true on a cache hit, false otherwise
+*/
+bool path_cache_lookup(PathCache *cache,
+                       const ConstraintSet *constraints,
+                       int agent_id,
+                       bool *out_found,
+                       AgentPath *out_path)
+{
+    if (cache->budget == 0)
+    {
+        return false;
+    }
+    uint64_t fingerprint = 0;
+    int record_count = build_key(cache, constraints, agent_id, &fingerprint);
+    PathCacheEntry *entry = find_entry(cache, agent_id, fingerprint, record_count);
+    if (!entry)
+    {
+        cache->misses++;
+        return false;
+    }
+
+    cache->hits++;
+    lru_unlink(cache, entry);
+    lru_push_front(cache, entry);
+    *out_found = entry->found;
+    if (entry->found)
+    {
+        path_copy(out_path, &entry->path);
+    }
+    return true;
+}
+
+/*
+Cache the low-level result of an agent, evicting least recently used
+entries until the cache fits its budget
+
+@param cache Pointer to the PathCache
+@param constraints Pointer to the ConstraintSet the search ran under
+@param agent_id ID of the agent
+@param found Whether the search found a path
+@param path Pointer to the found path (ignored if found is false)
+*/
+void path_cache_store(PathCache *cache,
+                      const ConstraintSet *constraints,
+                      int agent_id,
+                      bool found,
+                      const AgentPath *path)
+{
+    if (cache->budget == 0)
+    {
+        return;
+    }
+    uint64_t fingerprint = 0;
+    int record_count = build_key(cache, constraints, agent_id, &fingerprint);
+    size_t record_bytes = sizeof(int) * (size_t)record_count * PATH_CACHE_RECORD_INTS;
+    size_t bytes = sizeof(PathCacheEntry) + record_bytes + (found ? sizeof(int) * (size_t)path->length : 0);
+    if (bytes > cache->budget || find_entry(cache, agent_id, fingerprint, record_count))
+    {
+        return;
+    }
+
+    while (cache->bytes + bytes > cache->budget && cache->lru_tail)
+    {
+        remove_entry(cache, cache->lru_tail);
+        cache->evictions++;
+    }
+    if (cache->count >= cache->bucket_count)
+    {
+        grow_buckets(cache);
+    }
+
+    PathCacheEntry *entry = (PathCacheEntry *)calloc(1, sizeof(PathCacheEntry));
+    int *records = record_count > 0 ? (int *)malloc(record_bytes) : NULL;
+    if (!entry || (record_count > 0 && !records))
+    {
+        fprintf(stderr, "path_cache_store: failed to allocate PathCacheEntry (records=%d)\n", record_count);
+        exit(EXIT_FAILURE);
+    }
+    if (record_count > 0)
+    {
+        memcpy(records, cache->scratch, record_bytes);
+    }
+    entry->agent_id = agent_id;
+    entry->fingerprint = fingerprint;
+    entry->records = records;
+    entry->record_count = record_count;
+    entry->found = found;
+    entry->bytes = bytes;
+    path_init(&entry->path, 0);
+    if (found)
+    {
+        path_copy(&entry->path, path);
+    }
+
+    size_t slot = bucket_index(fingerprint, cache->bucket_count);
+    entry->bucket_next = cache->buckets[slot];
+    cache->buckets[slot] = entry;
+    lru_push_front(cache, entry);
+    cache->bytes += bytes;
+    cache->count++;
+}
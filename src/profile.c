@@ -0,0 +1,326 @@
+#include "profile.h"
+
+#include <float.h>
+#include <stdatomic.h>
+
+/* Length of the role names exchanged for the rank table */
+#define PROFILE_ROLE_LENGTH 16
+
+/* Doubles per rank in the gathered table: runtime, count/seconds/bytes per phase, LL and CT expansions, largest open list */
+#define PROFILE_ROW_VALUES (1 + 3 * PROFILE_PHASE_COUNT + 3)
+
+bool profile_enabled = false;
+
+/* Phase totals, atomic because the low level also runs on helper threads */
+static _Atomic long long phase_counts[PROFILE_PHASE_COUNT];
+static _Atomic long long phase_nanoseconds[PROFILE_PHASE_COUNT];
+static _Atomic long long phase_bytes[PROFILE_PHASE_COUNT];
+static _Atomic long long ll_expanded;
+static _Atomic long long hl_expanded;
+static _Atomic long long ll_histogram[PROFILE_LL_BUCKETS];
+
+/* Open list size over time, sampled by the thread that runs the search */
+typedef struct
+{
+    double time;
+    long long open_count;
+} OpenSample;
+
+static double profile_begin = 0.0;
+static OpenSample *samples = NULL;
+static int sample_count = 0;
+static double next_sample = 0.0;
+static long long open_max = 0;
+
+/*
+Reset the counters and start the rank's clock
+
+@param enabled Whether to collect anything, false keeps every hook to one branch
+*/
+void profile_init(bool enabled)
+{
+    for (int p = 0; p < PROFILE_PHASE_COUNT; ++p)
+    {
+        atomic_store(&phase_counts[p], 0);
+        atomic_store(&phase_nanoseconds[p], 0);
+        atomic_store(&phase_bytes[p], 0);
+    }
+    for (int b = 0; b < PROFILE_LL_BUCKETS; ++b)
+    {
+        atomic_store(&ll_histogram[b], 0);
+    }
+    atomic_store(&ll_expanded, 0);
+    atomic_store(&hl_expanded, 0);
+    free(samples);
+    samples = NULL;
+    sample_count = 0;
+    open_max = 0;
+    profile_begin = wall_time_seconds();
+    next_sample = profile_begin;
+    profile_enabled = enabled;
+}
+
+/*
+Add one timed occurrence of a phase. Safe on any thread.
+
+@param phase Phase to add to
+@param seconds Time spent
+@param bytes Bytes handled (0 for phases without a volume)
+*/
+void profile_record(ProfilePhase phase, double seconds, long long bytes)
+{
+    atomic_fetch_add_explicit(&phase_counts[phase], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&phase_nanoseconds[phase], (long long)(seconds * 1e9), memory_order_relaxed);
+    if (bytes != 0)
+    {
+        atomic_fetch_add_explicit(&phase_bytes[phase], bytes, memory_order_relaxed);
+    }
+}
+
+/*
+Record a low-level search that ran on this rank. Safe on any thread.
+
+@param seconds Duration of the search
+@param expanded Nodes the search expanded on this rank
+*/
+void profile_ll_call(double seconds, long long expanded)
+{
+    if (!profile_enabled)
+    {
+        return;
+    }
+    profile_record(PROFILE_LL_SEARCH, seconds, 0);
+    atomic_fetch_add_explicit(&ll_expanded, expanded, memory_order_relaxed);
+    long long micros = (long long)(seconds * 1e6);
+    int bucket = 0;
+    while (micros > 1 && bucket < PROFILE_LL_BUCKETS - 1)
+    {
+        micros >>= 1;
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&ll_histogram[bucket], 1, memory_order_relaxed);
+}
+
+/*
+Count one CT node expanded on this rank, the basis of the per-rank load
+imbalance. Safe on any thread.
+*/
+void profile_hl_expand(void)
+{
+    if (profile_enabled)
+    {
+        atomic_fetch_add_explicit(&hl_expanded, 1, memory_order_relaxed);
+    }
+}
+
+/*
+Sample the open list size, at most once per PROFILE_SAMPLE_INTERVAL.
+Called from the search loop of the rank only.
+
+@param open_count Nodes open on this rank
+*/
+void profile_sample_open(long long open_count)
+{
+    if (!profile_enabled)
+    {
+        return;
+    }
+    if (open_count > open_max)
+    {
+        open_max = open_count;
+    }
+    double now = wall_time_seconds();
+    if (now < next_sample || sample_count >= PROFILE_MAX_SAMPLES)
+    {
+        return;
+    }
+    if (samples == NULL)
+    {
+        samples = (OpenSample *)malloc(sizeof(OpenSample) * PROFILE_MAX_SAMPLES);
+        if (!samples)
+        {
+            fprintf(stderr, "profile_sample_open: failed to allocate samples\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    samples[sample_count].time = now - profile_begin;
+    samples[sample_count].open_count = open_count;
+    sample_count++;
+    next_sample = now + PROFILE_SAMPLE_INTERVAL;
+}
+
+/*
+@param phase Timed phase
+@return Name of the phase in the profile files
+*/
+const char *profile_phase_name(ProfilePhase phase)
+{
+    static const char *names[PROFILE_PHASE_COUNT] = {"ll_search", "ll_wait", "mdd", "conflicts", "clone",
+                                                     "serialize", "deserialize", "idle", "collective"};
+    return names[phase];
+}
+
+/*
+@param path Path of the JSON file
+@param rank World rank
+@param role Role of the rank
+@param runtime Seconds since profile_init
+@return true if the file was written
+*/
+static bool write_rank_json(const char *path, int rank, const char *role, double runtime)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+    {
+        return false;
+    }
+    fprintf(fp, "{\n  \"rank\": %d,\n  \"role\": \"%s\",\n  \"runtime_sec\": %.6f,\n  \"phases\": {\n", rank, role, runtime);
+    for (int p = 0; p < PROFILE_PHASE_COUNT; ++p)
+    {
+        fprintf(fp,
+                "    \"%s\": {\"count\": %lld, \"seconds\": %.6f, \"bytes\": %lld}%s\n",
+                profile_phase_name((ProfilePhase)p),
+                atomic_load(&phase_counts[p]),
+                (double)atomic_load(&phase_nanoseconds[p]) / 1e9,
+                atomic_load(&phase_bytes[p]),
+                p + 1 < PROFILE_PHASE_COUNT ? "," : "");
+    }
+    fprintf(fp, "  },\n  \"ll_expanded\": %lld,\n  \"hl_expanded\": %lld,\n  \"ll_time_histogram_us\": [",
+            atomic_load(&ll_expanded), atomic_load(&hl_expanded));
+    for (int b = 0; b < PROFILE_LL_BUCKETS; ++b)
+    {
+        fprintf(fp, "%s[%lld, %lld]", b > 0 ? ", " : "", 1LL << b, atomic_load(&ll_histogram[b]));
+    }
+    fprintf(fp, "],\n  \"open_max\": %lld,\n  \"open_samples\": [", open_max);
+    for (int s = 0; s < sample_count; ++s)
+    {
+        fprintf(fp, "%s[%.3f, %lld]", s > 0 ? ", " : "", samples[s].time, samples[s].open_count);
+    }
+    fprintf(fp, "]\n}\n");
+    fclose(fp);
+    return true;
+}
+
+/*
+@param fp Open CSV file
+@param label First two columns of the row
+@param row PROFILE_ROW_VALUES values
+*/
+static void write_csv_row(FILE *fp, const char *label, const double *row)
+{
+    fprintf(fp, "%s,%.6f", label, row[0]);
+    for (int p = 0; p < PROFILE_PHASE_COUNT; ++p)
+    {
+        fprintf(fp, ",%.0f,%.6f,%.0f", row[1 + 3 * p], row[2 + 3 * p], row[3 + 3 * p]);
+    }
+    fprintf(fp, ",%.0f,%.0f,%.0f\n", row[PROFILE_ROW_VALUES - 3], row[PROFILE_ROW_VALUES - 2], row[PROFILE_ROW_VALUES - 1]);
+}
+
+/*
+Write the profile of every rank. Collective over MPI_COMM_WORLD: each rank
+writes <prefix>.rank<N>.json with its phase totals, expansion counts,
+low-level time histogram and open list samples, and rank 0 writes <prefix>.ranks.csv with one row per
+rank followed by min, mean and max rows across the ranks.
+
+@param prefix Path prefix of the files
+@param role Role of the calling rank (coordinator, worker, ll_pool, ...)
+*/
+void profile_write(const char *prefix, const char *role)
+{
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    double runtime = wall_time_seconds() - profile_begin;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.rank%d.json", prefix, rank);
+    if (!write_rank_json(path, rank, role, runtime))
+    {
+        fprintf(stderr, "Warning: could not open profile file %s for writing.\n", path);
+    }
+
+    double row[PROFILE_ROW_VALUES];
+    row[0] = runtime;
+    for (int p = 0; p < PROFILE_PHASE_COUNT; ++p)
+    {
+        row[1 + 3 * p] = (double)atomic_load(&phase_counts[p]);
+        row[2 + 3 * p] = (double)atomic_load(&phase_nanoseconds[p]) / 1e9;
+        row[3 + 3 * p] = (double)atomic_load(&phase_bytes[p]);
+    }
+    row[PROFILE_ROW_VALUES - 3] = (double)atomic_load(&ll_expanded);
+    row[PROFILE_ROW_VALUES - 2] = (double)atomic_load(&hl_expanded);
+    row[PROFILE_ROW_VALUES - 1] = (double)open_max;
+    char role_name[PROFILE_ROLE_LENGTH] = {0};
+    snprintf(role_name, sizeof(role_name), "%s", role);
+
+    double *rows = NULL;
+    char *roles = NULL;
+    if (rank == 0)
+    {
+        rows = (double *)malloc(sizeof(double) * PROFILE_ROW_VALUES * (size_t)size);
+        roles = (char *)malloc((size_t)PROFILE_ROLE_LENGTH * (size_t)size);
+        if (!rows || !roles)
+        {
+            fprintf(stderr, "profile_write: failed to allocate rank table (ranks=%d)\n", size);
+            exit(EXIT_FAILURE);
+        }
+    }
+    MPI_Gather(row, PROFILE_ROW_VALUES, MPI_DOUBLE, rows, PROFILE_ROW_VALUES, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gather(role_name, PROFILE_ROLE_LENGTH, MPI_CHAR, roles, PROFILE_ROLE_LENGTH, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+    {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s.ranks.csv", prefix);
+    FILE *fp = fopen(path, "w");
+    if (fp)
+    {
+        fprintf(fp, "rank,role,runtime_sec");
+        for (int p = 0; p < PROFILE_PHASE_COUNT; ++p)
+        {
+            const char *name = profile_phase_name((ProfilePhase)p);
+            fprintf(fp, ",%s_count,%s_sec,%s_bytes", name, name, name);
+        }
+        fprintf(fp, ",ll_expanded,hl_expanded,open_max\n");
+
+        double min_row[PROFILE_ROW_VALUES];
+        double sum_row[PROFILE_ROW_VALUES];
+        double max_row[PROFILE_ROW_VALUES];
+        for (int v = 0; v < PROFILE_ROW_VALUES; ++v)
+        {
+            min_row[v] = DBL_MAX;
+            sum_row[v] = 0.0;
+            max_row[v] = -DBL_MAX;
+        }
+        for (int r = 0; r < size; ++r)
+        {
+            const double *values = rows + (size_t)r * PROFILE_ROW_VALUES;
+            char label[64];
+            roles[(size_t)r * PROFILE_ROLE_LENGTH + PROFILE_ROLE_LENGTH - 1] = '\0';
+            snprintf(label, sizeof(label), "%d,%s", r, roles + (size_t)r * PROFILE_ROLE_LENGTH);
+            write_csv_row(fp, label, values);
+            for (int v = 0; v < PROFILE_ROW_VALUES; ++v)
+            {
+                min_row[v] = values[v] < min_row[v] ? values[v] : min_row[v];
+                max_row[v] = values[v] > max_row[v] ? values[v] : max_row[v];
+                sum_row[v] += values[v];
+            }
+        }
+        for (int v = 0; v < PROFILE_ROW_VALUES; ++v)
+        {
+            sum_row[v] /= (double)size;
+        }
+        write_csv_row(fp, "min,all", min_row);
+        write_csv_row(fp, "mean,all", sum_row);
+        write_csv_row(fp, "max,all", max_row);
+        fclose(fp);
+    }
+    else
+    {
+        fprintf(stderr, "Warning: could not open profile file %s for writing.\n", path);
+    }
+    free(rows);
+    free(roles);
+}
@@ -1,179 +1,683 @@
 #include "serialization.h"
 
+#include "messages.h"
+#include "profile.h"
+
 #include <mpi.h>
 #include <string.h>
 
-static int compute_path_int_count(const HighLevelNode *node)
+MPI_Comm solver_comm = MPI_COMM_WORLD;
+
+#define NODE_BATCH_HEADER_INTS 4
+#define NODE_BATCH_HEADER_SIZE ((int)sizeof(int) * NODE_BATCH_HEADER_INTS)
+#define FULL_RECORD_INTS 6
+#define DELTA_RECORD_INTS 8
+#define CONSTRAINT_RECORD_INTS 5
+#define MOVES_PER_INT 10
+
+/* Path encodings */
+#define PATH_ENCODING_MOVES 0
+#define PATH_ENCODING_RAW 1
+
+
+static void node_batch_reserve(NodeBatch *batch, int bytes)
 {
-    int total = 0;
-    for (int i = 0; i < node->num_agents; ++i)
+    if (bytes <= batch->capacity)
+    {
+        return;
+    }
+    int new_cap = batch->capacity == 0 ? 1024 : batch->capacity;
+    while (new_cap < bytes)
     {
-        total += 1 + node->paths[i].length * 2;
+        new_cap *= 2;
     }
-    return total;
+    unsigned char *new_data = (unsigned char *)realloc(batch->data, (size_t)new_cap);
+    if (!new_data)
+    {
+        fprintf(stderr, "node_batch_reserve: failed to allocate NodeBatch (size=%d)\n", new_cap);
+        exit(EXIT_FAILURE);
+    }
+    batch->data = new_data;
+    batch->capacity = new_cap;
 }
 
-static void fill_path_data(const HighLevelNode *node, int *buffer)
+static inline void put_int(NodeBatch *batch, int value)
 {
-    int cursor = 0;
-    for (int i = 0; i < node->num_agents; ++i)
+    memcpy(batch->data + batch->size, &value, sizeof(int));
+    batch->size += (int)sizeof(int);
+}
+
+static inline bool get_int(const NodeBatch *batch, int *cursor, int *value)
+{
+    if (*cursor + (int)sizeof(int) > batch->size)
     {
-        buffer[cursor++] = node->paths[i].length;
-        for (int j = 0; j < node->paths[i].length; ++j)
+        return false;
+    }
+    memcpy(value, batch->data + *cursor, sizeof(int));
+    *cursor += (int)sizeof(int);
+    return true;
+}
+
+/*
+Initialize an empty NodeBatch
+
+@param batch Pointer to the NodeBatch to initialize
+*/
+void node_batch_init(NodeBatch *batch)
+{
+    batch->data = NULL;
+    batch->size = 0;
+    batch->capacity = 0;
+    batch->node_count = 0;
+    batch->aux_value = 0;
+}
+
+/*
+Free memory used by NodeBatch
+
+@param batch Pointer to the NodeBatch to free
+*/
+void node_batch_free(NodeBatch *batch)
+{
+    free(batch->data);
+    node_batch_init(batch);
+}
+
+/*
+Start a new message in the batch, keeping its buffer
+
+@param batch Pointer to the NodeBatch
+@param aux_value Per-message integer stored in the header
+*/
+void node_batch_reset(NodeBatch *batch, int aux_value)
+{
+    node_batch_reserve(batch, NODE_BATCH_HEADER_SIZE);
+    batch->size = 0;
+    batch->node_count = 0;
+    batch->aux_value = aux_value;
+    put_int(batch, NODE_WIRE_VERSION);
+    put_int(batch, 0);
+    put_int(batch, aux_value);
+    put_int(batch, 0);
+}
+
+static inline void put_double(NodeBatch *batch, double value)
+{
+    memcpy(batch->data + batch->size, &value, sizeof(double));
+    batch->size += (int)sizeof(double);
+}
+
+static inline bool get_double(const NodeBatch *batch, int *cursor, double *value)
+{
+    if (*cursor + (int)sizeof(double) > batch->size)
+    {
+        return false;
+    }
+    memcpy(value, batch->data + *cursor, sizeof(double));
+    *cursor += (int)sizeof(double);
+    return true;
+}
+
+/*
+3-bit code of a step between two cells: wait, +1, -1, +stride, -stride
+
+@param from Cell before the step
+@param to Cell after the step
+@param stride Row stride of the path (0 if it never changes rows)
+@return Move code, or -1 if the step is not a wait or unit move
+*/
+static int move_code(int from, int to, int stride)
+{
+    const int deltas[5] = {0, 1, -1, stride, -stride};
+    for (int code = 0; code < 5; ++code)
+    {
+        // codes 3 and 4 only exist once the path has changed rows
+        if (to - from == deltas[code] && (code < 3 || stride > 1))
         {
-            buffer[cursor++] = node->paths[i].steps[j].x;
-            buffer[cursor++] = node->paths[i].steps[j].y;
+            return code;
         }
     }
+    return -1;
 }
 
-static void apply_path_data(HighLevelNode *node, const int *buffer)
+/*
+The row stride a path's vertical steps use, so move codes can be decoded
+without knowing the grid: the first step that moves by more than one cell
+
+@param path Pointer to the AgentPath
+@return Row stride, or 0 if every step moves by at most one cell
+*/
+static int path_stride(const AgentPath *path)
 {
-    int cursor = 0;
-    for (int i = 0; i < node->num_agents; ++i)
+    for (int j = 1; j < path->length; ++j)
+    {
+        int delta = path->steps[j] - path->steps[j - 1];
+        if (delta > 1 || delta < -1)
+        {
+            return delta > 0 ? delta : -delta;
+        }
+    }
+    return 0;
+}
+
+/*
+Upper bound on the ints of an encoded path
+
+@param path Pointer to the AgentPath
+@return Number of ints put_path may write
+*/
+static int path_int_bound(const AgentPath *path)
+{
+    return 4 + path->length;
+}
+
+/*
+Encode a path as its first cell and row stride followed by one move code
+per step, falling back to raw cells if a step is not a unit move or a wait
+
+@param batch Pointer to the NodeBatch (with room for path_int_bound ints)
+@param path Pointer to the AgentPath
+*/
+static void put_path(NodeBatch *batch, const AgentPath *path)
+{
+    int stride = path_stride(path);
+    bool unit_moves = true;
+    for (int j = 1; unit_moves && j < path->length; ++j)
+    {
+        unit_moves = move_code(path->steps[j - 1], path->steps[j], stride) >= 0;
+    }
+
+    put_int(batch, path->length);
+    put_int(batch, unit_moves ? PATH_ENCODING_MOVES : PATH_ENCODING_RAW);
+    if (path->length == 0)
+    {
+        return;
+    }
+    if (!unit_moves)
+    {
+        for (int j = 0; j < path->length; ++j)
+        {
+            put_int(batch, path->steps[j]);
+        }
+        return;
+    }
+
+    put_int(batch, path->steps[0]);
+    put_int(batch, stride);
+    unsigned int word = 0;
+    int packed = 0;
+    for (int j = 1; j < path->length; ++j)
+    {
+        word |= (unsigned int)move_code(path->steps[j - 1], path->steps[j], stride) << (3 * packed);
+        if (++packed == MOVES_PER_INT)
+        {
+            put_int(batch, (int)word);
+            word = 0;
+            packed = 0;
+        }
+    }
+    if (packed > 0)
+    {
+        put_int(batch, (int)word);
+    }
+}
+
+/*
+Decode a path written by put_path
+
+@param batch Pointer to the NodeBatch
+@param cursor Byte offset of the path, advanced past it
+@param path Pointer to the AgentPath to fill
+@return true on success, false on malformed data
+*/
+static bool get_path(const NodeBatch *batch, int *cursor, AgentPath *path)
+{
+    int length = 0;
+    int encoding = 0;
+    if (!get_int(batch, cursor, &length) || !get_int(batch, cursor, &encoding) || length < 0)
+    {
+        return false;
+    }
+    int ints = 0;
+    if (length > 0)
+    {
+        ints = encoding == PATH_ENCODING_RAW ? length : 2 + (length - 1 + MOVES_PER_INT - 1) / MOVES_PER_INT;
+    }
+    if (*cursor + ints * (int)sizeof(int) > batch->size)
+    {
+        return false;
+    }
+    path_reserve(path, length);
+    path->length = length;
+    if (length == 0)
+    {
+        return true;
+    }
+    if (encoding == PATH_ENCODING_RAW)
     {
-        int length = buffer[cursor++];
-        path_reserve(&node->paths[i], length);
-        node->paths[i].length = length;
         for (int j = 0; j < length; ++j)
         {
-            node->paths[i].steps[j].x = buffer[cursor++];
-            node->paths[i].steps[j].y = buffer[cursor++];
+            get_int(batch, cursor, &path->steps[j]);
+        }
+        return true;
+    }
+
+    int stride = 0;
+    get_int(batch, cursor, &path->steps[0]);
+    get_int(batch, cursor, &stride);
+    const int deltas[5] = {0, 1, -1, stride, -stride};
+    int word = 0;
+    for (int j = 1; j < length; ++j)
+    {
+        int slot = (j - 1) % MOVES_PER_INT;
+        if (slot == 0)
+        {
+            get_int(batch, cursor, &word);
+        }
+        int code = (int)(((unsigned int)word >> (3 * slot)) & 7u);
+        if (code > 4)
+        {
+            return false;
+        }
+        path->steps[j] = path->steps[j - 1] + deltas[code];
+    }
+    return true;
+}
+
+static void put_constraint(NodeBatch *batch, const Constraint *c)
+{
+    put_int(batch, c->agent_id);
+    put_int(batch, c->time);
+    put_int(batch, (int)c->type);
+    put_int(batch, c->vertex);
+    put_int(batch, c->edge_to);
+}
+
+static bool get_constraint(const NodeBatch *batch, int *cursor, Constraint *out)
+{
+    int c[CONSTRAINT_RECORD_INTS];
+    for (int k = 0; k < CONSTRAINT_RECORD_INTS; ++k)
+    {
+        if (!get_int(batch, cursor, &c[k]))
+        {
+            return false;
         }
     }
+    *out = (Constraint){.agent_id = c[0],
+                        .time = c[1],
+                        .type = (ConstraintType)c[2],
+                        .vertex = c[3],
+                        .edge_to = c[4]};
+    return true;
 }
 
-void serialize_high_level_node(const HighLevelNode *node, SerializedNode *out)
+static void finish_record(NodeBatch *batch)
 {
-    out->node_id = node->id;
-    out->parent_id = node->parent_id;
-    out->depth = node->depth;
-    out->num_agents = node->num_agents;
-    out->constraint_count = node->constraints.count;
-    out->aux_value = 0;
-    out->cost = node->cost;
+    batch->node_count++;
+    memcpy(batch->data + sizeof(int), &batch->node_count, sizeof(int));
+}
+
+/*
+Pack a CT node at the end of the batch.
+The shared constraint chain is flattened oldest first, so the receiver
+rebuilds it in the same order.
+
+@param batch Pointer to the NodeBatch (reset at least once)
+@param node Pointer to the HighLevelNode to pack
+*/
+void node_batch_append(NodeBatch *batch, const HighLevelNode *node)
+{
+    double phase_start = profile_start();
+    int first_byte = batch->size;
+    int ints = FULL_RECORD_INTS + node->constraint_count * CONSTRAINT_RECORD_INTS;
+    for (int i = 0; i < node->num_agents; ++i)
+    {
+        ints += path_int_bound(cbs_node_path(node, i));
+    }
+    node_batch_reserve(batch, batch->size + ints * (int)sizeof(int) + (int)sizeof(double));
 
-    out->path_int_count = compute_path_int_count(node);
-    out->path_data = NULL;
-    if (out->path_int_count > 0)
+    put_int(batch, NODE_RECORD_FULL);
+    put_int(batch, node->id);
+    put_int(batch, node->parent_id);
+    put_int(batch, node->depth);
+    put_int(batch, node->num_agents);
+    put_int(batch, node->constraint_count);
+    put_double(batch, node->cost);
+
+    for (int i = 0; i < node->num_agents; ++i)
     {
-        out->path_data = (int *)malloc(sizeof(int) * (size_t)out->path_int_count);
-        fill_path_data(node, out->path_data);
+        put_path(batch, cbs_node_path(node, i));
     }
 
-    out->constraint_int_count = node->constraints.count * 7;
-    out->constraint_data = NULL;
-    if (out->constraint_int_count > 0)
+    if (node->constraint_count > 0)
     {
-        out->constraint_data = (int *)malloc(sizeof(int) * (size_t)out->constraint_int_count);
-        int cursor = 0;
-        for (int i = 0; i < node->constraints.count; ++i)
+        ConstraintSet constraints;
+        constraint_set_init(&constraints, node->constraint_count);
+        cbs_node_collect_constraints(node, -1, &constraints);
+        for (int i = 0; i < constraints.count; ++i)
         {
-            const Constraint *c = &node->constraints.items[i];
-            out->constraint_data[cursor++] = c->agent_id;
-            out->constraint_data[cursor++] = c->time;
-            out->constraint_data[cursor++] = (int)c->type;
-            out->constraint_data[cursor++] = c->vertex.x;
-            out->constraint_data[cursor++] = c->vertex.y;
-            out->constraint_data[cursor++] = c->edge_to.x;
-            out->constraint_data[cursor++] = c->edge_to.y;
+            put_constraint(batch, &constraints.items[i]);
         }
+        constraint_set_free(&constraints);
     }
+    finish_record(batch);
+    profile_stop_bytes(PROFILE_SERIALIZE, phase_start, batch->size - first_byte);
 }
 
-void free_serialized_node(SerializedNode *node)
+static bool paths_equal(const AgentPath *a, const AgentPath *b)
 {
-    free(node->path_data);
-    free(node->constraint_data);
-    node->path_data = NULL;
-    node->constraint_data = NULL;
-    node->path_int_count = 0;
-    node->constraint_int_count = 0;
+    return a->length == b->length &&
+           (a->length == 0 || memcmp(a->steps, b->steps, sizeof(int) * (size_t)a->length) == 0);
 }
 
-HighLevelNode *deserialize_high_level_node(const SerializedNode *data)
+/*
+Pack a CT node as its difference to a base node held by the receiver.
+The base must be an ancestor of the node (its chain is a prefix of the
+node's chain), otherwise the full node is packed instead.
+
+@param batch Pointer to the NodeBatch (reset at least once)
+@param node Pointer to the HighLevelNode to pack
+@param base Pointer to the base HighLevelNode known to the receiver
+*/
+void node_batch_append_delta(NodeBatch *batch, const HighLevelNode *node, const HighLevelNode *base)
 {
-    HighLevelNode *node = cbs_node_create(data->num_agents);
+    int new_constraints = node->constraint_count - base->constraint_count;
+    const ConstraintLink *link = node->constraints;
+    for (int k = 0; link && k < new_constraints; ++k)
+    {
+        link = link->parent;
+    }
+    if (new_constraints < 0 || base->num_agents != node->num_agents || link != base->constraints)
+    {
+        node_batch_append(batch, node);
+        return;
+    }
+
+    double phase_start = profile_start();
+    int first_byte = batch->size;
+    int changed = 0;
+    int ints = DELTA_RECORD_INTS + new_constraints * CONSTRAINT_RECORD_INTS;
+    for (int i = 0; i < node->num_agents; ++i)
+    {
+        if (node->paths[i] != base->paths[i] && !paths_equal(cbs_node_path(node, i), cbs_node_path(base, i)))
+        {
+            changed++;
+            ints += 1 + path_int_bound(cbs_node_path(node, i));
+        }
+    }
+    node_batch_reserve(batch, batch->size + ints * (int)sizeof(int) + (int)sizeof(double));
+
+    put_int(batch, NODE_RECORD_DELTA);
+    put_int(batch, node->id);
+    put_int(batch, node->parent_id);
+    put_int(batch, node->depth);
+    put_int(batch, node->num_agents);
+    put_int(batch, base->id);
+    put_int(batch, new_constraints);
+    put_int(batch, changed);
+    put_double(batch, node->cost);
+
+    // the newest links come first in the chain, the receiver adds them oldest first
+    int start = batch->size;
+    batch->size += new_constraints * CONSTRAINT_RECORD_INTS * (int)sizeof(int);
+    int end = batch->size;
+    link = node->constraints;
+    for (int k = new_constraints - 1; k >= 0; --k)
+    {
+        batch->size = start + k * CONSTRAINT_RECORD_INTS * (int)sizeof(int);
+        put_constraint(batch, &link->constraint);
+        link = link->parent;
+    }
+    batch->size = end;
+
+    for (int i = 0; i < node->num_agents; ++i)
+    {
+        if (node->paths[i] != base->paths[i] && !paths_equal(cbs_node_path(node, i), cbs_node_path(base, i)))
+        {
+            put_int(batch, i);
+            put_path(batch, cbs_node_path(node, i));
+        }
+    }
+    finish_record(batch);
+    profile_stop_bytes(PROFILE_SERIALIZE, phase_start, batch->size - first_byte);
+}
+
+static HighLevelNode *read_full_record(const NodeBatch *batch, int *cursor, const int *fields)
+{
+    int num_agents = fields[3];
+    int constraint_count = fields[4];
+    HighLevelNode *node = cbs_node_create(num_agents);
     if (!node)
     {
         return NULL;
     }
-    node->id = data->node_id;
-    node->parent_id = data->parent_id;
-    node->depth = data->depth;
-    node->cost = data->cost;
+    node->id = fields[0];
+    node->parent_id = fields[1];
+    node->depth = fields[2];
+
+    bool ok = get_double(batch, cursor, &node->cost);
+    for (int i = 0; ok && i < num_agents; ++i)
+    {
+        // a freshly created node holds its own unshared paths
+        ok = get_path(batch, cursor, &node->paths[i]->path);
+    }
+    for (int i = 0; ok && i < constraint_count; ++i)
+    {
+        Constraint c;
+        ok = get_constraint(batch, cursor, &c);
+        if (ok)
+        {
+            cbs_node_add_constraint(node, c);
+        }
+    }
+    if (!ok)
+    {
+        cbs_node_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+static HighLevelNode *read_delta_record(const NodeBatch *batch, int *cursor, const int *fields, const NodeWindow *bases)
+{
+    int base_id = fields[4];
+    int new_constraints = fields[5];
+    int changed = fields[6];
+    const HighLevelNode *base = bases ? node_window_find(bases, base_id) : NULL;
+    if (!base || base->num_agents != fields[3] || new_constraints < 0 || changed < 0)
+    {
+        fprintf(stderr, "node_batch_next: delta base %d not available\n", base_id);
+        return NULL;
+    }
 
-    if (data->path_int_count > 0 && data->path_data != NULL)
+    HighLevelNode *node = cbs_node_share(base);
+    if (!node)
     {
-        apply_path_data(node, data->path_data);
+        return NULL;
     }
+    node->id = fields[0];
+    node->parent_id = fields[1];
+    node->depth = fields[2];
 
-    if (data->constraint_int_count > 0 && data->constraint_data != NULL)
+    bool ok = get_double(batch, cursor, &node->cost);
+    for (int k = 0; ok && k < new_constraints; ++k)
+    {
+        Constraint c;
+        ok = get_constraint(batch, cursor, &c);
+        if (ok)
+        {
+            cbs_node_add_constraint(node, c);
+        }
+    }
+    for (int i = 0; ok && i < changed; ++i)
     {
-        int cursor = 0;
-        for (int i = 0; i < data->constraint_count; ++i)
+        int agent = -1;
+        ok = get_int(batch, cursor, &agent) && agent >= 0 && agent < node->num_agents;
+        if (!ok)
+        {
+            break;
+        }
+        PathRef *path = path_ref_create();
+        ok = get_path(batch, cursor, &path->path);
+        if (!ok)
         {
-            Constraint c = {
-                .agent_id = data->constraint_data[cursor++],
-                .time = data->constraint_data[cursor++],
-                .type = (ConstraintType)data->constraint_data[cursor++],
-                .vertex = {.x = data->constraint_data[cursor++], .y = data->constraint_data[cursor++]},
-                .edge_to = {.x = data->constraint_data[cursor++], .y = data->constraint_data[cursor++]}};
-            constraint_set_add(&node->constraints, c);
+            path_ref_release(path);
+            break;
         }
+        cbs_node_set_path(node, agent, path);
+    }
+    if (!ok)
+    {
+        cbs_node_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+/*
+Unpack the next node of a batch
+
+@param batch Pointer to the NodeBatch
+@param cursor Byte offset of the next node, 0 to start from the first one
+@param bases Window holding the bases of delta records (may be NULL)
+@return Newly allocated HighLevelNode, or NULL at the end of the batch or on malformed data
+*/
+HighLevelNode *node_batch_next(const NodeBatch *batch, int *cursor, const NodeWindow *bases)
+{
+    if (*cursor < NODE_BATCH_HEADER_SIZE)
+    {
+        *cursor = NODE_BATCH_HEADER_SIZE;
+    }
+    if (*cursor >= batch->size)
+    {
+        return NULL;
+    }
+    double phase_start = profile_start();
+    int first_byte = *cursor;
+
+    int kind = 0;
+    int fields[DELTA_RECORD_INTS - 1];
+    int field_count = 0;
+    bool ok = get_int(batch, cursor, &kind) && (kind == NODE_RECORD_FULL || kind == NODE_RECORD_DELTA);
+    if (ok)
+    {
+        field_count = (kind == NODE_RECORD_FULL ? FULL_RECORD_INTS : DELTA_RECORD_INTS) - 1;
+    }
+    for (int i = 0; ok && i < field_count; ++i)
+    {
+        ok = get_int(batch, cursor, &fields[i]);
     }
 
+    HighLevelNode *node = NULL;
+    if (ok && fields[3] >= 0)
+    {
+        node = kind == NODE_RECORD_FULL ? read_full_record(batch, cursor, fields)
+                                        : read_delta_record(batch, cursor, fields, bases);
+    }
+    if (!node)
+    {
+        // later records may depend on this one, drop the rest of the message
+        fprintf(stderr, "node_batch_next: malformed node record\n");
+        *cursor = batch->size;
+    }
+    profile_stop_bytes(PROFILE_DESERIALIZE, phase_start, *cursor - first_byte);
     return node;
 }
 
-void send_serialized_node(int dest_rank, int tag, const SerializedNode *node)
+/*
+Initialize an empty NodeWindow
+
+@param window Pointer to the NodeWindow to initialize
+@param capacity Number of nodes kept before the oldest is freed
+*/
+void node_window_init(NodeWindow *window, int capacity)
 {
-    int header[8] = {
-        node->node_id,
-        node->parent_id,
-        node->depth,
-        node->num_agents,
-        node->constraint_count,
-        node->path_int_count,
-        node->constraint_int_count,
-        node->aux_value};
+    window->nodes = (HighLevelNode **)calloc((size_t)capacity, sizeof(HighLevelNode *));
+    if (!window->nodes)
+    {
+        fprintf(stderr, "node_window_init: failed to allocate NodeWindow (size=%d)\n", capacity);
+        exit(EXIT_FAILURE);
+    }
+    window->capacity = capacity;
+    window->head = 0;
+    window->count = 0;
+}
+
+/*
+Free every node held by a NodeWindow
 
-    MPI_Send(header, 8, MPI_INT, dest_rank, tag, MPI_COMM_WORLD);
-    MPI_Send(&node->cost, 1, MPI_DOUBLE, dest_rank, tag, MPI_COMM_WORLD);
-    if (node->path_int_count > 0 && node->path_data != NULL)
+@param window Pointer to the NodeWindow to free
+*/
+void node_window_free(NodeWindow *window)
+{
+    for (int i = 0; i < window->count; ++i)
     {
-        MPI_Send(node->path_data, node->path_int_count, MPI_INT, dest_rank, tag, MPI_COMM_WORLD);
+        cbs_node_free(window->nodes[(window->head + i) % window->capacity]);
     }
-    if (node->constraint_int_count > 0 && node->constraint_data != NULL)
+    free(window->nodes);
+    window->nodes = NULL;
+    window->capacity = 0;
+    window->head = 0;
+    window->count = 0;
+}
+
+/*
+Add a node to the window, freeing the oldest node once the window is full
+
+@param window Pointer to the NodeWindow
+@param node Pointer to the HighLevelNode (ownership moves to the window)
+*/
+void node_window_push(NodeWindow *window, HighLevelNode *node)
+{
+    if (window->count == window->capacity)
     {
-        MPI_Send(node->constraint_data, node->constraint_int_count, MPI_INT, dest_rank, tag, MPI_COMM_WORLD);
+        cbs_node_free(window->nodes[window->head]);
+        window->nodes[window->head] = node;
+        window->head = (window->head + 1) % window->capacity;
+        return;
     }
+    window->nodes[(window->head + window->count) % window->capacity] = node;
+    window->count++;
 }
 
-void pending_send_pool_init(PendingSendPool *pool)
+/*
+Find a node of the window by id
+
+@param window Pointer to the NodeWindow
+@param node_id ID of the node
+@return Pointer to the HighLevelNode, or NULL if the window does not hold it
+*/
+HighLevelNode *node_window_find(const NodeWindow *window, int node_id)
 {
-    pool->count = 0;
-    for (int i = 0; i < MAX_PENDING_SENDS; ++i)
+    // newest first, recent parents are the common case
+    for (int i = window->count - 1; i >= 0; --i)
     {
-        pool->entries[i].num_requests = 0;
-        pool->entries[i].header = NULL;
-        pool->entries[i].cost = NULL;
-        pool->entries[i].path_data = NULL;
-        pool->entries[i].constraint_data = NULL;
+        HighLevelNode *node = window->nodes[(window->head + i) % window->capacity];
+        if (node->id == node_id)
+        {
+            return node;
+        }
     }
+    return NULL;
 }
 
-static void free_pending_send_entry(PendingSend *entry)
+void node_batch_send(int dest_rank, int tag, const NodeBatch *batch)
 {
-    free(entry->header);
-    free(entry->cost);
-    free(entry->path_data);
-    free(entry->constraint_data);
-    entry->header = NULL;
-    entry->cost = NULL;
-    entry->path_data = NULL;
-    entry->constraint_data = NULL;
-    entry->num_requests = 0;
+    MPI_Send(batch->data, batch->size, MPI_BYTE, dest_rank, tag, solver_comm);
+}
+
+void pending_send_pool_init(PendingSendPool *pool)
+{
+    pool->entries = NULL;
+    pool->count = 0;
+    pool->capacity = 0;
+}
+
+void pending_send_pool_free(PendingSendPool *pool)
+{
+    pending_send_pool_wait_all(pool);
+    free(pool->entries);
+    pending_send_pool_init(pool);
 }
 
 void pending_send_pool_progress(PendingSendPool *pool)
@@ -184,11 +688,11 @@ void pending_send_pool_progress(PendingSendPool *pool)
     {
         PendingSend *entry = &pool->entries[i];
         int flag = 0;
-        MPI_Testall(entry->num_requests, entry->requests, &flag, MPI_STATUSES_IGNORE);
+        MPI_Test(&entry->request, &flag, MPI_STATUS_IGNORE);
         if (flag)
         {
-            /* All requests completed - free buffers */
-            free_pending_send_entry(entry);
+            /* Send completed - free buffer */
+            free(entry->data);
         }
         else
         {
@@ -207,112 +711,72 @@ void pending_send_pool_wait_all(PendingSendPool *pool)
 {
     for (int i = 0; i < pool->count; ++i)
     {
-        PendingSend *entry = &pool->entries[i];
-        MPI_Waitall(entry->num_requests, entry->requests, MPI_STATUSES_IGNORE);
-        free_pending_send_entry(entry);
+        MPI_Wait(&pool->entries[i].request, MPI_STATUS_IGNORE);
+        free(pool->entries[i].data);
     }
     pool->count = 0;
 }
 
-void send_serialized_node_async(int dest_rank, int tag, const SerializedNode *node, PendingSendPool *pool)
+void node_batch_send_async(int dest_rank, int tag, NodeBatch *batch, PendingSendPool *pool)
 {
     /* First, try to make room by completing any finished sends */
     pending_send_pool_progress(pool);
 
-    /* If pool is full, block-wait for all to complete */
-    if (pool->count >= MAX_PENDING_SENDS)
-    {
-        printf("[SEND_POOL] Pool full (%d), waiting for all sends to complete...\n", pool->count);
-        fflush(stdout);
-        pending_send_pool_wait_all(pool);
-        printf("[SEND_POOL] All sends completed, pool cleared\n");
-        fflush(stdout);
-    }
-
-    PendingSend *entry = &pool->entries[pool->count];
-    entry->num_requests = 0;
-
-    /* Allocate and fill header buffer (must persist until send completes) */
-    entry->header = (int *)malloc(sizeof(int) * 8);
-    entry->header[0] = node->node_id;
-    entry->header[1] = node->parent_id;
-    entry->header[2] = node->depth;
-    entry->header[3] = node->num_agents;
-    entry->header[4] = node->constraint_count;
-    entry->header[5] = node->path_int_count;
-    entry->header[6] = node->constraint_int_count;
-    entry->header[7] = node->aux_value;
-
-    /* Allocate cost buffer */
-    entry->cost = (double *)malloc(sizeof(double));
-    *(entry->cost) = node->cost;
-
-    /* Copy path data if present */
-    entry->path_data = NULL;
-    if (node->path_int_count > 0 && node->path_data != NULL)
-    {
-        entry->path_data = (int *)malloc(sizeof(int) * (size_t)node->path_int_count);
-        memcpy(entry->path_data, node->path_data, sizeof(int) * (size_t)node->path_int_count);
-    }
-
-    /* Copy constraint data if present */
-    entry->constraint_data = NULL;
-    if (node->constraint_int_count > 0 && node->constraint_data != NULL)
-    {
-        entry->constraint_data = (int *)malloc(sizeof(int) * (size_t)node->constraint_int_count);
-        memcpy(entry->constraint_data, node->constraint_data, sizeof(int) * (size_t)node->constraint_int_count);
-    }
-
-    /* Issue non-blocking sends */
-    MPI_Isend(entry->header, 8, MPI_INT, dest_rank, tag, MPI_COMM_WORLD,
-              &entry->requests[entry->num_requests++]);
-    MPI_Isend(entry->cost, 1, MPI_DOUBLE, dest_rank, tag, MPI_COMM_WORLD,
-              &entry->requests[entry->num_requests++]);
-    if (entry->path_data != NULL)
+    if (pool->count >= pool->capacity)
     {
-        MPI_Isend(entry->path_data, node->path_int_count, MPI_INT, dest_rank, tag, MPI_COMM_WORLD,
-                  &entry->requests[entry->num_requests++]);
-    }
-    if (entry->constraint_data != NULL)
-    {
-        MPI_Isend(entry->constraint_data, node->constraint_int_count, MPI_INT, dest_rank, tag, MPI_COMM_WORLD,
-                  &entry->requests[entry->num_requests++]);
+        int new_cap = pool->capacity == 0 ? 64 : pool->capacity * 2;
+        PendingSend *new_entries = (PendingSend *)realloc(pool->entries, sizeof(PendingSend) * (size_t)new_cap);
+        if (!new_entries)
+        {
+            fprintf(stderr, "node_batch_send_async: failed to allocate PendingSendPool (size=%d)\n", new_cap);
+            exit(EXIT_FAILURE);
+        }
+        pool->entries = new_entries;
+        pool->capacity = new_cap;
     }
 
-    pool->count++;
+    /* The buffer must persist until the send completes, so the pool owns it */
+    PendingSend *entry = &pool->entries[pool->count++];
+    entry->data = batch->data;
+    MPI_Isend(entry->data, batch->size, MPI_BYTE, dest_rank, tag, solver_comm, &entry->request);
+    node_batch_init(batch);
 }
 
-void receive_serialized_node(int source_rank, int tag, SerializedNode *out, MPI_Status *status_out)
+bool node_batch_receive(int source_rank, int tag, NodeBatch *batch, MPI_Status *status_out)
 {
-    int header[8];
     MPI_Status status;
-    MPI_Recv(header, 8, MPI_INT, source_rank, tag, MPI_COMM_WORLD, &status);
+    MPI_Probe(source_rank, tag, solver_comm, &status);
+    int bytes = 0;
+    MPI_Get_count(&status, MPI_BYTE, &bytes);
+    node_batch_reserve(batch, bytes > 0 ? bytes : 1);
+    MPI_Recv(batch->data, bytes, MPI_BYTE, status.MPI_SOURCE, status.MPI_TAG, solver_comm, &status);
     if (status_out != NULL)
     {
         *status_out = status;
     }
-    out->node_id = header[0];
-    out->parent_id = header[1];
-    out->depth = header[2];
-    out->num_agents = header[3];
-    out->constraint_count = header[4];
-    out->path_int_count = header[5];
-    out->constraint_int_count = header[6];
-    out->aux_value = header[7];
 
-    MPI_Recv(&out->cost, 1, MPI_DOUBLE, source_rank, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-    out->path_data = NULL;
-    if (out->path_int_count > 0)
+    batch->size = bytes;
+    batch->node_count = 0;
+    batch->aux_value = 0;
+    int cursor = 0;
+    int version = 0;
+    int count = 0;
+    int aux = 0;
+    if (!get_int(batch, &cursor, &version) || !get_int(batch, &cursor, &count) || !get_int(batch, &cursor, &aux) ||
+        bytes < NODE_BATCH_HEADER_SIZE)
     {
-        out->path_data = (int *)malloc(sizeof(int) * (size_t)out->path_int_count);
-        MPI_Recv(out->path_data, out->path_int_count, MPI_INT, source_rank, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        fprintf(stderr, "node_batch_receive: short message (%d bytes) from rank %d\n", bytes, status.MPI_SOURCE);
+        batch->size = 0;
+        return false;
     }
-
-    out->constraint_data = NULL;
-    if (out->constraint_int_count > 0)
+    if (version != NODE_WIRE_VERSION)
     {
-        out->constraint_data = (int *)malloc(sizeof(int) * (size_t)out->constraint_int_count);
-        MPI_Recv(out->constraint_data, out->constraint_int_count, MPI_INT, source_rank, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        fprintf(stderr, "node_batch_receive: unsupported wire version %d from rank %d (expected %d)\n",
+                version, status.MPI_SOURCE, NODE_WIRE_VERSION);
+        batch->size = 0;
+        return false;
     }
+    batch->node_count = count;
+    batch->aux_value = aux;
+    return true;
 }
@@ -0,0 +1,342 @@
+#include "sipp.h"
+
+#include "heuristic.h"
+#include "log.h"
+#include "profile.h"
+
+#include <limits.h>
+#include <stdio.h>
+
+/* Interval end used for the last safe interval of a cell */
+#define SIPP_INFINITY INT_MAX
+
+/*
+Safe intervals of the planned agent.
+Vertex constraints are sorted by (cell, time); the k constrained times of
+a cell split its timeline into the k + 1 intervals between them.
+*/
+typedef struct
+{
+    /** Sorted (cell, time) pairs, two ints per vertex constraint */
+    int *pairs;
+    /** Number of pairs */
+    int count;
+} SafeIntervals;
+
+static int compare_pairs(const void *a, const void *b)
+{
+    const int *pa = (const int *)a;
+    const int *pb = (const int *)b;
+    if (pa[0] != pb[0])
+    {
+        return pa[0] < pb[0] ? -1 : 1;
+    }
+    if (pa[1] != pb[1])
+    {
+        return pa[1] < pb[1] ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+Collect and sort the agent's vertex constraints into the workspace scratch space
+
+@param intervals Pointer to the SafeIntervals to fill
+@param workspace Pointer to the AStarWorkspace holding the agent's ConstraintIndex
+*/
+static void safe_intervals_build(SafeIntervals *intervals, AStarWorkspace *workspace)
+{
+    const ConstraintIndex *index = &workspace->index;
+    intervals->count = 0;
+    intervals->pairs = a_star_workspace_scratch(workspace, 2 * index->filtered.count);
+    for (int i = 0; i < index->filtered.count; ++i)
+    {
+        const Constraint *c = &index->filtered.items[i];
+        if (c->type != CONSTRAINT_VERTEX)
+        {
+            continue;
+        }
+        intervals->pairs[intervals->count * 2] = c->vertex;
+        intervals->pairs[intervals->count * 2 + 1] = c->time;
+        intervals->count++;
+    }
+    if (intervals->count > 1)
+    {
+        qsort(intervals->pairs, (size_t)intervals->count, sizeof(int) * 2, compare_pairs);
+    }
+
+    // drop duplicate constraints so every interval is non-empty or detectably empty
+    int write = 0;
+    for (int i = 0; i < intervals->count; ++i)
+    {
+        if (write > 0 && compare_pairs(&intervals->pairs[i * 2], &intervals->pairs[(write - 1) * 2]) == 0)
+        {
+            continue;
+        }
+        intervals->pairs[write * 2] = intervals->pairs[i * 2];
+        intervals->pairs[write * 2 + 1] = intervals->pairs[i * 2 + 1];
+        write++;
+    }
+    intervals->count = write;
+}
+
+/*
+Find the constrained times of a cell
+
+@param intervals Pointer to the SafeIntervals
+@param cell Linear cell index
+@param first Output index of the first pair of the cell
+@return Number of constrained times of the cell
+*/
+static int safe_intervals_times(const SafeIntervals *intervals, int cell, int *first)
+{
+    int lo = 0;
+    int hi = intervals->count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (intervals->pairs[mid * 2] < cell)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    *first = lo;
+    int end = lo;
+    while (end < intervals->count && intervals->pairs[end * 2] == cell)
+    {
+        end++;
+    }
+    return end - lo;
+}
+
+/*
+Get the bounds of one safe interval of a cell
+
+@param intervals Pointer to the SafeIntervals
+@param first Index of the first pair of the cell
+@param times Number of constrained times of the cell
+@param interval Interval index in [0, times]
+@param out_start Output first safe timestep
+@param out_end Output last safe timestep (SIPP_INFINITY for the last interval)
+*/
+static void safe_interval_bounds(const SafeIntervals *intervals, int first, int times, int interval, int *out_start, int *out_end)
+{
+    *out_start = interval == 0 ? 0 : intervals->pairs[(first + interval - 1) * 2 + 1] + 1;
+    *out_end = interval == times ? SIPP_INFINITY : intervals->pairs[(first + interval) * 2 + 1] - 1;
+}
+
+/*
+Rebuild the timestep-by-timestep path, inserting the waits implied by each
+arrival time, by following parent indices
+
+@param buffer Pointer to the AStarNodeBuffer of (cell, interval) nodes
+@param goal_index Index of the goal node
+@param width Grid width used to linearize cells
+@param path Pointer to the AgentPath to store the reconstructed path
+*/
+static void sipp_reconstruct_path(const AStarNodeBuffer *buffer, int goal_index, int width, AgentPath *path)
+{
+    int length = buffer->nodes[goal_index].time + 1;
+    path_reserve(path, length);
+    path->length = length;
+
+    int idx = goal_index;
+    while (idx >= 0)
+    {
+        const AStarNode *node = &buffer->nodes[idx];
+        path->steps[node->time] = node->position.y * width + node->position.x;
+        if (node->parent_index >= 0)
+        {
+            const AStarNode *parent = &buffer->nodes[node->parent_index];
+            for (int t = parent->time + 1; t < node->time; ++t)
+            {
+                path->steps[t] = parent->position.y * width + parent->position.x;
+            }
+        }
+        idx = node->parent_index;
+    }
+}
+
+/*
+Safe Interval Path Planning.
+Searches over (cell, safe interval) states instead of (cell, time), so
+waiting is folded into the arrival time of the next interval instead of
+creating one node per timestep. Nodes reuse AStarNode with g_cost equal
+to the earliest arrival time in the interval.
+
+@param grid Pointer to the Grid
+@param constraints Pointer to the ConstraintSet
+@param start Starting GridCoord
+@param goal Goal GridCoord
+@param heuristic Exact goal distance table for this agent (NULL uses Manhattan distance)
+@param agent_id ID of the agent
+@param workspace Reusable search memory (NULL allocates a temporary one)
+@param out_path Pointer to the AgentPath to store the found path
+@return true if a path is found, false otherwise
+*/
+bool sipp_plan(const Grid *grid,
+               const ConstraintSet *constraints,
+               GridCoord start,
+               GridCoord goal,
+               const int *heuristic,
+               int agent_id,
+               AStarWorkspace *workspace,
+               AgentPath *out_path)
+{
+    double sipp_start = wall_time_seconds();
+    LOG_TRACE("[SIPP] Starting SIPP for agent %d (start=%d,%d goal=%d,%d)\n",
+              agent_id, start.x, start.y, goal.x, goal.y);
+
+    int start_h = heuristic_lookup(heuristic, grid, start, goal);
+    if (start_h == HEURISTIC_UNREACHABLE)
+    {
+        LOG_DEBUG("[SIPP] agent=%d: goal unreachable from start\n", agent_id);
+        return false;
+    }
+
+    AStarWorkspace local_workspace;
+    if (workspace == NULL)
+    {
+        a_star_workspace_init(&local_workspace);
+        workspace = &local_workspace;
+    }
+    a_star_workspace_reset(workspace);
+    AStarNodeBuffer *buffer = &workspace->buffer;
+    BucketQueue *open = &workspace->open;
+    StateTable *best_arrival = &workspace->closed;
+    ConstraintIndex *index = &workspace->index;
+    constraint_index_build(index, constraints, agent_id);
+
+    SafeIntervals intervals;
+    safe_intervals_build(&intervals, workspace);
+
+    // same arrival bound as the time-expanded search
+    int max_time = heuristic != NULL ? 2 * (index->last_time + 1) + start_h : INT_MAX;
+
+    int goal_cell = goal.y * grid->width + goal.x;
+    int start_cell = start.y * grid->width + start.x;
+    int first = 0;
+    int start_times = safe_intervals_times(&intervals, start_cell, &first);
+    int start_begin = 0;
+    int start_end = 0;
+    safe_interval_bounds(&intervals, first, start_times, 0, &start_begin, &start_end);
+    if (start_end >= 0)
+    {
+        AStarNode root = {.position = start, .g_cost = 0, .f_cost = start_h, .parent_index = -1, .time = 0, .interval = 0};
+        int root_index = a_star_buffer_add(buffer, root);
+        bucket_queue_push(open, root.f_cost, root_index);
+        state_table_improve(best_arrival, 0, start_cell, 0);
+    }
+
+    bool found = false;
+    int goal_index = -1;
+    long long iterations = 0;
+
+    while (open->count > 0)
+    {
+        iterations++;
+        int node_index = bucket_queue_pop(open, NULL);
+        AStarNode node = buffer->nodes[node_index];
+        int node_cell = node.position.y * grid->width + node.position.x;
+
+        int node_first = 0;
+        int node_times = safe_intervals_times(&intervals, node_cell, &node_first);
+        int interval_begin = 0;
+        int interval_end = 0;
+        safe_interval_bounds(&intervals, node_first, node_times, node.interval, &interval_begin, &interval_end);
+
+        // the agent can only stop at the goal in its unbounded last interval
+        if (node_cell == goal_cell && node.interval == node_times)
+        {
+            found = true;
+            goal_index = node_index;
+            break;
+        }
+
+        // waiting is implicit in the safe intervals, only steps change the cell
+        int m = 0;
+        for (unsigned int mask = grid_moves(grid, node_cell) & GRID_MOVE_STEPS; mask != 0; mask >>= 1, ++m)
+        {
+            if ((mask & 1u) == 0)
+            {
+                continue;
+            }
+            GridCoord next = grid_apply_move(node.position, m);
+            int h = heuristic_lookup(heuristic, grid, next, goal);
+            if (h == HEURISTIC_UNREACHABLE)
+            {
+                continue;
+            }
+            int next_cell = grid_move_cell(grid, node_cell, m);
+            int next_first = 0;
+            int next_times = safe_intervals_times(&intervals, next_cell, &next_first);
+            for (int j = 0; j <= next_times; ++j)
+            {
+                int next_begin = 0;
+                int next_end = 0;
+                safe_interval_bounds(&intervals, next_first, next_times, j, &next_begin, &next_end);
+                if (next_begin > next_end)
+                {
+                    continue;
+                }
+                // later intervals start after the agent has to leave its current cell
+                if (interval_end != SIPP_INFINITY && next_begin > interval_end + 1)
+                {
+                    break;
+                }
+                int departure = node.time > next_begin - 1 ? node.time : next_begin - 1;
+                int latest = interval_end;
+                if (next_end != SIPP_INFINITY && next_end - 1 < latest)
+                {
+                    latest = next_end - 1;
+                }
+                // edge constraints only forbid single departure times, wait them out
+                while (departure <= latest && constraint_index_contains(index, departure, node_cell, next_cell))
+                {
+                    departure++;
+                }
+                if (departure > latest)
+                {
+                    continue;
+                }
+                int arrival = departure + 1;
+                if (arrival + h > max_time)
+                {
+                    continue;
+                }
+                if (!state_table_improve(best_arrival, j, next_cell, arrival))
+                {
+                    continue;
+                }
+                AStarNode child = {.position = next,
+                                   .g_cost = arrival,
+                                   .f_cost = arrival + h,
+                                   .parent_index = node_index,
+                                   .time = arrival,
+                                   .interval = j};
+                int child_index = a_star_buffer_add(buffer, child);
+                bucket_queue_push(open, child.f_cost, child_index);
+            }
+        }
+    }
+
+    if (found)
+    {
+        sipp_reconstruct_path(buffer, goal_index, grid->width, out_path);
+    }
+
+    double sipp_end = wall_time_seconds();
+    LOG_DEBUG("[SIPP] agent=%d: %s in %.3fs (%lld iterations, %d nodes)\n",
+              agent_id, found ? "SUCCESS" : "FAILED", sipp_end - sipp_start, iterations, buffer->count);
+    profile_ll_call(sipp_end - sipp_start, iterations);
+
+    if (workspace == &local_workspace)
+    {
+        a_star_workspace_free(&local_workspace);
+    }
+    return found;
+}
@@ -0,0 +1,185 @@
+#include "state_table.h"
+
+#include <stdio.h>
+
+#include <string.h>
+
+#define STATE_TABLE_INITIAL_CAPACITY 1024
+
+static inline uint64_t state_key(int time, int cell)
+{
+    return ((uint64_t)(uint32_t)time << 32) | (uint64_t)(uint32_t)cell;
+}
+
+static inline size_t state_slot(uint64_t key, int capacity)
+{
+    // splitmix64 finalizer spreads the consecutive cells of one time layer
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    key ^= key >> 31;
+    return (size_t)key & (size_t)(capacity - 1);
+}
+
+/*
+Allocate the slot arrays of a StateTable and mark every slot empty
+
+@param table Pointer to the StateTable
+@param capacity Number of slots (power of two)
+*/
+static void state_table_allocate(StateTable *table, int capacity)
+{
+    table->keys = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)capacity);
+    table->values = (int *)malloc(sizeof(int) * (size_t)capacity);
+    table->stamps = (uint32_t *)calloc((size_t)capacity, sizeof(uint32_t));
+    if (!table->keys || !table->values || !table->stamps)
+    {
+        fprintf(stderr, "state_table_allocate: failed to allocate StateTable (size=%d)\n", capacity);
+        exit(EXIT_FAILURE);
+    }
+    table->generation = 1;
+    table->capacity = capacity;
+    table->count = 0;
+}
+
+/*
+Double the number of slots and rehash every occupied slot
+
+@param table Pointer to the StateTable
+*/
+static void state_table_grow(StateTable *table)
+{
+    uint64_t *old_keys = table->keys;
+    int *old_values = table->values;
+    uint32_t *old_stamps = table->stamps;
+    uint32_t old_generation = table->generation;
+    int old_capacity = table->capacity;
+
+    state_table_allocate(table, old_capacity * 2);
+    for (int i = 0; i < old_capacity; ++i)
+    {
+        if (old_stamps[i] != old_generation)
+        {
+            continue;
+        }
+        size_t slot = state_slot(old_keys[i], table->capacity);
+        while (table->stamps[slot] == table->generation)
+        {
+            slot = (slot + 1) & (size_t)(table->capacity - 1);
+        }
+        table->keys[slot] = old_keys[i];
+        table->values[slot] = old_values[i];
+        table->stamps[slot] = table->generation;
+        table->count++;
+    }
+    free(old_keys);
+    free(old_values);
+    free(old_stamps);
+}
+
+/*
+Initialize an empty StateTable
+
+@param table Pointer to the StateTable to initialize
+*/
+void state_table_init(StateTable *table)
+{
+    state_table_allocate(table, STATE_TABLE_INITIAL_CAPACITY);
+}
+
+/*
+Free memory used by StateTable
+
+@param table Pointer to the StateTable to free
+*/
+void state_table_free(StateTable *table)
+{
+    free(table->keys);
+    free(table->values);
+    free(table->stamps);
+    table->keys = NULL;
+    table->values = NULL;
+    table->stamps = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+/*
+Remove every state while keeping the allocated slots for the next search
+
+@param table Pointer to the StateTable to clear
+*/
+void state_table_clear(StateTable *table)
+{
+    table->count = 0;
+    table->generation++;
+    // stale stamps could match again after wrap-around, so reset them once
+    if (table->generation == 0)
+    {
+        memset(table->stamps, 0, sizeof(uint32_t) * (size_t)table->capacity);
+        table->generation = 1;
+    }
+}
+
+/*
+Record a g-cost for a (time, cell) state if it improves on the stored one
+
+@param table Pointer to the StateTable
+@param time Time step of the state
+@param cell Linear cell index of the state
+@param g_cost Cost from start to the state
+@return true if the state was new or g_cost is lower than the stored cost
+*/
+bool state_table_improve(StateTable *table, int time, int cell, int g_cost)
+{
+    // keep the load factor at or below one half
+    if ((table->count + 1) * 2 > table->capacity)
+    {
+        state_table_grow(table);
+    }
+
+    uint64_t key = state_key(time, cell);
+    size_t slot = state_slot(key, table->capacity);
+    while (table->stamps[slot] == table->generation)
+    {
+        if (table->keys[slot] == key)
+        {
+            if (table->values[slot] <= g_cost)
+            {
+                return false;
+            }
+            table->values[slot] = g_cost;
+            return true;
+        }
+        slot = (slot + 1) & (size_t)(table->capacity - 1);
+    }
+    table->keys[slot] = key;
+    table->values[slot] = g_cost;
+    table->stamps[slot] = table->generation;
+    table->count++;
+    return true;
+}
+
+/*
+Check whether a (time, cell) state has been recorded
+
+@param table Pointer to the StateTable
+@param time Time step of the state
+@param cell Linear cell index of the state
+@return true if the state is in the table
+*/
+bool state_table_contains(const StateTable *table, int time, int cell)
+{
+    uint64_t key = state_key(time, cell);
+    size_t slot = state_slot(key, table->capacity);
+    while (table->stamps[slot] == table->generation)
+    {
+        if (table->keys[slot] == key)
+        {
+            return true;
+        }
+        slot = (slot + 1) & (size_t)(table->capacity - 1);
+    }
+    return false;
+}
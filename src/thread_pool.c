@@ -0,0 +1,225 @@
+#include "thread_pool.h"
+
+#if defined(CBS_THREADS_PTHREADS)
+#include <pthread.h>
+#elif defined(CBS_THREADS_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(CBS_THREADS_PTHREADS)
+
+/* Shared state of the pthreads backend, guarded by lock */
+struct ThreadPoolState
+{
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    /** Signalled when a loop starts or the pool stops */
+    pthread_cond_t work_ready;
+    /** Signalled when the last helper thread leaves a loop */
+    pthread_cond_t work_done;
+    ThreadTask task;
+    void *context;
+    int task_count;
+    /** Next unclaimed task of the current loop */
+    int next_task;
+    /** Helper threads still inside the current loop */
+    int active;
+    /** Loop counter, helpers wait for it to change */
+    unsigned int generation;
+    bool stopping;
+};
+
+typedef struct
+{
+    struct ThreadPoolState *state;
+    int thread_index;
+} HelperArgs;
+
+/*
+Claim and run tasks of the current loop until none are left.
+Called and returns with state->lock held.
+
+@param state Pointer to the pool state
+@param thread_index Index of the calling thread
+*/
+static void run_claimed_tasks(struct ThreadPoolState *state, int thread_index)
+{
+    while (state->next_task < state->task_count)
+    {
+        int task_index = state->next_task++;
+        pthread_mutex_unlock(&state->lock);
+        state->task(state->context, task_index, thread_index);
+        pthread_mutex_lock(&state->lock);
+    }
+}
+
+static void *helper_main(void *arg)
+{
+    HelperArgs args = *(HelperArgs *)arg;
+    free(arg);
+    struct ThreadPoolState *state = args.state;
+    unsigned int seen = 0;
+    pthread_mutex_lock(&state->lock);
+    while (1)
+    {
+        while (!state->stopping && state->generation == seen)
+        {
+            pthread_cond_wait(&state->work_ready, &state->lock);
+        }
+        if (state->stopping)
+        {
+            break;
+        }
+        seen = state->generation;
+        run_claimed_tasks(state, args.thread_index);
+        if (--state->active == 0)
+        {
+            pthread_cond_signal(&state->work_done);
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+    return NULL;
+}
+
+#endif
+
+/*
+Start a thread pool. Without a threading backend the pool runs every
+loop on the caller and thread_count is forced to 1.
+
+@param pool Pointer to the ThreadPool to initialize
+@param thread_count Number of threads including the caller
+*/
+void thread_pool_init(ThreadPool *pool, int thread_count)
+{
+    pool->thread_count = thread_count < 1 ? 1 : thread_count;
+    pool->state = NULL;
+#if defined(CBS_THREADS_PTHREADS)
+    if (pool->thread_count == 1)
+    {
+        return;
+    }
+    struct ThreadPoolState *state = (struct ThreadPoolState *)calloc(1, sizeof(struct ThreadPoolState));
+    if (!state)
+    {
+        fprintf(stderr, "thread_pool_init: failed to allocate pool state\n");
+        exit(EXIT_FAILURE);
+    }
+    state->threads = (pthread_t *)malloc(sizeof(pthread_t) * (size_t)(pool->thread_count - 1));
+    if (!state->threads)
+    {
+        fprintf(stderr, "thread_pool_init: failed to allocate threads (count=%d)\n", pool->thread_count);
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_cond_init(&state->work_ready, NULL);
+    pthread_cond_init(&state->work_done, NULL);
+    for (int i = 0; i < pool->thread_count - 1; ++i)
+    {
+        HelperArgs *args = (HelperArgs *)malloc(sizeof(HelperArgs));
+        if (!args)
+        {
+            fprintf(stderr, "thread_pool_init: failed to allocate thread arguments\n");
+            exit(EXIT_FAILURE);
+        }
+        args->state = state;
+        args->thread_index = i + 1;
+        if (pthread_create(&state->threads[i], NULL, helper_main, args) != 0)
+        {
+            fprintf(stderr, "thread_pool_init: failed to start thread %d\n", i + 1);
+            exit(EXIT_FAILURE);
+        }
+    }
+    pool->state = state;
+#elif !defined(CBS_THREADS_OPENMP)
+    pool->thread_count = 1;
+#endif
+}
+
+/*
+Stop the threads of the pool
+
+@param pool Pointer to the ThreadPool to free
+*/
+void thread_pool_free(ThreadPool *pool)
+{
+#if defined(CBS_THREADS_PTHREADS)
+    struct ThreadPoolState *state = pool->state;
+    if (state)
+    {
+        pthread_mutex_lock(&state->lock);
+        state->stopping = true;
+        pthread_cond_broadcast(&state->work_ready);
+        pthread_mutex_unlock(&state->lock);
+        for (int i = 0; i < pool->thread_count - 1; ++i)
+        {
+            pthread_join(state->threads[i], NULL);
+        }
+        pthread_mutex_destroy(&state->lock);
+        pthread_cond_destroy(&state->work_ready);
+        pthread_cond_destroy(&state->work_done);
+        free(state->threads);
+        free(state);
+    }
+#endif
+    pool->state = NULL;
+    pool->thread_count = 1;
+}
+
+/*
+Run task(context, i, thread) for every i below task_count and return once
+all of them finished. Tasks must be independent of each other.
+
+@param pool Pointer to the ThreadPool
+@param task_count Number of tasks
+@param task Task function
+@param context Caller data passed to every task
+*/
+void thread_pool_run(ThreadPool *pool, int task_count, ThreadTask task, void *context)
+{
+    if (pool == NULL || pool->thread_count == 1 || task_count <= 1)
+    {
+        for (int i = 0; i < task_count; ++i)
+        {
+            task(context, i, 0);
+        }
+        return;
+    }
+#if defined(CBS_THREADS_PTHREADS)
+    struct ThreadPoolState *state = pool->state;
+    pthread_mutex_lock(&state->lock);
+    state->task = task;
+    state->context = context;
+    state->task_count = task_count;
+    state->next_task = 0;
+    state->active = pool->thread_count - 1;
+    state->generation++;
+    pthread_cond_broadcast(&state->work_ready);
+    run_claimed_tasks(state, 0);
+    while (state->active > 0)
+    {
+        pthread_cond_wait(&state->work_done, &state->lock);
+    }
+    pthread_mutex_unlock(&state->lock);
+#elif defined(CBS_THREADS_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) num_threads(pool->thread_count)
+    for (int i = 0; i < task_count; ++i)
+    {
+        task(context, i, omp_get_thread_num());
+    }
+#endif
+}
+
+/*
+@return Name of the threading backend compiled in
+*/
+const char *thread_pool_backend(void)
+{
+#if defined(CBS_THREADS_PTHREADS)
+    return "pthreads";
+#elif defined(CBS_THREADS_OPENMP)
+    return "openmp";
+#else
+    return "none";
+#endif
+}
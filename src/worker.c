@@ -1,151 +1,190 @@
 #define _DEFAULT_SOURCE  /* For usleep() on Linux */
 #include "worker.h"
 
+#include "log.h"
 #include "messages.h"
+#include "node_store.h"
 #include "parallel_a_star.h"
+#include "profile.h"
 #include "serialization.h"
 
 #include <stdio.h>
 #include <limits.h>
 #include <unistd.h>
 
-static HighLevelNode *clone_parent_node(const HighLevelNode *parent)
+/*
+Replan the constrained agent of each child in one low-level batch
+
+@param instance Pointer to the ProblemInstance
+@param children Children to replan
+@param agents Agent to replan per child
+@param count Number of children
+@param ll_ctx Pointer to the LowLevelContext
+@param out_ok Output success flag per child
+*/
+static void replan_children(const ProblemInstance *instance,
+                            HighLevelNode **children,
+                            const int *agents,
+                            int count,
+                            const LowLevelContext *ll_ctx,
+                            bool *out_ok)
 {
-    HighLevelNode *clone = cbs_node_create(parent->num_agents);
-    if (!clone)
-    {
-        return NULL;
-    }
-    clone->parent_id = parent->id;
-    clone->depth = parent->depth + 1;
-    clone->cost = parent->cost;
-    for (int i = 0; i < parent->constraints.count; ++i)
+    PathRef *new_paths[2];
+    AgentPath *outputs[2];
+    const HighLevelNode *nodes[2];
+    for (int i = 0; i < count; ++i)
     {
-        constraint_set_add(&clone->constraints, parent->constraints.items[i]);
+        new_paths[i] = path_ref_create();
+        outputs[i] = &new_paths[i]->path;
+        nodes[i] = children[i];
     }
-    for (int i = 0; i < parent->num_agents; ++i)
+    low_level_request_paths(instance, nodes, agents, count, ll_ctx, outputs, out_ok);
+    for (int i = 0; i < count; ++i)
     {
-        path_copy(&clone->paths[i], &parent->paths[i]);
+        if (out_ok[i])
+        {
+            cbs_node_set_path(children[i], agents[i], new_paths[i]);
+        }
+        else
+        {
+            path_ref_release(new_paths[i]);
+        }
     }
-    return clone;
 }
 
-static bool append_constraint(HighLevelNode *node, Constraint constraint)
+/*
+Per-rank state of an expansion worker
+*/
+typedef struct
 {
-    constraint_set_add(&node->constraints, constraint);
-    return true;
-}
+    const ProblemInstance *instance;
+    const LowLevelContext *ll_ctx;
+    int coordinator_rank;
+    int world_rank;
+    int world_size;
+    /** Whether children stay in the local store and only handles go to the coordinator */
+    bool resident;
+    /** Lowest incumbent cost heard of (INT_MAX if none) */
+    int incumbent_bound;
+    /** Reply buffer for solutions and children */
+    NodeBatch reply_batch;
+    /** Buffer of nodes forwarded to another worker */
+    NodeBatch forward_batch;
+    PendingSendPool send_pool;
+    /** Recent tasks, delta bases for later tasks; owns every queued task */
+    NodeWindow task_window;
+    /** Tasks received but not yet expanded, in arrival order */
+    HighLevelNode *pending[TASK_WINDOW_SIZE];
+    int pending_head;
+    int pending_count;
+    /** Resident children waiting for the coordinator to schedule them */
+    NodeStore store;
+    /** Sequence number of the last resident child */
+    int next_local_id;
+} WorkerState;
 
-static bool replan_agent_path(const ProblemInstance *instance,
-                              HighLevelNode *node,
-                              int agent_id,
-                              const LowLevelContext *ll_ctx)
+static void update_bound(WorkerState *state, int bound)
 {
-    AgentPath new_path;
-    path_init(&new_path, 0);
-    bool ok = low_level_request_path(instance,
-                                     &node->constraints,
-                                     agent_id,
-                                     ll_ctx,
-                                     &new_path);
-    if (!ok)
+    if (bound <= 0 || bound >= state->incumbent_bound)
     {
-        path_free(&new_path);
-        return false;
+        return;
     }
-    path_free(&node->paths[agent_id]);
-    node->paths[agent_id] = new_path;
-    return true;
+    state->incumbent_bound = bound;
+    // the coordinator drops the same handles when it pops them
+    int pruned = state->resident ? node_store_prune(&state->store, (double)bound) : 0;
+    LOG_DEBUG("[Worker %d] Updated incumbent bound to %d (pruned %d resident node(s))\n",
+              state->world_rank, bound, pruned);
 }
 
-static Constraint make_vertex_constraint(const Conflict *conflict, int agent_id)
+static void send_handles(const WorkerState *state, const NodeHandle *handles, int count)
 {
-    Constraint c = {.agent_id = agent_id,
-                    .time = conflict->time,
-                    .type = CONSTRAINT_VERTEX,
-                    .vertex = conflict->position,
-                    .edge_to = conflict->position};
-    return c;
+    MPI_Send(handles,
+             (int)(sizeof(NodeHandle) * (size_t)count),
+             MPI_BYTE,
+             state->coordinator_rank,
+             TAG_HANDLES,
+             solver_comm);
 }
 
-static Constraint make_edge_constraint(const HighLevelNode *node,
-                                       const Conflict *conflict,
-                                       int agent_id)
+static bool process_node(WorkerState *state, HighLevelNode *node)
 {
-    Constraint c = {.agent_id = agent_id,
-                    .time = conflict->time,
-                    .type = CONSTRAINT_EDGE,
-                    .vertex = conflict->position,
-                    .edge_to = conflict->edge_to};
-    if (agent_id == conflict->agent_b)
-    {
-        GridCoord from = path_step_at(&node->paths[agent_id], conflict->time);
-        GridCoord to = path_step_at(&node->paths[agent_id], conflict->time + 1);
-        c.vertex = from;
-        c.edge_to = to;
-    }
-    return c;
-}
+    const ProblemInstance *instance = state->instance;
+    int worker_rank = state->world_rank;
+    int incumbent_cost = state->incumbent_bound;
+    NodeBatch *batch = &state->reply_batch;
 
-static bool process_node(const ProblemInstance *instance,
-                         const LowLevelContext *ll_ctx,
-                         HighLevelNode *node,
-                         int incumbent_cost,
-                         int coordinator_rank,
-                         int worker_rank,
-                         PendingSendPool *send_pool)
-{
     node->cost = cbs_compute_soc(node);
-    printf("[Worker %d] Expanding node id=%d depth=%d cost=%.0f\n",
-           worker_rank,
-           node->id,
-           node->depth,
-           node->cost);
-    fflush(stdout);
+    LOG_DEBUG("[Worker %d] Expanding node id=%d depth=%d cost=%.0f\n",
+              worker_rank,
+              node->id,
+              node->depth,
+              node->cost);
     double process_start = MPI_Wtime();
-    printf("[Worker %d] [START] Processing node id=%d depth=%d cost=%.0f\n",
-           worker_rank, node->id, node->depth, node->cost);
-    fflush(stdout);
+    LOG_TRACE("[Worker %d] [START] Processing node id=%d depth=%d cost=%.0f\n",
+              worker_rank, node->id, node->depth, node->cost);
     Conflict conflict;
     if (incumbent_cost > 0 && node->cost >= (double)incumbent_cost)
     {
-        printf("[Worker %d] Skipping node id=%d cost=%.0f due to incumbent %d\n",
-               worker_rank, node->id, node->cost, incumbent_cost);
-        fflush(stdout);
+        LOG_DEBUG("[Worker %d] Skipping node id=%d cost=%.0f due to incumbent %d\n",
+                  worker_rank, node->id, node->cost, incumbent_cost);
+        // the coordinator counts one reply per task, so a pruned node still answers with no children
+        if (state->resident)
+        {
+            send_handles(state, NULL, 0);
+        }
+        else
+        {
+            node_batch_reset(batch, node->id);
+            node_batch_send_async(state->coordinator_rank, TAG_CHILDREN, batch, &state->send_pool);
+        }
         return false;
     }
-    if (!cbs_detect_conflict(node, &conflict))
+    profile_hl_expand();
+    cbs_prepare_mdds(node, instance, state->ll_ctx->threads);
+    if (!cbs_select_conflict(node, instance, &conflict, NULL))
     {
-        SerializedNode payload;
-        serialize_high_level_node(node, &payload);
-        send_serialized_node(coordinator_rank, TAG_SOLUTION, &payload);
-        free_serialized_node(&payload);
-        printf("[Worker %d] Found valid solution at cost=%.0f (node id=%d)\n",
-               worker_rank,
-               node->cost,
-               node->id);
-        fflush(stdout);
+        // the coordinator still holds a dispatched task, so the solution is sent as an empty delta;
+        // a resident node is unknown to it and goes in full
+        node_batch_reset(batch, node->id);
+        if (state->resident)
+        {
+            node_batch_append(batch, node);
+        }
+        else
+        {
+            node_batch_append_delta(batch, node, node);
+        }
+        node_batch_send(state->coordinator_rank, TAG_SOLUTION, batch);
+        LOG_INFO("[Worker %d] Found valid solution at cost=%.0f (node id=%d)\n",
+                 worker_rank,
+                 node->cost,
+                 node->id);
         return true;
     }
 
-    HighLevelNode *children[2] = {NULL, NULL};
-    int child_agents[2] = {conflict.agent_a, conflict.agent_b};
-    int produced = 0;
-
+    HighLevelNode *candidates[2] = {NULL, NULL};
+    int candidate_agents[2];
+    int candidate_count = 0;
+    int conflict_agents[2] = {conflict.agent_a, conflict.agent_b};
     for (int idx = 0; idx < 2; ++idx)
     {
-        HighLevelNode *child = clone_parent_node(node);
-        if (!child)
+        HighLevelNode *child = cbs_node_create_child(node, cbs_conflict_constraint(node, &conflict, conflict_agents[idx]));
+        if (child)
         {
-            continue;
+            candidates[candidate_count] = child;
+            candidate_agents[candidate_count++] = conflict_agents[idx];
         }
+    }
+    // both replans go to the low-level pool at once
+    bool replanned[2] = {false, false};
+    replan_children(instance, candidates, candidate_agents, candidate_count, state->ll_ctx, replanned);
 
-        Constraint c = conflict.is_vertex_conflict
-                           ? make_vertex_constraint(&conflict, child_agents[idx])
-                           : make_edge_constraint(node, &conflict, child_agents[idx]);
-        append_constraint(child, c);
-
-        if (!replan_agent_path(instance, child, child_agents[idx], ll_ctx))
+    HighLevelNode *children[2] = {NULL, NULL};
+    int produced = 0;
+    for (int idx = 0; idx < candidate_count; ++idx)
+    {
+        HighLevelNode *child = candidates[idx];
+        if (!replanned[idx])
         {
             cbs_node_free(child);
             continue;
@@ -161,110 +200,207 @@ static bool process_node(const ProblemInstance *instance,
         children[produced++] = child;
     }
 
-    printf("[Worker %d] Conflict agents=(%d,%d) time=%d -> %d child(ren)\n",
-           worker_rank,
-           conflict.agent_a,
-           conflict.agent_b,
-           conflict.time,
-           produced);
-    fflush(stdout);
+    LOG_DEBUG("[Worker %d] Conflict agents=(%d,%d) time=%d -> %d child(ren)\n",
+              worker_rank,
+              conflict.agent_a,
+              conflict.agent_b,
+              conflict.time,
+              produced);
 
-    MPI_Send(&produced, 1, MPI_INT, coordinator_rank, TAG_CHILDREN, MPI_COMM_WORLD);
-
-    for (int i = 0; i < produced; ++i)
+    if (state->resident)
     {
-        HighLevelNode *child = children[i];
-        child->id = -1;
-        SerializedNode payload;
-        serialize_high_level_node(child, &payload);
-        payload.aux_value = node->id;
-        send_serialized_node_async(coordinator_rank, TAG_CHILDREN, &payload, send_pool);
-        free_serialized_node(&payload);
-        cbs_node_free(child);
+        // children stay here, the coordinator only schedules their handles
+        NodeHandle handles[2];
+        for (int i = 0; i < produced; ++i)
+        {
+            HighLevelNode *child = children[i];
+            child->id = ++state->next_local_id * state->world_size + worker_rank;
+            handles[i] = (NodeHandle){.cost = child->cost,
+                                      .id = child->id,
+                                      .owner = worker_rank,
+                                      .conflicts = cbs_count_conflicts(child),
+                                      .depth = child->depth};
+            node_store_put(&state->store, child);
+        }
+        send_handles(state, handles, produced);
+    }
+    else
+    {
+        // all children of the expansion travel in one message tagged with the parent id,
+        // each as a delta against the parent the coordinator keeps until this reply
+        node_batch_reset(batch, node->id);
+        for (int i = 0; i < produced; ++i)
+        {
+            HighLevelNode *child = children[i];
+            child->id = -1;
+            node_batch_append_delta(batch, child, node);
+            cbs_node_free(child);
+        }
+        node_batch_send_async(state->coordinator_rank, TAG_CHILDREN, batch, &state->send_pool);
     }
 
     double process_end = MPI_Wtime();
-    printf("[Worker %d] [END] Processed node id=%d in %.3fs, produced %d children\n",
-           worker_rank, node->id, process_end - process_start, produced);
-    fflush(stdout);
+    LOG_TRACE("[Worker %d] [END] Processed node id=%d in %.3fs, produced %d children\n",
+              worker_rank, node->id, process_end - process_start, produced);
     
     return false;
 }
 
+static HighLevelNode *dequeue_task(WorkerState *state)
+{
+    HighLevelNode *node = state->pending[state->pending_head];
+    state->pending_head = (state->pending_head + 1) % TASK_WINDOW_SIZE;
+    state->pending_count--;
+    return node;
+}
+
+static void enqueue_task(WorkerState *state, HighLevelNode *node)
+{
+    if (state->pending_count == TASK_WINDOW_SIZE)
+    {
+        // never let a queued task leave the window before it is expanded
+        process_node(state, dequeue_task(state));
+    }
+    // every task enters the window in arrival order, mirroring the coordinator
+    node_window_push(&state->task_window, node);
+    state->pending[(state->pending_head + state->pending_count) % TASK_WINDOW_SIZE] = node;
+    state->pending_count++;
+}
+
+/*
+Expand a resident node locally or forward it to another worker
+
+@param state Pointer to the WorkerState
+@param request Expand request: node id, incumbent bound, forward rank (-1 to expand here)
+*/
+static void handle_expand(WorkerState *state, const int *request)
+{
+    update_bound(state, request[1]);
+    HighLevelNode *node = node_store_take(&state->store, request[0]);
+    if (!node)
+    {
+        fprintf(stderr, "handle_expand: worker %d does not hold node %d\n", state->world_rank, request[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (request[2] < 0)
+    {
+        enqueue_task(state, node);
+        return;
+    }
+    LOG_DEBUG("[Worker %d] Forwarding node id=%d to worker %d\n", state->world_rank, node->id, request[2]);
+    node_batch_reset(&state->forward_batch, state->incumbent_bound);
+    node_batch_append(&state->forward_batch, node);
+    node_batch_send_async(request[2], TAG_TASK, &state->forward_batch, &state->send_pool);
+    cbs_node_free(node);
+}
+
 void run_worker(const ProblemInstance *instance,
                 const LowLevelContext *ll_ctx,
-                int coordinator_rank)
+                int coordinator_rank,
+                bool resident_nodes)
 {
-    int world_rank = 0;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    WorkerState state;
+    state.instance = instance;
+    state.coordinator_rank = coordinator_rank;
+    MPI_Comm_rank(solver_comm, &state.world_rank);
+    MPI_Comm_size(solver_comm, &state.world_size);
+    state.resident = resident_nodes;
+    state.incumbent_bound = INT_MAX;
+    state.pending_head = 0;
+    state.pending_count = 0;
+    state.next_local_id = 0;
+    int world_rank = state.world_rank;
 
     /* Initialize pending send pool for async MPI operations */
-    PendingSendPool send_pool;
-    pending_send_pool_init(&send_pool);
+    pending_send_pool_init(&state.send_pool);
+
+    /* Low-level calls made by this worker share one search workspace */
+    AStarWorkspace workspace;
+    a_star_workspace_init(&workspace);
+    LowLevelContext local_ctx = *ll_ctx;
+    local_ctx.workspace = &workspace;
+    state.ll_ctx = &local_ctx;
 
-    int incumbent_bound = INT_MAX;
+    /* Task messages are received into one reusable buffer */
+    NodeBatch task_batch;
+    node_batch_init(&task_batch);
+    node_batch_init(&state.reply_batch);
+    node_batch_init(&state.forward_batch);
+
+    /* Recent tasks serve as delta bases for later tasks */
+    node_window_init(&state.task_window, TASK_WINDOW_SIZE);
+    node_store_init(&state.store);
 
     int active = 1;
     while (active)
     {
         /* Progress any pending async sends */
-        pending_send_pool_progress(&send_pool);
+        pending_send_pool_progress(&state.send_pool);
 
-        /* Use non-blocking probe to allow checking for termination */
+        /* Block while idle, otherwise take every queued message before expanding.
+           Tasks may also come from a peer forwarding a resident node. */
         MPI_Status status;
         int flag = 0;
-        MPI_Iprobe(coordinator_rank, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+        if (state.pending_count == 0)
+        {
+            double idle_start = profile_start();
+            MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, solver_comm, &status);
+            profile_stop(PROFILE_IDLE, idle_start);
+            flag = 1;
+        }
+        else
+        {
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, solver_comm, &flag, &status);
+        }
         
         if (!flag)
         {
-            /* No message available, sleep briefly to avoid busy-waiting */
-            usleep(1000);  /* 1ms */
+            process_node(&state, dequeue_task(&state));
             continue;
         }
         
         double worker_time = MPI_Wtime();
-        printf("[Worker %d] [t=%.1fs] Received message (tag=%d)\n",
-                world_rank, worker_time, status.MPI_TAG);
-        fflush(stdout);
+        LOG_TRACE("[Worker %d] [t=%.1fs] Received message (tag=%d) from rank %d\n",
+                   world_rank, worker_time, status.MPI_TAG, status.MPI_SOURCE);
         if (status.MPI_TAG == TAG_TERMINATE)
         {
-            MPI_Recv(NULL, 0, MPI_INT, coordinator_rank, TAG_TERMINATE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(NULL, 0, MPI_INT, coordinator_rank, TAG_TERMINATE, solver_comm, MPI_STATUS_IGNORE);
             active = 0;
             break;
         }
         else if (status.MPI_TAG == TAG_INCUMBENT)
         {
             int new_incumbent = INT_MAX;
-            MPI_Recv(&new_incumbent, 1, MPI_INT, coordinator_rank, TAG_INCUMBENT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            if (new_incumbent < incumbent_bound)
-            {
-                incumbent_bound = new_incumbent;
-                printf("[Worker %d] Updated incumbent bound to %d\n", world_rank, incumbent_bound);
-                fflush(stdout);
-            }
+            MPI_Recv(&new_incumbent, 1, MPI_INT, coordinator_rank, TAG_INCUMBENT, solver_comm, MPI_STATUS_IGNORE);
+            update_bound(&state, new_incumbent);
             continue;
         }
+        else if (status.MPI_TAG == TAG_EXPAND)
+        {
+            int request[3] = {0, 0, -1};
+            MPI_Recv(request, 3, MPI_INT, coordinator_rank, TAG_EXPAND, solver_comm, MPI_STATUS_IGNORE);
+            handle_expand(&state, request);
+        }
         else if (status.MPI_TAG == TAG_TASK)
         {
-            SerializedNode received;
-            receive_serialized_node(coordinator_rank, TAG_TASK, &received, NULL);
-            int incumbent_cost = received.aux_value;
-            if (incumbent_cost > 0 && incumbent_cost < incumbent_bound)
-            {
-                incumbent_bound = incumbent_cost;
-            }
-            HighLevelNode *node = deserialize_high_level_node(&received);
-            free_serialized_node(&received);
-            if (!node)
+            node_batch_receive(status.MPI_SOURCE, TAG_TASK, &task_batch, NULL);
+            // the header carries the sender's incumbent, also in tasks without nodes
+            update_bound(&state, task_batch.aux_value);
+            int cursor = 0;
+            HighLevelNode *node = NULL;
+            while ((node = node_batch_next(&task_batch, &cursor, &state.task_window)) != NULL)
             {
-                continue;
+                enqueue_task(&state, node);
             }
-
-            process_node(instance, ll_ctx, node, incumbent_bound, coordinator_rank, world_rank, &send_pool);
-            cbs_node_free(node);
         }
     }
 
     /* Wait for any remaining pending sends to complete before exiting */
-    pending_send_pool_wait_all(&send_pool);
+    pending_send_pool_free(&state.send_pool);
+    node_batch_free(&task_batch);
+    node_batch_free(&state.reply_batch);
+    node_batch_free(&state.forward_batch);
+    node_window_free(&state.task_window);
+    node_store_free(&state.store);
+    a_star_workspace_free(&workspace);
 }
@@ -4,10 +4,12 @@ CBS Results Visualization Pipeline
 
 Compares performance metrics across Serial, Centralized, and Decentralized CBS implementations.
 Calculates speedup and efficiency for parallel versions run with 16 MPI processors.
+With --scaling, summarizes the strong- and weak-scaling runs of run_scaling.sh instead.
 
 Author: Generated for ParallelCBS project
 """
 
+import argparse
 import pandas as pd
 import matplotlib.pyplot as plt
 import numpy as np
@@ -603,6 +605,183 @@ def export_comparison_csv(merged_central, merged_decentral):
     
     print("✓ Saved comparison_central.csv and comparison_decentral.csv")
 
+def load_scaling_runs(path):
+    """Load the runs of run_scaling.sh and match every parallel run with the serial run of its instance."""
+    runs = pd.read_csv(path)
+    runs = runs.dropna(subset=['solver'])
+
+    # The serial baseline of an instance is the serial run of the same study, instance and agent count
+    serial = runs[runs['solver'] == 'serial'][['study', 'instance', 'agents', 'status', 'runtime_sec', 'nodes_expanded']]
+    serial = serial.drop_duplicates(subset=['study', 'instance', 'agents'], keep='last')
+    parallel = runs[runs['solver'] != 'serial'].copy()
+    merged = parallel.merge(serial, on=['study', 'instance', 'agents'], how='left', suffixes=('', '_serial'))
+
+    # Decentralized ranks are all peers, the other solvers also differ by their low-level pool
+    merged['config'] = np.where(merged['solver'] == 'decentral',
+                                merged['solver'],
+                                merged['solver'] + ' (pool ' + merged['ll_pool'].astype(str) + ')')
+    return merged
+
+def calculate_scaling_metrics(merged):
+    """Calculate speedup, efficiency, search overhead, load imbalance and communication volume per run."""
+    solved = (merged['status'] == 'success') & (merged['status_serial'] == 'success') & (merged['runtime_sec'] > 0)
+    merged['solved'] = solved
+    merged['speedup'] = np.where(solved, merged['runtime_sec_serial'] / merged['runtime_sec'], np.nan)
+    merged['efficiency'] = merged['speedup'] / merged['procs'] * 100
+    # Extra CT nodes expanded over the serial search of the same instance, in percent
+    merged['search_overhead'] = np.where(solved & (merged['nodes_expanded_serial'] > 0),
+                                         (merged['nodes_expanded'] / merged['nodes_expanded_serial'] - 1) * 100,
+                                         np.nan)
+    merged['nodes_per_rank'] = merged['hl_expanded_mean']
+    # Most CT nodes expanded by one rank over the mean of the expanding ranks, idle ones included
+    merged['imbalance'] = np.where(merged['hl_expanded_mean'] > 0,
+                                   merged['hl_expanded_max'] / merged['hl_expanded_mean'],
+                                   np.nan)
+    merged['comm_mb'] = merged['comm_bytes'] / 1e6
+    merged['comm_bytes_per_node'] = np.where(merged['nodes_expanded'] > 0,
+                                             merged['comm_bytes'] / merged['nodes_expanded'],
+                                             np.nan)
+
+    # Weak efficiency: runtime at the smallest rank count over the runtime with proportionally more work
+    merged['weak_efficiency'] = np.nan
+    weak_mask = (merged['study'] == 'weak') & (merged['status'] == 'success')
+    weak = merged[weak_mask]
+    if len(weak) > 0:
+        base_index = weak.groupby(['instance', 'config'])['procs'].idxmin()
+        base_runtime = weak.loc[base_index].set_index(['instance', 'config'])['runtime_sec']
+        keys = pd.MultiIndex.from_frame(weak[['instance', 'config']])
+        merged.loc[weak_mask, 'weak_efficiency'] = base_runtime.reindex(keys).values / weak['runtime_sec'].values * 100
+    return merged
+
+def summarize_scaling(merged, study):
+    """Average the metrics of a study per solver configuration and rank count."""
+    data = merged[merged['study'] == study]
+    if len(data) == 0:
+        return pd.DataFrame()
+    summary = data.groupby(['config', 'procs']).agg(
+        expanders=('expanders', 'first'),
+        ll_pool=('ll_pool', 'first'),
+        agents=('agents', 'mean'),
+        runs=('status', 'size'),
+        solved=('solved', 'sum'),
+        runtime_sec=('runtime_sec', 'mean'),
+        speedup=('speedup', 'mean'),
+        efficiency_pct=('efficiency', 'mean'),
+        weak_efficiency_pct=('weak_efficiency', 'mean'),
+        search_overhead_pct=('search_overhead', 'mean'),
+        nodes_per_rank=('nodes_per_rank', 'mean'),
+        imbalance=('imbalance', 'mean'),
+        comm_mb=('comm_mb', 'mean'),
+        comm_bytes_per_node=('comm_bytes_per_node', 'mean'),
+        idle_sec_mean=('idle_sec_mean', 'mean'),
+    ).reset_index()
+    if study == 'strong':
+        summary = summary.drop(columns=['weak_efficiency_pct'])
+    return summary.round(4)
+
+def plot_scaling_panels(summary, study, panels, filename):
+    """Plot one line per solver configuration against the rank count for each metric in panels."""
+    fig, axes = plt.subplots(2, 2, figsize=(14, 10))
+    axes = axes.flatten()
+    configs = sorted(summary['config'].unique())
+    procs = sorted(summary['procs'].unique())
+
+    for ax, (column, label, ideal) in zip(axes, panels):
+        for config in configs:
+            config_data = summary[summary['config'] == config].sort_values('procs')
+            ax.plot(config_data['procs'], config_data[column], marker='o', label=config, linewidth=2, markersize=8)
+        if ideal == 'procs':
+            ax.plot(procs, procs, color='green', linestyle='--', label='Ideal', alpha=0.5)
+        elif ideal is not None:
+            ax.axhline(y=ideal, color='green', linestyle='--', label='Ideal', alpha=0.5)
+        ax.set_xlabel('MPI Ranks', fontsize=12)
+        ax.set_ylabel(label, fontsize=12)
+        ax.set_xscale('log', base=2)
+        ax.set_xticks(procs)
+        ax.set_xticklabels(procs)
+        ax.legend(fontsize=8)
+        ax.grid(True, alpha=0.3)
+
+    plt.suptitle(f'{study.capitalize()} Scaling', fontsize=14, y=1.02)
+    plt.tight_layout()
+    plt.savefig(OUTPUT_DIR / f'{filename}.png', dpi=150, bbox_inches='tight')
+    plt.savefig(OUTPUT_DIR / f'{filename}.pdf', bbox_inches='tight')
+    plt.close()
+    print(f"✓ Saved {filename}.png/pdf")
+
+def generate_scaling_summary(strong, weak):
+    """Report where each solver configuration stops scaling."""
+    summary = []
+    summary.append("=" * 70)
+    summary.append("CBS SCALING SUMMARY")
+    summary.append("=" * 70)
+
+    for name, data, column in [('Strong', strong, 'speedup'), ('Weak', weak, 'weak_efficiency_pct')]:
+        if len(data) == 0:
+            continue
+        summary.append(f"\n--- {name} Scaling ---")
+        for config in sorted(data['config'].unique()):
+            config_data = data[data['config'] == config].sort_values('procs')
+            summary.append(f"{config}:")
+            for _, row in config_data.iterrows():
+                line = f"  {int(row['procs']):4} ranks: {int(row['solved'])}/{int(row['runs'])} solved"
+                if name == 'Strong':
+                    line += f", speedup {row['speedup']:.2f}x, efficiency {row['efficiency_pct']:.1f}%"
+                else:
+                    line += f", {row['agents']:.0f} agents, weak efficiency {row['weak_efficiency_pct']:.1f}%"
+                line += (f", overhead {row['search_overhead_pct']:.1f}%, imbalance {row['imbalance']:.2f}"
+                         f", comm {row['comm_mb']:.2f} MB")
+                summary.append(line)
+            if config_data[column].notna().any():
+                peak = config_data.loc[config_data[column].idxmax()]
+                summary.append(f"  Peak at {int(peak['procs'])} ranks ({column} {peak[column]:.2f})")
+
+    summary.append("\n" + "=" * 70)
+    summary_text = "\n".join(summary)
+    print(summary_text)
+
+    with open(OUTPUT_DIR / 'scaling_summary.txt', 'w') as f:
+        f.write(summary_text)
+    print(f"\n✓ Saved scaling_summary.txt")
+
+def scaling_main(path):
+    """Scaling study pipeline: per-run metrics, strong and weak summaries and their plots."""
+    print("=" * 50)
+    print("CBS Scaling Visualization")
+    print("=" * 50)
+
+    OUTPUT_DIR.mkdir(exist_ok=True)
+    print(f"\nOutput directory: {OUTPUT_DIR.absolute()}")
+
+    print("\n--- Loading runs ---")
+    merged = calculate_scaling_metrics(load_scaling_runs(path))
+    print(f"Parallel runs: {len(merged)} ({int(merged['solved'].sum())} solved with a solved serial baseline)")
+    merged.to_csv(OUTPUT_DIR / 'scaling_runs_metrics.csv', index=False)
+
+    strong = summarize_scaling(merged, 'strong')
+    weak = summarize_scaling(merged, 'weak')
+
+    print("\n--- Generating plots ---")
+    if len(strong) > 0:
+        strong.to_csv(OUTPUT_DIR / 'scaling_strong.csv', index=False)
+        plot_scaling_panels(strong, 'strong',
+                            [('speedup', 'Speedup (Serial / Parallel)', 'procs'),
+                             ('efficiency_pct', 'Efficiency (%)', 100),
+                             ('search_overhead_pct', 'Search Overhead (% extra CT nodes)', 0),
+                             ('imbalance', 'Load Imbalance (max / mean CT nodes per rank)', 1)],
+                            'scaling_strong')
+    if len(weak) > 0:
+        weak.to_csv(OUTPUT_DIR / 'scaling_weak.csv', index=False)
+        plot_scaling_panels(weak, 'weak',
+                            [('weak_efficiency_pct', 'Weak Efficiency (%)', 100),
+                             ('runtime_sec', 'Runtime (seconds)', None),
+                             ('comm_bytes_per_node', 'Node Batch Bytes per CT Node', None),
+                             ('imbalance', 'Load Imbalance (max / mean CT nodes per rank)', 1)],
+                            'scaling_weak')
+
+    print("\n--- Generating summary ---")
+    generate_scaling_summary(strong, weak)
+
 def main():
     """Main visualization pipeline."""
     print("=" * 50)
@@ -653,4 +832,11 @@ def main():
     print("=" * 50)
 
 if __name__ == "__main__":
-    main()
+    parser = argparse.ArgumentParser(description="CBS results visualization")
+    parser.add_argument('--scaling', metavar='CSV',
+                        help="Summarize the scaling_runs.csv of run_scaling.sh instead of the final results")
+    args = parser.parse_args()
+    if args.scaling:
+        scaling_main(Path(args.scaling))
+    else:
+        main()